@@ -353,6 +353,7 @@ LOCAL_SRC_FILES := \
 	bluez/monitor/ll.c \
 	bluez/monitor/hwdb.c \
 	bluez/monitor/keys.c \
+	bluez/monitor/filter.c \
 	bluez/monitor/ellisys.c \
 	bluez/monitor/analyze.c \
 	bluez/monitor/intel.c \
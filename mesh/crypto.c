@@ -792,7 +792,8 @@ bool mesh_crypto_payload_decrypt(uint8_t *aad, uint16_t aad_len,
 	return true;
 }
 
-static bool mesh_crypto_packet_encrypt(uint8_t *packet, uint8_t packet_len,
+static bool mesh_crypto_packet_encrypt(const uint8_t *clear,
+				uint8_t *packet, uint8_t packet_len,
 				const uint8_t network_key[16],
 				uint32_t iv_index, bool proxy,
 				bool ctl, uint8_t ttl, uint32_t seq,
@@ -810,13 +811,13 @@ static bool mesh_crypto_packet_encrypt(uint8_t *packet, uint8_t packet_len,
 	if (ctl) {
 		if (!mesh_crypto_aes_ccm_encrypt(nonce, network_key,
 					NULL, 0,
-					packet + 7, packet_len - 7 - 8,
+					clear + 7, packet_len - 7 - 8,
 					packet + 7, NULL, 8))
 			return false;
 	} else {
 		if (!mesh_crypto_aes_ccm_encrypt(nonce, network_key,
 					NULL, 0,
-					packet + 7, packet_len - 7 - 4,
+					clear + 7, packet_len - 7 - 4,
 					packet + 7, NULL, 4))
 			return false;
 	}
@@ -839,8 +840,8 @@ bool mesh_crypto_packet_encode(uint8_t *packet, uint8_t packet_len,
 						&ctl, &ttl, &seq, &src, &dst))
 		return false;
 
-	if (!mesh_crypto_packet_encrypt(packet, packet_len, network_key,
-							iv_index, !dst,
+	if (!mesh_crypto_packet_encrypt(packet, packet, packet_len,
+							network_key, iv_index, !dst,
 							ctl, ttl, seq, src))
 
 		return false;
@@ -849,6 +850,35 @@ bool mesh_crypto_packet_encode(uint8_t *packet, uint8_t packet_len,
 							ctl, ttl, seq, src);
 }
 
+/*
+ * Same as mesh_crypto_packet_encode(), but leaves the clear packet intact.
+ * The header (without DST) is taken from the output packet, which lets the
+ * caller change the TTL without first copying the whole clear packet.
+ */
+bool mesh_crypto_packet_encode_from(const uint8_t *clear, uint8_t *packet,
+				uint8_t packet_len, uint32_t iv_index,
+				const uint8_t network_key[16],
+				const uint8_t privacy_key[16])
+{
+	bool ctl;
+	uint8_t ttl;
+	uint32_t seq;
+	uint16_t src;
+
+	if (!network_header_parse(packet, packet_len,
+					&ctl, &ttl, &seq, &src, NULL))
+		return false;
+
+	if (!mesh_crypto_packet_encrypt(clear, packet, packet_len,
+						network_key, iv_index,
+						!l_get_be16(clear + 7),
+						ctl, ttl, seq, src))
+		return false;
+
+	return mesh_crypto_network_obfuscate(packet, privacy_key, iv_index,
+							ctl, ttl, seq, src);
+}
+
 static bool mesh_crypto_packet_decrypt(uint8_t *packet, uint8_t packet_len,
 				const uint8_t network_key[16],
 				uint32_t iv_index, bool proxy,
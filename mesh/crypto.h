@@ -94,6 +94,10 @@ bool mesh_crypto_packet_encode(uint8_t *packet, uint8_t packet_len,
 				uint32_t iv_index,
 				const uint8_t network_key[16],
 				const uint8_t privacy_key[16]);
+bool mesh_crypto_packet_encode_from(const uint8_t *clear, uint8_t *packet,
+				uint8_t packet_len, uint32_t iv_index,
+				const uint8_t network_key[16],
+				const uint8_t privacy_key[16]);
 bool mesh_crypto_packet_decode(const uint8_t *packet, uint8_t packet_len,
 				bool proxy, uint8_t *out, uint32_t iv_index,
 				const uint8_t network_key[16],
@@ -81,7 +81,7 @@ static void response_delay(struct l_timeout *timeout, void *user_data)
 
 	msg[n++] = NET_OP_FRND_OFFER;
 	msg[n++] = frnd_relay_window;
-	msg[n++] = frnd_cache_size;
+	msg[n++] = neg->cache_size;
 	msg[n++] = frnd_sublist_size;
 	msg[n++] = neg->u.negotiate.rssi;
 	l_put_be16(neg->fn_cnt, msg + n);
@@ -139,6 +139,7 @@ void friend_request(struct mesh_net *net, uint16_t net_idx, uint16_t src,
 	uint8_t rssiScale = (minReq >> 5) & 3;
 	uint8_t winScale = (minReq >> 3) & 3;
 	uint8_t minCache = (minReq >> 0) & 7;
+	uint8_t offer = frnd_cache_size;
 	int32_t rsp_delay;
 
 	l_debug("RSSI of Request: %d dbm", rssi);
@@ -146,8 +147,12 @@ void friend_request(struct mesh_net *net, uint16_t net_idx, uint16_t src,
 	l_debug("Poll Timeout of Request: %d ms", timeout * 100);
 	l_debug("Previous Friend: %4.4x", prev);
 	l_debug("Num Elem: %2.2x", num_ele);
+	/* Never offer more than is left in the Friend Queue pool */
+	if (mesh_friend_queue_avail() < offer)
+		offer = mesh_friend_queue_avail();
+
 	l_debug("Cache Requested: %d", cache_size(minCache));
-	l_debug("Cache to offer: %d", frnd_cache_size);
+	l_debug("Cache to offer: %d", offer);
 
 	/* Determine our own suitability before
 	 * deciding to participate in negotiation
@@ -161,7 +166,7 @@ void friend_request(struct mesh_net *net, uint16_t net_idx, uint16_t src,
 	if (timeout < 0x00000A || timeout > 0x34BBFF)
 		return;
 
-	if (cache_size(minCache) > frnd_cache_size)
+	if (cache_size(minCache) > offer)
 		return;
 
 	/* TODO: Check RSSI, and then start Negotiation if appropriate */
@@ -179,6 +184,7 @@ void friend_request(struct mesh_net *net, uint16_t net_idx, uint16_t src,
 	neg->old_friend = prev;
 	neg->ele_cnt = num_ele;
 	neg->net_idx = net_idx;
+	neg->cache_size = offer;
 
 	/* RSSI (Negative Factor, larger values == less time)
 	 * Scaling factor 0-3 == multiplier of 1.0 - 2.5
@@ -344,7 +350,7 @@ static void clear_retry(struct l_timeout *timeout, void *user_data)
 static void friend_delay_rsp(struct l_timeout *timeout, void *user_data)
 {
 	struct mesh_friend *frnd = user_data;
-	struct mesh_friend_msg *pkt = frnd->pkt;
+	struct mesh_friend_pdu *pkt = frnd->pkt;
 	struct mesh_net *net = frnd->net;
 	uint32_t net_seq, iv_index;
 	uint8_t upd[7] = { NET_OP_FRND_UPDATE };
@@ -359,63 +365,51 @@ static void friend_delay_rsp(struct l_timeout *timeout, void *user_data)
 		 * once it has been set because that would cause
 		 * a "Dirty Nonce" security violation
 		 */
-		if (((pkt->u.one[0].hdr >> OPCODE_HDR_SHIFT) & OPCODE_MASK) ==
+		if (((pkt->hdr >> OPCODE_HDR_SHIFT) & OPCODE_MASK) ==
 						NET_OP_SEG_ACKNOWLEDGE) {
-			bool rly = !!((pkt->u.one[0].hdr >> RELAY_HDR_SHIFT) &
-									true);
-			uint16_t seqZero = pkt->u.one[0].hdr >>
-							SEQ_ZERO_HDR_SHIFT;
+			bool rly = !!((pkt->hdr >> RELAY_HDR_SHIFT) & true);
+			uint16_t seqZero = pkt->hdr >> SEQ_ZERO_HDR_SHIFT;
 
 			seqZero &= SEQ_ZERO_MASK;
 
 			l_debug("Fwd ACK pkt %6.6x-%8.8x",
-					pkt->u.one[0].seq,
+					pkt->seq,
 					pkt->iv_index);
 
-			pkt->u.one[0].sent = true;
+			pkt->sent = true;
 			mesh_net_ack_send(net, frnd->net_key_cur,
 					pkt->iv_index, pkt->ttl,
-					pkt->u.one[0].seq, pkt->src, pkt->dst,
+					pkt->seq, pkt->src, pkt->dst,
 					rly, seqZero,
-					l_get_be32(pkt->u.one[0].data));
+					l_get_be32(pkt->data));
 
 
 		} else {
 			l_debug("Fwd CTL pkt %6.6x-%8.8x",
-					pkt->u.one[0].seq,
+					pkt->seq,
 					pkt->iv_index);
 
-			print_packet("Frnd-CTL",
-					pkt->u.one[0].data, pkt->last_len);
+			print_packet("Frnd-CTL", pkt->data, pkt->len);
 
-			pkt->u.one[0].sent = true;
+			pkt->sent = true;
 			mesh_net_transport_send(net, frnd->net_key_cur, 0,
 					pkt->iv_index, pkt->ttl,
-					pkt->u.one[0].seq, pkt->src, pkt->dst,
-					pkt->u.one[0].data, pkt->last_len);
+					pkt->seq, pkt->src, pkt->dst,
+					pkt->data, pkt->len);
 		}
 	} else {
-		/* If segments after this one, then More Data must be TRUE */
-		uint8_t len;
-
-		if (pkt->cnt_out < pkt->cnt_in)
-			len = sizeof(pkt->u.s12[0].data);
-		else
-			len = pkt->last_len;
-
-		l_debug("Fwd FRND pkt %6.6x",
-				pkt->u.s12[pkt->cnt_out].seq);
+		l_debug("Fwd FRND pkt %6.6x", pkt->seq);
 
-		print_packet("Frnd-Msg", pkt->u.s12[pkt->cnt_out].data, len);
+		print_packet("Frnd-Msg", pkt->data, pkt->len);
 
-		pkt->u.s12[pkt->cnt_out].sent = true;
+		pkt->sent = true;
 		mesh_net_send_seg(net, frnd->net_key_cur,
 				pkt->iv_index,
 				pkt->ttl,
-				pkt->u.s12[pkt->cnt_out].seq,
+				pkt->seq,
 				pkt->src, pkt->dst,
-				pkt->u.s12[pkt->cnt_out].hdr,
-				pkt->u.s12[pkt->cnt_out].data, len);
+				pkt->hdr,
+				pkt->data, pkt->len);
 	}
 
 	return;
@@ -443,7 +437,7 @@ void friend_poll(struct mesh_net *net, uint16_t src, bool seq,
 {
 	struct l_queue *negotiations = mesh_net_get_negotiations(net);
 	struct mesh_friend *neg;
-	struct mesh_friend_msg *pkt;
+	struct mesh_friend_pdu *pkt;
 	bool md;
 
 	l_debug("POLL-RXED");
@@ -459,7 +453,18 @@ void friend_poll(struct mesh_net *net, uint16_t src, bool seq,
 						neg->receive_delay,
 						neg->frw,
 						neg->poll_timeout,
-						neg->fn_cnt, neg->lp_cnt);
+						neg->fn_cnt, neg->lp_cnt,
+						neg->cache_size);
+
+		/* The offered Friend Queue no longer fits in the pool */
+		if (!frnd) {
+			l_timeout_remove(neg->timeout);
+			net_key_unref(neg->net_key_cur);
+			net_key_unref(neg->net_key_upd);
+			l_queue_remove(negotiations, neg);
+			l_free(neg);
+			return;
+		}
 
 		frnd->timeout = l_timeout_create_ms(
 					frnd->poll_timeout * 100,
@@ -498,48 +503,32 @@ void friend_poll(struct mesh_net *net, uint16_t src, bool seq,
 	/* Reset Poll Timeout */
 	l_timeout_modify_ms(frnd->timeout, frnd->poll_timeout * 100);
 
-	if (!l_queue_length(frnd->pkt_cache))
+	if (!frnd->cache_len)
 		goto update;
 
+	/* The LPN acknowledged the head PDU, which may be a segment */
 	if (frnd->u.active.seq != frnd->u.active.last &&
-						frnd->u.active.seq != seq) {
-		pkt = l_queue_peek_head(frnd->pkt_cache);
-		if (pkt->cnt_out < pkt->cnt_in) {
-			pkt->cnt_out++;
-		} else {
-			pkt = l_queue_pop_head(frnd->pkt_cache);
-			l_free(pkt);
-		}
-	}
+						frnd->u.active.seq != seq)
+		mesh_friend_queue_pop(frnd);
 
-	pkt = l_queue_peek_head(frnd->pkt_cache);
+	pkt = mesh_friend_queue_peek(frnd);
 
 	if (!pkt)
 		goto update;
 
 	frnd->u.active.seq = seq;
 	frnd->u.active.last = !seq;
-	md = !!(l_queue_length(frnd->pkt_cache) > 1);
 
-	if (pkt->ctl) {
-		/* Make sure we don't change the bit-sense of MD,
-		 * once it has been set because that would cause
-		 * a "Dirty Nonce" security violation
-		 */
-		if (!(pkt->u.one[0].sent))
-			pkt->u.one[0].md = md;
-	} else {
-		/* If segments after this one, then More Data must be TRUE */
-		if (pkt->cnt_out < pkt->cnt_in)
-			md = true;
+	/* If PDUs after this one, including segments, More Data is TRUE */
+	md = frnd->cache_len > 1;
+
+	/* Make sure we don't change the bit-sense of MD, once
+	 * it has been set because that would cause a
+	 * "Dirty Nonce" security violation
+	 */
+	if (!pkt->sent)
+		pkt->md = md;
 
-		/* Make sure we don't change the bit-sense of MD, once
-		 * it has been set because that would cause a
-		 * "Dirty Nonce" security violation
-		 */
-		if (!(pkt->u.s12[pkt->cnt_out].sent))
-			pkt->u.s12[pkt->cnt_out].md = md;
-	}
 	frnd->pkt = pkt;
 	l_timeout_create_ms(frnd->frd, friend_delay_rsp, frnd, NULL);
 
@@ -34,6 +34,177 @@ static const char *dev_key_dir = "/dev_keys";
 static const char *app_key_dir = "/app_keys";
 static const char *net_key_dir = "/net_keys";
 
+/*
+ * Keys are cached per node after the first lookup, so that only changes
+ * need to touch the key files. Each key type has its own hashmap keyed by
+ * the NetKey/AppKey index or the element unicast address. Lookups that
+ * found no key are cached as well, but only for KEYRING_NEG_TTL seconds
+ * and at most KEYRING_NEG_MAX of them per hashmap, so that messages from
+ * unknown sources cannot grow the cache.
+ */
+#define KEYRING_NEG_TTL	30
+#define KEYRING_NEG_MAX	64
+
+struct key_cache {
+	struct l_hashmap *keys;
+	unsigned int num_neg;
+};
+
+struct keyring_cache {
+	struct mesh_node *node;
+	struct key_cache dev_keys;
+	struct key_cache net_keys;
+	struct key_cache app_keys;
+};
+
+struct cached_key {
+	bool present;
+	uint64_t expire;
+	union {
+		uint8_t dev_key[16];
+		struct keyring_net_key net_key;
+		struct keyring_app_key app_key;
+	};
+};
+
+static struct l_queue *caches;
+
+static bool match_cache_node(const void *a, const void *b)
+{
+	const struct keyring_cache *cache = a;
+
+	return cache->node == b;
+}
+
+static struct key_cache *get_cache(struct mesh_node *node,
+							const char *key_dir)
+{
+	struct keyring_cache *cache;
+
+	if (!caches)
+		caches = l_queue_new();
+
+	cache = l_queue_find(caches, match_cache_node, node);
+	if (!cache) {
+		cache = l_new(struct keyring_cache, 1);
+		cache->node = node;
+		cache->dev_keys.keys = l_hashmap_new();
+		cache->net_keys.keys = l_hashmap_new();
+		cache->app_keys.keys = l_hashmap_new();
+		l_queue_push_tail(caches, cache);
+	}
+
+	if (key_dir == dev_key_dir)
+		return &cache->dev_keys;
+	else if (key_dir == net_key_dir)
+		return &cache->net_keys;
+	else
+		return &cache->app_keys;
+}
+
+/* Forget idx when the state of its key file is unknown */
+static void cache_remove(struct key_cache *cache, uint16_t idx)
+{
+	struct cached_key *entry;
+
+	entry = l_hashmap_remove(cache->keys, L_UINT_TO_PTR(idx));
+	if (!entry)
+		return;
+
+	if (!entry->present)
+		cache->num_neg--;
+
+	l_free(entry);
+}
+
+static bool cache_lookup(struct mesh_node *node, const char *key_dir,
+				uint16_t idx, void *key, size_t sz, bool *found)
+{
+	struct key_cache *cache = get_cache(node, key_dir);
+	struct cached_key *entry;
+
+	entry = l_hashmap_lookup(cache->keys, L_UINT_TO_PTR(idx));
+	if (!entry)
+		return false;
+
+	if (!entry->present && l_time_after(l_time_now(), entry->expire)) {
+		cache_remove(cache, idx);
+		return false;
+	}
+
+	if (entry->present)
+		memcpy(key, &entry->dev_key, sz);
+
+	*found = entry->present;
+
+	return true;
+}
+
+/* Passing a NULL key records that no key is stored for idx */
+static void cache_update(struct mesh_node *node, const char *key_dir,
+				uint16_t idx, const void *key, size_t sz)
+{
+	struct key_cache *cache = get_cache(node, key_dir);
+	struct cached_key *entry;
+
+	cache_remove(cache, idx);
+
+	if (!key && cache->num_neg >= KEYRING_NEG_MAX)
+		return;
+
+	entry = l_new(struct cached_key, 1);
+	entry->present = key != NULL;
+
+	if (key)
+		memcpy(&entry->dev_key, key, sz);
+	else {
+		entry->expire = l_time_offset(l_time_now(),
+					KEYRING_NEG_TTL * L_USEC_PER_SEC);
+		cache->num_neg++;
+	}
+
+	l_hashmap_insert(cache->keys, L_UINT_TO_PTR(idx), entry);
+}
+
+static void cache_drop(struct mesh_node *node, const char *key_dir,
+								uint16_t idx)
+{
+	cache_remove(get_cache(node, key_dir), idx);
+}
+
+static void cache_clear(struct key_cache *cache)
+{
+	l_hashmap_destroy(cache->keys, l_free);
+	cache->keys = l_hashmap_new();
+	cache->num_neg = 0;
+}
+
+static void free_cache(void *data)
+{
+	struct keyring_cache *cache = data;
+
+	l_hashmap_destroy(cache->dev_keys.keys, l_free);
+	l_hashmap_destroy(cache->net_keys.keys, l_free);
+	l_hashmap_destroy(cache->app_keys.keys, l_free);
+	l_free(cache);
+}
+
+void keyring_cleanup(struct mesh_node *node)
+{
+	struct keyring_cache *cache;
+
+	cache = l_queue_remove_if(caches, match_cache_node, node);
+	if (!cache)
+		return;
+
+	free_cache(cache);
+
+	if (l_queue_isempty(caches)) {
+		l_queue_destroy(caches, NULL);
+		caches = NULL;
+	}
+}
+
 static int open_key_file(struct mesh_node *node, const char *key_dir,
 							uint16_t idx, int flags)
 {
@@ -85,6 +256,11 @@ bool keyring_put_net_key(struct mesh_node *node, uint16_t net_idx,
 
 	close(fd);
 
+	if (result)
+		cache_update(node, net_key_dir, net_idx, key, sizeof(*key));
+	else
+		cache_drop(node, net_key_dir, net_idx);
+
 	return result;
 }
 
@@ -122,6 +298,11 @@ bool keyring_put_app_key(struct mesh_node *node, uint16_t app_idx,
 
 	close(fd);
 
+	if (result)
+		cache_update(node, app_key_dir, app_idx, key, sizeof(*key));
+	else
+		cache_drop(node, app_key_dir, app_idx);
+
 	return result;
 }
 
@@ -161,6 +342,9 @@ bool keyring_finalize_app_keys(struct mesh_node *node, uint16_t net_idx)
 	if (!node)
 		return false;
 
+	/* Cached AppKeys are reloaded from the finalized files on demand */
+	cache_clear(get_cache(node, app_key_dir));
+
 	node_path = node_get_storage_dir(node);
 
 	ret = snprintf(key_dir, PATH_MAX, "%s%s", node_path, app_key_dir);
@@ -221,13 +405,16 @@ bool keyring_put_remote_dev_key(struct mesh_node *node, uint16_t unicast,
 		l_debug("Put Dev Key %s", key_file);
 
 		fd = open(key_file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
-		if (fd >= 0) {
-			if (write(fd, dev_key, 16) != 16)
-				result = false;
+		if (fd >= 0 && write(fd, dev_key, 16) == 16)
+			cache_update(node, dev_key_dir, unicast + i, dev_key,
+									16);
+		else {
+			cache_drop(node, dev_key_dir, unicast + i);
+			result = false;
+		}
 
+		if (fd >= 0)
 			close(fd);
-		} else
-			result = false;
 	}
 
 	return result;
@@ -239,9 +426,12 @@ static bool get_key(struct mesh_node *node, const char *key_dir,
 	bool result = false;
 	int fd;
 
-	if (!key)
+	if (!key || !node)
 		return false;
 
+	if (cache_lookup(node, key_dir, key_idx, key, sz, &result))
+		return result;
+
 	fd = open_key_file(node, key_dir, key_idx, O_RDONLY);
 
 	if (fd >= 0) {
@@ -251,6 +441,8 @@ static bool get_key(struct mesh_node *node, const char *key_dir,
 		close(fd);
 	}
 
+	cache_update(node, key_dir, key_idx, result ? key : NULL, sz);
+
 	return result;
 }
 
@@ -280,6 +472,9 @@ bool keyring_get_remote_dev_key(struct mesh_node *node, uint16_t unicast,
 	if (!node)
 		return false;
 
+	if (cache_lookup(node, dev_key_dir, unicast, dev_key, 16, &result))
+		return result;
+
 	node_path = node_get_storage_dir(node);
 
 	ret = snprintf(key_file, PATH_MAX, "%s%s/%4.4x", node_path, dev_key_dir,
@@ -295,6 +490,8 @@ bool keyring_get_remote_dev_key(struct mesh_node *node, uint16_t unicast,
 		close(fd);
 	}
 
+	cache_update(node, dev_key_dir, unicast, result ? dev_key : NULL, 16);
+
 	return result;
 }
 
@@ -315,6 +512,7 @@ bool keyring_del_net_key(struct mesh_node *node, uint16_t net_idx)
 
 	l_debug("RM Net Key %s", key_file);
 	remove(key_file);
+	cache_update(node, net_key_dir, net_idx, NULL, 0);
 
 	/* TODO: See if it is easiest to delete all bound App keys here */
 	/* TODO: see nftw() */
@@ -339,6 +537,7 @@ bool keyring_del_app_key(struct mesh_node *node, uint16_t app_idx)
 
 	l_debug("RM App Key %s", key_file);
 	remove(key_file);
+	cache_update(node, app_key_dir, app_idx, NULL, 0);
 
 	return true;
 }
@@ -366,6 +565,7 @@ bool keyring_del_remote_dev_key(struct mesh_node *node, uint16_t unicast,
 
 		l_debug("RM Dev Key %s", key_file);
 		remove(key_file);
+		cache_update(node, dev_key_dir, unicast + i, NULL, 0);
 	}
 
 	return true;
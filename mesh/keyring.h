@@ -40,5 +40,6 @@ bool keyring_put_remote_dev_key(struct mesh_node *node, uint16_t unicast,
 bool keyring_del_remote_dev_key(struct mesh_node *node, uint16_t unicast,
 								uint8_t count);
 bool keyring_del_remote_dev_key_all(struct mesh_node *node, uint16_t unicast);
+void keyring_cleanup(struct mesh_node *node);
 bool keyring_build_export_keys_reply(struct mesh_node *node,
 					struct l_dbus_message_builder *builder);
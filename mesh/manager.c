@@ -54,7 +54,7 @@ struct scan_req {
 };
 
 static struct l_queue *scans;
-static struct prov_remote_data *prov_pending;
+static struct l_queue *prov_pending;
 static const uint8_t prvb[2] = {MESH_AD_TYPE_BEACON, 0x00};
 
 static bool by_scan(const void *a, const void *b)
@@ -62,6 +62,11 @@ static bool by_scan(const void *a, const void *b)
 	return a == b;
 }
 
+static bool by_pending(const void *a, const void *b)
+{
+	return a == b;
+}
+
 static bool by_node(const void *a, const void *b)
 {
 	const struct scan_req *req = a;
@@ -110,31 +115,36 @@ static void scan_cancel(struct l_timeout *timeout, void *user_data)
 	l_free(req);
 }
 
-static void free_pending_add_call(void)
+static void free_pending_add_call(struct prov_remote_data *pending)
 {
-	if (!prov_pending)
+	if (!l_queue_remove(prov_pending, pending))
 		return;
 
-	if (prov_pending->disc_watch)
-		l_dbus_remove_watch(dbus_get_bus(),
-						prov_pending->disc_watch);
+	if (pending->disc_watch)
+		l_dbus_remove_watch(dbus_get_bus(), pending->disc_watch);
+
+	if (pending->msg)
+		l_dbus_message_unref(pending->msg);
 
-	if (prov_pending->msg)
-		l_dbus_message_unref(prov_pending->msg);
+	l_free(pending);
 
-	l_free(prov_pending);
-	prov_pending = NULL;
+	if (l_queue_isempty(prov_pending)) {
+		l_queue_destroy(prov_pending, NULL);
+		prov_pending = NULL;
+	}
 }
 
 static void prov_disc_cb(struct l_dbus *bus, void *user_data)
 {
-	if (!prov_pending)
+	struct prov_remote_data *pending = user_data;
+
+	if (!l_queue_find(prov_pending, by_pending, pending))
 		return;
 
-	initiator_cancel(prov_pending);
-	prov_pending->disc_watch = 0;
+	initiator_cancel(pending);
+	pending->disc_watch = 0;
 
-	free_pending_add_call();
+	free_pending_add_call(pending);
 }
 
 static void append_dict_entry_basic(struct l_dbus_message_builder *builder,
@@ -152,8 +162,9 @@ static void append_dict_entry_basic(struct l_dbus_message_builder *builder,
 	l_dbus_message_builder_leave_dict(builder);
 }
 
-static void send_add_failed(const char *owner, const char *path,
-							uint8_t status)
+static void send_add_failed(struct prov_remote_data *pending,
+				const char *owner, const char *path,
+				uint8_t status)
 {
 	struct l_dbus *dbus = dbus_get_bus();
 	struct l_dbus_message_builder *builder;
@@ -164,14 +175,14 @@ static void send_add_failed(const char *owner, const char *path,
 						"AddNodeFailed");
 
 	builder = l_dbus_message_builder_new(msg);
-	dbus_append_byte_array(builder, prov_pending->uuid, 16);
+	dbus_append_byte_array(builder, pending->uuid, 16);
 	l_dbus_message_builder_append_basic(builder, 's',
 						mesh_prov_status_str(status));
 	l_dbus_message_builder_finalize(builder);
 	l_dbus_message_builder_destroy(builder);
 	l_dbus_send(dbus, msg);
 
-	free_pending_add_call();
+	free_pending_add_call(pending);
 }
 
 static bool add_cmplt(void *user_data, uint8_t status,
@@ -184,12 +195,12 @@ static bool add_cmplt(void *user_data, uint8_t status,
 	struct l_dbus_message *msg;
 	bool result;
 
-	if (pending != prov_pending)
+	if (!l_queue_find(prov_pending, by_pending, pending))
 		return false;
 
 	if (status != PROV_ERR_SUCCESS) {
-		send_add_failed(node_get_owner(node), node_get_app_path(node),
-									status);
+		send_add_failed(pending, node_get_owner(node),
+					node_get_app_path(node), status);
 		return false;
 	}
 
@@ -202,7 +213,8 @@ static bool add_cmplt(void *user_data, uint8_t status,
 					info->num_ele, info->device_key);
 
 	if (!result) {
-		send_add_failed(node_get_owner(node), node_get_app_path(node),
+		send_add_failed(pending, node_get_owner(node),
+						node_get_app_path(node),
 						PROV_ERR_CANT_ASSIGN_ADDR);
 		return false;
 	}
@@ -237,7 +249,7 @@ static bool add_cmplt(void *user_data, uint8_t status,
 
 	l_dbus_send(dbus, msg);
 
-	free_pending_add_call();
+	free_pending_add_call(pending);
 
 	return true;
 }
@@ -248,7 +260,7 @@ static void mgr_prov_data (struct l_dbus_message *reply, void *user_data)
 	uint16_t net_idx;
 	uint16_t primary;
 
-	if (pending != prov_pending)
+	if (!l_queue_find(prov_pending, by_pending, pending))
 		return;
 
 	if (l_dbus_message_is_error(reply))
@@ -278,7 +290,7 @@ static bool add_data_get(void *user_data, uint8_t num_ele)
 	const char *app_path;
 	const char *sender;
 
-	if (pending != prov_pending)
+	if (!l_queue_find(prov_pending, by_pending, pending))
 		return false;
 
 	dbus = dbus_get_bus();
@@ -310,20 +322,44 @@ static bool add_data_get(void *user_data, uint8_t num_ele)
 
 static void add_start(void *user_data, int err)
 {
+	struct prov_remote_data *pending = user_data;
 	struct l_dbus_message *reply;
 
 	l_debug("Start callback");
 
+	if (!l_queue_find(prov_pending, by_pending, pending))
+		return;
+
 	if (err == MESH_ERROR_NONE)
-		reply = l_dbus_message_new_method_return(prov_pending->msg);
+		reply = l_dbus_message_new_method_return(pending->msg);
 	else
-		reply = dbus_error(prov_pending->msg, MESH_ERROR_FAILED,
+		reply = dbus_error(pending->msg, MESH_ERROR_FAILED,
 				"Failed to start provisioning initiator");
 
 	l_dbus_send(dbus_get_bus(), reply);
-	l_dbus_message_unref(prov_pending->msg);
+	l_dbus_message_unref(pending->msg);
 
-	prov_pending->msg = NULL;
+	pending->msg = NULL;
+
+	/* The initiator has already given up on a failed start */
+	if (err != MESH_ERROR_NONE)
+		free_pending_add_call(pending);
+}
+
+static struct prov_remote_data *new_pending_add_call(struct mesh_node *node)
+{
+	struct prov_remote_data *pending;
+
+	pending = l_new(struct prov_remote_data, 1);
+	pending->node = node;
+	pending->agent = node_get_agent(node);
+
+	if (!prov_pending)
+		prov_pending = l_queue_new();
+
+	l_queue_push_tail(prov_pending, pending);
+
+	return pending;
 }
 
 static struct l_dbus_message *reprovision_call(struct l_dbus *dbus,
@@ -331,6 +367,7 @@ static struct l_dbus_message *reprovision_call(struct l_dbus *dbus,
 						void *user_data)
 {
 	struct mesh_node *node = user_data;
+	struct prov_remote_data *pending;
 	struct l_dbus_message_iter options, var;
 	struct l_dbus_message *reply;
 	struct mesh_net *net = node_get_net(node);
@@ -376,33 +413,33 @@ static struct l_dbus_message *reprovision_call(struct l_dbus *dbus,
 	manager_scan_cancel(node);
 
 	/* Invoke Prov Initiator */
-	prov_pending = l_new(struct prov_remote_data, 1);
+	pending = new_pending_add_call(node);
 
-	prov_pending->transport = nppi;
-	prov_pending->node = node;
-	prov_pending->original = server;
-	prov_pending->agent = node_get_agent(node);
+	pending->transport = nppi;
+	pending->original = server;
 
-	if (!node_is_provisioner(node) || (prov_pending->agent == NULL)) {
+	if (!node_is_provisioner(node) || (pending->agent == NULL)) {
 		reply = dbus_error(msg, MESH_ERROR_NOT_AUTHORIZED,
 							"Missing Interfaces");
 		goto fail;
 	}
 
-	prov_pending->msg = l_dbus_message_ref(msg);
-	initiator_start(prov_pending->transport, server, subidx, NULL, 99, 60,
-					prov_pending->agent, add_start,
+	if (!initiator_start(pending->transport, server, subidx, NULL, 99, 60,
+					pending->agent, add_start,
 					add_data_get, add_cmplt, node,
-					prov_pending);
+					pending)) {
+		reply = dbus_error(msg, MESH_ERROR_BUSY, NULL);
+		goto fail;
+	}
 
-	prov_pending->disc_watch = l_dbus_add_disconnect_watch(dbus,
+	pending->msg = l_dbus_message_ref(msg);
+	pending->disc_watch = l_dbus_add_disconnect_watch(dbus,
 						node_get_owner(node),
-						prov_disc_cb, NULL, NULL);
+						prov_disc_cb, pending, NULL);
 
 	return NULL;
 fail:
-	l_free(prov_pending);
-	prov_pending = NULL;
+	free_pending_add_call(pending);
 	return reply;
 }
 
@@ -411,6 +448,7 @@ static struct l_dbus_message *add_node_call(struct l_dbus *dbus,
 						void *user_data)
 {
 	struct mesh_node *node = user_data;
+	struct prov_remote_data *pending;
 	struct l_dbus_message_iter iter_uuid, options, var;
 	struct l_dbus_message *reply;
 	struct mesh_net *net = node_get_net(node);
@@ -465,47 +503,49 @@ static struct l_dbus_message *add_node_call(struct l_dbus *dbus,
 		return dbus_error(msg, MESH_ERROR_INVALID_ARGS,
 							"Invalid options");
 
-	/* If no server specified, use local */
-	if (!server)
-		server = node_get_primary(node);
+	/*
+	 * If no server specified, open the PB-ADV link locally. Unlike a
+	 * Remote Provisioning Server, this allows any number of devices to
+	 * be provisioned in parallel.
+	 */
 
 	/* AddNode cancels all outstanding Scanning from node */
 	manager_scan_cancel(node);
 
 	/* Invoke Prov Initiator */
-	prov_pending = l_new(struct prov_remote_data, 1);
+	pending = new_pending_add_call(node);
 
 	if (n)
-		memcpy(prov_pending->uuid, uuid, 16);
+		memcpy(pending->uuid, uuid, 16);
 	else
 		uuid = NULL;
 
-	prov_pending->transport = PB_ADV;
-	prov_pending->node = node;
-	prov_pending->agent = node_get_agent(node);
+	pending->transport = PB_ADV;
 
-	if (!node_is_provisioner(node) || (prov_pending->agent == NULL)) {
+	if (!node_is_provisioner(node) || (pending->agent == NULL)) {
 		l_debug("Provisioner: %d", node_is_provisioner(node));
-		l_debug("Agent: %p", prov_pending->agent);
+		l_debug("Agent: %p", pending->agent);
 		reply = dbus_error(msg, MESH_ERROR_NOT_AUTHORIZED,
 							"Missing Interfaces");
 		goto fail;
 	}
 
-	prov_pending->msg = l_dbus_message_ref(msg);
-	initiator_start(PB_ADV, server, subidx, uuid, 99, sec,
-					prov_pending->agent, add_start,
+	if (!initiator_start(PB_ADV, server, subidx, uuid, 99, sec,
+					pending->agent, add_start,
 					add_data_get, add_cmplt, node,
-					prov_pending);
+					pending)) {
+		reply = dbus_error(msg, MESH_ERROR_BUSY, NULL);
+		goto fail;
+	}
 
-	prov_pending->disc_watch = l_dbus_add_disconnect_watch(dbus,
+	pending->msg = l_dbus_message_ref(msg);
+	pending->disc_watch = l_dbus_add_disconnect_watch(dbus,
 						node_get_owner(node),
-						prov_disc_cb, NULL, NULL);
+						prov_disc_cb, pending, NULL);
 
 	return NULL;
 fail:
-	l_free(prov_pending);
-	prov_pending = NULL;
+	free_pending_add_call(pending);
 	return reply;
 }
 
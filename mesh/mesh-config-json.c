@@ -1313,6 +1313,9 @@ static void parse_features(json_object *jconfig, struct mesh_config_node *node)
 	int mode, count;
 	uint16_t interval;
 
+	node->modes.sar_tx = MESH_CONFIG_SAR_UNSET;
+	node->modes.sar_rx = MESH_CONFIG_SAR_UNSET;
+
 	if (json_object_object_get_ex(jconfig, "proxy", &jvalue)) {
 		mode = get_mode(jvalue);
 		if (mode <= MESH_MODE_UNSUPPORTED)
@@ -1350,6 +1353,12 @@ static void parse_features(json_object *jconfig, struct mesh_config_node *node)
 		}
 	}
 
+	if (json_object_object_get_ex(jconfig, "sarTransmitter", &jvalue))
+		node->modes.sar_tx = json_object_get_int(jvalue);
+
+	if (json_object_object_get_ex(jconfig, "sarReceiver", &jvalue))
+		node->modes.sar_rx = json_object_get_int(jvalue);
+
 	if (!json_object_object_get_ex(jconfig, "relay", &jrelay))
 		return;
 
@@ -1662,6 +1671,15 @@ bool mesh_config_write_mpb(struct mesh_config *cfg, uint8_t mode,
 	return save_config(cfg->jnode, cfg->node_dir_path);
 }
 
+bool mesh_config_write_sar(struct mesh_config *cfg, const char *keyword,
+								uint32_t value)
+{
+	if (!cfg || !write_int(cfg->jnode, keyword, value))
+		return false;
+
+	return save_config(cfg->jnode, cfg->node_dir_path);
+}
+
 bool mesh_config_write_net_transmit(struct mesh_config *cfg, uint8_t cnt,
 							uint16_t interval)
 {
@@ -1794,6 +1812,15 @@ static struct mesh_config *create_config(const char *cfg_path,
 			return NULL;
 	}
 
+	/* SAR Configuration, only stored once set by a Config Client */
+	if (modes->sar_tx != MESH_CONFIG_SAR_UNSET &&
+			!write_int(jnode, "sarTransmitter", modes->sar_tx))
+		return NULL;
+
+	if (modes->sar_rx != MESH_CONFIG_SAR_UNSET &&
+			!write_int(jnode, "sarReceiver", modes->sar_rx))
+		return NULL;
+
 	/* Sequence number */
 	json_object_object_add(jnode, sequenceNumber,
 					json_object_new_int(node->seq_number));
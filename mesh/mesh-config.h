@@ -50,6 +50,9 @@ struct mesh_config_element {
 	uint8_t index;
 };
 
+/* SAR state that was never configured, the daemon defaults apply */
+#define MESH_CONFIG_SAR_UNSET	0xffffffff
+
 struct mesh_config_modes {
 	struct {
 		uint16_t interval;
@@ -62,6 +65,8 @@ struct mesh_config_modes {
 	uint8_t beacon;
 	uint8_t mpb;
 	uint8_t mpb_period;
+	uint32_t sar_tx;
+	uint32_t sar_rx;
 };
 
 struct mesh_config_netkey {
@@ -144,6 +149,8 @@ bool mesh_config_write_relay_mode(struct mesh_config *cfg, uint8_t mode,
 					uint8_t count, uint16_t interval);
 bool mesh_config_write_mpb(struct mesh_config *cfg, uint8_t mode,
 								uint8_t period);
+bool mesh_config_write_sar(struct mesh_config *cfg, const char *keyword,
+								uint32_t value);
 bool mesh_config_write_ttl(struct mesh_config *cfg, uint8_t ttl);
 bool mesh_config_write_mode(struct mesh_config *cfg, const char *keyword,
 								int value);
@@ -15,7 +15,7 @@ typedef bool (*mesh_io_destroy_t)(struct mesh_io *io);
 typedef bool (*mesh_io_caps_t)(struct mesh_io *io, struct mesh_io_caps *caps);
 typedef bool (*mesh_io_send_t)(struct mesh_io *io,
 					struct mesh_io_send_info *info,
-					const uint8_t *data, uint16_t len);
+					struct mesh_io_pkt *pkt);
 typedef bool (*mesh_io_register_t)(struct mesh_io *io, const uint8_t *filter,
 					uint8_t len, mesh_io_recv_func_t cb,
 					void *user_data);
@@ -50,8 +50,7 @@ struct process_data {
 struct tx_pkt {
 	struct mesh_io_send_info	info;
 	bool				delete;
-	uint8_t				len;
-	uint8_t				pkt[30];
+	struct mesh_io_pkt		*pkt;
 };
 
 struct tx_pattern {
@@ -59,6 +58,17 @@ struct tx_pattern {
 	uint8_t				len;
 };
 
+static void tx_free(void *data)
+{
+	struct tx_pkt *tx = data;
+
+	if (!tx)
+		return;
+
+	mesh_io_pkt_unref(tx->pkt);
+	l_free(tx);
+}
+
 static uint32_t get_instant(void)
 {
 	struct timeval tm;
@@ -330,7 +340,7 @@ static bool find_by_ad_type(const void *a, const void *b)
 	const struct tx_pkt *tx = a;
 	uint8_t ad_type = L_PTR_TO_UINT(b);
 
-	return !ad_type || ad_type == tx->pkt[0];
+	return !ad_type || ad_type == tx->pkt->data[0];
 }
 
 static bool find_by_pattern(const void *a, const void *b)
@@ -338,10 +348,10 @@ static bool find_by_pattern(const void *a, const void *b)
 	const struct tx_pkt *tx = a;
 	const struct tx_pattern *pattern = b;
 
-	if (tx->len < pattern->len)
+	if (tx->pkt->len < pattern->len)
 		return false;
 
-	return (!memcmp(tx->pkt, pattern->data, pattern->len));
+	return (!memcmp(tx->pkt->data, pattern->data, pattern->len));
 }
 
 static bool find_active(const void *a, const void *b)
@@ -431,8 +441,8 @@ static bool dev_destroy(struct mesh_io *io)
 	bt_hci_unref(pvt->hci);
 	l_timeout_remove(pvt->tx_timeout);
 	l_queue_remove_if(pvt->tx_pkts, simple_match, pvt->tx);
-	l_queue_destroy(pvt->tx_pkts, l_free);
-	l_free(pvt->tx);
+	l_queue_destroy(pvt->tx_pkts, tx_free);
+	tx_free(pvt->tx);
 	l_free(pvt);
 	io->pvt = NULL;
 
@@ -514,14 +524,14 @@ static void set_send_adv_data(const void *buf, uint8_t size,
 		return;
 
 	tx = pvt->tx;
-	if (tx->len >= sizeof(cmd.data))
+	if (tx->pkt->len >= sizeof(cmd.data))
 		goto done;
 
 	memset(&cmd, 0, sizeof(cmd));
 
-	cmd.len = tx->len + 1;
-	cmd.data[0] = tx->len;
-	memcpy(cmd.data + 1, tx->pkt, tx->len);
+	cmd.len = tx->pkt->len + 1;
+	cmd.data[0] = tx->pkt->len;
+	memcpy(cmd.data + 1, tx->pkt->data, tx->pkt->len);
 
 	bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_ADV_DATA,
 					&cmd, sizeof(cmd),
@@ -529,7 +539,7 @@ static void set_send_adv_data(const void *buf, uint8_t size,
 done:
 	if (tx->delete) {
 		l_queue_remove_if(pvt->tx_pkts, simple_match, tx);
-		l_free(tx);
+		tx_free(tx);
 	}
 
 	pvt->tx = NULL;
@@ -568,7 +578,7 @@ static void send_pkt(struct mesh_io_private *pvt, struct tx_pkt *tx,
 	/* Delete superseded packet in favor of new packet */
 	if (pvt->tx && pvt->tx != tx && pvt->tx->delete) {
 		l_queue_remove_if(pvt->tx_pkts, simple_match, pvt->tx);
-		l_free(pvt->tx);
+		tx_free(pvt->tx);
 	}
 
 	pvt->tx = tx;
@@ -689,19 +699,18 @@ static void tx_worker(void *user_data)
 }
 
 static bool send_tx(struct mesh_io *io, struct mesh_io_send_info *info,
-					const uint8_t *data, uint16_t len)
+						struct mesh_io_pkt *pkt)
 {
 	struct mesh_io_private *pvt = io->pvt;
 	struct tx_pkt *tx;
 
-	if (!info || !data || !len || len > sizeof(tx->pkt))
+	if (!info || !pkt || !pkt->len)
 		return false;
 
 	tx = l_new(struct tx_pkt, 1);
 
 	memcpy(&tx->info, info, sizeof(tx->info));
-	memcpy(&tx->pkt, data, len);
-	tx->len = len;
+	tx->pkt = mesh_io_pkt_ref(pkt);
 
 	if (info->type == MESH_IO_TIMING_TYPE_POLL_RSP)
 		l_queue_push_head(pvt->tx_pkts, tx);
@@ -741,7 +750,7 @@ static bool tx_cancel(struct mesh_io *io, const uint8_t *data, uint8_t len)
 		do {
 			tx = l_queue_remove_if(pvt->tx_pkts, find_by_ad_type,
 							L_UINT_TO_PTR(data[0]));
-			l_free(tx);
+			tx_free(tx);
 
 			if (tx == pvt->tx)
 				pvt->tx = NULL;
@@ -756,7 +765,7 @@ static bool tx_cancel(struct mesh_io *io, const uint8_t *data, uint8_t len)
 		do {
 			tx = l_queue_remove_if(pvt->tx_pkts, find_by_pattern,
 								&pattern);
-			l_free(tx);
+			tx_free(tx);
 
 			if (tx == pvt->tx)
 				pvt->tx = NULL;
@@ -58,8 +58,7 @@ struct process_data {
 struct tx_pkt {
 	struct mesh_io_send_info	info;
 	bool				delete;
-	uint8_t				len;
-	uint8_t				pkt[30];
+	struct mesh_io_pkt		*pkt;
 };
 
 struct tx_pattern {
@@ -67,6 +66,17 @@ struct tx_pattern {
 	uint8_t				len;
 };
 
+static void tx_free(void *data)
+{
+	struct tx_pkt *tx = data;
+
+	if (!tx)
+		return;
+
+	mesh_io_pkt_unref(tx->pkt);
+	l_free(tx);
+}
+
 #define DUP_FILTER_TIME        1000
 /* Accept one instance of unique message a second */
 struct dup_filter {
@@ -279,7 +289,7 @@ static bool find_by_ad_type(const void *a, const void *b)
 	const struct tx_pkt *tx = a;
 	uint8_t ad_type = L_PTR_TO_UINT(b);
 
-	return !ad_type || ad_type == tx->pkt[0];
+	return !ad_type || ad_type == tx->pkt->data[0];
 }
 
 static bool find_by_pattern(const void *a, const void *b)
@@ -287,10 +297,10 @@ static bool find_by_pattern(const void *a, const void *b)
 	const struct tx_pkt *tx = a;
 	const struct tx_pattern *pattern = b;
 
-	if (tx->len < pattern->len)
+	if (tx->pkt->len < pattern->len)
 		return false;
 
-	return (!memcmp(tx->pkt, pattern->data, pattern->len));
+	return (!memcmp(tx->pkt->data, pattern->data, pattern->len));
 }
 
 static bool find_active(const void *a, const void *b)
@@ -462,7 +472,7 @@ static bool dev_destroy(struct mesh_io *io)
 	l_timeout_remove(pvt->tx_timeout);
 	l_timeout_remove(pvt->dup_timeout);
 	l_queue_destroy(pvt->dup_filters, l_free);
-	l_queue_destroy(pvt->tx_pkts, l_free);
+	l_queue_destroy(pvt->tx_pkts, tx_free);
 	io->pvt = NULL;
 	l_free(pvt);
 	pvt = NULL;
@@ -512,7 +522,7 @@ static void send_queued(uint8_t status, uint16_t length,
 
 	if (tx->delete) {
 		l_queue_remove_if(pvt->tx_pkts, simple_match, tx);
-		l_free(tx);
+		tx_free(tx);
 		pvt->tx = NULL;
 	}
 }
@@ -520,7 +530,7 @@ static void send_queued(uint8_t status, uint16_t length,
 static void send_pkt(struct mesh_io_private *pvt, struct tx_pkt *tx,
 							uint16_t interval)
 {
-	uint8_t buffer[sizeof(struct mgmt_cp_mesh_send) + tx->len + 1];
+	uint8_t buffer[sizeof(struct mgmt_cp_mesh_send) + tx->pkt->len + 1];
 	struct mgmt_cp_mesh_send *send = (void *) buffer;
 	uint16_t index;
 	size_t len;
@@ -536,17 +546,17 @@ static void send_pkt(struct mesh_io_private *pvt, struct tx_pkt *tx,
 	send->instant = 0;
 	send->delay = 0;
 	send->cnt = 1;
-	send->adv_data_len = tx->len + 1;
-	send->adv_data[0] = tx->len;
-	memcpy(send->adv_data + 1, tx->pkt, tx->len);
+	send->adv_data_len = tx->pkt->len + 1;
+	send->adv_data[0] = tx->pkt->len;
+	memcpy(send->adv_data + 1, tx->pkt->data, tx->pkt->len);
 
 	/* Filter looped back Provision packets */
-	if (tx->pkt[0] == MESH_AD_TYPE_PROVISION)
+	if (tx->pkt->data[0] == MESH_AD_TYPE_PROVISION)
 		filter_dups(NULL, send->adv_data, get_instant());
 
 	mesh_mgmt_send(MGMT_OP_MESH_SEND, index,
 			len, send, send_queued, tx, NULL);
-	/* print_packet("Mesh Send Start", tx->pkt, tx->len); */
+	/* print_packet("Mesh Send Start", tx->pkt->data, tx->pkt->len); */
 	pvt->tx = tx;
 }
 
@@ -655,19 +665,18 @@ static void tx_worker(void *user_data)
 }
 
 static bool send_tx(struct mesh_io *io, struct mesh_io_send_info *info,
-					const uint8_t *data, uint16_t len)
+						struct mesh_io_pkt *pkt)
 {
 	struct tx_pkt *tx;
 	bool sending = false;
 
-	if (!info || !data || !len || len > sizeof(tx->pkt))
+	if (!info || !pkt || !pkt->len)
 		return false;
 
 	tx = l_new(struct tx_pkt, 1);
 
 	memcpy(&tx->info, info, sizeof(tx->info));
-	memcpy(&tx->pkt, data, len);
-	tx->len = len;
+	tx->pkt = mesh_io_pkt_ref(pkt);
 
 	if (info->type == MESH_IO_TIMING_TYPE_POLL_RSP)
 		l_queue_push_head(pvt->tx_pkts, tx);
@@ -701,7 +710,7 @@ static bool tx_cancel(struct mesh_io *io, const uint8_t *data, uint8_t len)
 		do {
 			tx = l_queue_remove_if(pvt->tx_pkts, find_by_ad_type,
 							L_UINT_TO_PTR(data[0]));
-			l_free(tx);
+			tx_free(tx);
 
 			if (tx == pvt->tx)
 				pvt->tx = NULL;
@@ -716,7 +725,7 @@ static bool tx_cancel(struct mesh_io *io, const uint8_t *data, uint8_t len)
 		do {
 			tx = l_queue_remove_if(pvt->tx_pkts, find_by_pattern,
 								&pattern);
-			l_free(tx);
+			tx_free(tx);
 
 			if (tx == pvt->tx)
 				pvt->tx = NULL;
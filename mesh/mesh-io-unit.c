@@ -57,8 +57,7 @@ struct process_data {
 struct tx_pkt {
 	struct mesh_io_send_info	info;
 	bool				delete;
-	uint8_t				len;
-	uint8_t				pkt[30];
+	struct mesh_io_pkt		*pkt;
 };
 
 struct tx_pattern {
@@ -66,6 +65,17 @@ struct tx_pattern {
 	uint8_t				len;
 };
 
+static void tx_free(void *data)
+{
+	struct tx_pkt *tx = data;
+
+	if (!tx)
+		return;
+
+	mesh_io_pkt_unref(tx->pkt);
+	l_free(tx);
+}
+
 static uint32_t get_instant(void)
 {
 	struct timeval tm;
@@ -145,7 +155,7 @@ static bool find_by_ad_type(const void *a, const void *b)
 	const struct tx_pkt *tx = a;
 	uint8_t ad_type = L_PTR_TO_UINT(b);
 
-	return !ad_type || ad_type == tx->pkt[0];
+	return !ad_type || ad_type == tx->pkt->data[0];
 }
 
 static bool find_by_pattern(const void *a, const void *b)
@@ -153,10 +163,10 @@ static bool find_by_pattern(const void *a, const void *b)
 	const struct tx_pkt *tx = a;
 	const struct tx_pattern *pattern = b;
 
-	if (tx->len < pattern->len)
+	if (tx->pkt->len < pattern->len)
 		return false;
 
-	return (!memcmp(tx->pkt, pattern->data, pattern->len));
+	return (!memcmp(tx->pkt->data, pattern->data, pattern->len));
 }
 
 static void free_socket(struct mesh_io_private *pvt)
@@ -273,7 +283,7 @@ static bool unit_destroy(struct mesh_io *io)
 	l_free(pvt->unique_name);
 	l_timeout_remove(pvt->tx_timeout);
 	l_queue_destroy(pvt->rx_regs, l_free);
-	l_queue_destroy(pvt->tx_pkts, l_free);
+	l_queue_destroy(pvt->tx_pkts, tx_free);
 
 	free_socket(pvt);
 
@@ -304,12 +314,12 @@ static bool simple_match(const void *a, const void *b)
 static void send_pkt(struct mesh_io_private *pvt, struct tx_pkt *tx,
 							uint16_t interval)
 {
-	if (send(pvt->fd, tx->pkt, tx->len, MSG_DONTWAIT) < 0)
+	if (send(pvt->fd, tx->pkt->data, tx->pkt->len, MSG_DONTWAIT) < 0)
 		l_error("Failed to send(%d)", errno);
 
 	if (tx->delete) {
 		l_queue_remove_if(pvt->tx_pkts, simple_match, tx);
-		l_free(tx);
+		tx_free(tx);
 	}
 }
 
@@ -416,20 +426,19 @@ static void tx_worker(void *user_data)
 }
 
 static bool send_tx(struct mesh_io *io, struct mesh_io_send_info *info,
-					const uint8_t *data, uint16_t len)
+						struct mesh_io_pkt *pkt)
 {
 	struct mesh_io_private *pvt = io->pvt;
 	struct tx_pkt *tx;
 	bool sending = false;
 
-	if (!info || !data || !len || len > sizeof(tx->pkt))
+	if (!info || !pkt || !pkt->len)
 		return false;
 
 	tx = l_new(struct tx_pkt, 1);
 
 	memcpy(&tx->info, info, sizeof(tx->info));
-	memcpy(&tx->pkt, data, len);
-	tx->len = len;
+	tx->pkt = mesh_io_pkt_ref(pkt);
 
 	if (info->type == MESH_IO_TIMING_TYPE_POLL_RSP)
 		l_queue_push_head(pvt->tx_pkts, tx);
@@ -460,7 +469,7 @@ static bool tx_cancel(struct mesh_io *io, const uint8_t *data, uint8_t len)
 		do {
 			tx = l_queue_remove_if(pvt->tx_pkts, find_by_ad_type,
 							L_UINT_TO_PTR(data[0]));
-			l_free(tx);
+			tx_free(tx);
 
 		} while (tx);
 	} else {
@@ -472,7 +481,7 @@ static bool tx_cancel(struct mesh_io *io, const uint8_t *data, uint8_t len)
 		do {
 			tx = l_queue_remove_if(pvt->tx_pkts, find_by_pattern,
 								&pattern);
-			l_free(tx);
+			tx_free(tx);
 
 		} while (tx);
 	}
@@ -283,8 +283,45 @@ static void loop_unprv_beacon(const uint8_t *data, uint16_t len)
 	loop_adv_to = l_timeout_create_ms(500, loop_rx, pkt, loop_destroy);
 }
 
-bool mesh_io_send(struct mesh_io *io, struct mesh_io_send_info *info,
-					const uint8_t *data, uint16_t len)
+struct mesh_io_pkt *mesh_io_pkt_new(const uint8_t *data, uint16_t len)
+{
+	struct mesh_io_pkt *pkt;
+
+	if (!len || len > MESH_IO_PKT_MAX)
+		return NULL;
+
+	pkt = l_new(struct mesh_io_pkt, 1);
+	pkt->len = len;
+
+	if (data)
+		memcpy(pkt->data, data, len);
+
+	return mesh_io_pkt_ref(pkt);
+}
+
+struct mesh_io_pkt *mesh_io_pkt_ref(struct mesh_io_pkt *pkt)
+{
+	if (!pkt)
+		return NULL;
+
+	pkt->ref_count++;
+
+	return pkt;
+}
+
+void mesh_io_pkt_unref(struct mesh_io_pkt *pkt)
+{
+	if (!pkt)
+		return;
+
+	if (--pkt->ref_count)
+		return;
+
+	l_free(pkt);
+}
+
+bool mesh_io_send_pkt(struct mesh_io *io, struct mesh_io_send_info *info,
+						struct mesh_io_pkt *pkt)
 {
 	if (io && io != default_io)
 		return false;
@@ -292,16 +329,36 @@ bool mesh_io_send(struct mesh_io *io, struct mesh_io_send_info *info,
 	if (!io)
 		io = default_io;
 
+	if (!pkt)
+		return false;
+
 	/* Loop unprovisioned beacons for local clients */
-	if (!memcmp(data, unprv_filter, sizeof(unprv_filter)))
-		loop_unprv_beacon(data, len);
+	if (pkt->len >= sizeof(unprv_filter) &&
+			!memcmp(pkt->data, unprv_filter, sizeof(unprv_filter)))
+		loop_unprv_beacon(pkt->data, pkt->len);
 
+	/* The transmit queue holds its own reference until sent */
 	if (io && io->api && io->api->send)
-		return io->api->send(io, info, data, len);
+		return io->api->send(io, info, pkt);
 
 	return false;
 }
 
+bool mesh_io_send(struct mesh_io *io, struct mesh_io_send_info *info,
+					const uint8_t *data, uint16_t len)
+{
+	struct mesh_io_pkt *pkt = mesh_io_pkt_new(data, len);
+	bool result;
+
+	if (!pkt)
+		return false;
+
+	result = mesh_io_send_pkt(io, info, pkt);
+	mesh_io_pkt_unref(pkt);
+
+	return result;
+}
+
 bool mesh_io_send_cancel(struct mesh_io *io, const uint8_t *pattern,
 								uint8_t len)
 {
@@ -10,6 +10,9 @@
 
 #define MESH_IO_TX_COUNT_UNLIMITED	0
 
+/* AD Type followed by the largest AD payload of a legacy advertisement */
+#define MESH_IO_PKT_MAX			30
+
 enum mesh_io_type {
 	MESH_IO_TYPE_NONE = 0,
 	MESH_IO_TYPE_UNIT_TEST,
@@ -57,6 +60,13 @@ struct mesh_io_send_info {
 	} u;
 };
 
+/* Reference counted AD, shared by the layers it passes through */
+struct mesh_io_pkt {
+	int ref_count;
+	uint8_t len;
+	uint8_t data[MESH_IO_PKT_MAX];
+};
+
 struct mesh_io_caps {
 	uint8_t max_num_filters;
 	uint8_t window_accuracy;
@@ -88,5 +98,11 @@ bool mesh_io_deregister_recv_cb(struct mesh_io *io, const uint8_t *filter,
 
 bool mesh_io_send(struct mesh_io *io, struct mesh_io_send_info *info,
 					const uint8_t *data, uint16_t len);
+bool mesh_io_send_pkt(struct mesh_io *io, struct mesh_io_send_info *info,
+						struct mesh_io_pkt *pkt);
 bool mesh_io_send_cancel(struct mesh_io *io, const uint8_t *pattern,
 								uint8_t len);
+
+struct mesh_io_pkt *mesh_io_pkt_new(const uint8_t *data, uint16_t len);
+struct mesh_io_pkt *mesh_io_pkt_ref(struct mesh_io_pkt *pkt);
+void mesh_io_pkt_unref(struct mesh_io_pkt *pkt);
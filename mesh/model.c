@@ -27,6 +27,7 @@
 #include "mesh/prov.h"
 #include "mesh/remprv.h"
 #include "mesh/prv-beacon.h"
+#include "mesh/sar-config.h"
 #include "mesh/error.h"
 #include "mesh/dbus.h"
 #include "mesh/util.h"
@@ -85,6 +86,9 @@ static bool is_internal(uint32_t id)
 	if (id == PRV_BEACON_SRV_MODEL || id == PRV_BEACON_CLI_MODEL)
 		return true;
 
+	if (id == SAR_CFG_SRV_MODEL || id == SAR_CFG_CLI_MODEL)
+		return true;
+
 	return false;
 }
 
@@ -654,6 +658,9 @@ static int update_binding(struct mesh_node *node, uint16_t addr, uint32_t id,
 	if (id == PRV_BEACON_SRV_MODEL || id == PRV_BEACON_CLI_MODEL)
 		return MESH_STATUS_INVALID_MODEL;
 
+	if (id == SAR_CFG_SRV_MODEL || id == SAR_CFG_CLI_MODEL)
+		return MESH_STATUS_INVALID_MODEL;
+
 	if (!appkey_have_key(node_get_net(node), app_idx))
 		return MESH_STATUS_INVALID_APPKEY;
 
@@ -1663,7 +1670,8 @@ static struct mesh_model *model_setup(struct mesh_net *net, uint8_t ele_idx,
 
 	/* Implicitly bind config server model to device key */
 	if (db_mod->id == CONFIG_SRV_MODEL ||
-					db_mod->id == PRV_BEACON_SRV_MODEL) {
+					db_mod->id == PRV_BEACON_SRV_MODEL ||
+					db_mod->id == SAR_CFG_SRV_MODEL) {
 
 		if (ele_idx != PRIMARY_ELE_IDX) {
 			l_free(mod);
@@ -27,6 +27,15 @@
 /* This allows daemon to skip decryption on recently seen beacons */
 #define BEACON_CACHE_MAX	10
 
+/* Recently seen Network PDUs, shared by all local nodes and subnets */
+#define DECRYPT_CACHE_MAX	16
+
+/* Length of the largest Network PDU in an advertisement */
+#define NET_PKT_MAX		29
+
+/* Number of packet lookups between two reports of the cache statistics */
+#define DECRYPT_STATS_INTERVAL	4096
+
 struct beacon_rx {
 	uint8_t data[28];
 	uint32_t id;
@@ -71,13 +80,56 @@ static struct l_queue *beacons;
 static struct l_queue *keys;
 static uint32_t last_flooding_id;
 
-/* To avoid re-decrypting same packet for multiple nodes, cache and check */
-static uint8_t cache_pkt[29];
-static uint8_t cache_plain[29];
-static size_t cache_len;
-static size_t cache_plainlen;
-static uint32_t cache_id;
-static uint32_t cache_iv_index;
+/*
+ * To avoid re-decrypting same packet for multiple nodes, cache and check.
+ * Packets that none of our keys decrypt are cached too (with id 0).
+ */
+struct decrypt_cache {
+	uint64_t hash;
+	uint32_t id;
+	uint32_t iv_index;
+	uint8_t len;
+	uint8_t plain_len;
+	uint8_t pkt[NET_PKT_MAX];
+	uint8_t plain[NET_PKT_MAX];
+};
+
+static struct decrypt_cache decrypt_cache[DECRYPT_CACHE_MAX];
+static unsigned int decrypt_cache_next;
+static struct net_key_cache_stats cache_stats;
+
+/* Keys indexed by NID, so only candidate keys are tried on a packet */
+static struct l_queue *nid_keys[0x80];
+
+static void cache_flush(uint32_t id)
+{
+	unsigned int i;
+
+	for (i = 0; i < DECRYPT_CACHE_MAX; i++) {
+		if (decrypt_cache[i].id == id)
+			decrypt_cache[i].len = 0;
+	}
+}
+
+static void nid_add(struct net_key *key, bool head)
+{
+	if (!nid_keys[key->nid])
+		nid_keys[key->nid] = l_queue_new();
+
+	if (head)
+		l_queue_push_head(nid_keys[key->nid], key);
+	else
+		l_queue_push_tail(nid_keys[key->nid], key);
+
+	/* Packets that failed to decrypt may be ours now */
+	cache_flush(0);
+}
+
+static void nid_remove(struct net_key *key)
+{
+	l_queue_remove(nid_keys[key->nid], key);
+	cache_flush(key->id);
+}
 
 static bool match_flooding(const void *a, const void *b)
 {
@@ -143,6 +195,7 @@ uint32_t net_key_add(const uint8_t flooding[16])
 
 	key->id = ++last_flooding_id;
 	l_queue_push_tail(keys, key);
+	nid_add(key, false);
 	return key->id;
 
 fail:
@@ -181,6 +234,7 @@ uint32_t net_key_frnd_add(uint32_t flooding_id, uint16_t lpn, uint16_t frnd,
 	frnd_key->ref_cnt++;
 	frnd_key->id = ++last_flooding_id;
 	l_queue_push_head(keys, frnd_key);
+	nid_add(frnd_key, true);
 
 	return frnd_key->id;
 }
@@ -193,6 +247,7 @@ void net_key_unref(uint32_t id)
 		if (--key->ref_cnt == 0) {
 			l_timeout_remove(key->observe.timeout);
 			l_queue_remove(keys, key);
+			nid_remove(key);
 			l_free(key);
 		}
 	}
@@ -220,54 +275,114 @@ bool net_key_retrieve(uint32_t id, uint8_t *flooding)
 	return false;
 }
 
+static void cache_stats_report(void)
+{
+	struct net_key_cache_stats stats;
+
+	net_key_get_cache_stats(&stats);
+
+	l_debug("Decrypt cache: %u hits, %u misses, %u decrypts",
+				stats.hits, stats.misses, stats.decrypts);
+}
+
 static void decrypt_net_pkt(void *a, void *b)
 {
 	const struct net_key *key = a;
+	struct decrypt_cache *cache = b;
 	bool result;
 
-	if (cache_id || !key->ref_cnt || (cache_pkt[0] & 0x7f) != key->nid)
+	if (cache->id || !key->ref_cnt)
 		return;
 
-	result = mesh_crypto_packet_decode(cache_pkt, cache_len, false,
-						cache_plain, cache_iv_index,
+	cache_stats.decrypts++;
+
+	result = mesh_crypto_packet_decode(cache->pkt, cache->len, false,
+						cache->plain, cache->iv_index,
 						key->enc_key, key->prv_key);
 
 	if (result) {
-		cache_id = key->id;
-		if (cache_plain[1] & 0x80)
-			cache_plainlen = cache_len - 8;
+		cache->id = key->id;
+		if (cache->plain[1] & 0x80)
+			cache->plain_len = cache->len - 8;
 		else
-			cache_plainlen = cache_len - 4;
+			cache->plain_len = cache->len - 4;
 	}
 }
 
+static struct decrypt_cache *cache_find(uint64_t hash, const uint8_t *pkt,
+								size_t len)
+{
+	unsigned int i;
+
+	for (i = 0; i < DECRYPT_CACHE_MAX; i++) {
+		struct decrypt_cache *cache = &decrypt_cache[i];
+
+		if (cache->hash == hash && cache->len == len &&
+						!memcmp(cache->pkt, pkt, len))
+			return cache;
+	}
+
+	return NULL;
+}
+
 uint32_t net_key_decrypt(uint32_t iv_index, const uint8_t *pkt, size_t len,
 					uint8_t **plain, size_t *plain_len)
 {
-	/* If we already successfully decrypted this packet, use cached data */
-	if (cache_id && cache_len == len && !memcmp(pkt, cache_pkt, len)) {
+	struct decrypt_cache *cache;
+	uint64_t hash;
+
+	if (len < 14 || len > NET_PKT_MAX)
+		return 0;
+
+	/* Header is obfuscated with SEQ and SRC, so it makes a good hash */
+	hash = l_get_le64(pkt);
+
+	if (!((cache_stats.hits + cache_stats.misses + 1) %
+						DECRYPT_STATS_INTERVAL))
+		cache_stats_report();
+
+	/* If we already tried to decrypt this packet, use cached data */
+	cache = cache_find(hash, pkt, len);
+	if (cache && (cache->id || cache->iv_index == iv_index)) {
+		cache_stats.hits++;
+
 		/* IV Index must match what was used to decrypt */
-		if (cache_iv_index != iv_index)
+		if (cache->iv_index != iv_index)
 			return 0;
 
 		goto done;
 	}
 
-	cache_id = 0;
-	memcpy(cache_pkt, pkt, len);
-	cache_len = len;
-	cache_iv_index = iv_index;
+	cache_stats.misses++;
 
-	/* Try all network keys known to us */
-	l_queue_foreach(keys, decrypt_net_pkt, NULL);
+	/* Replace the oldest entry, unless retrying with another IV Index */
+	if (!cache) {
+		cache = &decrypt_cache[decrypt_cache_next];
+		decrypt_cache_next = (decrypt_cache_next + 1) %
+							DECRYPT_CACHE_MAX;
+		cache->hash = hash;
+		cache->len = len;
+		memcpy(cache->pkt, pkt, len);
+	}
+
+	cache->id = 0;
+	cache->iv_index = iv_index;
+
+	/* Try the network keys known to us with a matching NID */
+	l_queue_foreach(nid_keys[pkt[0] & 0x7f], decrypt_net_pkt, cache);
 
 done:
-	if (cache_id) {
-		*plain = cache_plain;
-		*plain_len = cache_plainlen;
+	if (cache->id) {
+		*plain = cache->plain;
+		*plain_len = cache->plain_len;
 	}
 
-	return cache_id;
+	return cache->id;
+}
+
+void net_key_get_cache_stats(struct net_key_cache_stats *stats)
+{
+	*stats = cache_stats;
 }
 
 bool net_key_encrypt(uint32_t id, uint32_t iv_index, uint8_t *pkt, size_t len)
@@ -289,6 +404,56 @@ bool net_key_encrypt(uint32_t id, uint32_t iv_index, uint8_t *pkt, size_t len)
 	return result;
 }
 
+/*
+ * Re-encrypts a decrypted packet for relaying with its TTL decremented. The
+ * relayed Network PDU is built directly in a new advertising buffer, so the
+ * clear packet (which may be the decrypt cache) is never modified. As with
+ * net_key_decrypt(), plain_len does not include the NetMIC.
+ */
+struct mesh_io_pkt *net_key_encrypt_relay(uint32_t id, uint32_t iv_index,
+					const uint8_t *plain, size_t plain_len)
+{
+	struct net_key *key = l_queue_find(keys, match_id, L_UINT_TO_PTR(id));
+	struct mesh_io_pkt *pkt;
+	uint8_t *packet;
+	size_t len;
+
+	if (!key || plain_len < 10)
+		return NULL;
+
+	len = plain_len + ((plain[1] & 0x80) ? 8 : 4);
+	if (len + 1 > MESH_IO_PKT_MAX)
+		return NULL;
+
+	pkt = mesh_io_pkt_new(NULL, len + 1);
+	pkt->data[0] = MESH_AD_TYPE_NETWORK;
+	packet = pkt->data + 1;
+
+	/*
+	 * Rebuild the clear header (IVI/NID, CTL/TTL, SEQ, SRC) from the
+	 * decrypted packet with TTL decremented; DST and the transport PDU
+	 * are encrypted from the clear packet and the header is obfuscated
+	 * afterwards.
+	 */
+	packet[0] = plain[0];
+	packet[1] = (plain[1] & ~TTL_MASK) | ((plain[1] & TTL_MASK) - 1);
+	packet[2] = plain[2];
+	packet[3] = plain[3];
+	packet[4] = plain[4];
+	packet[5] = plain[5];
+	packet[6] = plain[6];
+
+	if (!mesh_crypto_packet_encode_from(plain, packet, len, iv_index,
+						key->enc_key, key->prv_key) ||
+			!mesh_crypto_packet_label(packet, len, iv_index,
+								key->nid)) {
+		mesh_io_pkt_unref(pkt);
+		return NULL;
+	}
+
+	return pkt;
+}
+
 uint32_t net_key_network_id(const uint8_t net_id[8])
 {
 	struct net_key *key = l_queue_find(keys, match_network, net_id);
@@ -791,6 +956,18 @@ static void free_key(void *data)
 
 void net_key_cleanup(void)
 {
+	unsigned int i;
+
+	cache_stats_report();
+
+	for (i = 0; i < L_ARRAY_SIZE(nid_keys); i++) {
+		l_queue_destroy(nid_keys[i], NULL);
+		nid_keys[i] = NULL;
+	}
+
+	memset(decrypt_cache, 0, sizeof(decrypt_cache));
+	decrypt_cache_next = 0;
+
 	l_queue_destroy(keys, free_key);
 	keys = NULL;
 	l_queue_destroy(beacons, l_free);
@@ -14,6 +14,14 @@
 #define IV_INDEX_UPDATE		0x02
 #define NET_MPB_REFRESH_DEFAULT	60
 
+struct mesh_io_pkt;
+
+struct net_key_cache_stats {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t decrypts;
+};
+
 void net_key_cleanup(void);
 bool net_key_confirm(uint32_t id, const uint8_t flooding[16]);
 bool net_key_retrieve(uint32_t id, uint8_t *flooding);
@@ -23,7 +31,10 @@ uint32_t net_key_frnd_add(uint32_t flooding_id, uint16_t lpn, uint16_t frnd,
 void net_key_unref(uint32_t id);
 uint32_t net_key_decrypt(uint32_t iv_index, const uint8_t *pkt, size_t len,
 					uint8_t **plain, size_t *plain_len);
+void net_key_get_cache_stats(struct net_key_cache_stats *stats);
 bool net_key_encrypt(uint32_t id, uint32_t iv_index, uint8_t *pkt, size_t len);
+struct mesh_io_pkt *net_key_encrypt_relay(uint32_t id, uint32_t iv_index,
+					const uint8_t *plain, size_t plain_len);
 uint32_t net_key_network_id(const uint8_t network[8]);
 uint32_t net_key_beacon(const uint8_t *data, uint16_t len, uint32_t *ivi,
 							bool *ivu, bool *kr);
@@ -44,10 +44,31 @@
 
 #define IV_UPDATE_SEQ_TRIGGER 0x800000  /* Half of Seq-Nums expended */
 
-#define SEG_TO	2
-#define MSG_TO	60
 #define SAR_DEL	10
 
+/* Every SAR context can hold the largest Upper Transport PDU */
+#define SAR_BUF_MAX	MAX_SEG_TO_LEN(SEG_MASK)
+#define SAR_POOL_MAX	8
+
+/* MshPRTv1.1 default SAR Transmitter and Receiver states */
+#define SAR_TX_SEG_INT_STEP		0x05
+#define SAR_TX_UNICAST_RTX_CNT		0x02
+#define SAR_TX_UNICAST_RTX_WO_PROG_CNT	0x02
+#define SAR_TX_UNICAST_RTX_INT_STEP	0x07
+#define SAR_TX_UNICAST_RTX_INT_INC	0x01
+#define SAR_TX_MULTICAST_RTX_CNT	0x02
+#define SAR_TX_MULTICAST_RTX_INT_STEP	0x03
+#define SAR_RX_SEG_THRESHOLD		0x03
+#define SAR_RX_ACK_DELAY_INC		0x01
+#define SAR_RX_DISCARD_TO		0x01
+#define SAR_RX_SEG_INT_STEP		0x05
+#define SAR_RX_ACK_RTX_CNT		0x00
+
+/* Decoded SAR intervals, in milliseconds unless noted */
+#define SAR_SEG_INT(step)		(((step) + 1) * 10)
+#define SAR_RTX_INT(step)		(((step) + 1) * 25)
+#define SAR_DISCARD_SECS(to)		(((to) + 1) * 5)
+
 #define DEFAULT_TRANSMIT_COUNT		1
 #define DEFAULT_TRANSMIT_INTERVAL	100
 
@@ -136,10 +157,12 @@ struct mesh_net {
 	struct l_queue *subnets;
 	struct l_queue *msg_cache;
 	struct l_queue *replay_cache;
-	struct l_queue *sar_in;
-	struct l_queue *sar_out;
+	struct l_hashmap *sar_in;
+	struct l_hashmap *sar_out;
 	struct l_queue *sar_queue;
-	struct l_queue *frnd_msgs;
+	struct l_queue *sar_pool;
+	struct mesh_net_sar_tx sar_tx;
+	struct mesh_net_sar_rx sar_rx;
 	struct l_queue *friends;
 	struct l_queue *negotiations;
 	struct l_queue *destinations;
@@ -152,11 +175,13 @@ struct mesh_msg {
 };
 
 struct mesh_sar {
+	struct mesh_net *net;
 	unsigned int id;
-	struct l_timeout *seg_timeout;
-	struct l_timeout *msg_timeout;
+	struct l_timeout *seg_timeout;	/* Segment pacing or ACK delay */
+	struct l_timeout *msg_timeout;	/* Discard, Incoming only */
 	uint32_t flags;
 	uint32_t last_nak;
+	uint32_t pending;		/* Segments left in this round */
 	uint32_t iv_index;
 	uint32_t seqAuth;
 	uint16_t seqZero;
@@ -173,6 +198,11 @@ struct mesh_sar {
 	uint8_t ttl;
 	uint8_t last_seg;
 	uint8_t key_aid;
+	uint8_t cnt;
+	uint16_t interval;
+	uint8_t rtx_cnt;
+	uint8_t rtx_wo_prog;
+	uint8_t ack_cnt;
 	uint8_t buf[4]; /* Large enough for ACK-Flags and MIC */
 };
 
@@ -209,8 +239,7 @@ struct oneshot_tx {
 	struct mesh_net *net;
 	uint16_t interval;
 	uint8_t cnt;
-	uint8_t size;
-	uint8_t packet[30];
+	struct mesh_io_pkt *pkt;
 };
 
 struct net_beacon_data {
@@ -224,6 +253,7 @@ struct net_beacon_data {
 
 static struct l_queue *fast_cache;
 static struct l_queue *nets;
+static uint32_t frnd_queue_pool;
 
 static void net_rx(void *net_ptr, void *user_data);
 
@@ -310,12 +340,21 @@ static bool match_by_friend(const void *a, const void *b)
 
 static void free_friend_internals(struct mesh_friend *frnd)
 {
-	if (frnd->pkt_cache)
-		l_queue_destroy(frnd->pkt_cache, l_free);
+	if (frnd->pkt_cache) {
+		frnd_queue_pool -= frnd->cache_size;
+		l_free(frnd->pkt_cache);
+	}
 
 	l_free(frnd->u.active.grp_list);
 	frnd->u.active.grp_list = NULL;
 	frnd->pkt_cache = NULL;
+	frnd->pkt = NULL;
+	frnd->cache_head = 0;
+	frnd->cache_len = 0;
+	frnd->ack_queued = false;
+
+	l_free(frnd->sar);
+	frnd->sar = NULL;
 
 	net_key_unref(frnd->net_key_cur);
 	net_key_unref(frnd->net_key_upd);
@@ -363,11 +402,26 @@ static void frnd_kr_phase3(void *a, void *b)
 struct mesh_friend *mesh_friend_new(struct mesh_net *net, uint16_t dst,
 					uint8_t ele_cnt, uint8_t frd,
 					uint8_t frw, uint32_t fpt,
-					uint16_t fn_cnt, uint16_t lp_cnt)
+					uint16_t fn_cnt, uint16_t lp_cnt,
+					uint8_t cache_size)
 {
 	struct mesh_subnet *subnet;
 	struct mesh_friend *frnd = l_queue_find(net->friends,
 					match_by_friend, L_UINT_TO_PTR(dst));
+	uint32_t avail = mesh_friend_queue_avail();
+
+	/*
+	 * Offers to several LPNs may be outstanding at once, so the pool
+	 * can be used up by the time this friendship is established. A
+	 * Queue being replaced returns its share of the pool first.
+	 */
+	if (frnd && frnd->pkt_cache)
+		avail += frnd->cache_size;
+
+	if (cache_size > avail) {
+		l_debug("Friend Queue pool exhausted for %4.4x", dst);
+		return NULL;
+	}
 
 	if (frnd) {
 		/* Kill all timers and empty cache for this friend */
@@ -388,9 +442,13 @@ struct mesh_friend *mesh_friend_new(struct mesh_net *net, uint16_t dst,
 	frnd->lp_cnt = lp_cnt;
 	frnd->poll_timeout = fpt;
 	frnd->ele_cnt = ele_cnt;
-	frnd->pkt_cache = l_queue_new();
 	frnd->net_key_upd = 0;
 
+	/* The Friend Queue holds as many PDUs as we offered to the LPN */
+	frnd->cache_size = cache_size;
+	frnd->pkt_cache = l_new(struct mesh_friend_pdu, cache_size);
+	frnd_queue_pool += cache_size;
+
 	subnet = get_primary_subnet(net);
 	/* TODO: the primary key must be present, do we need to add check?. */
 
@@ -416,6 +474,39 @@ void mesh_friend_free(void *data)
 	l_free(frnd);
 }
 
+uint32_t mesh_friend_queue_avail(void)
+{
+	if (frnd_queue_pool >= FRND_QUEUE_POOL_MAX)
+		return 0;
+
+	return FRND_QUEUE_POOL_MAX - frnd_queue_pool;
+}
+
+struct mesh_friend_pdu *mesh_friend_queue_peek(struct mesh_friend *frnd)
+{
+	if (!frnd->cache_len)
+		return NULL;
+
+	return &frnd->pkt_cache[frnd->cache_head];
+}
+
+void mesh_friend_queue_pop(struct mesh_friend *frnd)
+{
+	struct mesh_friend_pdu *head = mesh_friend_queue_peek(frnd);
+
+	if (!head)
+		return;
+
+	if (frnd->ack_queued && frnd->ack_slot == frnd->cache_head)
+		frnd->ack_queued = false;
+
+	if (frnd->pkt == head)
+		frnd->pkt = NULL;
+
+	frnd->cache_head = (frnd->cache_head + 1) % frnd->cache_size;
+	frnd->cache_len--;
+}
+
 bool mesh_friend_clear(struct mesh_net *net, struct mesh_friend *frnd)
 {
 	bool removed = l_queue_remove(net->friends, frnd);
@@ -504,13 +595,15 @@ uint32_t mesh_net_next_seq_num(struct mesh_net *net)
 	return seq;
 }
 
-static struct mesh_sar *mesh_sar_new(size_t len)
+static struct mesh_sar *mesh_sar_new(struct mesh_net *net)
 {
-	size_t size = sizeof(struct mesh_sar) + len;
-	struct mesh_sar *sar;
+	struct mesh_sar *sar = l_queue_pop_head(net->sar_pool);
 
-	sar = l_malloc(size);
-	memset(sar, 0, size);
+	if (!sar)
+		sar = l_malloc(sizeof(struct mesh_sar) + SAR_BUF_MAX);
+
+	memset(sar, 0, sizeof(struct mesh_sar));
+	sar->net = net;
 	return sar;
 }
 
@@ -526,6 +619,23 @@ static void mesh_sar_free(void *data)
 	l_free(sar);
 }
 
+static void mesh_sar_release(struct mesh_sar *sar)
+{
+	struct mesh_net *net = sar->net;
+
+	if (l_queue_length(net->sar_pool) >= SAR_POOL_MAX) {
+		mesh_sar_free(sar);
+		return;
+	}
+
+	/* Keep the buffer for the next segmented message */
+	l_timeout_remove(sar->seg_timeout);
+	l_timeout_remove(sar->msg_timeout);
+	sar->seg_timeout = NULL;
+	sar->msg_timeout = NULL;
+	l_queue_push_head(net->sar_pool, sar);
+}
+
 static void subnet_free(void *data)
 {
 	struct mesh_subnet *subnet = data;
@@ -643,10 +753,24 @@ struct mesh_net *mesh_net_new(struct mesh_node *node)
 
 	net->subnets = l_queue_new();
 	net->msg_cache = l_queue_new();
-	net->sar_in = l_queue_new();
-	net->sar_out = l_queue_new();
+	net->sar_in = l_hashmap_new();
+	net->sar_out = l_hashmap_new();
 	net->sar_queue = l_queue_new();
-	net->frnd_msgs = l_queue_new();
+	net->sar_pool = l_queue_new();
+
+	net->sar_tx.seg_int_step = SAR_TX_SEG_INT_STEP;
+	net->sar_tx.unicast_rtx_cnt = SAR_TX_UNICAST_RTX_CNT;
+	net->sar_tx.unicast_rtx_wo_prog_cnt = SAR_TX_UNICAST_RTX_WO_PROG_CNT;
+	net->sar_tx.unicast_rtx_int_step = SAR_TX_UNICAST_RTX_INT_STEP;
+	net->sar_tx.unicast_rtx_int_inc = SAR_TX_UNICAST_RTX_INT_INC;
+	net->sar_tx.multicast_rtx_cnt = SAR_TX_MULTICAST_RTX_CNT;
+	net->sar_tx.multicast_rtx_int_step = SAR_TX_MULTICAST_RTX_INT_STEP;
+
+	net->sar_rx.seg_threshold = SAR_RX_SEG_THRESHOLD;
+	net->sar_rx.ack_delay_inc = SAR_RX_ACK_DELAY_INC;
+	net->sar_rx.discard_to = SAR_RX_DISCARD_TO;
+	net->sar_rx.seg_int_step = SAR_RX_SEG_INT_STEP;
+	net->sar_rx.ack_rtx_cnt = SAR_RX_ACK_RTX_CNT;
 	net->destinations = l_queue_new();
 	net->app_keys = l_queue_new();
 	net->replay_cache = l_queue_new();
@@ -670,10 +794,10 @@ void mesh_net_free(void *user_data)
 	l_queue_destroy(net->subnets, subnet_free);
 	l_queue_destroy(net->msg_cache, l_free);
 	l_queue_destroy(net->replay_cache, l_free);
-	l_queue_destroy(net->sar_in, mesh_sar_free);
-	l_queue_destroy(net->sar_out, mesh_sar_free);
+	l_hashmap_destroy(net->sar_in, mesh_sar_free);
+	l_hashmap_destroy(net->sar_out, mesh_sar_free);
 	l_queue_destroy(net->sar_queue, mesh_sar_free);
-	l_queue_destroy(net->frnd_msgs, l_free);
+	l_queue_destroy(net->sar_pool, mesh_sar_free);
 	l_queue_destroy(net->friends, mesh_friend_free);
 	l_queue_destroy(net->negotiations, mesh_friend_free);
 	l_queue_destroy(net->destinations, l_free);
@@ -1080,14 +1204,6 @@ static bool msg_in_cache(struct mesh_net *net, uint16_t src, uint32_t seq,
 	return false;
 }
 
-static bool match_sar_seq0(const void *a, const void *b)
-{
-	const struct mesh_sar *sar = a;
-	uint16_t seqZero = L_PTR_TO_UINT(b);
-
-	return sar->seqZero == seqZero;
-}
-
 static bool match_sar_remote(const void *a, const void *b)
 {
 	const struct mesh_sar *sar = a;
@@ -1096,22 +1212,6 @@ static bool match_sar_remote(const void *a, const void *b)
 	return sar->remote == remote;
 }
 
-static bool match_msg_timeout(const void *a, const void *b)
-{
-	const struct mesh_sar *sar = a;
-	const struct l_timeout *msg_timeout = b;
-
-	return sar->msg_timeout == msg_timeout;
-}
-
-static bool match_seg_timeout(const void *a, const void *b)
-{
-	const struct mesh_sar *sar = a;
-	const struct l_timeout *seg_timeout = b;
-
-	return sar->seg_timeout == seg_timeout;
-}
-
 static bool match_dest_dst(const void *a, const void *b)
 {
 	const struct mesh_destination *dest = a;
@@ -1202,10 +1302,9 @@ static struct mesh_friend_msg *mesh_friend_msg_new(uint8_t seg_max)
 }
 
 
-static bool match_ack(const void *a, const void *b)
+static bool match_ack(const struct mesh_friend_pdu *old,
+					const struct mesh_friend_msg *rx)
 {
-	const struct mesh_friend_msg *old = a;
-	const struct mesh_friend_msg *rx = b;
 	uint32_t old_hdr;
 	uint32_t new_hdr;
 
@@ -1214,17 +1313,60 @@ static bool match_ack(const void *a, const void *b)
 		return false;
 
 	/* Check the quickest items first before digging deeper */
-	old_hdr = old->u.one[0].hdr & HDR_ACK_MASK;
+	old_hdr = old->hdr & HDR_ACK_MASK;
 	new_hdr = rx->u.one[0].hdr & HDR_ACK_MASK;
 
 	return old_hdr == new_hdr;
 }
 
+static struct mesh_friend_pdu *friend_queue_push(struct mesh_friend *frnd,
+					const struct mesh_friend_msg *rx,
+					uint32_t hdr, uint32_t seq,
+					const uint8_t *data, uint8_t len)
+{
+	struct mesh_friend_pdu *pdu;
+	uint8_t slot;
+
+	slot = (frnd->cache_head + frnd->cache_len++) % frnd->cache_size;
+	pdu = &frnd->pkt_cache[slot];
+
+	pdu->iv_index = rx->iv_index;
+	pdu->hdr = hdr;
+	pdu->seq = seq;
+	pdu->src = rx->src;
+	pdu->dst = rx->dst;
+	pdu->ttl = rx->ttl;
+	pdu->ctl = rx->ctl;
+	pdu->len = len;
+	pdu->sent = false;
+	pdu->md = false;
+	memcpy(pdu->data, data, len);
+
+	return pdu;
+}
+
+static void friend_queue_drop_head(struct mesh_friend *frnd)
+{
+	struct mesh_friend_pdu *head;
+
+	/* Discard all remaining segments of the oldest message */
+	do {
+		mesh_friend_queue_pop(frnd);
+		head = mesh_friend_queue_peek(frnd);
+	} while (head && !head->ctl && IS_SEGMENTED(head->hdr) &&
+				((head->hdr >> SEGO_HDR_SHIFT) & SEG_MASK));
+
+	/* If we are discarding head for any reason, reset FRND SEQ */
+	frnd->u.active.last = frnd->u.active.seq;
+}
+
 static void enqueue_friend_pkt(void *a, void *b)
 {
 	struct mesh_friend *frnd = a;
-	struct mesh_friend_msg *pkt, *rx = b;
-	size_t size;
+	struct mesh_friend_msg *rx = b;
+	struct mesh_friend_pdu *pdu;
+	uint8_t pdus = rx->cnt_in + 1;
+	bool ack;
 	int16_t i;
 
 	if (rx->done)
@@ -1252,55 +1394,64 @@ static void enqueue_friend_pkt(void *a, void *b)
 	}
 
 enqueue:
-	/* Special handling for Seg Ack -- Only one per message queue */
-	if (((rx->u.one[0].hdr >> OPCODE_HDR_SHIFT) & OPCODE_MASK) ==
-						NET_OP_SEG_ACKNOWLEDGE) {
-		void *old_head = l_queue_peek_head(frnd->pkt_cache);
-		/* Suppress duplicate ACKs */
-		do {
-			void *old = l_queue_remove_if(frnd->pkt_cache,
-							match_ack, rx);
-
-			if (!old)
-				break;
+	ack = rx->ctl && !rx->cnt_in &&
+			((rx->u.one[0].hdr >> OPCODE_HDR_SHIFT) &
+					OPCODE_MASK) == NET_OP_SEG_ACKNOWLEDGE;
 
-			if (old_head == old)
-				/*
-				 * If we are discarding head for any
-				 * reason, reset FRND SEQ
-				 */
-				frnd->u.active.last = frnd->u.active.seq;
-
-			l_free(old);
-
-		} while (true);
+	/*
+	 * Special handling for Seg Ack -- Only one per message queue.
+	 * A newer ACK to the same SAR message replaces the last queued one
+	 * in place, as long as it has not been sent to the LPN yet.
+	 */
+	if (ack && frnd->ack_queued) {
+		pdu = &frnd->pkt_cache[frnd->ack_slot];
+
+		if (!pdu->sent && match_ack(pdu, rx)) {
+			pdu->seq = rx->u.one[0].seq;
+			pdu->hdr = rx->u.one[0].hdr;
+			pdu->iv_index = rx->iv_index;
+			memcpy(pdu->data, rx->u.one[0].data, rx->last_len);
+			return;
+		}
 	}
 
 	l_debug("%s for %4.4x from %4.4x ttl: %2.2x (seq: %6.6x) (ctl: %d)",
 			__func__, frnd->lp_addr, rx->src, rx->ttl,
 			rx->u.one[0].seq, rx->ctl);
 
-	if (rx->cnt_in) {
-		size = sizeof(struct mesh_friend_msg) -
-				sizeof(struct mesh_friend_seg_one);
-		size += (rx->cnt_in + 1) * sizeof(struct mesh_friend_seg_12);
-	} else
-		size = sizeof(struct mesh_friend_msg);
+	/* Evicting older messages cannot make room for this one */
+	if (pdus > frnd->cache_size) {
+		l_warn("Dropped %u segment message from %4.4x, Friend Queue"
+				" of %4.4x holds %u", pdus, rx->src,
+				frnd->lp_addr, frnd->cache_size);
+		return;
+	}
 
-	pkt = l_malloc(size);
-	memcpy(pkt, rx, size);
+	/*
+	 * TODO: Guard against popping UPDATE packets
+	 * (disallowed per spec)
+	 */
+	while (frnd->cache_size - frnd->cache_len < pdus)
+		friend_queue_drop_head(frnd);
 
-	l_queue_push_tail(frnd->pkt_cache, pkt);
+	if (!rx->cnt_in) {
+		pdu = friend_queue_push(frnd, rx, rx->u.one[0].hdr,
+					rx->u.one[0].seq, rx->u.one[0].data,
+					rx->last_len);
 
-	if (l_queue_length(frnd->pkt_cache) > FRND_CACHE_MAX) {
-		/*
-		 * TODO: Guard against popping UPDATE packets
-		 * (disallowed per spec)
-		 */
-		pkt = l_queue_pop_head(frnd->pkt_cache);
-		l_free(pkt);
-		frnd->u.active.last = frnd->u.active.seq;
+		if (ack) {
+			frnd->ack_slot = pdu - frnd->pkt_cache;
+			frnd->ack_queued = true;
+		}
+
+		return;
 	}
+
+	for (i = 0; i <= rx->cnt_in; i++)
+		friend_queue_push(frnd, rx, rx->u.s12[i].hdr, rx->u.s12[i].seq,
+					rx->u.s12[i].data,
+					i < rx->cnt_in ? MAX_SEG_LEN :
+								rx->last_len);
 }
 
 static void enqueue_update(void *a, void *b)
@@ -1503,35 +1654,55 @@ static void send_net_ack(struct mesh_net *net, struct mesh_sar *sar,
 
 static void inseg_to(struct l_timeout *seg_timeout, void *user_data)
 {
-	struct mesh_net *net = user_data;
-	struct mesh_sar *sar = l_queue_find(net->sar_in,
-					match_seg_timeout, seg_timeout);
+	struct mesh_sar *sar = user_data;
+	struct mesh_net *net = sar->net;
 
-	l_timeout_remove(seg_timeout);
-	if (!sar)
+	/* One Block ACK covers all segments received during the delay */
+	send_net_ack(net, sar, sar->flags);
+
+	if (sar->ack_cnt) {
+		sar->ack_cnt--;
+		l_timeout_modify_ms(seg_timeout,
+					SAR_SEG_INT(net->sar_rx.seg_int_step));
 		return;
+	}
 
-	/* Send NAK */
-	l_debug("Timeout %p %3.3x", sar, sar->app_idx);
-	send_net_ack(net, sar, sar->flags);
+	l_timeout_remove(seg_timeout);
+	sar->seg_timeout = NULL;
+}
 
-	sar->seg_timeout = l_timeout_create(SEG_TO, inseg_to, net, NULL);
+static void arm_net_ack(struct mesh_sar *sar, uint32_t ms)
+{
+	if (sar->seg_timeout)
+		l_timeout_modify_ms(sar->seg_timeout, ms);
+	else
+		sar->seg_timeout = l_timeout_create_ms(ms, inseg_to, sar, NULL);
 }
 
-static void inmsg_to(struct l_timeout *msg_timeout, void *user_data)
+static uint32_t net_ack_delay(struct mesh_net *net, uint8_t segN)
 {
-	struct mesh_net *net = user_data;
-	struct mesh_sar *sar = l_queue_find(net->sar_in,
-			match_msg_timeout, msg_timeout);
+	uint32_t halves = 2 * net->sar_rx.ack_delay_inc + 3;
 
-	if (!sar) {
-		l_timeout_remove(msg_timeout);
-		return;
-	}
+	/* Min(SegN + 0.5, SAR Acknowledgment Delay Increment + 1.5) */
+	if (2 * segN + 1 < halves)
+		halves = 2 * segN + 1;
+
+	return halves * SAR_SEG_INT(net->sar_rx.seg_int_step) / 2;
+}
+
+static void sar_in_done(struct mesh_sar *sar)
+{
+	l_hashmap_remove(sar->net->sar_in, L_UINT_TO_PTR(sar->remote));
+	mesh_sar_release(sar);
+}
+
+static void inmsg_to(struct l_timeout *msg_timeout, void *user_data)
+{
+	struct mesh_sar *sar = user_data;
 
 	if (!sar->delete) {
 		/*
-		 * Incomplete timer expired, cancel SAR and start
+		 * Discard timer expired, cancel SAR and start
 		 * delete timer
 		 */
 		l_timeout_remove(sar->seg_timeout);
@@ -1541,25 +1712,119 @@ static void inmsg_to(struct l_timeout *msg_timeout, void *user_data)
 		return;
 	}
 
-	l_queue_remove(net->sar_in, sar);
-	mesh_sar_free(sar);
+	sar_in_done(sar);
 }
 
-static void outmsg_to(struct l_timeout *msg_timeout, void *user_data)
+static uint32_t sar_rtx_interval(struct mesh_net *net, struct mesh_sar *sar)
 {
-	struct mesh_net *net = user_data;
-	struct mesh_sar *sar = l_queue_remove_if(net->sar_out,
-			match_msg_timeout, msg_timeout);
+	const struct mesh_net_sar_tx *cfg = &net->sar_tx;
+	uint32_t ms;
 
-	l_timeout_remove(msg_timeout);
-	if (!sar)
-		return;
+	if (!IS_UNICAST(sar->remote))
+		return SAR_RTX_INT(cfg->multicast_rtx_int_step);
 
-	sar->msg_timeout = NULL;
-	mesh_sar_free(sar);
+	ms = SAR_RTX_INT(cfg->unicast_rtx_int_step);
+
+	/* Leave time for the ACK to travel back over as many hops */
+	if (sar->ttl > 1)
+		ms += SAR_RTX_INT(cfg->unicast_rtx_int_inc) * (sar->ttl - 1);
+
+	return ms;
 }
 
 static void outseg_to(struct l_timeout *seg_timeout, void *user_data);
+static void send_queued_sar(struct mesh_net *net, uint16_t dst);
+
+static void sar_out_done(struct mesh_sar *sar)
+{
+	struct mesh_net *net = sar->net;
+	uint16_t dst = sar->remote;
+
+	l_hashmap_remove(net->sar_out, L_UINT_TO_PTR(dst));
+	mesh_sar_release(sar);
+	send_queued_sar(net, dst);
+}
+
+/* Segments of a round are paced by the SAR Segment Interval */
+static bool send_next_seg(struct mesh_sar *sar)
+{
+	struct mesh_net *net = sar->net;
+	uint32_t ms;
+	uint8_t seg = 0;
+
+	/* Nothing left to send in this round */
+	if (!sar->pending)
+		return true;
+
+	while (!(sar->pending & (0x00000001 << seg)))
+		seg++;
+
+	sar->pending &= ~(0x00000001 << seg);
+
+	if (!send_seg(net, sar->cnt, sar->interval, sar, seg)) {
+		sar_out_done(sar);
+		return false;
+	}
+
+	if (sar->pending)
+		ms = SAR_SEG_INT(net->sar_tx.seg_int_step);
+	else
+		ms = sar_rtx_interval(net, sar);
+
+	if (sar->seg_timeout)
+		l_timeout_modify_ms(sar->seg_timeout, ms);
+	else
+		sar->seg_timeout = l_timeout_create_ms(ms, outseg_to, sar,
+									NULL);
+
+	return true;
+}
+
+static void sar_retransmit(struct mesh_sar *sar)
+{
+	bool unicast = IS_UNICAST(sar->remote);
+
+	if (!sar->rtx_cnt || (unicast && !sar->rtx_wo_prog)) {
+		if (unicast)
+			l_debug("SAR to %4.4x not ACKed (%x)", sar->remote,
+								sar->last_nak);
+
+		sar_out_done(sar);
+		return;
+	}
+
+	sar->rtx_cnt--;
+
+	if (unicast)
+		sar->rtx_wo_prog--;
+
+	sar->pending = sar->flags & ~sar->last_nak;
+
+	/* Partial ACKs may add up to the whole message */
+	if (!sar->pending) {
+		sar_out_done(sar);
+		return;
+	}
+
+	send_next_seg(sar);
+}
+
+static bool sar_out_start(struct mesh_net *net, struct mesh_sar *sar)
+{
+	const struct mesh_net_sar_tx *cfg = &net->sar_tx;
+
+	if (IS_UNICAST(sar->remote))
+		sar->rtx_cnt = cfg->unicast_rtx_cnt;
+	else
+		sar->rtx_cnt = cfg->multicast_rtx_cnt;
+
+	/* The first round is not a retransmission */
+	sar->rtx_wo_prog = cfg->unicast_rtx_wo_prog_cnt;
+	sar->pending = sar->flags;
+	l_hashmap_insert(net->sar_out, L_UINT_TO_PTR(sar->remote), sar);
+
+	return send_next_seg(sar);
+}
 
 static void send_queued_sar(struct mesh_net *net, uint16_t dst)
 {
@@ -1569,88 +1834,94 @@ static void send_queued_sar(struct mesh_net *net, uint16_t dst)
 	if (!sar)
 		return;
 
-	/* Out to current outgoing, and immediate expire Seg TO */
-	l_queue_push_head(net->sar_out, sar);
-	sar->seg_timeout = NULL;
-	sar->msg_timeout = l_timeout_create(MSG_TO, outmsg_to, net, NULL);
-	outseg_to(NULL, net);
+	sar_out_start(net, sar);
+}
+
+struct sar_seq0_search {
+	uint16_t seqZero;
+	struct mesh_sar *sar;
+};
+
+static void find_sar_seq0(const void *key, void *value, void *user_data)
+{
+	struct mesh_sar *sar = value;
+	struct sar_seq0_search *search = user_data;
+
+	if (sar->seqZero == search->seqZero)
+		search->sar = sar;
 }
 
-static void ack_received(struct mesh_net *net, bool timeout,
-				uint16_t src, uint16_t dst,
-				uint16_t seq0, uint32_t ack_flag)
+static void ack_received(struct mesh_net *net, uint16_t src, bool obo,
+					uint16_t seq0, uint32_t ack_flag)
 {
 	struct mesh_sar *outgoing;
-	uint32_t seg_flag = 0x00000001;
-	uint32_t ack_copy = ack_flag;
-	uint16_t i;
+	uint32_t progress;
 
-	l_debug("ACK Rxed (%x) (to:%d): %8.8x", seq0, timeout, ack_flag);
+	l_debug("ACK Rxed (%x): %8.8x", seq0, ack_flag);
+
+	outgoing = l_hashmap_lookup(net->sar_out, L_UINT_TO_PTR(src));
+
+	/*
+	 * Only a Friend ACKing on behalf of its Low Power Node, with the OBO
+	 * flag set, may ACK from another address than we are sending to
+	 */
+	if (outgoing && outgoing->seqZero != seq0)
+		outgoing = NULL;
 
-	outgoing = l_queue_find(net->sar_out, match_sar_seq0,
-							L_UINT_TO_PTR(seq0));
+	if (!outgoing && obo) {
+		struct sar_seq0_search search = { .seqZero = seq0 };
+
+		l_hashmap_foreach(net->sar_out, find_sar_seq0, &search);
+		outgoing = search.sar;
+	}
 
 	if (!outgoing) {
 		l_debug("Not Found: %4.4x", seq0);
 		return;
 	}
 
-	/*
-	 * TODO -- If we receive from different
-	 * SRC than we are sending to, make sure the OBO flag is set
-	 */
-
-	if ((!timeout && !ack_flag) ||
-			(outgoing->flags & ack_flag) == outgoing->flags) {
+	/* ACKs of a message accumulate, a lost one does not undo progress */
+	if (!ack_flag || ((outgoing->last_nak | ack_flag) & outgoing->flags) ==
+							outgoing->flags) {
 		l_debug("ob_sar_removal (%x)", outgoing->flags);
 
 		/* Note: ack_flags == 0x00000000 is a remote Cancel request */
 
-		l_queue_remove(net->sar_out, outgoing);
-		send_queued_sar(net, outgoing->remote);
-		mesh_sar_free(outgoing);
-
+		sar_out_done(outgoing);
 		return;
 	}
 
+	progress = ack_flag & outgoing->flags & ~outgoing->last_nak;
 	outgoing->last_nak |= ack_flag;
 
-	ack_copy &= outgoing->flags;
-
-	for (i = 0; i <= SEG_MAX(true, outgoing->len); i++, seg_flag <<= 1) {
-		if (seg_flag & ack_flag) {
-			l_debug("Skipping Seg %d of %d",
-					i, SEG_MAX(true, outgoing->len));
-			continue;
-		}
+	if (!progress)
+		return;
 
-		ack_copy |= seg_flag;
+	outgoing->rtx_wo_prog = net->sar_tx.unicast_rtx_wo_prog_cnt;
 
-		l_debug("Resend Seg %d net:%p dst:%x app_idx:%3.3x",
-				i, net, outgoing->remote, outgoing->app_idx);
+	/* Mid-round, only skip the segments that already made it */
+	if (outgoing->pending) {
+		outgoing->pending &= ~ack_flag;
 
-		send_seg(net, net->tx_cnt, net->tx_interval, outgoing, i);
+		if (!outgoing->pending)
+			l_timeout_modify_ms(outgoing->seg_timeout,
+					sar_rtx_interval(net, outgoing));
+		return;
 	}
 
-	l_timeout_remove(outgoing->seg_timeout);
-	outgoing->seg_timeout = l_timeout_create(SEG_TO, outseg_to, net, NULL);
+	/* Resend the missing segments without waiting out the interval */
+	sar_retransmit(outgoing);
 }
 
 static void outseg_to(struct l_timeout *seg_timeout, void *user_data)
 {
-	struct mesh_net *net = user_data;
-	struct mesh_sar *sar = l_queue_find(net->sar_out,
-					match_seg_timeout, seg_timeout);
-
-	l_timeout_remove(seg_timeout);
-	if (!sar)
-		return;
-
-	sar->seg_timeout = NULL;
+	struct mesh_sar *sar = user_data;
 
-	/* Re-Send missing segments by faking NACK */
-	ack_received(net, true, sar->remote, sar->src,
-					sar->seqZero, sar->last_nak);
+	if (sar->pending)
+		send_next_seg(sar);
+	else
+		/* No ACK within the retransmission interval */
+		sar_retransmit(sar);
 }
 
 static bool match_replay_cache(const void *a, const void *b)
@@ -1841,14 +2112,6 @@ static uint16_t key_id_to_net_idx(struct mesh_net *net,
 		return NET_IDX_INVALID;
 }
 
-static bool match_frnd_sar_dst(const void *a, const void *b)
-{
-	const struct mesh_friend_msg *frnd_msg = a;
-	uint16_t dst = L_PTR_TO_UINT(b);
-
-	return frnd_msg->dst == dst;
-}
-
 static void friend_seg_rxed(struct mesh_net *net,
 				uint32_t iv_index,
 				uint8_t ttl, uint32_t seq,
@@ -1878,19 +2141,17 @@ static void friend_seg_rxed(struct mesh_net *net,
 	}
 
 	/* Check if we have a SAR-in-progress that matches incoming segment */
-	frnd_msg = l_queue_find(net->frnd_msgs, match_frnd_sar_dst,
-			L_UINT_TO_PTR(dst));
+	frnd_msg = frnd->sar;
 
 	if (frnd_msg) {
-		/* Flush if SZMICN or IV Index has changed */
-		if (frnd_msg->iv_index != iv_index)
+		/* Flush if SZMICN, IV Index or destination has changed */
+		if (frnd_msg->iv_index != iv_index || frnd_msg->dst != dst)
 			frnd_msg->u.s12[0].hdr = 0;
 
 		/* Flush incomplete old SAR message if it doesn't match */
 		if ((frnd_msg->u.s12[0].hdr & HDR_KEY_MASK) != hdr_key) {
-			l_queue_remove(net->frnd_msgs, frnd_msg);
 			l_free(frnd_msg);
-			frnd_msg = NULL;
+			frnd_msg = frnd->sar = NULL;
 		}
 	}
 
@@ -1900,7 +2161,7 @@ static void friend_seg_rxed(struct mesh_net *net,
 		frnd_msg->src = src;
 		frnd_msg->dst = dst;
 		frnd_msg->ttl = ttl;
-		l_queue_push_tail(net->frnd_msgs, frnd_msg);
+		frnd->sar = frnd_msg;
 	} else if (frnd_msg->flags & this_seg_flag) /* Ignore dup segs */
 		return;
 
@@ -1930,8 +2191,8 @@ static void friend_seg_rxed(struct mesh_net *net,
 					enqueue_friend_pkt, frnd_msg);
 		}
 
-		/* Remove from "in progress" queue */
-		l_queue_remove(net->frnd_msgs, frnd_msg);
+		/* No longer "in progress" */
+		frnd->sar = NULL;
 
 		/* TODO Optimization(?): Unicast messages keep this buffer */
 		l_free(frnd_msg);
@@ -1958,15 +2219,14 @@ static bool seg_rxed(struct mesh_net *net, bool frnd, uint32_t iv_index,
 {
 	struct mesh_sar *sar_in = NULL;
 	uint16_t seg_off = 0;
-	uint32_t expected, this_seg_flag, largest, seqAuth;
-	bool reset_seg_to = true;
+	uint32_t expected, this_seg_flag, seqAuth;
+	uint8_t discard_to = SAR_DISCARD_SECS(net->sar_rx.discard_to);
 
 	/*
 	 * DST could receive additional Segments after
 	 * completing due to a lost ACK, so re-ACK and discard
 	 */
-	sar_in = l_queue_find(net->sar_in, match_sar_remote,
-						L_UINT_TO_PTR(src));
+	sar_in = l_hashmap_lookup(net->sar_in, L_UINT_TO_PTR(src));
 
 	/* Discard *old* incoming-SAR-in-progress if this segment newer */
 	seqAuth = seq_auth(seq, seqZero);
@@ -1983,8 +2243,7 @@ static bool seg_rxed(struct mesh_net *net, bool frnd, uint32_t iv_index,
 
 		if (newer) {
 			/* Cancel Old, start New */
-			l_queue_remove(net->sar_in, sar_in);
-			mesh_sar_free(sar_in);
+			sar_in_done(sar_in);
 			sar_in = NULL;
 		} else
 			/* Ignore Old */
@@ -2013,8 +2272,8 @@ static bool seg_rxed(struct mesh_net *net, bool frnd, uint32_t iv_index,
 
 		l_debug("RXed (new: %04x %06x size: %d len: %d) %d of %d",
 				seqZero, seq, size, len, segO, segN);
-		l_debug("Queue Size: %d", l_queue_length(net->sar_in));
-		sar_in = mesh_sar_new(len);
+		l_debug("Queue Size: %d", l_hashmap_size(net->sar_in));
+		sar_in = mesh_sar_new(net);
 		sar_in->seqAuth = seqAuth;
 		sar_in->iv_index = iv_index;
 		sar_in->src = dst;
@@ -2024,20 +2283,20 @@ static bool seg_rxed(struct mesh_net *net, bool frnd, uint32_t iv_index,
 		sar_in->len = len;
 		sar_in->last_seg = 0xff;
 		sar_in->net_idx = net_idx;
-		sar_in->msg_timeout = l_timeout_create(MSG_TO,
-					inmsg_to, net, NULL);
+		sar_in->msg_timeout = l_timeout_create(discard_to,
+					inmsg_to, sar_in, NULL);
 
 		l_debug("First Seg %4.4x", sar_in->flags);
-		l_queue_push_head(net->sar_in, sar_in);
+		l_hashmap_insert(net->sar_in, L_UINT_TO_PTR(src), sar_in);
 	}
 
 	seg_off = segO * MAX_SEG_LEN;
 	memcpy(sar_in->buf + seg_off, data, size);
 	this_seg_flag = 0x00000001 << segO;
 
-	/* Don't reset Seg TO or NAK if we already have this seg */
-	if (this_seg_flag & sar_in->flags)
-		reset_seg_to = false;
+	/* Only new segments hold off the Discard timeout */
+	if (!(this_seg_flag & sar_in->flags))
+		l_timeout_modify(sar_in->msg_timeout, discard_to);
 
 	sar_in->flags |= this_seg_flag;
 	sar_in->ttl = ttl;
@@ -2054,9 +2313,15 @@ static bool seg_rxed(struct mesh_net *net, bool frnd, uint32_t iv_index,
 				sar_in->remote, dst, key_aid, true, szmic,
 				sar_in->seqZero, sar_in->buf, sar_in->len);
 
-		/* Kill Inter-Seg timeout */
-		l_timeout_remove(sar_in->seg_timeout);
-		sar_in->seg_timeout = NULL;
+		/* Losing this ACK costs the sender a whole round */
+		if (segN >= net->sar_rx.seg_threshold) {
+			sar_in->ack_cnt = net->sar_rx.ack_rtx_cnt;
+			arm_net_ack(sar_in,
+				SAR_SEG_INT(net->sar_rx.seg_int_step));
+		} else {
+			l_timeout_remove(sar_in->seg_timeout);
+			sar_in->seg_timeout = NULL;
+		}
 
 		/* Start delete timer */
 		sar_in->delete = true;
@@ -2064,22 +2329,13 @@ static bool seg_rxed(struct mesh_net *net, bool frnd, uint32_t iv_index,
 		return true;
 	}
 
-	if (reset_seg_to) {
-		/* Restart Inter-Seg Timeout */
-		l_timeout_remove(sar_in->seg_timeout);
-
-		/* if this is the largest outstanding segment, send NAK now */
-		largest = (0xffffffff << segO) & expected;
-		if ((largest & sar_in->flags) == largest)
-			send_net_ack(net, sar_in, sar_in->flags);
-
-		sar_in->seg_timeout = l_timeout_create(SEG_TO,
-				inseg_to, net, NULL);
-	} else
-		largest = 0;
+	/* Coalesce the segments of the next ACK delay into one Block ACK */
+	if (!sar_in->seg_timeout) {
+		sar_in->ack_cnt = 0;
+		arm_net_ack(sar_in, net_ack_delay(net, segN));
+	}
 
-	l_debug("NAK: %d expected:%08x largest:%08x flags:%08x",
-			reset_seg_to, expected, largest, sar_in->flags);
+	l_debug("expected:%08x flags:%08x", expected, sar_in->flags);
 	return false;
 }
 
@@ -2251,9 +2507,8 @@ static bool match_by_dst(const void *a, const void *b)
 	return dest->dst == dst;
 }
 
-static void send_relay_pkt(struct mesh_net *net, uint8_t *data, uint8_t size)
+static void send_relay_pkt(struct mesh_net *net, struct mesh_io_pkt *pkt)
 {
-	uint8_t packet[30];
 	struct mesh_io *io = net->io;
 	struct mesh_io_send_info info = {
 		.type = MESH_IO_TIMING_TYPE_GENERAL,
@@ -2263,10 +2518,7 @@ static void send_relay_pkt(struct mesh_net *net, uint8_t *data, uint8_t size)
 		.u.gen.max_delay = DEFAULT_MAX_DELAY
 	};
 
-	packet[0] = MESH_AD_TYPE_NETWORK;
-	memcpy(packet + 1, data, size);
-
-	mesh_io_send(io, &info, packet, size + 1);
+	mesh_io_send_pkt(io, &info, pkt);
 }
 
 static bool simple_match(const void *a, const void *b)
@@ -2281,8 +2533,8 @@ static void send_msg_pkt_oneshot(void *user_data)
 	struct mesh_io_send_info info;
 	struct net_queue_data net_data = {
 		.info = NULL,
-		.data = tx->packet + 1,
-		.len = tx->size - 1,
+		.data = tx->pkt->data + 1,
+		.len = tx->pkt->len - 1,
 		.relay_advice = RELAY_NONE,
 	};
 
@@ -2292,12 +2544,10 @@ static void send_msg_pkt_oneshot(void *user_data)
 	/* Make sure specific network still valid */
 	net = l_queue_find(nets, simple_match, tx->net);
 
-	if (!net || net_data.relay_advice == RELAY_DISALLOWED) {
-		l_free(tx);
-		return;
-	}
+	if (!net || net_data.relay_advice == RELAY_DISALLOWED)
+		goto done;
 
-	tx->packet[0] = MESH_AD_TYPE_NETWORK;
+	tx->pkt->data[0] = MESH_AD_TYPE_NETWORK;
 	info.type = MESH_IO_TIMING_TYPE_GENERAL;
 	info.u.gen.interval = tx->interval;
 	info.u.gen.cnt = tx->cnt;
@@ -2305,20 +2555,27 @@ static void send_msg_pkt_oneshot(void *user_data)
 	/* No extra randomization when sending regular mesh messages */
 	info.u.gen.max_delay = DEFAULT_MIN_DELAY;
 
-	mesh_io_send(net->io, &info, tx->packet, tx->size);
+	mesh_io_send_pkt(net->io, &info, tx->pkt);
+
+done:
+	mesh_io_pkt_unref(tx->pkt);
 	l_free(tx);
 }
 
 static void send_msg_pkt(struct mesh_net *net, uint8_t cnt, uint16_t interval,
 						uint8_t *packet, uint8_t size)
 {
-	struct oneshot_tx *tx = l_new(struct oneshot_tx, 1);
+	struct mesh_io_pkt *pkt = mesh_io_pkt_new(packet, size);
+	struct oneshot_tx *tx;
+
+	if (!pkt)
+		return;
 
+	tx = l_new(struct oneshot_tx, 1);
 	tx->net = net;
 	tx->interval = interval;
 	tx->cnt = cnt;
-	tx->size = size;
-	memcpy(tx->packet, packet, size);
+	tx->pkt = pkt;
 
 	l_idle_oneshot(send_msg_pkt_oneshot, tx, NULL);
 }
@@ -2334,14 +2591,12 @@ static enum _relay_advice packet_received(void *user_data,
 	uint8_t net_ttl, key_aid, net_segO, net_segN, net_opcode;
 	uint32_t net_seq, cache_cookie;
 	uint16_t net_src, net_dst, net_seqZero;
-	uint8_t packet[31];
+	const uint8_t *packet = data;
 	bool net_ctl, net_segmented, net_szmic, net_relay;
 
-	memcpy(packet + 2, data, size);
+	print_packet("RX: Network [clr] :", packet, size);
 
-	print_packet("RX: Network [clr] :", packet + 2, size);
-
-	if (!mesh_crypto_packet_parse(packet + 2, size, &net_ctl, &net_ttl,
+	if (!mesh_crypto_packet_parse(packet, size, &net_ctl, &net_ttl,
 					&net_seq, &net_src, &net_dst,
 					&cache_cookie, &net_opcode,
 					&net_segmented, &key_aid, &net_szmic,
@@ -2393,8 +2648,7 @@ static enum _relay_advice packet_received(void *user_data,
 					friend_ack_rxed(net, iv_index, net_seq,
 							net_src, net_dst, msg);
 				else
-					ack_received(net, false,
-							net_src, net_dst,
+					ack_received(net, net_src, net_relay,
 							net_seqZero,
 							l_get_be32(msg + 3));
 			} else {
@@ -2417,7 +2671,7 @@ static enum _relay_advice packet_received(void *user_data,
 				if (net_ttl >= 2) {
 					friend_seg_rxed(net, iv_index, net_ttl,
 						net_seq, net_src, net_dst,
-						l_get_be32(packet + 2 + 9),
+						l_get_be32(packet + 9),
 						msg, app_msg_len);
 				}
 			} else {
@@ -2549,13 +2803,17 @@ static void net_msg_recv(void *user_data, struct mesh_io_recv_info *info,
 
 	if (net_data.relay_advice == RELAY_ALWAYS ||
 			net_data.relay_advice == RELAY_ALLOWED) {
-		uint8_t ttl = net_data.out[1] & TTL_MASK;
+		struct mesh_io_pkt *pkt;
+
+		/* Decrypted packet stays in the cache, relay gets a new AD */
+		pkt = net_key_encrypt_relay(net_data.net_key_id,
+						net_data.iv_index,
+						net_data.out, net_data.out_size);
+		if (!pkt)
+			return;
 
-		net_data.out[1] &=  ~TTL_MASK;
-		net_data.out[1] |= ttl - 1;
-		net_key_encrypt(net_data.net_key_id, net_data.iv_index,
-					net_data.out, net_data.out_size);
-		send_relay_pkt(net_data.net, net_data.out, net_data.out_size);
+		send_relay_pkt(net_data.net, pkt);
+		mesh_io_pkt_unref(pkt);
 	}
 }
 
@@ -2565,7 +2823,7 @@ static void iv_upd_to(struct l_timeout *upd_timeout, void *user_data)
 
 	switch (net->iv_upd_state) {
 	case IV_UPD_UPDATING:
-		if (l_queue_length(net->sar_out) ||
+		if (l_hashmap_size(net->sar_out) ||
 					l_queue_length(net->sar_queue)) {
 			l_debug("don't leave IV Update until sar_out empty");
 			l_timeout_modify(net->iv_update_timeout, 10);
@@ -2723,7 +2981,7 @@ static bool update_iv_ivu_state(struct mesh_net *net, uint32_t iv_index,
 {
 	if ((iv_index - ivu) > (net->iv_index - net->iv_update)) {
 		/* Don't accept IV_Index changes when performing SAR Out */
-		if (l_queue_length(net->sar_out))
+		if (l_hashmap_size(net->sar_out))
 			return false;
 	}
 
@@ -3255,7 +3513,7 @@ bool mesh_net_app_send(struct mesh_net *net, bool frnd_cred, uint16_t src,
 				bool szmic, const void *msg, uint16_t msg_len)
 {
 	struct mesh_sar *payload = NULL;
-	uint8_t seg, seg_max;
+	uint8_t seg_max;
 	bool result;
 
 	if (!net || msg_len > 384)
@@ -3296,7 +3554,7 @@ bool mesh_net_app_send(struct mesh_net *net, bool frnd_cred, uint16_t src,
 		return true;
 
 	/* Setup OTA Network send */
-	payload = mesh_sar_new(msg_len);
+	payload = mesh_sar_new(net);
 	memcpy(payload->buf, msg, msg_len);
 	payload->len = msg_len;
 	payload->src = src;
@@ -3309,51 +3567,34 @@ bool mesh_net_app_send(struct mesh_net *net, bool frnd_cred, uint16_t src,
 	payload->iv_index = mesh_net_get_iv_index(net);
 	payload->seqAuth = seq;
 	payload->segmented = segmented;
+	payload->cnt = cnt;
+	payload->interval = interval;
 
-	if (segmented) {
-		payload->flags = 0xffffffff >> (31 - seg_max);
-		payload->seqZero = seq & SEQ_ZERO_MASK;
-		payload->id = ++net->sar_id_next;
-
-		/* Single thread SAR messages to same Unicast DST */
-		if (l_queue_find(net->sar_out, match_sar_remote,
-							L_UINT_TO_PTR(dst))) {
-			/* Delay sending Outbound SAR unless prior
-			 * SAR to same DST has completed */
-
-			l_debug("OB-Queued SeqZero: %4.4x", payload->seqZero);
-			l_queue_push_tail(net->sar_queue, payload);
-			return true;
-		}
+	if (!segmented) {
+		result = send_seg(net, cnt, interval, payload, 0);
+		mesh_sar_release(payload);
+		return result;
 	}
 
-	result = true;
+	payload->flags = 0xffffffff >> (31 - seg_max);
+	payload->seqZero = seq & SEQ_ZERO_MASK;
+	payload->id = ++net->sar_id_next;
 
-	if (!IS_UNICAST(dst) && segmented) {
-		int i;
+	/* Single thread SAR messages to same DST */
+	if (l_hashmap_lookup(net->sar_out, L_UINT_TO_PTR(dst))) {
+		/* Delay sending Outbound SAR unless prior
+		 * SAR to same DST has completed */
 
-		for (i = 0; i < 4; i++) {
-			for (seg = 0; seg <= seg_max && result; seg++)
-				result = send_seg(net, cnt, interval, payload,
-									seg);
-		}
-	} else {
-		for (seg = 0; seg <= seg_max && result; seg++)
-			result = send_seg(net, cnt, interval, payload, seg);
-	}
-
-	/* Reliable: Cache; Unreliable: Flush*/
-	if (result && segmented && IS_UNICAST(dst)) {
-		l_queue_push_head(net->sar_out, payload);
-		payload->seg_timeout =
-			l_timeout_create(SEG_TO, outseg_to, net, NULL);
-		payload->msg_timeout =
-			l_timeout_create(MSG_TO, outmsg_to, net, NULL);
-		payload->id = ++net->sar_id_next;
-	} else
-		mesh_sar_free(payload);
+		l_debug("OB-Queued SeqZero: %4.4x", payload->seqZero);
+		l_queue_push_tail(net->sar_queue, payload);
+		return true;
+	}
 
-	return result;
+	/*
+	 * Reliable: paced until ACKed; Unreliable: paced for the
+	 * configured number of Multicast Retransmissions
+	 */
+	return sar_out_start(net, payload);
 }
 
 void mesh_net_ack_send(struct mesh_net *net, uint32_t net_key_id,
@@ -3681,6 +3922,98 @@ void mesh_net_transmit_params_get(struct mesh_net *net, uint8_t *count,
 	*count = net->tx_cnt;
 }
 
+bool mesh_net_set_sar_tx(struct mesh_net *net,
+					const struct mesh_net_sar_tx *sar_tx)
+{
+	if (!net || !sar_tx)
+		return false;
+
+	/* All SAR Transmitter states are 4 bits wide */
+	if (sar_tx->seg_int_step > 0x0f || sar_tx->unicast_rtx_cnt > 0x0f ||
+			sar_tx->unicast_rtx_wo_prog_cnt > 0x0f ||
+			sar_tx->unicast_rtx_int_step > 0x0f ||
+			sar_tx->unicast_rtx_int_inc > 0x0f ||
+			sar_tx->multicast_rtx_cnt > 0x0f ||
+			sar_tx->multicast_rtx_int_step > 0x0f)
+		return false;
+
+	net->sar_tx = *sar_tx;
+	return true;
+}
+
+const struct mesh_net_sar_tx *mesh_net_get_sar_tx(struct mesh_net *net)
+{
+	if (!net)
+		return NULL;
+
+	return &net->sar_tx;
+}
+
+bool mesh_net_set_sar_rx(struct mesh_net *net,
+					const struct mesh_net_sar_rx *sar_rx)
+{
+	if (!net || !sar_rx)
+		return false;
+
+	if (sar_rx->seg_threshold > 0x1f || sar_rx->ack_delay_inc > 0x07 ||
+			sar_rx->discard_to > 0x0f ||
+			sar_rx->seg_int_step > 0x0f ||
+			sar_rx->ack_rtx_cnt > 0x03)
+		return false;
+
+	net->sar_rx = *sar_rx;
+	return true;
+}
+
+const struct mesh_net_sar_rx *mesh_net_get_sar_rx(struct mesh_net *net)
+{
+	if (!net)
+		return NULL;
+
+	return &net->sar_rx;
+}
+
+/* SAR states are stored and sent on the air in their packed format */
+uint32_t mesh_net_sar_tx_encode(const struct mesh_net_sar_tx *sar_tx)
+{
+	return sar_tx->seg_int_step |
+			sar_tx->unicast_rtx_cnt << 4 |
+			sar_tx->unicast_rtx_wo_prog_cnt << 8 |
+			sar_tx->unicast_rtx_int_step << 12 |
+			sar_tx->unicast_rtx_int_inc << 16 |
+			sar_tx->multicast_rtx_cnt << 20 |
+			(uint32_t) sar_tx->multicast_rtx_int_step << 24;
+}
+
+void mesh_net_sar_tx_decode(uint32_t val, struct mesh_net_sar_tx *sar_tx)
+{
+	sar_tx->seg_int_step = val & 0x0f;
+	sar_tx->unicast_rtx_cnt = (val >> 4) & 0x0f;
+	sar_tx->unicast_rtx_wo_prog_cnt = (val >> 8) & 0x0f;
+	sar_tx->unicast_rtx_int_step = (val >> 12) & 0x0f;
+	sar_tx->unicast_rtx_int_inc = (val >> 16) & 0x0f;
+	sar_tx->multicast_rtx_cnt = (val >> 20) & 0x0f;
+	sar_tx->multicast_rtx_int_step = (val >> 24) & 0x0f;
+}
+
+uint32_t mesh_net_sar_rx_encode(const struct mesh_net_sar_rx *sar_rx)
+{
+	return sar_rx->seg_threshold |
+			sar_rx->ack_delay_inc << 5 |
+			sar_rx->discard_to << 8 |
+			sar_rx->seg_int_step << 12 |
+			sar_rx->ack_rtx_cnt << 16;
+}
+
+void mesh_net_sar_rx_decode(uint32_t val, struct mesh_net_sar_rx *sar_rx)
+{
+	sar_rx->seg_threshold = val & 0x1f;
+	sar_rx->ack_delay_inc = (val >> 5) & 0x07;
+	sar_rx->discard_to = (val >> 8) & 0x0f;
+	sar_rx->seg_int_step = (val >> 12) & 0x0f;
+	sar_rx->ack_rtx_cnt = (val >> 16) & 0x03;
+}
+
 struct mesh_io *mesh_net_get_io(struct mesh_net *net)
 {
 	if (!net)
@@ -24,8 +24,13 @@ struct mesh_node;
 #define CTL		0x80
 
 #define KEY_CACHE_SIZE	64
+
+/* Friend Queue size in Lower Transport PDUs, one per segment */
 #define FRND_CACHE_MAX	32
 
+/* Friend Queue PDUs shared by all Low Power Nodes we are Friends of */
+#define FRND_QUEUE_POOL_MAX	(FRND_CACHE_MAX * 256)
+
 #define MAX_UNSEG_LEN	15 /* msg_len == 11 + sizeof(MIC) */
 #define MAX_SEG_LEN	12 /* UnSeg length - 3 octets overhead */
 #define SEG_MAX(seg, len) ((!seg && len <= MAX_UNSEG_LEN) ? 0 : \
@@ -143,6 +148,26 @@ struct mesh_net_heartbeat_pub {
 	uint8_t ttl;
 };
 
+/* MshPRTv1.1 SAR Transmitter state, fields hold the encoded values */
+struct mesh_net_sar_tx {
+	uint8_t seg_int_step;
+	uint8_t unicast_rtx_cnt;
+	uint8_t unicast_rtx_wo_prog_cnt;
+	uint8_t unicast_rtx_int_step;
+	uint8_t unicast_rtx_int_inc;
+	uint8_t multicast_rtx_cnt;
+	uint8_t multicast_rtx_int_step;
+};
+
+/* MshPRTv1.1 SAR Receiver state */
+struct mesh_net_sar_rx {
+	uint8_t seg_threshold;
+	uint8_t ack_delay_inc;
+	uint8_t discard_to;
+	uint8_t seg_int_step;
+	uint8_t ack_rtx_cnt;
+};
+
 struct mesh_key_set {
 	bool frnd;
 	uint8_t nid;
@@ -163,11 +188,27 @@ struct friend_act {
 	bool last;
 };
 
+/* Lower Transport PDU in a Friend Queue */
+struct mesh_friend_pdu {
+	uint32_t iv_index;
+	uint32_t hdr;
+	uint32_t seq;
+	uint16_t src;
+	uint16_t dst;
+	uint8_t ttl;
+	uint8_t len;
+	bool ctl;
+	bool sent;
+	bool md;
+	uint8_t data[15];
+};
+
 struct mesh_friend {
 	struct mesh_net *net;
 	struct l_timeout *timeout;
-	struct l_queue *pkt_cache;
-	void *pkt;
+	struct mesh_friend_pdu *pkt_cache;	/* Ring of cache_size PDUs */
+	struct mesh_friend_pdu *pkt;
+	struct mesh_friend_msg *sar;		/* SAR message being received */
 	uint32_t poll_timeout;
 	uint32_t net_key_cur;
 	uint32_t net_key_upd;
@@ -180,6 +221,11 @@ struct mesh_friend {
 	uint8_t ele_cnt;
 	uint8_t frd;
 	uint8_t frw;
+	uint8_t cache_size;	/* Offered, then allocated Queue size */
+	uint8_t cache_head;
+	uint8_t cache_len;
+	uint8_t ack_slot;
+	bool ack_queued;
 	union {
 		struct friend_neg negotiate;
 		struct friend_act active;
@@ -282,8 +328,12 @@ bool mesh_net_dst_unreg(struct mesh_net *net, uint16_t dst);
 struct mesh_friend *mesh_friend_new(struct mesh_net *net, uint16_t dst,
 					uint8_t ele_cnt, uint8_t frd,
 					uint8_t frw, uint32_t fpt,
-					uint16_t fn_cnt, uint16_t lp_cnt);
+					uint16_t fn_cnt, uint16_t lp_cnt,
+					uint8_t cache_size);
 void mesh_friend_free(void *frnd);
+uint32_t mesh_friend_queue_avail(void);
+struct mesh_friend_pdu *mesh_friend_queue_peek(struct mesh_friend *frnd);
+void mesh_friend_queue_pop(struct mesh_friend *frnd);
 bool mesh_friend_clear(struct mesh_net *net, struct mesh_friend *frnd);
 void mesh_friend_sub_add(struct mesh_net *net, uint16_t lpn, uint8_t ele_cnt,
 							uint8_t grp_cnt,
@@ -317,6 +367,16 @@ void mesh_net_transmit_params_set(struct mesh_net *net, uint8_t count,
 							uint16_t interval);
 void mesh_net_transmit_params_get(struct mesh_net *net, uint8_t *count,
 							uint16_t *interval);
+bool mesh_net_set_sar_tx(struct mesh_net *net,
+					const struct mesh_net_sar_tx *sar_tx);
+const struct mesh_net_sar_tx *mesh_net_get_sar_tx(struct mesh_net *net);
+bool mesh_net_set_sar_rx(struct mesh_net *net,
+					const struct mesh_net_sar_rx *sar_rx);
+const struct mesh_net_sar_rx *mesh_net_get_sar_rx(struct mesh_net *net);
+uint32_t mesh_net_sar_tx_encode(const struct mesh_net_sar_tx *sar_tx);
+void mesh_net_sar_tx_decode(uint32_t val, struct mesh_net_sar_tx *sar_tx);
+uint32_t mesh_net_sar_rx_encode(const struct mesh_net_sar_rx *sar_rx);
+void mesh_net_sar_rx_decode(uint32_t val, struct mesh_net_sar_rx *sar_rx);
 struct mesh_prov *mesh_net_get_prov(struct mesh_net *net);
 void mesh_net_set_prov(struct mesh_net *net, struct mesh_prov *prov);
 uint32_t mesh_net_get_instant(struct mesh_net *net);
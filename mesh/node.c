@@ -33,6 +33,7 @@
 #include "mesh/cfgmod.h"
 #include "mesh/remprv.h"
 #include "mesh/prv-beacon.h"
+#include "mesh/sar-config.h"
 #include "mesh/util.h"
 #include "mesh/error.h"
 #include "mesh/dbus.h"
@@ -103,6 +104,8 @@ struct mesh_node {
 	uint8_t beacon;
 	uint8_t mpb;
 	uint8_t mpb_period;
+	uint32_t sar_tx;
+	uint32_t sar_rx;
 };
 
 struct node_import {
@@ -211,6 +214,8 @@ static void set_defaults(struct mesh_node *node)
 	node->proxy = MESH_MODE_UNSUPPORTED;
 	node->mpb = MESH_MODE_DISABLED;
 	node->mpb_period = NET_MPB_REFRESH_DEFAULT;
+	node->sar_tx = MESH_CONFIG_SAR_UNSET;
+	node->sar_rx = MESH_CONFIG_SAR_UNSET;
 	node->friend = (mesh_friendship_supported()) ? MESH_MODE_DISABLED :
 							MESH_MODE_UNSUPPORTED;
 	node->beacon = (mesh_beacon_enabled()) ? MESH_MODE_ENABLED :
@@ -302,6 +307,7 @@ static void free_node_resources(void *data)
 	mesh_agent_remove(node->agent);
 	mesh_config_release(node->cfg);
 	mesh_net_free(node->net);
+	keyring_cleanup(node);
 	l_free(node->storage_dir);
 	l_free(node);
 }
@@ -366,6 +372,9 @@ static bool add_elements_from_storage(struct mesh_node *node,
 	/* Add remote provisioning models on the primary element */
 	mesh_model_add(node, ele->models, REM_PROV_SRV_MODEL, NULL);
 
+	/* Add SAR Configuration server model on the primary element */
+	mesh_model_add(node, ele->models, SAR_CFG_SRV_MODEL, NULL);
+
 	if (node->provisioner)
 		mesh_model_add(node, ele->models, REM_PROV_CLI_MODEL, NULL);
 
@@ -428,6 +437,20 @@ static void init_net_settings(struct mesh_node *node)
 	mesh_net_set_snb_mode(net, node->beacon == MESH_MODE_ENABLED);
 	mesh_net_set_mpb_mode(net, node->mpb == MESH_MODE_ENABLED,
 							node->mpb_period, true);
+
+	if (node->sar_tx != MESH_CONFIG_SAR_UNSET) {
+		struct mesh_net_sar_tx sar_tx;
+
+		mesh_net_sar_tx_decode(node->sar_tx, &sar_tx);
+		mesh_net_set_sar_tx(net, &sar_tx);
+	}
+
+	if (node->sar_rx != MESH_CONFIG_SAR_UNSET) {
+		struct mesh_net_sar_rx sar_rx;
+
+		mesh_net_sar_rx_decode(node->sar_rx, &sar_rx);
+		mesh_net_set_sar_rx(net, &sar_rx);
+	}
 }
 
 static bool init_from_storage(struct mesh_config_node *db_node,
@@ -457,6 +480,8 @@ static bool init_from_storage(struct mesh_config_node *db_node,
 	node->beacon = db_node->modes.beacon;
 	node->mpb = db_node->modes.mpb;
 	node->mpb_period = db_node->modes.mpb_period;
+	node->sar_tx = db_node->modes.sar_tx;
+	node->sar_rx = db_node->modes.sar_rx;
 
 	l_debug("relay %2.2x, proxy %2.2x, lpn %2.2x, friend %2.2x",
 			node->relay.mode, node->proxy, node->lpn, node->friend);
@@ -522,6 +547,9 @@ static bool init_from_storage(struct mesh_config_node *db_node,
 	/* Initialize Private Beacon server model */
 	prv_beacon_server_init(node, PRIMARY_ELE_IDX);
 
+	/* Initialize SAR Configuration server model */
+	sar_cfg_server_init(node, PRIMARY_ELE_IDX);
+
 	node->cfg = cfg;
 
 	return true;
@@ -887,6 +915,38 @@ uint8_t node_mpb_mode_get(struct mesh_node *node, uint8_t *period)
 	return node->mpb;
 }
 
+bool node_sar_tx_set(struct mesh_node *node, uint32_t sar_tx)
+{
+	struct mesh_net_sar_tx state;
+
+	if (!node)
+		return false;
+
+	if (!mesh_config_write_sar(node->cfg, "sarTransmitter", sar_tx))
+		return false;
+
+	node->sar_tx = sar_tx;
+	mesh_net_sar_tx_decode(sar_tx, &state);
+
+	return mesh_net_set_sar_tx(node->net, &state);
+}
+
+bool node_sar_rx_set(struct mesh_node *node, uint32_t sar_rx)
+{
+	struct mesh_net_sar_rx state;
+
+	if (!node)
+		return false;
+
+	if (!mesh_config_write_sar(node->cfg, "sarReceiver", sar_rx))
+		return false;
+
+	node->sar_rx = sar_rx;
+	mesh_net_sar_rx_decode(sar_rx, &state);
+
+	return mesh_net_set_sar_rx(node->net, &state);
+}
+
 bool node_friend_mode_set(struct mesh_node *node, bool enable)
 {
 	bool res;
@@ -1001,6 +1061,8 @@ static void convert_node_to_storage(struct mesh_node *node,
 	db_node->modes.beacon = node->beacon;
 	db_node->modes.mpb = node->mpb;
 	db_node->modes.mpb_period = node->mpb_period;
+	db_node->modes.sar_tx = node->sar_tx;
+	db_node->modes.sar_rx = node->sar_rx;
 
 	db_node->ttl = node->ttl;
 	db_node->seq_number = node->seq_number;
@@ -1224,14 +1286,16 @@ static bool get_sig_models_from_properties(struct mesh_node *node,
 		uint32_t id = SET_ID(SIG_VENDOR, m_id);
 
 		/*
-		 * Allow Config Server & Private Beacon Models only on
-		 * the primary element
+		 * Allow Config Server, Private Beacon & SAR Configuration
+		 * Models only on the primary element
 		 */
 		if (ele->idx != PRIMARY_ELE_IDX) {
 			if (id == CONFIG_SRV_MODEL)
 				return false;
 			if (id == PRV_BEACON_SRV_MODEL)
 				return false;
+			if (id == SAR_CFG_SRV_MODEL)
+				return false;
 		}
 
 		if (!mesh_model_add(node, ele->models, id, &var))
@@ -1336,6 +1400,7 @@ static bool get_element_properties(struct mesh_node *node, const char *path,
 	if (ele->idx == PRIMARY_ELE_IDX) {
 		mesh_model_add(node, ele->models, CONFIG_SRV_MODEL, NULL);
 		mesh_model_add(node, ele->models, PRV_BEACON_SRV_MODEL, NULL);
+		mesh_model_add(node, ele->models, SAR_CFG_SRV_MODEL, NULL);
 		mesh_model_add(node, ele->models, REM_PROV_SRV_MODEL, NULL);
 		if (node->provisioner)
 			mesh_model_add(node, ele->models, REM_PROV_CLI_MODEL,
@@ -1465,6 +1530,9 @@ static bool add_local_node(struct mesh_node *node, uint16_t unicast, bool kr,
 	/* Initialize Private Beacon server model */
 	prv_beacon_server_init(node, PRIMARY_ELE_IDX);
 
+	/* Initialize SAR Configuration server model */
+	sar_cfg_server_init(node, PRIMARY_ELE_IDX);
+
 	node->busy = true;
 
 	return true;
@@ -65,6 +65,8 @@ uint8_t node_proxy_mode_get(struct mesh_node *node);
 bool node_beacon_mode_set(struct mesh_node *node, bool enable);
 bool node_mpb_mode_set(struct mesh_node *node, bool enable, uint8_t period);
 uint8_t node_mpb_mode_get(struct mesh_node *node, uint8_t *period);
+bool node_sar_tx_set(struct mesh_node *node, uint32_t sar_tx);
+bool node_sar_rx_set(struct mesh_node *node, uint32_t sar_rx);
 uint8_t node_beacon_mode_get(struct mesh_node *node);
 bool node_friend_mode_set(struct mesh_node *node, bool enable);
 uint8_t node_friend_mode_get(struct mesh_node *node);
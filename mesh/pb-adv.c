@@ -57,6 +57,14 @@ struct pb_adv_session {
 
 #define PB_ADV_MTU	24
 
+/*
+ * Each link retransmits its outstanding PDU about every
+ * PB_ADV_RETRANS_MS, so the advertising interval is divided between all
+ * open links, down to PB_ADV_MIN_INTERVAL_MS.
+ */
+#define PB_ADV_RETRANS_MS	500
+#define PB_ADV_MIN_INTERVAL_MS	50
+
 struct pb_ack {
 	uint8_t ad_type;
 	uint32_t link_id;
@@ -95,8 +103,6 @@ struct idle_rx {
 
 static struct l_queue *pb_sessions = NULL;
 
-static const uint8_t filter[1] = { MESH_AD_TYPE_PROVISION };
-
 static void pb_adv_packet(void *user_data, const uint8_t *pkt, uint16_t len);
 
 static void idle_rx_adv(void *user_data)
@@ -124,19 +130,39 @@ static void pb_adv_send(struct pb_adv_session *session,
 		mesh_send_pkt(count, interval, data, len);
 }
 
+static uint16_t tx_interval(void)
+{
+	unsigned int links = l_queue_length(pb_sessions);
+
+	if (links * PB_ADV_MIN_INTERVAL_MS > PB_ADV_RETRANS_MS)
+		return PB_ADV_MIN_INTERVAL_MS;
+
+	return PB_ADV_RETRANS_MS / (links ? links : 1);
+}
+
+static void send_cancel(struct pb_adv_session *session)
+{
+	uint8_t filter[5] = { MESH_AD_TYPE_PROVISION };
+
+	/* Only cancel the PDUs of this link */
+	l_put_be32(session->link_id, filter + 1);
+	mesh_send_cancel(filter, sizeof(filter));
+}
+
 static void send_adv_segs(struct pb_adv_session *session, const uint8_t *data,
 							uint16_t size)
 {
 	uint16_t init_size;
 	uint8_t buf[PB_ADV_MTU + 6] = { MESH_AD_TYPE_PROVISION };
 	uint8_t max_seg;
+	uint16_t interval = tx_interval();
 	uint8_t consumed;
 	int i;
 
 	if (!size)
 		return;
 
-	mesh_send_cancel(filter, sizeof(filter));
+	send_cancel(session);
 
 	l_put_be32(session->link_id, buf + 1);
 	buf[1 + 4] = ++session->local_trans_num;
@@ -160,7 +186,7 @@ static void send_adv_segs(struct pb_adv_session *session, const uint8_t *data,
 	l_debug("max_seg: %2.2x", max_seg);
 	l_debug("size: %2.2x, CRC: %2.2x", size, buf[9]);
 
-	pb_adv_send(session, MESH_IO_TX_COUNT_UNLIMITED, 500,
+	pb_adv_send(session, MESH_IO_TX_COUNT_UNLIMITED, interval,
 							buf, init_size + 10);
 
 	consumed = init_size;
@@ -176,7 +202,7 @@ static void send_adv_segs(struct pb_adv_session *session, const uint8_t *data,
 		buf[6] = (i << 2) | 0x02;
 		memcpy(buf + 7, data + consumed, seg_size);
 
-		pb_adv_send(session, MESH_IO_TX_COUNT_UNLIMITED, 500,
+		pb_adv_send(session, MESH_IO_TX_COUNT_UNLIMITED, interval,
 							buf, seg_size + 7);
 
 		consumed += seg_size;
@@ -203,6 +229,21 @@ static bool user_match (const void *a, const void *b)
 	return session->user_data == b;
 }
 
+static bool link_match(const void *a, const void *b)
+{
+	const struct pb_adv_session *session = a;
+	uint32_t link_id = L_PTR_TO_UINT(b);
+
+	return !session->loop && session->link_id == link_id;
+}
+
+static bool acceptor_match(const void *a, const void *b)
+{
+	const struct pb_adv_session *session = a;
+
+	return !session->initiator && !session->loop;
+}
+
 static void tx_timeout(struct l_timeout *timeout, void *user_data)
 {
 	struct pb_adv_session *session = user_data;
@@ -211,7 +252,7 @@ static void tx_timeout(struct l_timeout *timeout, void *user_data)
 	if (!l_queue_find(pb_sessions, session_match, session))
 		return;
 
-	mesh_send_cancel(filter, sizeof(filter));
+	send_cancel(session);
 
 	l_debug("TX timeout");
 	cb = session->close_cb;
@@ -241,10 +282,10 @@ static void send_open_req(struct pb_adv_session *session)
 	open_req.opcode = PB_ADV_OPEN_REQ;
 	memcpy(open_req.uuid, session->uuid, 16);
 
-	mesh_send_cancel(filter, sizeof(filter));
+	send_cancel(session);
 
-	pb_adv_send(session, MESH_IO_TX_COUNT_UNLIMITED, 500, &open_req,
-							sizeof(open_req));
+	pb_adv_send(session, MESH_IO_TX_COUNT_UNLIMITED, tx_interval(),
+						&open_req, sizeof(open_req));
 }
 
 static void send_open_cfm(struct pb_adv_session *session)
@@ -255,10 +296,10 @@ static void send_open_cfm(struct pb_adv_session *session)
 	open_cfm.trans_num = 0;
 	open_cfm.opcode = PB_ADV_OPEN_CFM;
 
-	mesh_send_cancel(filter, sizeof(filter));
+	send_cancel(session);
 
-	pb_adv_send(session, MESH_IO_TX_COUNT_UNLIMITED, 500, &open_cfm,
-							sizeof(open_cfm));
+	pb_adv_send(session, MESH_IO_TX_COUNT_UNLIMITED, tx_interval(),
+						&open_cfm, sizeof(open_cfm));
 }
 
 static void send_ack(struct pb_adv_session *session, uint8_t trans_num)
@@ -272,7 +313,7 @@ static void send_ack(struct pb_adv_session *session, uint8_t trans_num)
 	ack.trans_num = trans_num;
 	ack.opcode = PB_ADV_ACK;
 
-	pb_adv_send(session, MESH_IO_TX_COUNT_UNLIMITED, 500,
+	pb_adv_send(session, MESH_IO_TX_COUNT_UNLIMITED, tx_interval(),
 							&ack, sizeof(ack));
 }
 
@@ -288,7 +329,7 @@ static void send_close_ind(struct pb_adv_session *session, uint8_t reason)
 	close_ind.opcode = PB_ADV_CLOSE;
 	close_ind.reason = reason;
 
-	mesh_send_cancel(filter, sizeof(filter));
+	send_cancel(session);
 
 	pb_adv_send(session, 10, 100, &close_ind, sizeof(close_ind));
 }
@@ -391,7 +432,7 @@ static void pb_adv_packet(void *user_data, const uint8_t *pkt, uint16_t len)
 		if (session->local_acked > trans_num)
 			return;
 
-		mesh_send_cancel(filter, sizeof(filter));
+		send_cancel(session);
 		session->local_acked = trans_num;
 		session->ack_cb(session->user_data, trans_num);
 		break;
@@ -475,6 +516,29 @@ static void pb_adv_packet(void *user_data, const uint8_t *pkt, uint16_t len)
 	}
 }
 
+static void pb_adv_rx(void *user_data, const uint8_t *pkt, uint16_t len)
+{
+	struct pb_adv_session *session;
+	uint32_t link_id;
+
+	/* AD Type, Link ID, Transaction Number and Opcode */
+	if (len < 7)
+		return;
+
+	/* Dispatch to the session that owns the Link ID */
+	link_id = l_get_be32(pkt + 1);
+	session = l_queue_find(pb_sessions, link_match,
+						L_UINT_TO_PTR(link_id));
+
+	/* New links may only be opened towards an idle acceptor */
+	if (!session && l_get_u8(pkt + 6) == PB_ADV_OPEN_REQ)
+		session = l_queue_find(pb_sessions, link_match,
+							L_UINT_TO_PTR(0));
+
+	if (session)
+		pb_adv_packet(session, pkt, len);
+}
+
 bool pb_adv_reg(bool initiator, mesh_prov_open_func_t open_cb,
 		mesh_prov_close_func_t close_cb,
 		mesh_prov_receive_func_t rx_cb, mesh_prov_ack_func_t ack_cb,
@@ -487,15 +551,19 @@ bool pb_adv_reg(bool initiator, mesh_prov_open_func_t open_cb,
 
 	old_session = l_queue_find(pb_sessions, uuid_match, uuid);
 
-	/* Reject 2nd session if not looping back */
-	if (l_queue_length(pb_sessions) && !old_session)
-		return false;
-
 	/* Reject looping to more than one session or with same role*/
 	if (old_session && (old_session->loop ||
 					old_session->initiator == initiator))
 		return false;
 
+	/*
+	 * Any number of devices may be provisioned in parallel, each on its
+	 * own link, but we can only be provisioned once at a time.
+	 */
+	if (!old_session && !initiator &&
+			l_queue_find(pb_sessions, acceptor_match, NULL))
+		return false;
+
 	session = l_new(struct pb_adv_session, 1);
 	session->open_cb = open_cb;
 	session->close_cb = close_cb;
@@ -505,19 +573,25 @@ bool pb_adv_reg(bool initiator, mesh_prov_open_func_t open_cb,
 	session->initiator = initiator;
 	memcpy(session->uuid, uuid, 16);
 
-	l_queue_push_head(pb_sessions, session);
-
 	if (initiator) {
-		l_getrandom(&session->link_id, sizeof(session->link_id));
+		/* Pick a Link ID that is not in use by another session */
+		do {
+			l_getrandom(&session->link_id,
+						sizeof(session->link_id));
+		} while (!session->link_id ||
+				l_queue_find(pb_sessions, link_match,
+					L_UINT_TO_PTR(session->link_id)));
+
 		session->tx_timeout = l_timeout_create(60, tx_timeout,
 							session, NULL);
 	}
 
+	l_queue_push_head(pb_sessions, session);
+
 	/* Setup Loop-back if complementary session with same UUID */
 	if (old_session) {
 		session->loop = old_session;
 		old_session->loop = session;
-		mesh_unreg_prov_rx(pb_adv_packet);
 
 		if (initiator)
 			send_open_req(session);
@@ -527,7 +601,7 @@ bool pb_adv_reg(bool initiator, mesh_prov_open_func_t open_cb,
 		return true;
 	}
 
-	mesh_reg_prov_rx(pb_adv_packet, session);
+	mesh_reg_prov_rx(pb_adv_rx, NULL);
 
 	if (initiator)
 		send_open_req(session);
@@ -552,5 +626,6 @@ void pb_adv_unreg(void *user_data)
 	if (!l_queue_length(pb_sessions)) {
 		l_queue_destroy(pb_sessions, l_free);
 		pb_sessions = NULL;
+		mesh_unreg_prov_rx(pb_adv_rx);
 	}
 }
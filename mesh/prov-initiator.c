@@ -49,7 +49,6 @@ static const uint16_t expected_pdu_size[] = {
 
 #define BEACON_TYPE_UNPROVISIONED		0x00
 
-static const uint8_t pkt_filter = MESH_AD_TYPE_PROVISION;
 
 enum int_state {
 	INT_PROV_IDLE = 0,
@@ -82,6 +81,8 @@ struct mesh_prov_initiator {
 	void *trans_data;
 	struct mesh_node *node;
 	struct l_timeout *timeout;
+	uint64_t start_time;
+	uint32_t id;
 	uint32_t to_secs;
 	enum int_state	state;
 	uint16_t net_idx;
@@ -94,6 +95,7 @@ struct mesh_prov_initiator {
 	int8_t previous;
 	uint8_t out_num;
 	uint8_t rpr_state;
+	bool agent_wait;
 	struct conf_input conf_inputs;
 	uint8_t calc_key[16];
 	uint8_t salt[16];
@@ -112,22 +114,114 @@ struct scan_req {
 	int count;
 };
 
-static struct mesh_prov_initiator *prov = NULL;
+static struct l_queue *initiators;
 static struct l_queue *scans;
+static uint32_t last_id;
 
-static void initiator_free(void)
+static bool match_prov(const void *a, const void *b)
 {
-	if (prov) {
-		l_timeout_remove(prov->timeout);
+	return a == b;
+}
 
-		if (!prov->server)
-			mesh_send_cancel(&pkt_filter, sizeof(pkt_filter));
-	}
+static bool match_caller(const void *a, const void *b)
+{
+	const struct mesh_prov_initiator *prov = a;
 
-	pb_adv_unreg(prov);
+	return prov->caller_data == b;
+}
+
+static bool match_server(const void *a, const void *b)
+{
+	const struct mesh_prov_initiator *prov = a;
+	uint16_t server = L_PTR_TO_UINT(b);
+
+	return prov->server == server;
+}
+
+static bool match_link(const void *a, const void *b)
+{
+	const struct mesh_prov_initiator *prov = a;
+	const struct mesh_prov_initiator *req = b;
+
+	/* A Remote Provisioning Server only supports a single link */
+	if (req->server)
+		return prov->node == req->node && prov->server == req->server;
+
+	return !prov->server && !memcmp(prov->uuid, req->uuid, 16);
+}
+
+static bool match_id(const void *a, const void *b)
+{
+	const struct mesh_prov_initiator *prov = a;
+	uint32_t id = L_PTR_TO_UINT(b);
+
+	return prov->id == id;
+}
+
+static bool match_agent(const void *a, const void *b)
+{
+	const struct mesh_prov_initiator *prov = a;
+
+	return prov->agent == b;
+}
 
+static bool match_agent_wait(const void *a, const void *b)
+{
+	const struct mesh_prov_initiator *prov = a;
+
+	return prov->agent_wait && prov->agent == b;
+}
+
+static bool initiator_valid(struct mesh_prov_initiator *prov)
+{
+	return prov && l_queue_find(initiators, match_prov, prov);
+}
+
+/*
+ * Agent replies and idle callbacks may arrive after their session is gone,
+ * and a new session may since have been allocated at the same address.
+ * These carry the session id instead of the session pointer.
+ */
+static struct mesh_prov_initiator *initiator_find(void *user_data)
+{
+	return l_queue_find(initiators, match_id, user_data);
+}
+
+static void initiator_free(struct mesh_prov_initiator *prov)
+{
+	if (!l_queue_remove(initiators, prov))
+		return;
+
+	l_timeout_remove(prov->timeout);
+	pb_adv_unreg(prov);
 	l_free(prov);
-	prov = NULL;
+
+	if (l_queue_isempty(initiators)) {
+		l_queue_destroy(initiators, NULL);
+		initiators = NULL;
+	}
+}
+
+static void log_duration(struct mesh_prov_initiator *prov, uint8_t reason)
+{
+	unsigned int ms;
+	char *dev;
+
+	ms = l_time_diff(prov->start_time, l_time_now()) / 1000;
+
+	if (prov->transport <= PB_NPPI_02)
+		dev = l_strdup_printf("%4.4x", prov->server);
+	else
+		dev = l_util_hexstring(prov->uuid, 16);
+
+	if (reason == PROV_ERR_SUCCESS)
+		l_info("Provisioned %s in %u ms (%u sessions active)", dev, ms,
+						l_queue_length(initiators));
+	else
+		l_info("Provisioning %s failed after %u ms (reason: %u)", dev,
+								ms, reason);
+
+	l_free(dev);
 }
 
 static void int_prov_close(void *user_data, uint8_t reason)
@@ -137,6 +231,8 @@ static void int_prov_close(void *user_data, uint8_t reason)
 	uint8_t msg[4];
 	int n;
 
+	log_duration(prov, reason);
+
 	if (prov->server) {
 		n = mesh_model_opcode_set(OP_REM_PROV_LINK_CLOSE, msg);
 		msg[n++] = reason == PROV_ERR_SUCCESS ? 0x00 : 0x02;
@@ -146,7 +242,7 @@ static void int_prov_close(void *user_data, uint8_t reason)
 
 	if (reason != PROV_ERR_SUCCESS) {
 		prov->complete_cb(prov->caller_data, reason, NULL);
-		initiator_free();
+		initiator_free(prov);
 		return;
 	}
 
@@ -156,7 +252,7 @@ static void int_prov_close(void *user_data, uint8_t reason)
 	info.num_ele = prov->conf_inputs.caps.num_ele;
 
 	prov->complete_cb(prov->caller_data, PROV_ERR_SUCCESS, &info);
-	initiator_free();
+	initiator_free(prov);
 }
 
 static void swap_u256_bytes(uint8_t *u256)
@@ -174,14 +270,13 @@ static void swap_u256_bytes(uint8_t *u256)
 static void int_prov_open(void *user_data, prov_trans_tx_t trans_tx,
 				void *trans_data, uint8_t transport)
 {
-	struct mesh_prov_initiator *rx_prov = user_data;
+	struct mesh_prov_initiator *prov = user_data;
 	struct prov_invite_msg msg = { PROV_INVITE, { 30 }};
 
-	/* Only one provisioning session may be open at a time */
-	if (rx_prov != prov)
+	if (!initiator_valid(prov))
 		return;
 
-	/* Only one provisioning session may be open at a time */
+	/* Each session may only be open on a single transport */
 	if (prov->trans_tx && prov->trans_tx != trans_tx &&
 					prov->transport != transport)
 		return;
@@ -285,7 +380,8 @@ static uint32_t digit_mod(uint8_t power)
 	return ret;
 }
 
-static void calc_local_material(const uint8_t *random)
+static void calc_local_material(struct mesh_prov_initiator *prov,
+							const uint8_t *random)
 {
 	/* Calculate SessionKey while the data is fresh */
 	mesh_crypto_prov_prov_salt(prov->salt,
@@ -314,10 +410,10 @@ static void send_confirm(struct mesh_prov_initiator *prov)
 
 static void number_cb(void *user_data, int err, uint32_t number)
 {
-	struct mesh_prov_initiator *rx_prov = user_data;
+	struct mesh_prov_initiator *prov = initiator_find(user_data);
 	struct prov_fail_msg msg;
 
-	if (prov != rx_prov)
+	if (!prov)
 		return;
 
 	if (err) {
@@ -336,10 +432,10 @@ static void number_cb(void *user_data, int err, uint32_t number)
 
 static void static_cb(void *user_data, int err, uint8_t *key, uint32_t len)
 {
-	struct mesh_prov_initiator *rx_prov = user_data;
+	struct mesh_prov_initiator *prov = initiator_find(user_data);
 	struct prov_fail_msg msg;
 
-	if (prov != rx_prov)
+	if (!prov)
 		return;
 
 	if (err || !key || len != 16) {
@@ -367,11 +463,11 @@ static void send_pub_key(struct mesh_prov_initiator *prov)
 
 static void pub_key_cb(void *user_data, int err, uint8_t *key, uint32_t len)
 {
-	struct mesh_prov_initiator *rx_prov = user_data;
+	struct mesh_prov_initiator *prov = initiator_find(user_data);
 	struct prov_fail_msg msg;
 	uint8_t fail_code[2];
 
-	if (prov != rx_prov)
+	if (!prov)
 		return;
 
 	if (err || !key || len != 64) {
@@ -410,6 +506,7 @@ static void send_random(struct mesh_prov_initiator *prov)
 
 void initiator_prov_data(uint16_t net_idx, uint16_t primary, void *caller_data)
 {
+	struct mesh_prov_initiator *prov;
 	struct prov_data_msg prov_data;
 	struct prov_fail_msg prov_fail;
 	struct keyring_net_key key;
@@ -417,7 +514,8 @@ void initiator_prov_data(uint16_t net_idx, uint16_t primary, void *caller_data)
 	uint32_t iv_index;
 	uint8_t snb_flags;
 
-	if (!prov || caller_data != prov->caller_data)
+	prov = l_queue_find(initiators, match_caller, caller_data);
+	if (!prov)
 		return;
 
 	if (prov->state != INT_PROV_RAND_ACKED)
@@ -525,7 +623,7 @@ static void get_random_key(struct mesh_prov_initiator *prov, uint8_t action,
 	l_put_be32(oob_key, prov->rand_auth_workspace + 44);
 }
 
-static void int_prov_auth(void)
+static void int_prov_auth(struct mesh_prov_initiator *prov)
 {
 	uint8_t fail_code[2];
 	uint32_t oob_key;
@@ -545,7 +643,7 @@ static void int_prov_auth(void)
 		/* Auth Type 3c - Static OOB */
 		/* Prompt Agent for Static OOB */
 		fail_code[1] = mesh_agent_request_static(prov->agent,
-				static_cb, prov);
+				static_cb, L_UINT_TO_PTR(prov->id));
 
 		if (fail_code[1])
 			goto failure;
@@ -558,12 +656,12 @@ static void int_prov_auth(void)
 						PROV_ACTION_OUT_ALPHA) {
 			fail_code[1] = mesh_agent_prompt_alpha(
 				prov->agent, true,
-				static_cb, prov);
+				static_cb, L_UINT_TO_PTR(prov->id));
 		} else {
 			fail_code[1] = mesh_agent_prompt_number(
 				prov->agent, true,
 				prov->conf_inputs.start.auth_action,
-				number_cb, prov);
+				number_cb, L_UINT_TO_PTR(prov->id));
 		}
 
 		if (fail_code[1])
@@ -585,12 +683,12 @@ static void int_prov_auth(void)
 			fail_code[1] = mesh_agent_display_string(
 				prov->agent,
 				(char *) prov->rand_auth_workspace + 16,
-				NULL, prov);
+				NULL, L_UINT_TO_PTR(prov->id));
 		} else {
 			fail_code[1] = mesh_agent_display_number(
 				prov->agent, true,
 				prov->conf_inputs.start.auth_action,
-				oob_key, NULL, prov);
+				oob_key, NULL, L_UINT_TO_PTR(prov->id));
 		}
 
 		if (fail_code[1])
@@ -652,13 +750,13 @@ static void int_prov_start_auth(const struct mesh_agent_prov_caps *prov_caps,
 
 static void int_prov_rx(void *user_data, const void *dptr, uint16_t len)
 {
-	struct mesh_prov_initiator *rx_prov = user_data;
+	struct mesh_prov_initiator *prov = user_data;
 	const uint8_t *data = dptr;
 	uint8_t *out;
 	uint8_t type = *data++;
 	uint8_t fail_code[2];
 
-	if (rx_prov != prov || !prov->trans_tx)
+	if (!initiator_valid(prov) || !prov->trans_tx)
 		return;
 
 	l_debug("Provisioning packet received type: %2.2x (%u octets)",
@@ -718,8 +816,8 @@ static void int_prov_rx(void *user_data, const void *dptr, uint16_t len)
 		if (prov->conf_inputs.start.pub_key == 0x01) {
 			prov->expected = PROV_CONFIRM;
 			/* Prompt Agent for remote Public Key */
-			mesh_agent_request_public_key(prov->agent,
-							pub_key_cb, prov);
+			mesh_agent_request_public_key(prov->agent, pub_key_cb,
+						L_UINT_TO_PTR(prov->id));
 			/* Nothing else for us to do now */
 		} else
 			prov->expected = PROV_PUB_KEY;
@@ -754,7 +852,7 @@ static void int_prov_rx(void *user_data, const void *dptr, uint16_t len)
 			goto failure;
 		}
 
-		int_prov_auth();
+		int_prov_auth(prov);
 		break;
 
 	case PROV_INP_CMPLT: /* Provisioning Input Complete */
@@ -788,7 +886,7 @@ static void int_prov_rx(void *user_data, const void *dptr, uint16_t len)
 		}
 
 		/* RXed Device Confirmation */
-		calc_local_material(data);
+		calc_local_material(prov, data);
 		memcpy(prov->rand_auth_workspace + 16, data, 16);
 		print_packet("RandomDevice", data, 16);
 
@@ -834,7 +932,7 @@ static void int_prov_rx(void *user_data, const void *dptr, uint16_t len)
 		goto failure;
 	}
 
-	if (prov)
+	if (initiator_valid(prov))
 		prov->previous = type;
 
 	return;
@@ -848,9 +946,9 @@ failure:
 
 static void int_prov_ack(void *user_data, uint8_t msg_num)
 {
-	struct mesh_prov_initiator *rx_prov = user_data;
+	struct mesh_prov_initiator *prov = user_data;
 
-	if (rx_prov != prov || !prov->trans_tx)
+	if (!initiator_valid(prov) || !prov->trans_tx)
 		return;
 
 	switch (prov->state) {
@@ -866,7 +964,7 @@ static void int_prov_ack(void *user_data, uint8_t msg_num)
 
 	case INT_PROV_KEY_SENT:
 		if (prov->conf_inputs.start.pub_key)
-			int_prov_auth();
+			int_prov_auth(prov);
 		break;
 
 	case INT_PROV_IDLE:
@@ -884,15 +982,12 @@ static void int_prov_ack(void *user_data, uint8_t msg_num)
 	}
 }
 
-static void initiator_open_cb(void *user_data, int err)
+static void initiator_open(struct mesh_prov_initiator *prov, int err)
 {
 	uint8_t msg[20];
 	int n;
 	bool result;
 
-	if (!prov)
-		return;
-
 	if (err != MESH_ERROR_NONE)
 		goto fail;
 
@@ -924,19 +1019,39 @@ static void initiator_open_cb(void *user_data, int err)
 	return;
 fail:
 	prov->start_cb(prov->caller_data, err);
-	initiator_free();
+	initiator_free(prov);
+}
+
+static void initiator_agent_cb(void *user_data, int err)
+{
+	struct mesh_agent *agent = user_data;
+	struct mesh_prov_initiator *prov;
+
+	/* Open every session that waited for this agent to be refreshed */
+	while ((prov = l_queue_find(initiators, match_agent_wait, agent))) {
+		prov->agent_wait = false;
+		initiator_open(prov, err);
+	}
+}
+
+static void initiator_idle_open(void *user_data)
+{
+	struct mesh_prov_initiator *prov = initiator_find(user_data);
+
+	if (prov)
+		initiator_open(prov, MESH_ERROR_NONE);
 }
 
 static void initiate_to(struct l_timeout *timeout, void *user_data)
 {
-	struct mesh_prov_initiator *rx_prov = user_data;
+	struct mesh_prov_initiator *prov = user_data;
 
-	if (rx_prov != prov) {
+	if (!initiator_valid(prov)) {
 		l_timeout_remove(timeout);
 		return;
 	}
 
-	int_prov_close(user_data, PROV_ERR_TIMEOUT);
+	int_prov_close(prov, PROV_ERR_TIMEOUT);
 }
 
 bool initiator_start(uint8_t transport, uint16_t server, uint16_t svr_idx,
@@ -947,13 +1062,12 @@ bool initiator_start(uint8_t transport, uint16_t server, uint16_t svr_idx,
 		mesh_prov_initiator_complete_func_t complete_cb,
 		void *node, void *caller_data)
 {
+	struct mesh_prov_initiator *prov;
+
 	/* Invoked from Add() method in mesh-api.txt, to add a
 	 * remote unprovisioned device network.
 	 */
 
-	if (prov)
-		return false;
-
 	prov = l_new(struct mesh_prov_initiator, 1);
 	prov->to_secs = timeout;
 	prov->node = node;
@@ -966,17 +1080,49 @@ bool initiator_start(uint8_t transport, uint16_t server, uint16_t svr_idx,
 	prov->server = server;
 	prov->svr_idx = svr_idx;
 	prov->transport = transport;
+
+	if (uuid)
+		memcpy(prov->uuid, uuid, 16);
+
+	/* Any number of devices may be provisioned, each on its own link */
+	if (l_queue_find(initiators, match_link, prov)) {
+		l_free(prov);
+		return false;
+	}
+
+	if (!++last_id)
+		++last_id;
+
+	prov->id = last_id;
 	prov->timeout = l_timeout_create(timeout, initiate_to, prov, NULL);
-	memcpy(prov->uuid, uuid, 16);
+	prov->start_time = l_time_now();
+
+	/*
+	 * The agent only handles one request, so it is refreshed once. Later
+	 * sessions wait for that refresh to complete, or open right away if
+	 * it already has.
+	 */
+	if (l_queue_find(initiators, match_agent_wait, agent))
+		prov->agent_wait = true;
+	else if (l_queue_find(initiators, match_agent, agent))
+		l_idle_oneshot(initiator_idle_open, L_UINT_TO_PTR(prov->id),
+									NULL);
+	else {
+		prov->agent_wait = true;
+		mesh_agent_refresh(prov->agent, initiator_agent_cb, agent);
+	}
+
+	if (!initiators)
+		initiators = l_queue_new();
 
-	mesh_agent_refresh(prov->agent, initiator_open_cb, prov);
+	l_queue_push_tail(initiators, prov);
 
 	return true;
 }
 
 void initiator_cancel(void *user_data)
 {
-	initiator_free();
+	initiator_free(l_queue_find(initiators, match_caller, user_data));
 }
 
 static void rpr_tx(void *user_data, const void *data, uint16_t len)
@@ -1009,6 +1155,7 @@ static bool remprv_cli_pkt(uint16_t src, uint16_t unicast, uint16_t app_idx,
 					uint16_t size, const void *user_data)
 {
 	struct mesh_node *node = (struct mesh_node *) user_data;
+	struct mesh_prov_initiator *prov;
 	const uint8_t *pkt = data;
 	struct scan_req *req;
 	uint32_t opcode;
@@ -1031,7 +1178,8 @@ static bool remprv_cli_pkt(uint16_t src, uint16_t unicast, uint16_t app_idx,
 	if (app_idx == APP_IDX_DEV_LOCAL && unicast != src)
 		return true;
 
-	if (prov && (prov->server != src || prov->node != node))
+	prov = l_queue_find(initiators, match_server, L_UINT_TO_PTR(src));
+	if (prov && prov->node != node)
 		return true;
 
 	n = 0;
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+struct mesh_node;
+
+#define SAR_CFG_SRV_MODEL	SET_ID(SIG_VENDOR, 0x000E)
+#define SAR_CFG_CLI_MODEL	SET_ID(SIG_VENDOR, 0x000F)
+
+/* SAR Configuration opcodes */
+#define OP_SAR_TRANSMITTER_GET			0x806C
+#define OP_SAR_TRANSMITTER_SET			0x806D
+#define OP_SAR_TRANSMITTER_STATUS		0x806E
+#define OP_SAR_RECEIVER_GET			0x806F
+#define OP_SAR_RECEIVER_SET			0x8070
+#define OP_SAR_RECEIVER_STATUS			0x8071
+
+void sar_cfg_server_init(struct mesh_node *node, uint8_t ele_idx);
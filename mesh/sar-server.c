@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/time.h>
+#include <ell/ell.h>
+
+#include "mesh/mesh-defs.h"
+#include "mesh/node.h"
+#include "mesh/net.h"
+#include "mesh/model.h"
+#include "mesh/sar-config.h"
+
+static bool sar_srv_pkt(uint16_t src, uint16_t dst, uint16_t app_idx,
+				uint16_t net_idx, const uint8_t *data,
+				uint16_t size, const void *user_data)
+{
+	struct mesh_node *node = (struct mesh_node *) user_data;
+	struct mesh_net *net = node_get_net(node);
+	const uint8_t *pkt = data;
+	uint32_t opcode;
+	uint8_t msg[6];
+	uint16_t n;
+
+	if (app_idx != APP_IDX_DEV_LOCAL)
+		return false;
+
+	if (mesh_model_opcode_get(pkt, size, &opcode, &n)) {
+		size -= n;
+		pkt += n;
+	} else
+		return false;
+
+	l_debug("SAR-CFG-SRV-opcode 0x%x size %u idx %3.3x", opcode, size,
+								net_idx);
+
+	n = 0;
+
+	switch (opcode) {
+	default:
+		return false;
+
+	case OP_SAR_TRANSMITTER_SET:
+		/* RFU bits of the last octet must be zero */
+		if (size != 4 || pkt[3] & 0xf0)
+			return true;
+
+		node_sar_tx_set(node, l_get_le32(pkt));
+
+		/* fall through */
+
+	case OP_SAR_TRANSMITTER_GET:
+		n = mesh_model_opcode_set(OP_SAR_TRANSMITTER_STATUS, msg);
+		l_put_le32(mesh_net_sar_tx_encode(mesh_net_get_sar_tx(net)),
+								msg + n);
+		n += 4;
+
+		l_debug("Get/Set SAR Transmitter");
+		break;
+
+	case OP_SAR_RECEIVER_SET:
+		if (size != 3 || pkt[2] & 0xfc)
+			return true;
+
+		node_sar_rx_set(node, l_get_le16(pkt) | pkt[2] << 16);
+
+		/* fall through */
+
+	case OP_SAR_RECEIVER_GET:
+		n = mesh_model_opcode_set(OP_SAR_RECEIVER_STATUS, msg);
+		l_put_le32(mesh_net_sar_rx_encode(mesh_net_get_sar_rx(net)),
+								msg + n);
+		n += 3;
+
+		l_debug("Get/Set SAR Receiver");
+		break;
+	}
+
+	if (n)
+		mesh_model_send(node, dst, src, APP_IDX_DEV_LOCAL, net_idx,
+						DEFAULT_TTL, false, n, msg);
+
+	return true;
+}
+
+static void sar_srv_unregister(void *user_data)
+{
+}
+
+static const struct mesh_model_ops ops = {
+	.unregister = sar_srv_unregister,
+	.recv = sar_srv_pkt,
+	.bind = NULL,
+	.sub = NULL,
+	.pub = NULL
+};
+
+void sar_cfg_server_init(struct mesh_node *node, uint8_t ele_idx)
+{
+	l_debug("%2.2x", ele_idx);
+	mesh_model_register(node, ele_idx, SAR_CFG_SRV_MODEL, &ops, node);
+}
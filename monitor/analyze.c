@@ -15,8 +15,12 @@
 
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <unistd.h>
 
 #include "lib/bluetooth.h"
@@ -24,6 +28,7 @@
 #include "src/shared/util.h"
 #include "src/shared/queue.h"
 #include "src/shared/btsnoop.h"
+#include "src/shared/mainloop.h"
 #include "monitor/bt.h"
 #include "monitor/display.h"
 #include "monitor/packet.h"
@@ -59,11 +64,25 @@ struct hci_dev {
 #define CONN_LE_ACL	0x04
 #define CONN_LE_ISO	0x05
 
+#define LATENCY_BUCKETS	12
+
+/* Upper bounds of the TX completion latency histogram buckets */
+static const unsigned int latency_bucket_msec[LATENCY_BUCKETS] = {
+	1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000
+};
+
+struct hci_hist {
+	size_t count[LATENCY_BUCKETS];
+	size_t num;
+	long long sum_usec;
+};
+
 struct hci_stats {
 	size_t bytes;
 	size_t num;
 	size_t num_comp;
 	struct packet_latency latency;
+	struct hci_hist hist;
 	struct queue *plot;
 	uint16_t min;
 	uint16_t max;
@@ -76,6 +95,8 @@ struct hci_conn {
 	uint8_t bdaddr[6];
 	bool setup_seen;
 	bool terminated;
+	bool exported;
+	size_t flushed;
 	struct queue *tx_queue;
 	struct timeval last_rx;
 	struct queue *chan_list;
@@ -104,6 +125,15 @@ struct l2cap_chan {
 
 static struct queue *dev_list;
 
+/* Live mode keeps collecting until stopped and exports metrics instead of
+ * printing a summary of each controller.
+ */
+static bool live;
+static char *metrics_path;
+static int metrics_fd = -1;
+static unsigned int metrics_interval;
+static int metrics_timeout = -1;
+
 static void tmp_write(void *data, void *user_data)
 {
 	struct plot *plot = data;
@@ -158,6 +188,15 @@ static void print_stats(struct hci_stats *stats, const char *label)
 	plot_draw(stats->plot, label);
 }
 
+static void chan_free(void *data)
+{
+	struct l2cap_chan *chan = data;
+
+	queue_destroy(chan->rx.plot, free);
+	queue_destroy(chan->tx.plot, free);
+	free(chan);
+}
+
 static void chan_destroy(void *data)
 {
 	struct l2cap_chan *chan = data;
@@ -174,7 +213,7 @@ static void chan_destroy(void *data)
 	print_stats(&chan->tx, "TX");
 
 done:
-	free(chan);
+	chan_free(chan);
 }
 
 static struct l2cap_chan *chan_alloc(struct hci_conn *conn, uint16_t cid,
@@ -217,33 +256,42 @@ static struct l2cap_chan *chan_lookup(struct hci_conn *conn, uint16_t cid,
 	return chan;
 }
 
-static void conn_destroy(void *data)
+static const char *conn_type_str(uint8_t type)
 {
-	struct hci_conn *conn = data;
-	const char *str;
-
-	switch (conn->type) {
+	switch (type) {
 	case CONN_BR_ACL:
-		str = "BR-ACL";
-		break;
+		return "BR-ACL";
 	case CONN_BR_SCO:
-		str = "BR-SCO";
-		break;
+		return "BR-SCO";
 	case CONN_BR_ESCO:
-		str = "BR-ESCO";
-		break;
+		return "BR-ESCO";
 	case CONN_LE_ACL:
-		str = "LE-ACL";
-		break;
+		return "LE-ACL";
 	case CONN_LE_ISO:
-		str = "LE-ISO";
-		break;
+		return "LE-ISO";
 	default:
-		str = "unknown";
-		break;
+		return "unknown";
 	}
+}
+
+static void conn_free(void *data)
+{
+	struct hci_conn *conn = data;
+
+	queue_destroy(conn->rx.plot, free);
+	queue_destroy(conn->tx.plot, free);
+	queue_destroy(conn->chan_list, chan_free);
 
-	printf("  Found %s connection with handle %u\n", str, conn->handle);
+	queue_destroy(conn->tx_queue, free);
+	free(conn);
+}
+
+static void conn_destroy(void *data)
+{
+	struct hci_conn *conn = data;
+
+	printf("  Found %s connection with handle %u\n",
+				conn_type_str(conn->type), conn->handle);
 	/* TODO: Store address type */
 	packet_print_addr("Address", conn->bdaddr, 0x00);
 	if (!conn->setup_seen)
@@ -251,12 +299,10 @@ static void conn_destroy(void *data)
 	print_stats(&conn->rx, "RX");
 	print_stats(&conn->tx, "TX");
 
-	queue_destroy(conn->rx.plot, free);
-	queue_destroy(conn->tx.plot, free);
 	queue_destroy(conn->chan_list, chan_destroy);
+	conn->chan_list = NULL;
 
-	queue_destroy(conn->tx_queue, free);
-	free(conn);
+	conn_free(conn);
 }
 
 static struct hci_conn *conn_alloc(struct hci_dev *dev, uint16_t handle,
@@ -320,6 +366,14 @@ static struct hci_conn *conn_lookup_type(struct hci_dev *dev, uint16_t handle,
 	return conn;
 }
 
+static void dev_free(void *data)
+{
+	struct hci_dev *dev = data;
+
+	queue_destroy(dev->conn_list, conn_free);
+	free(dev);
+}
+
 static void dev_destroy(void *data)
 {
 	struct hci_dev *dev = data;
@@ -451,7 +505,10 @@ static void del_index(struct timeval *tv, uint16_t index,
 		return;
 	}
 
-	dev_destroy(dev);
+	if (live)
+		dev_free(dev);
+	else
+		dev_destroy(dev);
 }
 
 static void command_pkt(struct timeval *tv, uint16_t index,
@@ -500,6 +557,22 @@ static void evt_disconnect_complete(struct hci_dev *dev, struct timeval *tv,
 	conn->terminated = true;
 }
 
+static void evt_flush_occurred(struct hci_dev *dev, struct timeval *tv,
+					const void *data, uint16_t size)
+{
+	const struct bt_hci_evt_flush_occurred *evt = data;
+	struct hci_conn *conn;
+
+	if (size < sizeof(*evt))
+		return;
+
+	conn = conn_lookup(dev, le16_to_cpu(evt->handle));
+	if (!conn)
+		return;
+
+	conn->flushed++;
+}
+
 static void rsp_read_bd_addr(struct hci_dev *dev, struct timeval *tv,
 					const void *data, uint16_t size)
 {
@@ -557,6 +630,22 @@ static void plot_add(struct queue *queue, struct timeval *latency,
 	queue_push_tail(queue, plot);
 }
 
+static void hist_add(struct hci_hist *hist, struct timeval *latency)
+{
+	long long msec = TIMEVAL_MSEC(latency);
+	unsigned int i;
+
+	for (i = 0; i < LATENCY_BUCKETS; i++) {
+		if (msec <= latency_bucket_msec[i]) {
+			hist->count[i]++;
+			break;
+		}
+	}
+
+	hist->num++;
+	hist->sum_usec += latency->tv_sec * 1000000LL + latency->tv_usec;
+}
+
 static void evt_le_conn_complete(struct hci_dev *dev, struct timeval *tv,
 					struct iovec *iov)
 {
@@ -628,12 +717,14 @@ static void evt_num_completed_packets(struct hci_dev *dev, struct timeval *tv,
 
 				packet_latency_add(&conn->tx.latency, &res);
 				plot_add(conn->tx.plot, &res, 1);
+				hist_add(&conn->tx.hist, &res);
 
 				if (chan) {
 					chan->tx.num_comp += count;
 					packet_latency_add(&chan->tx.latency,
 									&res);
 					plot_add(chan->tx.plot, &res, 1);
+					hist_add(&chan->tx.hist, &res);
 				}
 
 				free(last_tx);
@@ -807,6 +898,9 @@ static void event_pkt(struct timeval *tv, uint16_t index,
 	case BT_HCI_EVT_NUM_COMPLETED_PACKETS:
 		evt_num_completed_packets(dev, tv, data, size);
 		break;
+	case BT_HCI_EVT_FLUSH_OCCURRED:
+		evt_flush_occurred(dev, tv, data, size);
+		break;
 	case BT_HCI_EVT_SYNC_CONN_COMPLETE:
 		evt_sync_conn_complete(dev, tv, data, size);
 		break;
@@ -1038,6 +1132,67 @@ static void unknown_opcode(struct timeval *tv, uint16_t index,
 	dev->unknown++;
 }
 
+static void process_packet(struct timeval *tv, uint16_t index,
+				uint16_t opcode, const void *buf, uint16_t pktlen)
+{
+	switch (opcode) {
+	case BTSNOOP_OPCODE_NEW_INDEX:
+		new_index(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_DEL_INDEX:
+		del_index(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_COMMAND_PKT:
+		command_pkt(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_EVENT_PKT:
+		event_pkt(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_ACL_TX_PKT:
+		acl_pkt(tv, index, true, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_ACL_RX_PKT:
+		acl_pkt(tv, index, false, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_SCO_TX_PKT:
+		sco_pkt(tv, index, true, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_SCO_RX_PKT:
+		sco_pkt(tv, index, false, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_OPEN_INDEX:
+	case BTSNOOP_OPCODE_CLOSE_INDEX:
+		break;
+	case BTSNOOP_OPCODE_INDEX_INFO:
+		info_index(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_VENDOR_DIAG:
+		vendor_diag(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_SYSTEM_NOTE:
+		system_note(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_USER_LOGGING:
+		user_log(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_CTRL_OPEN:
+	case BTSNOOP_OPCODE_CTRL_CLOSE:
+	case BTSNOOP_OPCODE_CTRL_COMMAND:
+	case BTSNOOP_OPCODE_CTRL_EVENT:
+		ctrl_msg(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_ISO_TX_PKT:
+		iso_pkt(tv, index, true, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_ISO_RX_PKT:
+		iso_pkt(tv, index, false, buf, pktlen);
+		break;
+	default:
+		unknown_opcode(tv, index, buf, pktlen);
+		break;
+	}
+}
+
 void analyze_trace(const char *path)
 {
 	struct btsnoop *btsnoop_file;
@@ -1071,62 +1226,7 @@ void analyze_trace(const char *path)
 								buf, &pktlen))
 			break;
 
-		switch (opcode) {
-		case BTSNOOP_OPCODE_NEW_INDEX:
-			new_index(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_DEL_INDEX:
-			del_index(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_COMMAND_PKT:
-			command_pkt(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_EVENT_PKT:
-			event_pkt(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_ACL_TX_PKT:
-			acl_pkt(&tv, index, true, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_ACL_RX_PKT:
-			acl_pkt(&tv, index, false, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_SCO_TX_PKT:
-			sco_pkt(&tv, index, true, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_SCO_RX_PKT:
-			sco_pkt(&tv, index, false, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_OPEN_INDEX:
-		case BTSNOOP_OPCODE_CLOSE_INDEX:
-			break;
-		case BTSNOOP_OPCODE_INDEX_INFO:
-			info_index(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_VENDOR_DIAG:
-			vendor_diag(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_SYSTEM_NOTE:
-			system_note(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_USER_LOGGING:
-			user_log(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_CTRL_OPEN:
-		case BTSNOOP_OPCODE_CTRL_CLOSE:
-		case BTSNOOP_OPCODE_CTRL_COMMAND:
-		case BTSNOOP_OPCODE_CTRL_EVENT:
-			ctrl_msg(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_ISO_TX_PKT:
-			iso_pkt(&tv, index, true, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_ISO_RX_PKT:
-			iso_pkt(&tv, index, false, buf, pktlen);
-			break;
-		default:
-			unknown_opcode(&tv, index, buf, pktlen);
-			break;
-		}
+		process_packet(&tv, index, opcode, buf, pktlen);
 
 		num_packets++;
 	}
@@ -1138,3 +1238,402 @@ void analyze_trace(const char *path)
 done:
 	btsnoop_unref(btsnoop_file);
 }
+
+enum {
+	METRIC_TX_BYTES,
+	METRIC_RX_BYTES,
+	METRIC_TX_PACKETS,
+	METRIC_RX_PACKETS,
+	METRIC_TX_COMPLETED,
+	METRIC_TX_PENDING,
+	METRIC_FLUSHED,
+	METRIC_TX_LATENCY,
+};
+
+struct metric {
+	int id;
+	const char *name;
+	const char *type;
+	const char *help;
+};
+
+static const struct metric conn_metrics[] = {
+	{ METRIC_TX_BYTES, "btmon_conn_tx_bytes_total", "counter",
+				"Payload octets sent to the controller" },
+	{ METRIC_RX_BYTES, "btmon_conn_rx_bytes_total", "counter",
+				"Payload octets received from the controller" },
+	{ METRIC_TX_PACKETS, "btmon_conn_tx_packets_total", "counter",
+				"Packets sent to the controller" },
+	{ METRIC_RX_PACKETS, "btmon_conn_rx_packets_total", "counter",
+				"Packets received from the controller" },
+	{ METRIC_TX_COMPLETED, "btmon_conn_tx_completed_total", "counter",
+				"Packets reported as completed" },
+	{ METRIC_TX_PENDING, "btmon_conn_tx_pending", "gauge",
+				"Packets queued in the controller" },
+	{ METRIC_FLUSHED, "btmon_conn_flushed_total", "counter",
+				"Flush Occurred events" },
+	{ METRIC_TX_LATENCY, "btmon_conn_tx_latency_seconds", "histogram",
+				"Time until packets are reported as completed" },
+	{ }
+};
+
+static const struct metric chan_metrics[] = {
+	{ METRIC_TX_BYTES, "btmon_chan_tx_bytes_total", "counter",
+				"L2CAP octets sent to the controller" },
+	{ METRIC_RX_BYTES, "btmon_chan_rx_bytes_total", "counter",
+				"L2CAP octets received from the controller" },
+	{ METRIC_TX_PACKETS, "btmon_chan_tx_packets_total", "counter",
+				"L2CAP packets sent to the controller" },
+	{ METRIC_RX_PACKETS, "btmon_chan_rx_packets_total", "counter",
+				"L2CAP packets received from the controller" },
+	{ METRIC_TX_LATENCY, "btmon_chan_tx_latency_seconds", "histogram",
+				"Time until packets are reported as completed" },
+	{ }
+};
+
+static void metrics_hist(FILE *f, const char *name, const char *labels,
+						const struct hci_hist *hist)
+{
+	size_t count = 0;
+	unsigned int i;
+
+	for (i = 0; i < LATENCY_BUCKETS; i++) {
+		count += hist->count[i];
+		fprintf(f, "%s_bucket{%s,le=\"%g\"} %zu\n", name, labels,
+					latency_bucket_msec[i] / 1000.0, count);
+	}
+
+	fprintf(f, "%s_bucket{%s,le=\"+Inf\"} %zu\n", name, labels, hist->num);
+	fprintf(f, "%s_sum{%s} %lld.%06lld\n", name, labels,
+					hist->sum_usec / 1000000,
+					hist->sum_usec % 1000000);
+	fprintf(f, "%s_count{%s} %zu\n", name, labels, hist->num);
+}
+
+static void metrics_stats(FILE *f, const struct metric *metric,
+				const char *labels, const struct hci_stats *tx,
+				const struct hci_stats *rx)
+{
+	switch (metric->id) {
+	case METRIC_TX_BYTES:
+		fprintf(f, "%s{%s} %zu\n", metric->name, labels, tx->bytes);
+		break;
+	case METRIC_RX_BYTES:
+		fprintf(f, "%s{%s} %zu\n", metric->name, labels, rx->bytes);
+		break;
+	case METRIC_TX_PACKETS:
+		fprintf(f, "%s{%s} %zu\n", metric->name, labels, tx->num);
+		break;
+	case METRIC_RX_PACKETS:
+		fprintf(f, "%s{%s} %zu\n", metric->name, labels, rx->num);
+		break;
+	case METRIC_TX_COMPLETED:
+		fprintf(f, "%s{%s} %zu\n", metric->name, labels,
+								tx->num_comp);
+		break;
+	case METRIC_TX_LATENCY:
+		metrics_hist(f, metric->name, labels, &tx->hist);
+		break;
+	}
+}
+
+static int conn_labels(char *str, size_t len, const struct hci_dev *dev,
+						const struct hci_conn *conn)
+{
+	return snprintf(str, len, "index=\"%u\",handle=\"%u\",type=\"%s\","
+			"address=\"%2.2X:%2.2X:%2.2X:%2.2X:%2.2X:%2.2X\"",
+			dev->index, conn->handle, conn_type_str(conn->type),
+			conn->bdaddr[5], conn->bdaddr[4], conn->bdaddr[3],
+			conn->bdaddr[2], conn->bdaddr[1], conn->bdaddr[0]);
+}
+
+static void metrics_conn(FILE *f, const struct metric *metric,
+				const struct hci_dev *dev, struct hci_conn *conn)
+{
+	char labels[128];
+
+	conn_labels(labels, sizeof(labels), dev, conn);
+
+	switch (metric->id) {
+	case METRIC_TX_PENDING:
+		fprintf(f, "%s{%s} %u\n", metric->name, labels,
+					queue_length(conn->tx_queue));
+		break;
+	case METRIC_FLUSHED:
+		fprintf(f, "%s{%s} %zu\n", metric->name, labels,
+							conn->flushed);
+		break;
+	default:
+		metrics_stats(f, metric, labels, &conn->tx, &conn->rx);
+		break;
+	}
+
+	conn->exported = true;
+}
+
+static void metrics_chan(FILE *f, const struct metric *metric,
+				const struct hci_dev *dev,
+				const struct hci_conn *conn,
+				const struct l2cap_chan *chan)
+{
+	char labels[192];
+	int len;
+
+	if (!chan->rx.num && !chan->tx.num)
+		return;
+
+	len = conn_labels(labels, sizeof(labels), dev, conn);
+	snprintf(labels + len, sizeof(labels) - len,
+				",cid=\"%u\",psm=\"%u\",dir=\"%s\"",
+				chan->cid, chan->psm, chan->out ? "tx" : "rx");
+
+	metrics_stats(f, metric, labels, &chan->tx, &chan->rx);
+}
+
+static void metrics_header(FILE *f, const struct metric *metric)
+{
+	fprintf(f, "# HELP %s %s\n", metric->name, metric->help);
+	fprintf(f, "# TYPE %s %s\n", metric->name, metric->type);
+}
+
+static void metrics_write(FILE *f)
+{
+	const struct queue_entry *d, *c, *l;
+	const struct metric *metric;
+
+	fprintf(f, "# HELP btmon_hci_packets_total HCI packets by type\n");
+	fprintf(f, "# TYPE btmon_hci_packets_total counter\n");
+
+	for (d = queue_get_entries(dev_list); d; d = d->next) {
+		const struct hci_dev *dev = d->data;
+
+		fprintf(f, "btmon_hci_packets_total{index=\"%u\",type=\"cmd\"}"
+						" %lu\n", dev->index, dev->num_cmd);
+		fprintf(f, "btmon_hci_packets_total{index=\"%u\",type=\"evt\"}"
+						" %lu\n", dev->index, dev->num_evt);
+		fprintf(f, "btmon_hci_packets_total{index=\"%u\",type=\"acl\"}"
+						" %lu\n", dev->index, dev->num_acl);
+		fprintf(f, "btmon_hci_packets_total{index=\"%u\",type=\"sco\"}"
+						" %lu\n", dev->index, dev->num_sco);
+		fprintf(f, "btmon_hci_packets_total{index=\"%u\",type=\"iso\"}"
+						" %lu\n", dev->index, dev->num_iso);
+	}
+
+	/* Samples of a metric have to be grouped after its header */
+	for (metric = conn_metrics; metric->name; metric++) {
+		metrics_header(f, metric);
+
+		for (d = queue_get_entries(dev_list); d; d = d->next) {
+			const struct hci_dev *dev = d->data;
+
+			for (c = queue_get_entries(dev->conn_list); c;
+								c = c->next)
+				metrics_conn(f, metric, dev, c->data);
+		}
+	}
+
+	for (metric = chan_metrics; metric->name; metric++) {
+		metrics_header(f, metric);
+
+		for (d = queue_get_entries(dev_list); d; d = d->next) {
+			const struct hci_dev *dev = d->data;
+
+			for (c = queue_get_entries(dev->conn_list); c;
+								c = c->next) {
+				const struct hci_conn *conn = c->data;
+
+				for (l = queue_get_entries(conn->chan_list); l;
+								l = l->next)
+					metrics_chan(f, metric, dev, conn,
+								l->data);
+			}
+		}
+	}
+}
+
+static void metrics_write_file(void)
+{
+	char path[PATH_MAX];
+	FILE *f;
+
+	/* Replace the file atomically so collectors never see it partial */
+	snprintf(path, sizeof(path), "%s.tmp", metrics_path);
+
+	f = fopen(path, "w");
+	if (!f) {
+		perror("Failed to open metrics file");
+		return;
+	}
+
+	metrics_write(f);
+
+	if (fclose(f) < 0 || rename(path, metrics_path) < 0) {
+		perror("Failed to write metrics file");
+		unlink(path);
+	}
+}
+
+static bool match_conn_exported(const void *data, const void *user_data)
+{
+	const struct hci_conn *conn = data;
+
+	return conn->terminated && conn->exported;
+}
+
+static void prune_dev(void *data, void *user_data)
+{
+	struct hci_dev *dev = data;
+
+	queue_remove_all(dev->conn_list, match_conn_exported, NULL,
+								conn_free);
+}
+
+static void metrics_timeout_cb(int id, void *user_data)
+{
+	if (metrics_path)
+		metrics_write_file();
+
+	/* Terminated connections are kept until exported once */
+	queue_foreach(dev_list, prune_dev, NULL);
+
+	mainloop_modify_timeout(id, metrics_interval * 1000);
+}
+
+static void metrics_accept(int fd, uint32_t events, void *user_data)
+{
+	char *buf = NULL;
+	size_t len = 0;
+	FILE *f;
+	int nfd;
+
+	if (events & (EPOLLERR | EPOLLHUP)) {
+		mainloop_remove_fd(fd);
+		return;
+	}
+
+	nfd = accept4(fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (nfd < 0)
+		return;
+
+	f = open_memstream(&buf, &len);
+	if (!f) {
+		close(nfd);
+		return;
+	}
+
+	metrics_write(f);
+
+	/*
+	 * Don't let a stuck reader stall capturing: whatever doesn't fit
+	 * into the socket buffer is dropped, the reader gets the next
+	 * sample on its next connection.
+	 */
+	if (!fclose(f) && send(nfd, buf, len, MSG_NOSIGNAL) != (ssize_t) len)
+		fprintf(stderr, "Metrics sample dropped, reader is too slow\n");
+
+	free(buf);
+	close(nfd);
+}
+
+static int metrics_listen(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) > sizeof(addr.sun_path) - 1) {
+		fprintf(stderr, "Socket name too long\n");
+		return -1;
+	}
+
+	unlink(path);
+
+	fd = socket(PF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		perror("Failed to open metrics socket");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		perror("Failed to bind metrics socket");
+		close(fd);
+		return -1;
+	}
+
+	if (listen(fd, 5) < 0) {
+		perror("Failed to listen metrics socket");
+		close(fd);
+		return -1;
+	}
+
+	if (mainloop_add_fd(fd, EPOLLIN, metrics_accept, NULL, NULL) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+bool analyze_live(const char *path, unsigned int interval)
+{
+	if (live)
+		return false;
+
+	if (!strncmp(path, "unix:", 5)) {
+		metrics_fd = metrics_listen(path + 5);
+		if (metrics_fd < 0)
+			return false;
+	} else
+		metrics_path = strdup(path);
+
+	metrics_interval = interval;
+	metrics_timeout = mainloop_add_timeout(interval * 1000,
+					metrics_timeout_cb, NULL, NULL);
+
+	dev_list = queue_new();
+	live = true;
+
+	return true;
+}
+
+void analyze_packet(struct timeval *tv, uint16_t index, uint16_t opcode,
+					const void *data, uint16_t size)
+{
+	struct timeval now;
+
+	if (!live)
+		return;
+
+	if (!tv) {
+		gettimeofday(&now, NULL);
+		tv = &now;
+	}
+
+	process_packet(tv, index, opcode, data, size);
+}
+
+void analyze_stop(void)
+{
+	if (!live)
+		return;
+
+	if (metrics_timeout >= 0)
+		mainloop_remove_timeout(metrics_timeout);
+
+	if (metrics_fd >= 0) {
+		mainloop_remove_fd(metrics_fd);
+		close(metrics_fd);
+	}
+
+	if (metrics_path) {
+		metrics_write_file();
+		free(metrics_path);
+	}
+
+	queue_destroy(dev_list, dev_free);
+	dev_list = NULL;
+	live = false;
+}
@@ -9,4 +9,14 @@
  *
  */
 
+#include <stdint.h>
+#include <stdbool.h>
+
+struct timeval;
+
 void analyze_trace(const char *path);
+
+bool analyze_live(const char *path, unsigned int interval);
+void analyze_packet(struct timeval *tv, uint16_t index, uint16_t opcode,
+					const void *data, uint16_t size);
+void analyze_stop(void);
@@ -23,6 +23,7 @@
 #include <stdbool.h>
 #include <errno.h>
 #include <limits.h>
+#include <time.h>
 #include <sys/stat.h>
 
 #include <glib.h>
@@ -54,11 +55,18 @@ struct att_read {
 	struct iovec *iov;
 };
 
+/* Minimum interval between checks for storage changes */
+#define ATT_DB_CHECK_INTERVAL	1	/* seconds */
+
 struct att_conn_data {
 	struct gatt_db *ldb;
 	struct timespec ldb_mtim;
+	char *ldb_file;
 	struct gatt_db *rdb;
 	struct timespec rdb_mtim;
+	char *rdb_file;
+	unsigned int keys_gen;
+	time_t check_time;
 	struct queue *reads;
 	uint16_t mtu;
 };
@@ -403,6 +411,8 @@ static void att_conn_data_free(void *data)
 
 	gatt_db_unref(att_data->rdb);
 	gatt_db_unref(att_data->ldb);
+	free(att_data->rdb_file);
+	free(att_data->ldb_file);
 	queue_destroy(att_data->reads, free);
 	free(att_data);
 }
@@ -447,7 +457,8 @@ static void gatt_load_db(struct gatt_db *db, const char *filename,
 
 	*mtim = st.st_mtim;
 
-	btd_settings_gatt_db_load(db, filename);
+	if (btd_settings_gatt_db_load(db, filename, NULL) < 0)
+		gatt_db_clear(db);
 }
 
 static void load_gatt_db(struct packet_conn_data *conn)
@@ -457,6 +468,18 @@ static void load_gatt_db(struct packet_conn_data *conn)
 	char local[18];
 	char peer[18];
 	uint8_t id[6], id_type;
+	unsigned int gen = keys_get_generation();
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	/* Resolving the identity is only needed again if keys changed */
+	if (data->rdb_file && data->keys_gen == gen) {
+		if (now.tv_sec - data->check_time < ATT_DB_CHECK_INTERVAL)
+			return;
+
+		goto load;
+	}
 
 	ba2str((bdaddr_t *)conn->src, local);
 
@@ -465,11 +488,21 @@ static void load_gatt_db(struct packet_conn_data *conn)
 	else
 		ba2str((bdaddr_t *)conn->dst, peer);
 
+	free(data->ldb_file);
 	create_filename(filename, PATH_MAX, "/%s/attributes", local);
-	gatt_load_db(data->ldb, filename, &data->ldb_mtim);
+	data->ldb_file = strdup(filename);
 
+	free(data->rdb_file);
 	create_filename(filename, PATH_MAX, "/%s/cache/%s", local, peer);
-	gatt_load_db(data->rdb, filename, &data->rdb_mtim);
+	data->rdb_file = strdup(filename);
+
+	data->keys_gen = gen;
+
+load:
+	data->check_time = now.tv_sec;
+
+	gatt_load_db(data->ldb, data->ldb_file, &data->ldb_mtim);
+	gatt_load_db(data->rdb, data->rdb_file, &data->rdb_mtim);
 }
 
 static struct gatt_db *get_db(const struct l2cap_frame *frame, bool rsp)
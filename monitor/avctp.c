@@ -1002,6 +1002,28 @@ static bool avrcp_set_player_value(struct avctp_frame *avctp_frame,
 	return true;
 }
 
+static bool print_string(struct l2cap_frame *frame, int indent,
+					const char *label, uint16_t len)
+{
+	char str[len + 1];
+	uint16_t i;
+
+	for (i = 0; i < len; i++) {
+		uint8_t c;
+
+		if (!l2cap_frame_get_u8(frame, &c))
+			return false;
+
+		str[i] = isprint(c) ? c : '.';
+	}
+
+	str[len] = '\0';
+
+	print_field("%*c%s: %s", indent, ' ', label, str);
+
+	return true;
+}
+
 static bool avrcp_get_player_attribute_text(struct avctp_frame *avctp_frame,
 						uint8_t ctype, uint8_t len,
 						uint8_t indent)
@@ -1051,16 +1073,8 @@ response:
 
 		print_field("%*cStringLength: 0x%02x", (indent - 8), ' ', len);
 
-		printf("String: ");
-		for (; len > 0; len--) {
-			uint8_t c;
-
-			if (!l2cap_frame_get_u8(frame, &c))
-				return false;
-
-			printf("%1c", isprint(c) ? c : '.');
-		}
-		printf("\n");
+		if (!print_string(frame, indent - 8, "String", len))
+			return false;
 	}
 
 	return true;
@@ -1127,16 +1141,8 @@ response:
 
 		print_field("%*cStringLength: 0x%02x", (indent - 8), ' ', len);
 
-		printf("String: ");
-		for (; len > 0; len--) {
-			uint8_t c;
-
-			if (!l2cap_frame_get_u8(frame, &c))
-				return false;
-
-			printf("%1c", isprint(c) ? c : '.');
-		}
-		printf("\n");
+		if (!print_string(frame, indent - 8, "String", len))
+			return false;
 	}
 
 	return true;
@@ -1344,6 +1350,7 @@ static bool avrcp_register_notification(struct avctp_frame *avctp_frame,
 	uint16_t uid;
 	uint32_t interval;
 	uint64_t id;
+	const char *str;
 
 	if (ctype > AVC_CTYPE_GENERAL_INQUIRY)
 		goto response;
@@ -1403,22 +1410,23 @@ response:
 		if (!l2cap_frame_get_u8(frame, &status))
 			return false;
 
-		print_field("%*cSystemStatus: 0x%02x ", (indent - 8),
-								' ', status);
 		switch (status) {
 		case 0x00:
-			printf("(POWER_ON)\n");
+			str = "POWER_ON";
 			break;
 		case 0x01:
-			printf("(POWER_OFF)\n");
+			str = "POWER_OFF";
 			break;
 		case 0x02:
-			printf("(UNPLUGGED)\n");
+			str = "UNPLUGGED";
 			break;
 		default:
-			printf("(UNKNOWN)\n");
+			str = "UNKNOWN";
 			break;
 		}
+
+		print_field("%*cSystemStatus: 0x%02x (%s)", (indent - 8),
+							' ', status, str);
 		break;
 	case AVRCP_EVENT_PLAYER_APPLICATION_SETTING_CHANGED:
 		if (!l2cap_frame_get_u8(frame, &status))
@@ -1851,6 +1859,7 @@ static bool avrcp_media_player_item(struct avctp_frame *avctp_frame,
 	uint8_t type, status, i;
 	uint32_t subtype;
 	uint8_t features[16];
+	char str[sizeof(features) * 2 + 1];
 
 	if (!l2cap_frame_get_be16(frame, &id))
 		return false;
@@ -1875,16 +1884,14 @@ static bool avrcp_media_player_item(struct avctp_frame *avctp_frame,
 	print_field("%*cPlayStatus: 0x%02x (%s)", indent, ' ',
 						status, playstatus2str(status));
 
-	printf("%*cFeatures: 0x", indent+8, ' ');
-
 	for (i = 0; i < 16; i++) {
 		if (!l2cap_frame_get_u8(frame, &features[i]))
 			return false;
 
-		printf("%02x", features[i]);
+		sprintf(str + i * 2, "%02x", features[i]);
 	}
 
-	printf("\n");
+	print_field("%*cFeatures: 0x%s", indent, ' ', str);
 
 	print_features(features, indent + 2);
 
@@ -1900,15 +1907,8 @@ static bool avrcp_media_player_item(struct avctp_frame *avctp_frame,
 	print_field("%*cNameLength: 0x%04x (%u)", indent, ' ',
 						namelen, namelen);
 
-	printf("%*cName: ", indent+8, ' ');
-	for (; namelen > 0; namelen--) {
-		uint8_t c;
-
-		if (!l2cap_frame_get_u8(frame, &c))
-			return false;
-		printf("%1c", isprint(c) ? c : '.');
-	}
-	printf("\n");
+	if (!print_string(frame, indent, "Name", namelen))
+		return false;
 
 	return true;
 }
@@ -1922,7 +1922,7 @@ static bool avrcp_folder_item(struct avctp_frame *avctp_frame,
 	uint64_t uid;
 
 	if (frame->size < 14) {
-		printf("PDU Malformed\n");
+		print_field("%*cPDU Malformed", indent, ' ');
 		return false;
 	}
 
@@ -1956,15 +1956,8 @@ static bool avrcp_folder_item(struct avctp_frame *avctp_frame,
 	print_field("%*cNameLength: 0x%04x (%u)", indent, ' ',
 					namelen, namelen);
 
-	printf("%*cName: ", indent+8, ' ');
-	for (; namelen > 0; namelen--) {
-		uint8_t c;
-		if (!l2cap_frame_get_u8(frame, &c))
-			return false;
-
-		printf("%1c", isprint(c) ? c : '.');
-	}
-	printf("\n");
+	if (!print_string(frame, indent, "Name", namelen))
+		return false;
 
 	return true;
 }
@@ -1996,16 +1989,8 @@ static bool avrcp_attribute_entry_list(struct avctp_frame *avctp_frame,
 		print_field("%*cAttributeLength: 0x%04x (%u)", indent, ' ',
 						len, len);
 
-		printf("%*cAttributeValue: ", indent+8, ' ');
-		for (; len > 0; len--) {
-			uint8_t c;
-
-			if (!l2cap_frame_get_u8(frame, &c))
-				return false;
-
-			printf("%1c", isprint(c) ? c : '.');
-		}
-		printf("\n");
+		if (!print_string(frame, indent, "AttributeValue", len))
+			return false;
 	}
 
 	return true;
@@ -2043,15 +2028,8 @@ static bool avrcp_media_element_item(struct avctp_frame *avctp_frame,
 	print_field("%*cNameLength: 0x%04x (%u)", indent, ' ',
 					namelen, namelen);
 
-	printf("%*cName: ", indent+8, ' ');
-	for (; namelen > 0; namelen--) {
-		uint8_t c;
-		if (!l2cap_frame_get_u8(frame, &c))
-			return false;
-
-		printf("%1c", isprint(c) ? c : '.');
-	}
-	printf("\n");
+	if (!print_string(frame, indent, "Name", namelen))
+		return false;
 
 	if (!l2cap_frame_get_u8(frame, &count))
 		return false;
@@ -2099,7 +2077,7 @@ static bool avrcp_get_total_number_of_items(struct avctp_frame *avctp_frame)
 		goto response;
 
 	if (frame->size < 4) {
-		printf("PDU Malformed\n");
+		print_field("%*cPDU Malformed", indent, ' ');
 		packet_hexdump(frame->data, frame->size);
 		return false;
 	}
@@ -2148,7 +2126,7 @@ static bool avrcp_search_item(struct avctp_frame *avctp_frame)
 		goto response;
 
 	if (frame->size < 4) {
-		printf("PDU Malformed\n");
+		print_field("%*cPDU Malformed", indent, ' ');
 		packet_hexdump(frame->data, frame->size);
 		return false;
 	}
@@ -2164,17 +2142,8 @@ static bool avrcp_search_item(struct avctp_frame *avctp_frame)
 
 	print_field("%*cLength: 0x%04x (%u)", indent, ' ', namelen, namelen);
 
-	printf("%*cString: ", indent+8, ' ');
-	for (; namelen > 0; namelen--) {
-		uint8_t c;
-
-		if (!l2cap_frame_get_u8(frame, &c))
-			return false;
-
-		printf("%1c", isprint(c) ? c : '.');
-	}
-
-	printf("\n");
+	if (!print_string(frame, indent, "String", namelen))
+		return false;
 
 	return true;
 
@@ -2428,16 +2397,8 @@ response:
 			continue;
 		}
 
-		printf("%*cFolder: ", indent+8, ' ');
-		for (; len > 0; len--) {
-			uint8_t c;
-
-			if (!l2cap_frame_get_u8(frame, &c))
-				return false;
-
-			printf("%1c", isprint(c) ? c : '.');
-		}
-		printf("\n");
+		if (!print_string(frame, indent, "Folder", len))
+			return false;
 	}
 
 	return true;
@@ -45,10 +45,13 @@
 #include "tty.h"
 #include "control.h"
 #include "jlink.h"
+#include "filter.h"
+#include "analyze.h"
 
 static struct btsnoop *btsnoop_file = NULL;
 static bool hcidump_fallback = false;
 static bool decode_control = true;
+static bool analyze_live_data;
 static uint16_t filter_index = HCI_DEV_NONE;
 
 struct control_data {
@@ -790,7 +793,10 @@ static void mgmt_advertising_removed(uint16_t len, const void *buf)
 
 void control_message(uint16_t opcode, const void *data, uint16_t size)
 {
-	if (!decode_control)
+	/* Control messages are only decoded as text, they have no record
+	 * form and would break JSON lines or binary output.
+	 */
+	if (!decode_control || !use_text())
 		return;
 
 	switch (opcode) {
@@ -970,6 +976,11 @@ static void data_callback(int fd, uint32_t events, void *user_data)
 							data->buf, pktlen);
 			ellisys_inject_hci(tv, index, opcode,
 							data->buf, pktlen);
+			if (analyze_live_data) {
+				analyze_packet(tv, index, opcode,
+							data->buf, pktlen);
+				break;
+			}
 			packet_monitor(tv, cred, index, opcode,
 							data->buf, pktlen);
 			break;
@@ -1020,33 +1031,17 @@ static int open_socket(uint16_t channel)
 	return fd;
 }
 
-static void attach_index_filter(int fd, uint16_t index)
+static void attach_filter(int fd, uint16_t channel)
 {
-	struct sock_filter filters[] = {
-		/* Load MGMT index:
-		 * A <- MGMT index
-		 */
-		BPF_STMT(BPF_LD + BPF_B + BPF_ABS,
-					offsetof(struct mgmt_hdr, index)),
-		/* Accept if index is HCI_DEV_NONE:
-		 * A == HCI_DEV_NONE
-		 */
-		BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, HCI_DEV_NONE, 0, 1),
-		/* return */
-		BPF_STMT(BPF_RET|BPF_K, 0x0fffffff), /* pass */
-		/* Accept if index match:
-		 * A == index
-		 */
-		BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, index, 0, 1),
-		/* returns */
-		BPF_STMT(BPF_RET|BPF_K, 0x0fffffff), /* pass */
-		BPF_STMT(BPF_RET|BPF_K, 0), /* reject */
-	};
-	struct sock_fprog fprog = {
-		.len = sizeof(filters) / sizeof(filters[0]),
-		/* casting const away: */
-		.filter = filters,
-	};
+	struct sock_filter filters[FILTER_BPF_MAX];
+	struct sock_fprog fprog;
+
+	fprog.len = filter_bpf(filter_index, channel == HCI_CHANNEL_MONITOR,
+						filters, FILTER_BPF_MAX);
+	if (!fprog.len)
+		return;
+
+	fprog.filter = filters;
 
 	setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
 }
@@ -1068,8 +1063,7 @@ static int open_channel(uint16_t channel)
 		return -1;
 	}
 
-	if (filter_index != HCI_DEV_NONE)
-		attach_index_filter(data->fd, filter_index);
+	attach_filter(data->fd, channel);
 
 	if (mainloop_add_fd(data->fd, EPOLLIN, data_callback,
 						data, free_data) < 0) {
@@ -1141,7 +1135,8 @@ static void server_accept_callback(int fd, uint32_t events, void *user_data)
 		return;
 	}
 
-	printf("--- New monitor connection ---\n");
+	if (use_text())
+		printf("--- New monitor connection ---\n");
 
 	data = malloc(sizeof(*data));
 	if (!data) {
@@ -1280,16 +1275,18 @@ static bool tty_parse_header(uint8_t *hdr, uint8_t len, struct timeval **tv,
 			*tv = ctv;
 			break;
 		default:
-			printf("Unknown extended header type %u\n", type);
+			fprintf(stderr, "Unknown extended header type %u\n",
+									type);
 			return false;
 		}
 	}
 
 	if (total) {
 		*drops += total;
-		printf("* Drops: cmd %u evt %u acl_tx %u acl_rx %u sco_tx %u "
-			"sco_rx %u other %u\n", cmd, evt, acl_tx, acl_rx,
-			sco_tx, sco_rx, other);
+		if (use_text())
+			printf("* Drops: cmd %u evt %u acl_tx %u acl_rx %u "
+				"sco_tx %u sco_rx %u other %u\n", cmd, evt,
+				acl_tx, acl_rx, sco_tx, sco_rx, other);
 	}
 
 	return true;
@@ -1394,7 +1391,8 @@ int control_tty(const char *path, unsigned int speed)
 		return err;
 	}
 
-	printf("--- %s opened ---\n", path);
+	if (use_text())
+		printf("--- %s opened ---\n", path);
 
 	data = malloc(sizeof(*data));
 	if (!data) {
@@ -1451,7 +1449,8 @@ int control_rtt(char *jlink, char *rtt)
 		return -ENODEV;
 	}
 
-	printf("--- RTT opened ---\n");
+	if (use_text())
+		printf("--- RTT opened ---\n");
 
 	data = new0(struct control_data, 1);
 	data->channel = HCI_CHANNEL_MONITOR;
@@ -1564,6 +1563,11 @@ void control_disable_decoding(void)
 	decode_control = false;
 }
 
+void control_analyze(void)
+{
+	analyze_live_data = true;
+}
+
 void control_filter_index(uint16_t index)
 {
 	filter_index = index;
@@ -18,6 +18,7 @@ int control_tty(const char *path, unsigned int speed);
 int control_rtt(char *jlink, char *rtt);
 int control_tracing(void);
 void control_disable_decoding(void);
+void control_analyze(void);
 void control_filter_index(uint16_t index);
 
 void control_message(uint16_t opcode, const void *data, uint16_t size);
@@ -13,6 +13,8 @@
 #include <config.h>
 #endif
 
+#include <stdbool.h>
+
 #include "crc.h"
 
 uint32_t crc24_bit_reverse(uint32_t value)
@@ -26,26 +28,65 @@ uint32_t crc24_bit_reverse(uint32_t value)
 	return result;
 }
 
+/* Polynomial x^24 + x^10 + x^9 + x^6 + x^4 + x^3 + x + 1 in the bit
+ * reflected order the LFSR is operated in.
+ */
+#define CRC24_POLY	0xda6000
+
+/* Slicing-by-4 tables, crc24_table[n][i] is the LFSR state after feeding
+ * byte i followed by n zero bytes into a zero register.
+ */
+static uint32_t crc24_table[4][256];
+
+static void crc24_init_table(void)
+{
+	uint32_t state;
+	int i, n;
+
+	for (i = 0; i < 256; i++) {
+		state = i;
+
+		for (n = 0; n < 8; n++)
+			state = (state >> 1) ^ ((state & 1) ? CRC24_POLY : 0);
+
+		crc24_table[0][i] = state;
+	}
+
+	for (i = 0; i < 256; i++) {
+		state = crc24_table[0][i];
+
+		for (n = 1; n < 4; n++) {
+			state = (state >> 8) ^ crc24_table[0][state & 0xff];
+			crc24_table[n][i] = state;
+		}
+	}
+}
+
 uint32_t crc24_calculate(uint32_t preset, const uint8_t *data, uint8_t len)
 {
+	static bool initialized = false;
 	uint32_t state = preset;
-	uint8_t i;
 
-	for (i = 0; i < len; i++) {
-		uint8_t n, cur = data[i];
+	if (!initialized) {
+		crc24_init_table();
+		initialized = true;
+	}
 
-		for (n = 0; n < 8; n++) {
-			int next_bit = (state ^ cur) & 1;
-
-			cur >>= 1;
-			state >>= 1;
-			if (next_bit) {
-				state |= 1 << 23;
-				state ^= 0x5a6000;
-			}
-		}
+	while (len >= 4) {
+		state ^= data[0] | data[1] << 8 | data[2] << 16;
+
+		state = crc24_table[3][state & 0xff] ^
+			crc24_table[2][(state >> 8) & 0xff] ^
+			crc24_table[1][(state >> 16) & 0xff] ^
+			crc24_table[0][data[3]];
+
+		data += 4;
+		len -= 4;
 	}
 
+	while (len--)
+		state = (state >> 8) ^ crc24_table[0][(state ^ *data++) & 0xff];
+
 	return state;
 }
 
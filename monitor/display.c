@@ -18,18 +18,23 @@
 #include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <limits.h>
 #include <string.h>
 #include <signal.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 #include <sys/prctl.h>
 #include <sys/ioctl.h>
 #include <termios.h>
 
+#include "src/shared/util.h"
 #include "display.h"
 
 static pid_t pager_pid = 0;
 int default_pager_num_columns = FALLBACK_TERMINAL_WIDTH;
 enum monitor_color setting_monitor_color = COLOR_AUTO;
+enum monitor_output setting_monitor_output = OUTPUT_TEXT;
 
 void set_monitor_color(enum monitor_color color)
 {
@@ -50,6 +55,336 @@ bool use_color(void)
 	return cached_use_color;
 }
 
+void set_monitor_output(enum monitor_output output)
+{
+	setting_monitor_output = output;
+}
+
+bool use_text(void)
+{
+	return setting_monitor_output == OUTPUT_TEXT;
+}
+
+/*
+ * Structured output collects everything decoded for one packet into a
+ * single record, which is then written with one call.
+ *
+ * JSON output is one object per line:
+ *
+ *	{"ts":<sec.usec>,"index":<n>,"ident":"<c>","channel":"..",
+ *	 "label":"..","text":"..","extra":"..","fields":[..]}
+ *
+ * Each field is either {"depth":<n>,"name":"..","value":..} or
+ * {"depth":<n>,"text":".."} for lines without a name. Values that are
+ * plain numbers are emitted as numbers; values that start with a number
+ * followed by a description also carry it as "num".
+ *
+ * Binary output is a stream of little-endian TLVs, each starting with
+ * a type octet and a 16-bit length of the data that follows:
+ *
+ *	0x01 record	u32 sec, u32 usec, u16 index, u8 ident,
+ *			channel\0 label\0 text\0 extra\0
+ *	0x02 field	u8 depth, name\0 value\0
+ *	0x03 number	u8 depth, s64 number, name\0 value\0
+ *	0x00 end	(no data)
+ */
+#define RECORD_BINARY_RECORD	0x01
+#define RECORD_BINARY_FIELD	0x02
+#define RECORD_BINARY_NUMBER	0x03
+#define RECORD_BINARY_END	0x00
+
+static struct {
+	char *buf;
+	size_t len;
+	size_t size;
+	bool open;
+	unsigned int fields;
+} record;
+
+static void record_reserve(size_t len)
+{
+	if (record.len + len <= record.size)
+		return;
+
+	while (record.len + len > record.size)
+		record.size = record.size ? record.size * 2 : 1024;
+
+	record.buf = realloc(record.buf, record.size);
+	if (!record.buf) {
+		perror("Failed to allocate record");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void record_put(const void *data, size_t len)
+{
+	record_reserve(len);
+	memcpy(record.buf + record.len, data, len);
+	record.len += len;
+}
+
+static void record_put_str(const char *str)
+{
+	record_put(str ? str : "", (str ? strlen(str) : 0) + 1);
+}
+
+static void record_put_json(const char *str, size_t len)
+{
+	static const char hexdigits[] = "0123456789abcdef";
+	size_t i;
+
+	record_reserve(len * 6 + 2);
+
+	record.buf[record.len++] = '"';
+
+	for (i = 0; i < len; i++) {
+		unsigned char c = str[i];
+
+		if (c == '"' || c == '\\') {
+			record.buf[record.len++] = '\\';
+			record.buf[record.len++] = c;
+		} else if (c < 0x20 || c == 0x7f) {
+			memcpy(record.buf + record.len, "\\u00", 4);
+			record.buf[record.len + 4] = hexdigits[c >> 4];
+			record.buf[record.len + 5] = hexdigits[c & 0xf];
+			record.len += 6;
+		} else
+			record.buf[record.len++] = c;
+	}
+
+	record.buf[record.len++] = '"';
+}
+
+static void record_printf(const char *fmt, ...)
+{
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+
+	if (len < 0)
+		return;
+
+	record_reserve(len + 1);
+
+	va_start(ap, fmt);
+	vsnprintf(record.buf + record.len, len + 1, fmt, ap);
+	va_end(ap);
+
+	record.len += len;
+}
+
+static void record_put_json_member(const char *name, const char *str)
+{
+	if (!str)
+		return;
+
+	record_printf(",\"%s\":", name);
+	record_put_json(str, strlen(str));
+}
+
+static bool parse_number(const char *str, long long *num, bool *exact)
+{
+	char *end;
+
+	if (!str[0] || str[0] == ' ')
+		return false;
+
+	errno = 0;
+
+	if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
+		*num = strtoll(str + 2, &end, 16);
+	else
+		*num = strtoll(str, &end, 10);
+
+	if (errno || end == str || (*end && *end != ' '))
+		return false;
+
+	*exact = !*end;
+
+	return true;
+}
+
+void display_record_begin(const struct timeval *tv, int index, char ident,
+				const char *channel, const char *label,
+				const char *text, const char *extra)
+{
+	uint8_t hdr[14];
+
+	display_record_end();
+
+	record.len = 0;
+	record.fields = 0;
+	record.open = true;
+
+	if (setting_monitor_output == OUTPUT_BINARY) {
+		hdr[0] = RECORD_BINARY_RECORD;
+		put_le32(tv ? tv->tv_sec : 0, hdr + 3);
+		put_le32(tv ? tv->tv_usec : 0, hdr + 7);
+		put_le16(index < 0 ? 0xffff : index, hdr + 11);
+		hdr[13] = ident;
+		record_put(hdr, sizeof(hdr));
+		record_put_str(channel);
+		record_put_str(label);
+		record_put_str(text);
+		record_put_str(extra);
+		put_le16(record.len - 3, record.buf + 1);
+		return;
+	}
+
+	if (tv)
+		record_printf("{\"ts\":%lld.%06lld", (long long) tv->tv_sec,
+						(long long) tv->tv_usec);
+	else
+		record_printf("{\"ts\":null");
+
+	if (index >= 0)
+		record_printf(",\"index\":%d", index);
+
+	record_printf(",\"ident\":");
+	record_put_json(&ident, 1);
+	record_put_json_member("channel", channel);
+	record_put_json_member("label", label);
+	record_put_json_member("text", text);
+	record_put_json_member("extra", extra);
+	record_printf(",\"fields\":[");
+}
+
+static void record_field_binary(int depth, const char *name,
+					const char *value, size_t value_len)
+{
+	size_t start = record.len;
+	long long num;
+	bool exact;
+	uint8_t hdr[4];
+
+	hdr[0] = RECORD_BINARY_FIELD;
+	hdr[3] = depth;
+
+	if (name && parse_number(value, &num, &exact)) {
+		uint8_t buf[8];
+
+		hdr[0] = RECORD_BINARY_NUMBER;
+		record_put(hdr, sizeof(hdr));
+		put_le64(num, buf);
+		record_put(buf, sizeof(buf));
+	} else
+		record_put(hdr, sizeof(hdr));
+
+	record_put_str(name);
+	record_put(value, value_len);
+	record_put("", 1);
+
+	if (record.len - start - 3 > UINT16_MAX) {
+		record.len = start;
+		return;
+	}
+
+	put_le16(record.len - start - 3, record.buf + start + 1);
+}
+
+static void record_field_json(int depth, const char *name,
+					const char *value, size_t value_len)
+{
+	long long num;
+	bool exact;
+
+	record_printf("%s{\"depth\":%d", record.fields ? "," : "", depth);
+
+	if (!name) {
+		record_printf(",\"text\":");
+		record_put_json(value, value_len);
+		record_printf("}");
+		return;
+	}
+
+	record_printf(",\"name\":");
+	record_put_json(name, strlen(name));
+
+	if (!value_len) {
+		record_printf("}");
+		return;
+	}
+
+	record_printf(",\"value\":");
+
+	if (!parse_number(value, &num, &exact)) {
+		record_put_json(value, value_len);
+		record_printf("}");
+		return;
+	}
+
+	if (exact) {
+		record_printf("%lld}", num);
+		return;
+	}
+
+	record_put_json(value, value_len);
+	record_printf(",\"num\":%lld}", num);
+}
+
+void display_record_field(int indent, const char *prefix, const char *title,
+						const char *fmt, ...)
+{
+	char line[LINE_MAX], *str, *sep, *name = NULL;
+	va_list ap;
+	int len, depth;
+
+	if (!record.open)
+		return;
+
+	len = snprintf(line, sizeof(line), "%s%s", prefix, title);
+	if (len < 0 || (size_t) len >= sizeof(line))
+		return;
+
+	va_start(ap, fmt);
+	vsnprintf(line + len, sizeof(line) - len, fmt, ap);
+	va_end(ap);
+
+	for (str = line; *str == ' '; str++)
+		indent++;
+
+	depth = indent > 8 ? (indent - 8) / 2 : 0;
+
+	sep = strstr(str, ": ");
+	if (sep) {
+		*sep = '\0';
+		name = str;
+		str = sep + 2;
+	} else {
+		len = strlen(str);
+		if (len && str[len - 1] == ':') {
+			str[len - 1] = '\0';
+			name = str;
+			str += len;
+		}
+	}
+
+	if (setting_monitor_output == OUTPUT_BINARY)
+		record_field_binary(depth, name, str, strlen(str));
+	else
+		record_field_json(depth, name, str, strlen(str));
+
+	record.fields++;
+}
+
+void display_record_end(void)
+{
+	if (!record.open)
+		return;
+
+	record.open = false;
+
+	if (setting_monitor_output == OUTPUT_BINARY)
+		record_put((uint8_t[]) { RECORD_BINARY_END, 0x00, 0x00 }, 3);
+	else
+		record_printf("]}\n");
+
+	fwrite(record.buf, 1, record.len, stdout);
+}
+
 void set_default_pager_num_columns(int num_columns)
 {
 	default_pager_num_columns = num_columns;
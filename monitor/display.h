@@ -17,6 +17,20 @@ bool use_color(void);
 enum monitor_color { COLOR_AUTO, COLOR_ALWAYS, COLOR_NEVER };
 void set_monitor_color(enum monitor_color);
 
+enum monitor_output { OUTPUT_TEXT, OUTPUT_JSON, OUTPUT_BINARY };
+void set_monitor_output(enum monitor_output);
+bool use_text(void);
+
+struct timeval;
+
+void display_record_begin(const struct timeval *tv, int index, char ident,
+				const char *channel, const char *label,
+				const char *text, const char *extra);
+void display_record_field(int indent, const char *prefix, const char *title,
+						const char *fmt, ...)
+					__attribute__((format(printf, 4, 5)));
+void display_record_end(void);
+
 #define COLOR_OFF	"\x1B[0m"
 #define COLOR_BLACK	"\x1B[0;30m"
 #define COLOR_RED	"\x1B[0;31m"
@@ -43,10 +57,13 @@ void set_monitor_color(enum monitor_color);
 
 #define print_indent(indent, color1, prefix, title, color2, fmt, args...) \
 do { \
-	printf("%*c%s%s%s%s" fmt "%s\n", (indent), ' ', \
-		use_color() ? (color1) : "", prefix, title, \
-		use_color() ? (color2) : "", ## args, \
-		use_color() ? COLOR_OFF : ""); \
+	if (!use_text()) \
+		display_record_field((indent), prefix, title, fmt, ## args); \
+	else \
+		printf("%*c%s%s%s%s" fmt "%s\n", (indent), ' ', \
+			use_color() ? (color1) : "", prefix, title, \
+			use_color() ? (color2) : "", ## args, \
+			use_color() ? COLOR_OFF : ""); \
 } while (0)
 
 #define print_text(color, fmt, args...) \
@@ -0,0 +1,951 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/time.h>
+#include <linux/filter.h>
+
+#include "lib/bluetooth.h"
+#include "lib/hci.h"
+#include "lib/mgmt.h"
+
+#include "src/shared/util.h"
+#include "src/shared/queue.h"
+#include "src/shared/btsnoop.h"
+
+#include "filter.h"
+
+#define FILTER_MAX_VALUES	16
+
+#define BPF_PASS		0x0fffffff
+
+struct filter_values {
+	unsigned int num;
+	uint16_t val[FILTER_MAX_VALUES];
+};
+
+struct filter_conn {
+	uint16_t index;
+	uint16_t handle;
+	bool has_addr;
+	uint8_t addr[6];
+	bool frag_match;
+};
+
+struct filter_chan {
+	uint16_t index;
+	uint16_t handle;
+	uint8_t ident;
+	uint16_t psm;
+	uint16_t scid;
+	uint16_t dcid;
+};
+
+/* Location of the connection handle and peer address in the parameters
+ * of commands and events, -1 if not present.
+ */
+struct filter_field {
+	uint16_t code;
+	int8_t handle;
+	int8_t addr;
+};
+
+static const struct filter_field cmd_fields[] = {
+	{ 0x0405,  -1,  0 },		/* Create Connection */
+	{ 0x0406,   0, -1 },		/* Disconnect */
+	{ 0x0419,  -1,  0 },		/* Remote Name Request */
+	{ 0x041b,   0, -1 },		/* Read Remote Supported Features */
+	{ 0x041d,   0, -1 },		/* Read Remote Version Information */
+	{ 0x200d,  -1,  6 },		/* LE Create Connection */
+	{ 0x2013,   0, -1 },		/* LE Connection Update */
+	{ 0x2016,   0, -1 },		/* LE Read Remote Features */
+	{ 0x2019,   0, -1 },		/* LE Enable Encryption */
+	{ 0x2022,   0, -1 },		/* LE Set Data Length */
+	{ 0x2032,   0, -1 },		/* LE Set PHY */
+	{ 0x2043,  -1,  3 },		/* LE Extended Create Connection */
+	{ }
+};
+
+static const struct filter_field evt_fields[] = {
+	{ 0x03,  1,  3 },		/* Connection Complete */
+	{ 0x04, -1,  0 },		/* Connection Request */
+	{ 0x05,  1, -1 },		/* Disconnect Complete */
+	{ 0x07, -1,  1 },		/* Remote Name Request Complete */
+	{ 0x08,  1, -1 },		/* Encryption Change */
+	{ 0x0b,  1, -1 },		/* Read Remote Supported Features */
+	{ 0x0c,  1, -1 },		/* Read Remote Version Complete */
+	{ 0x1b,  0, -1 },		/* Max Slots Change */
+	{ 0x22, -1,  1 },		/* Inquiry Result with RSSI */
+	{ 0x2f, -1,  1 },		/* Extended Inquiry Result */
+	{ 0x30,  1, -1 },		/* Encryption Key Refresh Complete */
+	{ 0x59,  1, -1 },		/* Encryption Change v2 */
+	{ }
+};
+
+/* Offsets relative to the parameters following the subevent code */
+static const struct filter_field le_fields[] = {
+	{ 0x01,  1,  5 },		/* Connection Complete */
+	{ 0x02, -1,  3 },		/* Advertising Report */
+	{ 0x03,  1, -1 },		/* Connection Update Complete */
+	{ 0x04,  1, -1 },		/* Read Remote Features Complete */
+	{ 0x05,  0, -1 },		/* Long Term Key Request */
+	{ 0x06,  0, -1 },		/* Remote Connection Parameter Request */
+	{ 0x07,  0, -1 },		/* Data Length Change */
+	{ 0x0a,  1,  5 },		/* Enhanced Connection Complete */
+	{ 0x0b, -1,  3 },		/* Direct Advertising Report */
+	{ 0x0c,  1, -1 },		/* PHY Update Complete */
+	{ 0x0d, -1,  4 },		/* Extended Advertising Report */
+	{ 0x29,  1,  5 },		/* Enhanced Connection Complete v2 */
+	{ }
+};
+
+static struct {
+	bool enabled;
+	struct filter_values handle;
+	struct filter_values psm;
+	struct filter_values cid;
+	struct filter_values att;
+	struct filter_values opcode;
+	struct filter_values event;
+	unsigned int num_addr;
+	uint8_t addr[FILTER_MAX_VALUES][6];
+	bool time;
+	double time_start;
+	double time_end;
+	time_t time_base;
+} filter;
+
+static struct queue *conn_list;
+static struct queue *chan_list;
+
+static bool parse_values(char *str, struct filter_values *values)
+{
+	char *val, *end;
+
+	for (val = strtok_r(str, ",", &str); val;
+					val = strtok_r(NULL, ",", &str)) {
+		unsigned long num = strtoul(val, &end, 0);
+
+		if (*end || end == val || num > UINT16_MAX)
+			return false;
+
+		if (values->num == FILTER_MAX_VALUES)
+			return false;
+
+		values->val[values->num++] = num;
+	}
+
+	return values->num > 0;
+}
+
+static bool parse_addr(char *str)
+{
+	char *val;
+
+	for (val = strtok_r(str, ",", &str); val;
+					val = strtok_r(NULL, ",", &str)) {
+		uint8_t *addr;
+
+		if (strlen(val) != 17 || filter.num_addr == FILTER_MAX_VALUES)
+			return false;
+
+		addr = filter.addr[filter.num_addr++];
+
+		if (sscanf(val, "%2hhx:%2hhx:%2hhx:%2hhx:%2hhx:%2hhx",
+						&addr[5], &addr[4], &addr[3],
+						&addr[2], &addr[1], &addr[0]) != 6)
+			return false;
+	}
+
+	return filter.num_addr > 0;
+}
+
+static bool parse_time(char *str)
+{
+	char *sep, *end;
+
+	sep = strchr(str, '-');
+	if (!sep)
+		return false;
+
+	*sep++ = '\0';
+
+	filter.time_start = 0;
+	filter.time_end = -1;
+
+	if (*str) {
+		filter.time_start = strtod(str, &end);
+		if (*end || filter.time_start < 0)
+			return false;
+	}
+
+	if (*sep) {
+		filter.time_end = strtod(sep, &end);
+		if (*end || filter.time_end < filter.time_start)
+			return false;
+	}
+
+	filter.time = true;
+
+	return true;
+}
+
+static bool parse_term(char *term)
+{
+	char *value;
+
+	value = strchr(term, '=');
+	if (!value)
+		return false;
+
+	*value++ = '\0';
+
+	if (!strcmp(term, "handle"))
+		return parse_values(value, &filter.handle);
+	else if (!strcmp(term, "addr"))
+		return parse_addr(value);
+	else if (!strcmp(term, "psm"))
+		return parse_values(value, &filter.psm);
+	else if (!strcmp(term, "cid"))
+		return parse_values(value, &filter.cid);
+	else if (!strcmp(term, "att"))
+		return parse_values(value, &filter.att);
+	else if (!strcmp(term, "opcode"))
+		return parse_values(value, &filter.opcode);
+	else if (!strcmp(term, "event"))
+		return parse_values(value, &filter.event);
+	else if (!strcmp(term, "time"))
+		return parse_time(value);
+
+	return false;
+}
+
+bool filter_parse(const char *str)
+{
+	char *buf, *ptr, *term;
+	bool result = true;
+
+	buf = strdup(str);
+	if (!buf)
+		return false;
+
+	for (term = strtok_r(buf, " ", &ptr); term;
+					term = strtok_r(NULL, " ", &ptr)) {
+		if (!parse_term(term)) {
+			result = false;
+			break;
+		}
+	}
+
+	free(buf);
+
+	if (!result)
+		return false;
+
+	if (!conn_list)
+		conn_list = queue_new();
+
+	if (!chan_list)
+		chan_list = queue_new();
+
+	filter.enabled = true;
+
+	return true;
+}
+
+void filter_cleanup(void)
+{
+	queue_destroy(chan_list, free);
+	chan_list = NULL;
+
+	queue_destroy(conn_list, free);
+	conn_list = NULL;
+
+	memset(&filter, 0, sizeof(filter));
+}
+
+static bool match_value(const struct filter_values *values, uint16_t val)
+{
+	unsigned int i;
+
+	for (i = 0; i < values->num; i++) {
+		if (values->val[i] == val)
+			return true;
+	}
+
+	return false;
+}
+
+static bool match_addr(const uint8_t *addr)
+{
+	unsigned int i;
+
+	for (i = 0; i < filter.num_addr; i++) {
+		if (!memcmp(filter.addr[i], addr, 6))
+			return true;
+	}
+
+	return false;
+}
+
+static bool has_conn_terms(void)
+{
+	return filter.handle.num || filter.num_addr;
+}
+
+static bool has_l2cap_terms(void)
+{
+	return filter.psm.num || filter.cid.num || filter.att.num;
+}
+
+static bool has_hci_terms(void)
+{
+	return filter.opcode.num || filter.event.num;
+}
+
+struct conn_match {
+	uint16_t index;
+	uint16_t handle;
+};
+
+static bool match_conn(const void *data, const void *user_data)
+{
+	const struct filter_conn *conn = data;
+	const struct conn_match *match = user_data;
+
+	return conn->index == match->index && conn->handle == match->handle;
+}
+
+static struct filter_conn *conn_lookup(uint16_t index, uint16_t handle,
+								bool create)
+{
+	struct conn_match match = { index, handle };
+	struct filter_conn *conn;
+
+	conn = queue_find(conn_list, match_conn, &match);
+	if (conn || !create)
+		return conn;
+
+	conn = new0(struct filter_conn, 1);
+	conn->index = index;
+	conn->handle = handle;
+	queue_push_tail(conn_list, conn);
+
+	return conn;
+}
+
+static bool match_chan_conn(const void *data, const void *user_data)
+{
+	const struct filter_chan *chan = data;
+	const struct conn_match *match = user_data;
+
+	return chan->index == match->index && chan->handle == match->handle;
+}
+
+static void conn_remove(uint16_t index, uint16_t handle)
+{
+	struct conn_match match = { index, handle };
+
+	queue_remove_all(chan_list, match_chan_conn, &match, free);
+	free(queue_remove_if(conn_list, match_conn, &match));
+}
+
+static void conn_add(uint16_t index, uint16_t handle, const uint8_t *addr)
+{
+	struct filter_conn *conn;
+
+	conn_remove(index, handle);
+
+	conn = conn_lookup(index, handle, true);
+	conn->has_addr = true;
+	memcpy(conn->addr, addr, 6);
+}
+
+static bool conn_matches(const struct filter_conn *conn)
+{
+	if (filter.handle.num && !match_value(&filter.handle, conn->handle))
+		return false;
+
+	if (filter.num_addr && (!conn->has_addr || !match_addr(conn->addr)))
+		return false;
+
+	return true;
+}
+
+static bool match_handle_addr(uint16_t index, const uint8_t *params,
+					uint16_t size, int8_t handle, int8_t addr)
+{
+	if (handle >= 0 && size >= handle + 2) {
+		struct filter_conn *conn;
+		uint16_t val = get_le16(params + handle) & 0x0fff;
+
+		conn = conn_lookup(index, val, false);
+		if (conn)
+			return conn_matches(conn);
+
+		if (!filter.num_addr)
+			return match_value(&filter.handle, val);
+	}
+
+	if (addr >= 0 && size >= addr + 6 && !filter.handle.num)
+		return match_addr(params + addr);
+
+	return false;
+}
+
+static const struct filter_field *find_field(const struct filter_field *table,
+								uint16_t code)
+{
+	for (; table->code; table++) {
+		if (table->code == code)
+			return table;
+	}
+
+	return NULL;
+}
+
+static bool match_command(uint16_t index, const uint8_t *data, uint16_t size)
+{
+	const struct filter_field *field;
+	uint16_t opcode;
+
+	if (size < 3)
+		return false;
+
+	opcode = get_le16(data);
+
+	if (has_hci_terms() && !match_value(&filter.opcode, opcode))
+		return false;
+
+	if (!has_conn_terms())
+		return true;
+
+	field = find_field(cmd_fields, opcode);
+	if (!field)
+		return false;
+
+	return match_handle_addr(index, data + 3, size - 3, field->handle,
+								field->addr);
+}
+
+static bool match_hci_event(uint8_t evt, const uint8_t *params,
+								uint16_t size)
+{
+	if (match_value(&filter.event, evt))
+		return true;
+
+	switch (evt) {
+	case 0x0e:
+		return size >= 3 && match_value(&filter.opcode,
+						get_le16(params + 1));
+	case 0x0f:
+		return size >= 4 && match_value(&filter.opcode,
+						get_le16(params + 2));
+	}
+
+	return false;
+}
+
+static bool match_nocp(uint16_t index, const uint8_t *params, uint16_t size)
+{
+	uint8_t i, num;
+
+	if (size < 1)
+		return false;
+
+	num = params[0];
+
+	for (i = 0; i < num && size >= 1 + (i + 1) * 4; i++) {
+		if (match_handle_addr(index, params + 1 + i * 4, 4, 0, -1))
+			return true;
+	}
+
+	return false;
+}
+
+static void learn_event(uint16_t index, uint8_t evt, const uint8_t *params,
+								uint16_t size)
+{
+	switch (evt) {
+	case 0x03:
+		if (size >= 9 && !params[0])
+			conn_add(index, get_le16(params + 1) & 0x0fff,
+								params + 3);
+		break;
+	case 0x3e:
+		if (size < 12 || params[1])
+			break;
+
+		if (params[0] == 0x01 || params[0] == 0x0a ||
+							params[0] == 0x29)
+			conn_add(index, get_le16(params + 2) & 0x0fff,
+								params + 6);
+		break;
+	}
+}
+
+static bool match_event(uint16_t index, const uint8_t *data, uint16_t size)
+{
+	const struct filter_field *field;
+	const uint8_t *params = data + 2;
+	uint8_t evt;
+	bool match = true;
+
+	if (size < 2)
+		return false;
+
+	evt = data[0];
+	size -= 2;
+
+	learn_event(index, evt, params, size);
+
+	if (has_hci_terms() && !match_hci_event(evt, params, size))
+		match = false;
+	else if (!has_conn_terms())
+		match = true;
+	else if (evt == 0x13)
+		match = match_nocp(index, params, size);
+	else if (evt == 0x3e && size >= 1) {
+		field = find_field(le_fields, params[0]);
+		match = field && match_handle_addr(index, params + 1, size - 1,
+						field->handle, field->addr);
+	} else {
+		field = find_field(evt_fields, evt);
+		match = field && match_handle_addr(index, params, size,
+						field->handle, field->addr);
+	}
+
+	if (evt == 0x05 && size >= 3 && !params[0])
+		conn_remove(index, get_le16(params + 1) & 0x0fff);
+
+	return match;
+}
+
+static void chan_add(struct filter_conn *conn, uint8_t ident, uint16_t psm,
+								uint16_t scid)
+{
+	struct filter_chan *chan;
+
+	chan = new0(struct filter_chan, 1);
+	chan->index = conn->index;
+	chan->handle = conn->handle;
+	chan->ident = ident;
+	chan->psm = psm;
+	chan->scid = scid;
+	queue_push_tail(chan_list, chan);
+}
+
+struct chan_match {
+	const struct filter_conn *conn;
+	uint8_t ident;
+	uint16_t cid;
+};
+
+static bool match_chan_scid(const void *data, const void *user_data)
+{
+	const struct filter_chan *chan = data;
+	const struct chan_match *match = user_data;
+
+	return chan->index == match->conn->index &&
+				chan->handle == match->conn->handle &&
+				chan->scid == match->cid;
+}
+
+static bool match_chan_ident(const void *data, const void *user_data)
+{
+	const struct filter_chan *chan = data;
+	const struct chan_match *match = user_data;
+
+	return chan->index == match->conn->index &&
+				chan->handle == match->conn->handle &&
+				chan->ident == match->ident && !chan->dcid;
+}
+
+static bool match_chan_cid(const void *data, const void *user_data)
+{
+	const struct filter_chan *chan = data;
+	const struct chan_match *match = user_data;
+
+	return chan->index == match->conn->index &&
+				chan->handle == match->conn->handle &&
+				(chan->scid == match->cid ||
+				chan->dcid == match->cid);
+}
+
+static void learn_signaling(struct filter_conn *conn, const uint8_t *data,
+								uint16_t size)
+{
+	while (size >= 4) {
+		struct chan_match match = { conn, data[1], 0 };
+		struct filter_chan *chan;
+		uint8_t code = data[0];
+		uint16_t len = get_le16(data + 2);
+		const uint8_t *pdu = data + 4;
+		uint16_t i;
+
+		if (len > size - 4)
+			break;
+
+		switch (code) {
+		case 0x02:	/* Connection Request */
+		case 0x14:	/* LE Credit Based Connection Request */
+			if (len < 4)
+				break;
+
+			match.cid = get_le16(pdu + 2);
+			free(queue_remove_if(chan_list, match_chan_scid,
+								&match));
+			chan_add(conn, data[1], get_le16(pdu), match.cid);
+			break;
+		case 0x03:	/* Connection Response */
+			if (len < 4)
+				break;
+
+			match.cid = get_le16(pdu + 2);
+			chan = queue_find(chan_list, match_chan_scid, &match);
+			if (chan)
+				chan->dcid = get_le16(pdu);
+			break;
+		case 0x15:	/* LE Credit Based Connection Response */
+			if (len < 2)
+				break;
+
+			chan = queue_find(chan_list, match_chan_ident, &match);
+			if (chan)
+				chan->dcid = get_le16(pdu);
+			break;
+		case 0x17:	/* Credit Based Connection Request */
+			for (i = 8; i + 2 <= len; i += 2)
+				chan_add(conn, data[1], get_le16(pdu),
+							get_le16(pdu + i));
+			break;
+		case 0x18:	/* Credit Based Connection Response */
+			for (i = 8; i + 2 <= len; i += 2) {
+				chan = queue_find(chan_list, match_chan_ident,
+								&match);
+				if (!chan)
+					break;
+
+				chan->dcid = get_le16(pdu + i);
+			}
+			break;
+		}
+
+		data += 4 + len;
+		size -= 4 + len;
+	}
+}
+
+static bool match_att(uint16_t cid, const uint8_t *data, uint16_t size)
+{
+	uint16_t offset;
+
+	if (cid != 0x0004 || size < 1)
+		return false;
+
+	switch (data[0]) {
+	case 0x01:	/* Error Response */
+		offset = 2;
+		break;
+	case 0x0a:	/* Read Request */
+	case 0x0c:	/* Read Blob Request */
+	case 0x12:	/* Write Request */
+	case 0x16:	/* Prepare Write Request */
+	case 0x17:	/* Prepare Write Response */
+	case 0x1b:	/* Handle Value Notification */
+	case 0x1d:	/* Handle Value Indication */
+	case 0x23:	/* Multiple Handle Value Notification */
+	case 0x52:	/* Write Command */
+	case 0xd2:	/* Signed Write Command */
+		offset = 1;
+		break;
+	default:
+		return false;
+	}
+
+	if (size < offset + 2)
+		return false;
+
+	return match_value(&filter.att, get_le16(data + offset));
+}
+
+/* Signaling and the ATT MTU exchange are always shown since the decoders
+ * need them to follow the channels and PDUs that do match.
+ */
+static bool is_l2cap_state(uint16_t cid, const uint8_t *data, uint16_t size)
+{
+	if (cid == 0x0001 || cid == 0x0005)
+		return true;
+
+	if (cid == 0x0004 && size >= 1 && (data[0] == 0x02 || data[0] == 0x03))
+		return true;
+
+	return false;
+}
+
+static bool match_l2cap(struct filter_conn *conn, uint16_t cid,
+					const uint8_t *data, uint16_t size)
+{
+	if (is_l2cap_state(cid, data, size))
+		return true;
+
+	if (filter.cid.num && !match_value(&filter.cid, cid))
+		return false;
+
+	if (filter.psm.num) {
+		struct chan_match match = { conn, 0, cid };
+		struct filter_chan *chan;
+
+		chan = queue_find(chan_list, match_chan_cid, &match);
+		if (!chan || !match_value(&filter.psm, chan->psm))
+			return false;
+	}
+
+	if (filter.att.num && !match_att(cid, data, size))
+		return false;
+
+	return true;
+}
+
+static bool match_acl(uint16_t index, const uint8_t *data, uint16_t size)
+{
+	struct filter_conn *conn;
+	uint16_t handle, flags, cid;
+
+	if (size < 4)
+		return false;
+
+	handle = get_le16(data);
+	flags = handle >> 12;
+	handle &= 0x0fff;
+
+	conn = conn_lookup(index, handle, true);
+	if (!conn_matches(conn))
+		return false;
+
+	if (!has_l2cap_terms())
+		return true;
+
+	/* Continuation fragments follow the start fragment */
+	if ((flags & 0x03) == 0x01)
+		return conn->frag_match;
+
+	conn->frag_match = false;
+
+	if (size < 8)
+		return false;
+
+	cid = get_le16(data + 6);
+
+	if (filter.psm.num && (cid == 0x0001 || cid == 0x0005))
+		learn_signaling(conn, data + 8, size - 8);
+
+	conn->frag_match = match_l2cap(conn, cid, data + 8, size - 8);
+
+	return conn->frag_match;
+}
+
+static bool match_sync(uint16_t index, const uint8_t *data, uint16_t size)
+{
+	struct filter_conn *conn;
+
+	if (size < 3)
+		return false;
+
+	/* SCO and ISO data are not carried over L2CAP */
+	if (has_l2cap_terms())
+		return false;
+
+	conn = conn_lookup(index, get_le16(data) & 0x0fff, true);
+
+	return conn_matches(conn);
+}
+
+static bool match_time(struct timeval *tv)
+{
+	double offset;
+
+	if (!tv)
+		return true;
+
+	offset = (tv->tv_sec - filter.time_base) + tv->tv_usec / 1000000.0;
+
+	if (offset < filter.time_start)
+		return false;
+
+	if (filter.time_end >= 0 && offset > filter.time_end)
+		return false;
+
+	return true;
+}
+
+bool filter_packet(struct timeval *tv, uint16_t index, uint16_t opcode,
+					const void *data, uint16_t size)
+{
+	bool match;
+
+	if (!filter.enabled)
+		return true;
+
+	/* Time range is relative to the first packet, as displayed */
+	if (tv && !filter.time_base)
+		filter.time_base = tv->tv_sec;
+
+	switch (opcode) {
+	case BTSNOOP_OPCODE_COMMAND_PKT:
+		match = match_command(index, data, size);
+		break;
+	case BTSNOOP_OPCODE_EVENT_PKT:
+		match = match_event(index, data, size);
+		break;
+	case BTSNOOP_OPCODE_ACL_TX_PKT:
+	case BTSNOOP_OPCODE_ACL_RX_PKT:
+		match = match_acl(index, data, size);
+		break;
+	case BTSNOOP_OPCODE_SCO_TX_PKT:
+	case BTSNOOP_OPCODE_SCO_RX_PKT:
+	case BTSNOOP_OPCODE_ISO_TX_PKT:
+	case BTSNOOP_OPCODE_ISO_RX_PKT:
+		match = match_sync(index, data, size);
+		break;
+	default:
+		return true;
+	}
+
+	if (match && filter.time)
+		match = match_time(tv);
+
+	return match;
+}
+
+static void bpf_add(struct sock_filter *insns, unsigned int *pos,
+				uint16_t code, uint32_t k, uint8_t jt, uint8_t jf)
+{
+	struct sock_filter insn = { code, jt, jf, k };
+
+	insns[(*pos)++] = insn;
+}
+
+/* Emits a list of comparisons against the accumulator that jump to the
+ * pass return, which follows after extra instructions and the reject.
+ */
+static void bpf_add_values(struct sock_filter *insns, unsigned int *pos,
+				const struct filter_values *values, bool swap,
+				unsigned int extra)
+{
+	unsigned int i;
+
+	for (i = 0; i < values->num; i++) {
+		uint16_t val = values->val[i];
+
+		if (swap)
+			val = val << 8 | val >> 8;
+
+		bpf_add(insns, pos, BPF_JMP + BPF_JEQ + BPF_K, val,
+					values->num - i + extra, 0);
+	}
+}
+
+static void bpf_add_returns(struct sock_filter *insns, unsigned int *pos)
+{
+	bpf_add(insns, pos, BPF_RET + BPF_K, 0, 0, 0);
+	bpf_add(insns, pos, BPF_RET + BPF_K, BPF_PASS, 0, 0);
+}
+
+unsigned int filter_bpf(uint16_t index, bool hci, struct sock_filter *insns,
+							unsigned int max)
+{
+	unsigned int pos = 0, list;
+
+	/* Three compare lists of opcodes plus one of events and the fixed
+	 * instructions around them.
+	 */
+	if (max < 4 * FILTER_MAX_VALUES + 32)
+		return 0;
+
+	if (index != HCI_DEV_NONE) {
+		/* A <- MGMT index, accept if it is HCI_DEV_NONE or a match */
+		bpf_add(insns, &pos, BPF_LD + BPF_H + BPF_ABS,
+					offsetof(struct mgmt_hdr, index), 0, 0);
+		bpf_add(insns, &pos, BPF_JMP + BPF_JEQ + BPF_K,
+						HCI_DEV_NONE, 2, 0);
+		bpf_add(insns, &pos, BPF_JMP + BPF_JEQ + BPF_K,
+					(index & 0xff) << 8 | index >> 8, 1, 0);
+		bpf_add(insns, &pos, BPF_RET + BPF_K, 0, 0, 0);
+	}
+
+	/* Connections are tracked from events, so only commands and events
+	 * can be dropped in the kernel and only if no address is needed.
+	 * Channels matched by L2CAP terms need every event of their link.
+	 */
+	if (!hci || !has_hci_terms() || filter.num_addr || has_l2cap_terms())
+		goto pass;
+
+	/* Length of a compare list of opcodes with its returns */
+	list = 1 + filter.opcode.num + 2;
+
+	/* A <- packet type */
+	bpf_add(insns, &pos, BPF_LD + BPF_B + BPF_ABS,
+				offsetof(struct mgmt_hdr, opcode), 0, 0);
+	bpf_add(insns, &pos, BPF_JMP + BPF_JEQ + BPF_K,
+				BTSNOOP_OPCODE_COMMAND_PKT, 2, 0);
+	bpf_add(insns, &pos, BPF_JMP + BPF_JEQ + BPF_K,
+				BTSNOOP_OPCODE_EVENT_PKT, 1 + list, 0);
+	bpf_add(insns, &pos, BPF_RET + BPF_K, BPF_PASS, 0, 0);
+
+	/* Commands: A <- HCI opcode */
+	bpf_add(insns, &pos, BPF_LD + BPF_H + BPF_ABS, MGMT_HDR_SIZE, 0, 0);
+	bpf_add_values(insns, &pos, &filter.opcode, true, 0);
+	bpf_add_returns(insns, &pos);
+
+	/* Events: A <- HCI event code */
+	bpf_add(insns, &pos, BPF_LD + BPF_B + BPF_ABS, MGMT_HDR_SIZE, 0, 0);
+
+	if (!filter.opcode.num) {
+		bpf_add_values(insns, &pos, &filter.event, false, 0);
+		bpf_add_returns(insns, &pos);
+		goto done;
+	}
+
+	/* Command Complete and Command Status jump past the returns to
+	 * the opcode lists that follow.
+	 */
+	bpf_add_values(insns, &pos, &filter.event, false, 2);
+	bpf_add(insns, &pos, BPF_JMP + BPF_JEQ + BPF_K, 0x0e, 3, 0);
+	bpf_add(insns, &pos, BPF_JMP + BPF_JEQ + BPF_K, 0x0f, 2 + list, 0);
+	bpf_add_returns(insns, &pos);
+
+	/* Command Complete: A <- opcode after event header and ncmd */
+	bpf_add(insns, &pos, BPF_LD + BPF_H + BPF_ABS,
+						MGMT_HDR_SIZE + 3, 0, 0);
+	bpf_add_values(insns, &pos, &filter.opcode, true, 0);
+	bpf_add_returns(insns, &pos);
+
+	/* Command Status: A <- opcode after event header, status, ncmd */
+	bpf_add(insns, &pos, BPF_LD + BPF_H + BPF_ABS,
+						MGMT_HDR_SIZE + 4, 0, 0);
+	bpf_add_values(insns, &pos, &filter.opcode, true, 0);
+	bpf_add_returns(insns, &pos);
+	goto done;
+
+pass:
+	/* Only the index is checked, everything else is accepted */
+	if (pos)
+		bpf_add(insns, &pos, BPF_RET + BPF_K, BPF_PASS, 0, 0);
+
+done:
+	return pos;
+}
@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct timeval;
+struct sock_filter;
+
+#define FILTER_BPF_MAX	128
+
+bool filter_parse(const char *str);
+void filter_cleanup(void);
+
+bool filter_packet(struct timeval *tv, uint16_t index, uint16_t opcode,
+					const void *data, uint16_t size);
+
+unsigned int filter_bpf(uint16_t index, bool hci, struct sock_filter *insns,
+							unsigned int max);
@@ -15,6 +15,7 @@
 
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "hwdb.h"
@@ -22,23 +23,48 @@
 #ifdef HAVE_UDEV
 #include <libudev.h>
 
-bool hwdb_get_vendor_model(const char *modalias, char **vendor, char **model)
+#define OUI_CACHE_SIZE	256
+
+struct oui_entry {
+	uint32_t oui;
+	bool valid;
+	char *company;
+};
+
+static struct udev *udev;
+static struct udev_hwdb *hwdb;
+static bool hwdb_failed;
+static struct oui_entry oui_cache[OUI_CACHE_SIZE];
+
+static struct udev_hwdb *hwdb_get(void)
 {
-	struct udev *udev;
-	struct udev_hwdb *hwdb;
-	struct udev_list_entry *head, *entry;
-	bool result;
+	if (hwdb || hwdb_failed)
+		return hwdb;
 
 	udev = udev_new();
 	if (!udev)
-		return false;
+		goto failed;
 
 	hwdb = udev_hwdb_new(udev);
 	if (!hwdb) {
-		result = false;
-		goto done;
+		udev = udev_unref(udev);
+		goto failed;
 	}
 
+	return hwdb;
+
+failed:
+	hwdb_failed = true;
+	return NULL;
+}
+
+bool hwdb_get_vendor_model(const char *modalias, char **vendor, char **model)
+{
+	struct udev_list_entry *head, *entry;
+
+	if (!hwdb_get())
+		return false;
+
 	*vendor = NULL;
 	*model = NULL;
 
@@ -56,61 +82,71 @@ bool hwdb_get_vendor_model(const char *modalias, char **vendor, char **model)
 			*model = strdup(udev_list_entry_get_value(entry));
 	}
 
-	hwdb = udev_hwdb_unref(hwdb);
+	return true;
+}
 
-	result = true;
+static char *hwdb_lookup_company(uint32_t oui)
+{
+	struct udev_list_entry *head, *entry;
+	char modalias[11];
 
-done:
-	udev = udev_unref(udev);
+	sprintf(modalias, "OUI:%6.6X", oui);
+
+	head = udev_hwdb_get_properties_list_entry(hwdb, modalias, 0);
 
-	return result;
+	udev_list_entry_foreach(entry, head) {
+		const char *name = udev_list_entry_get_name(entry);
+
+		if (name && !strcmp(name, "ID_OUI_FROM_DATABASE"))
+			return strdup(udev_list_entry_get_value(entry));
+	}
+
+	return NULL;
 }
 
 bool hwdb_get_company(const uint8_t *bdaddr, char **company)
 {
-	struct udev *udev;
-	struct udev_hwdb *hwdb;
-	struct udev_list_entry *head, *entry;
-	char modalias[11];
-	bool result;
+	struct oui_entry *cache;
+	uint32_t oui;
 
 	if (!bdaddr[2] && !bdaddr[1] && !bdaddr[0])
 		return false;
 
-	sprintf(modalias, "OUI:%2.2X%2.2X%2.2X",
-				bdaddr[5], bdaddr[4], bdaddr[3]);
+	oui = bdaddr[5] << 16 | bdaddr[4] << 8 | bdaddr[3];
 
-	udev = udev_new();
-	if (!udev)
+	/* Traces tend to repeat the same few OUIs, so cache the last
+	 * lookup for each one including those that are not found.
+	 */
+	cache = &oui_cache[(oui ^ oui >> 8 ^ oui >> 16) % OUI_CACHE_SIZE];
+	if (cache->valid && cache->oui == oui)
+		goto done;
+
+	if (!hwdb_get())
 		return false;
 
-	hwdb = udev_hwdb_new(udev);
-	if (!hwdb) {
-		result = false;
-		goto done;
-	}
+	free(cache->company);
+	cache->company = hwdb_lookup_company(oui);
+	cache->oui = oui;
+	cache->valid = true;
 
-	*company = NULL;
+done:
+	*company = cache->company ? strdup(cache->company) : NULL;
 
-	head = udev_hwdb_get_properties_list_entry(hwdb, modalias, 0);
+	return true;
+}
 
-	udev_list_entry_foreach(entry, head) {
-		const char *name = udev_list_entry_get_name(entry);
+void hwdb_cleanup(void)
+{
+	unsigned int i;
 
-		if (name && !strcmp(name, "ID_OUI_FROM_DATABASE")) {
-			*company = strdup(udev_list_entry_get_value(entry));
-			break;
-		}
+	for (i = 0; i < OUI_CACHE_SIZE; i++) {
+		free(oui_cache[i].company);
+		memset(&oui_cache[i], 0, sizeof(oui_cache[i]));
 	}
 
 	hwdb = udev_hwdb_unref(hwdb);
-
-	result = true;
-
-done:
 	udev = udev_unref(udev);
-
-	return result;
+	hwdb_failed = false;
 }
 #else
 bool hwdb_get_vendor_model(const char *modalias, char **vendor, char **model)
@@ -122,4 +158,8 @@ bool hwdb_get_company(const uint8_t *bdaddr, char **company)
 {
 	return false;
 }
+
+void hwdb_cleanup(void)
+{
+}
 #endif
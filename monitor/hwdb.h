@@ -14,3 +14,4 @@
 
 bool hwdb_get_vendor_model(const char *modalias, char **vendor, char **model);
 bool hwdb_get_company(const uint8_t *bdaddr, char **company);
+void hwdb_cleanup(void);
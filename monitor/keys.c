@@ -33,6 +33,7 @@ struct irk_data {
 };
 
 static struct queue *irk_list;
+static unsigned int irk_gen;
 
 void keys_setup(void)
 {
@@ -52,6 +53,8 @@ void keys_update_identity_key(const uint8_t key[16])
 {
 	struct irk_data *irk;
 
+	irk_gen++;
+
 	irk = queue_peek_tail(irk_list);
 	if (irk && !memcmp(irk->key, empty_key, 16)) {
 		memcpy(irk->key, key, 16);
@@ -70,6 +73,8 @@ void keys_update_identity_addr(const uint8_t addr[6], uint8_t addr_type)
 {
 	struct irk_data *irk;
 
+	irk_gen++;
+
 	irk = queue_peek_tail(irk_list);
 	if (irk && !memcmp(irk->addr, empty_addr, 6)) {
 		memcpy(irk->addr, addr, 6);
@@ -102,6 +107,10 @@ bool keys_resolve_identity(const uint8_t addr[6], uint8_t ident[6],
 {
 	struct irk_data *irk;
 
+	/* Only Resolvable Private Addresses can be resolved */
+	if ((addr[5] & 0xc0) != 0x40)
+		return false;
+
 	irk = queue_find(irk_list, match_resolve_irk, addr);
 
 	if (irk) {
@@ -126,6 +135,8 @@ bool keys_add_identity(const uint8_t addr[6], uint8_t addr_type,
 {
 	struct irk_data *irk;
 
+	irk_gen++;
+
 	irk = queue_find(irk_list, match_key, key);
 	if (!irk) {
 		irk = new0(struct irk_data, 1);
@@ -138,3 +149,8 @@ bool keys_add_identity(const uint8_t addr[6], uint8_t addr_type,
 
 	return true;
 }
+
+unsigned int keys_get_generation(void)
+{
+	return irk_gen;
+}
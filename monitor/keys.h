@@ -22,3 +22,6 @@ bool keys_resolve_identity(const uint8_t addr[6], uint8_t ident[6],
 							uint8_t *ident_type);
 bool keys_add_identity(const uint8_t addr[6], uint8_t addr_type,
 					const uint8_t key[16]);
+
+/* Changes whenever an identity is added or updated */
+unsigned int keys_get_generation(void);
@@ -419,73 +419,92 @@ static char *mode2str(uint8_t mode)
 
 static void l2cap_ctrl_ext_parse(struct l2cap_frame *frame, uint32_t ctrl)
 {
-	printf("      %s:",
-		ctrl & L2CAP_EXT_CTRL_FRAME_TYPE ? "S-frame" : "I-frame");
+	char str[128];
+	int len = 0;
 
 	if (ctrl & L2CAP_EXT_CTRL_FRAME_TYPE) {
-		printf(" %s",
+		len += snprintf(str + len, sizeof(str) - len, " %s",
 		supervisory2str((ctrl & L2CAP_EXT_CTRL_SUPERVISE_MASK) >>
 						L2CAP_EXT_CTRL_SUPER_SHIFT));
 
 		if (ctrl & L2CAP_EXT_CTRL_POLL)
-			printf(" P-bit");
+			len += snprintf(str + len, sizeof(str) - len,
+								" P-bit");
 	} else {
 		uint8_t sar = (ctrl & L2CAP_EXT_CTRL_SAR_MASK) >>
 						L2CAP_EXT_CTRL_SAR_SHIFT;
-		printf(" %s", sar2str(sar));
+		len += snprintf(str + len, sizeof(str) - len, " %s",
+								sar2str(sar));
 		if (sar == L2CAP_SAR_START) {
-			uint16_t len;
+			uint16_t sdu_len;
 
-			if (!l2cap_frame_get_le16(frame, &len))
-				return;
+			if (!l2cap_frame_get_le16(frame, &sdu_len))
+				goto done;
 
-			printf(" (len %d)", len);
+			len += snprintf(str + len, sizeof(str) - len,
+						" (len %d)", sdu_len);
 		}
-		printf(" TxSeq %d", (ctrl & L2CAP_EXT_CTRL_TXSEQ_MASK) >>
+		len += snprintf(str + len, sizeof(str) - len, " TxSeq %d",
+				(ctrl & L2CAP_EXT_CTRL_TXSEQ_MASK) >>
 						L2CAP_EXT_CTRL_TXSEQ_SHIFT);
 	}
 
-	printf(" ReqSeq %d", (ctrl & L2CAP_EXT_CTRL_REQSEQ_MASK) >>
+	len += snprintf(str + len, sizeof(str) - len, " ReqSeq %d",
+				(ctrl & L2CAP_EXT_CTRL_REQSEQ_MASK) >>
 						L2CAP_EXT_CTRL_REQSEQ_SHIFT);
 
 	if (ctrl & L2CAP_EXT_CTRL_FINAL)
-		printf(" F-bit");
+		snprintf(str + len, sizeof(str) - len, " F-bit");
+
+done:
+	print_indent(6, COLOR_OFF, "", "", COLOR_OFF, "%s:%s",
+		ctrl & L2CAP_EXT_CTRL_FRAME_TYPE ? "S-frame" : "I-frame", str);
 }
 
 static void l2cap_ctrl_parse(struct l2cap_frame *frame, uint32_t ctrl)
 {
-	printf("      %s:",
-			ctrl & L2CAP_CTRL_FRAME_TYPE ? "S-frame" : "I-frame");
+	char str[128];
+	int len = 0;
 
 	if (ctrl & 0x01) {
-		printf(" %s",
+		len += snprintf(str + len, sizeof(str) - len, " %s",
 			supervisory2str((ctrl & L2CAP_CTRL_SUPERVISE_MASK) >>
 						L2CAP_CTRL_SUPER_SHIFT));
 
 		if (ctrl & L2CAP_CTRL_POLL)
-			printf(" P-bit");
+			len += snprintf(str + len, sizeof(str) - len,
+								" P-bit");
 	} else {
 		uint8_t sar;
 
 		sar = (ctrl & L2CAP_CTRL_SAR_MASK) >> L2CAP_CTRL_SAR_SHIFT;
-		printf(" %s", sar2str(sar));
+		len += snprintf(str + len, sizeof(str) - len, " %s",
+								sar2str(sar));
 		if (sar == L2CAP_SAR_START) {
-			uint16_t len;
+			uint16_t sdu_len;
 
-			if (!l2cap_frame_get_le16(frame, &len))
-				return;
+			if (!l2cap_frame_get_le16(frame, &sdu_len))
+				goto done;
 
-			printf(" (len %d)", len);
+			len += snprintf(str + len, sizeof(str) - len,
+						" (len %d)", sdu_len);
 		}
-		printf(" TxSeq %d", (ctrl & L2CAP_CTRL_TXSEQ_MASK) >>
+		len += snprintf(str + len, sizeof(str) - len, " TxSeq %d",
+					(ctrl & L2CAP_CTRL_TXSEQ_MASK) >>
 						L2CAP_CTRL_TXSEQ_SHIFT);
 	}
 
-	printf(" ReqSeq %d", (ctrl & L2CAP_CTRL_REQSEQ_MASK) >>
+	len += snprintf(str + len, sizeof(str) - len, " ReqSeq %d",
+					(ctrl & L2CAP_CTRL_REQSEQ_MASK) >>
 						L2CAP_CTRL_REQSEQ_SHIFT);
 
 	if (ctrl & L2CAP_CTRL_FINAL)
-		printf(" F-bit");
+		snprintf(str + len, sizeof(str) - len, " F-bit");
+
+done:
+	print_indent(6, COLOR_OFF, "", "", COLOR_OFF, "%s:%s",
+			ctrl & L2CAP_CTRL_FRAME_TYPE ? "S-frame" : "I-frame",
+			str);
 }
 
 #define MAX_INDEX 16
@@ -2633,8 +2652,6 @@ void l2cap_frame(uint16_t index, bool in, uint16_t handle, uint16_t cid,
 
 				l2cap_ctrl_parse(&frame, ctrl16);
 			}
-
-			printf("\n");
 			break;
 		}
 
@@ -27,6 +27,8 @@
 #include "packet.h"
 #include "lmp.h"
 #include "keys.h"
+#include "hwdb.h"
+#include "filter.h"
 #include "analyze.h"
 #include "ellisys.h"
 #include "control.h"
@@ -54,9 +56,12 @@ static void usage(void)
 		"\t                       If gnuplot is installed on the\n"
                 "\t                       system it will also attempt to plot\n"
 		"\t                       packet latency graph.\n"
+		"\t-m, --metrics <file>[,<interval>]\n"
+		"\t                       Export live metrics (unix:<path>)\n"
 		"\t-s, --server <socket>  Start monitor server socket\n"
 		"\t-p, --priority <level> Show only priority or lower\n"
 		"\t-i, --index <num>      Show only specified controller\n"
+		"\t-F, --filter <expr>    Show only packets matching filter\n"
 		"\t-d, --tty <tty>        Read data from TTY\n"
 		"\t-B, --tty-speed <rate> Set TTY speed (default 115200)\n"
 		"\t-V, --vendor <compid>  Set default company identifier\n"
@@ -74,6 +79,7 @@ static void usage(void)
 		"\t                       RTT control block parameters\n"
 		"\t-C, --columns [width]  Output width if not a terminal\n"
 		"\t-c, --color [mode]     Output color: auto/always/never\n"
+		"\t-o, --output [format]  Output format: text/json/binary\n"
 		"\t-h, --help             Show help options\n");
 }
 
@@ -81,9 +87,11 @@ static const struct option main_options[] = {
 	{ "read",      required_argument, NULL, 'r' },
 	{ "write",     required_argument, NULL, 'w' },
 	{ "analyze",   required_argument, NULL, 'a' },
+	{ "metrics",   required_argument, NULL, 'm' },
 	{ "server",    required_argument, NULL, 's' },
 	{ "priority",  required_argument, NULL, 'p' },
 	{ "index",     required_argument, NULL, 'i' },
+	{ "filter",    required_argument, NULL, 'F' },
 	{ "tty",       required_argument, NULL, 'd' },
 	{ "tty-speed", required_argument, NULL, 'B' },
 	{ "vendor",    required_argument, NULL, 'V' },
@@ -100,6 +108,7 @@ static const struct option main_options[] = {
 	{ "rtt",       required_argument, NULL, 'R' },
 	{ "columns",   required_argument, NULL, 'C' },
 	{ "color",     required_argument, NULL, 'c' },
+	{ "output",    required_argument, NULL, 'o' },
 	{ "todo",      no_argument,       NULL, '#' },
 	{ "version",   no_argument,       NULL, 'v' },
 	{ "help",      no_argument,       NULL, 'h' },
@@ -113,6 +122,9 @@ int main(int argc, char *argv[])
 	const char *reader_path = NULL;
 	const char *writer_path = NULL;
 	const char *analyze_path = NULL;
+	char *metrics_path = NULL;
+	unsigned int metrics_interval = 10;
+	char *sep;
 	const char *ellisys_server = NULL;
 	const char *tty = NULL;
 	unsigned int tty_speed = B115200;
@@ -131,7 +143,7 @@ int main(int argc, char *argv[])
 		struct sockaddr_un addr;
 
 		opt = getopt_long(argc, argv,
-				"r:w:a:s:p:i:d:B:V:MNtTSAIE:PJ:R:C:c:vh",
+				"r:w:a:m:s:p:i:F:d:B:V:MNtTSAIE:PJ:R:C:c:o:vh",
 				main_options, NULL);
 		if (opt < 0)
 			break;
@@ -146,6 +158,18 @@ int main(int argc, char *argv[])
 		case 'a':
 			analyze_path = optarg;
 			break;
+		case 'm':
+			metrics_path = optarg;
+			sep = strrchr(optarg, ',');
+			if (sep) {
+				*sep = '\0';
+				metrics_interval = atoi(sep + 1);
+			}
+			if (!metrics_interval) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			break;
 		case 's':
 			if (strlen(optarg) > sizeof(addr.sun_path) - 1) {
 				fprintf(stderr, "Socket name too long\n");
@@ -167,6 +191,12 @@ int main(int argc, char *argv[])
 			}
 			packet_select_index(atoi(str));
 			break;
+		case 'F':
+			if (!filter_parse(optarg)) {
+				fprintf(stderr, "Invalid filter: %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
 		case 'd':
 			tty = optarg;
 			break;
@@ -234,6 +264,19 @@ int main(int argc, char *argv[])
 				return EXIT_FAILURE;
 			}
 			break;
+		case 'o':
+			if (strcmp("text", optarg) == 0)
+				set_monitor_output(OUTPUT_TEXT);
+			else if (strcmp("json", optarg) == 0)
+				set_monitor_output(OUTPUT_JSON);
+			else if (strcmp("binary", optarg) == 0)
+				set_monitor_output(OUTPUT_BINARY);
+			else {
+				fprintf(stderr, "Output option must be one of "
+						"text/json/binary\n");
+				return EXIT_FAILURE;
+			}
+			break;
 		case '#':
 			packet_todo();
 			lmp_todo();
@@ -259,7 +302,15 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
-	printf("Bluetooth monitor ver %s\n", VERSION);
+	if (metrics_path && (reader_path || analyze_path)) {
+		fprintf(stderr, "Metrics are only exported when tracing\n");
+		return EXIT_FAILURE;
+	}
+
+	if (use_text())
+		printf("Bluetooth monitor ver %s\n", VERSION);
+	else
+		use_pager = false;
 
 	keys_setup();
 
@@ -275,9 +326,17 @@ int main(int argc, char *argv[])
 			ellisys_enable(ellisys_server, ellisys_port);
 
 		control_reader(reader_path, use_pager);
+		display_record_end();
 		return EXIT_SUCCESS;
 	}
 
+	if (metrics_path) {
+		if (!analyze_live(metrics_path, metrics_interval))
+			return EXIT_FAILURE;
+
+		control_analyze();
+	}
+
 	if (writer_path && !control_writer(writer_path)) {
 		printf("Failed to open '%s'\n", writer_path);
 		return EXIT_FAILURE;
@@ -297,7 +356,12 @@ int main(int argc, char *argv[])
 
 	exit_status = mainloop_run_with_signal(signal_callback, NULL);
 
+	analyze_stop();
+	display_record_end();
+
 	keys_cleanup();
+	hwdb_cleanup();
+	filter_cleanup();
 
 	return exit_status;
 }
@@ -41,6 +41,7 @@
 #include "bt.h"
 #include "ll.h"
 #include "hwdb.h"
+#include "filter.h"
 #include "keys.h"
 #include "packet.h"
 #include "l2cap.h"
@@ -381,6 +382,12 @@ static void print_packet(struct timeval *tv, struct ucred *cred, char ident,
 	int n, ts_len = 0, ts_pos = 0, len = 0, pos = 0;
 	static size_t last_frame;
 
+	if (!use_text()) {
+		display_record_begin(tv, index == HCI_DEV_NONE ? -1 : index,
+					ident, channel, label, text, extra);
+		return;
+	}
+
 	if (channel) {
 		if (use_color()) {
 			n = sprintf(ts_str + ts_pos, "%s", COLOR_CHANNEL_LABEL);
@@ -4215,6 +4222,13 @@ void packet_monitor(struct timeval *tv, struct ucred *cred,
 	if (tv && time_offset == ((time_t) -1))
 		time_offset = tv->tv_sec;
 
+	if (!filter_packet(tv, index, opcode, data, size)) {
+		/* Keep frame numbers matching the unfiltered trace */
+		if (index < MAX_INDEX)
+			index_list[index].frame++;
+		return;
+	}
+
 	switch (opcode) {
 	case BTSNOOP_OPCODE_NEW_INDEX:
 		ni = data;
@@ -4372,6 +4386,8 @@ void packet_monitor(struct timeval *tv, struct ucred *cred,
 		packet_hexdump(data, size);
 		break;
 	}
+
+	display_record_end();
 }
 
 void packet_simulator(struct timeval *tv, uint16_t frequency,
@@ -4388,6 +4404,8 @@ void packet_simulator(struct timeval *tv, uint16_t frequency,
 					"Physical packet:", NULL, str);
 
 	ll_packet(frequency, data, size, false);
+
+	display_record_end();
 }
 
 static void null_cmd(uint16_t index, const void *data, uint8_t size)
@@ -137,17 +137,20 @@ static void print_rfcomm_hdr(struct rfcomm_frame *rfcomm_frame, uint8_t indent)
 static inline bool mcc_test(struct rfcomm_frame *rfcomm_frame, uint8_t indent)
 {
 	struct l2cap_frame *frame = &rfcomm_frame->l2cap_frame;
+	char str[frame->size * 3 + 1];
 	uint8_t data;
+	int len = 0;
 
-	printf("%*cTest Data: 0x ", indent, ' ');
+	str[0] = '\0';
 
+	/* Build the line first so that it goes through print_field() */
 	while (frame->size > 1) {
 		if (!l2cap_frame_get_u8(frame, &data))
 			return false;
-		printf("%2.2x ", data);
+		len += sprintf(str + len, "%2.2x ", data);
 	}
 
-	printf("\n");
+	print_field("%*cTest Data: 0x %s", indent, ' ', str);
 	return true;
 }
 
@@ -3531,6 +3531,21 @@ static void media_server_remove(struct btd_adapter *adapter)
 	media_unregister(adapter);
 }
 
+/* Connect A2DP after the telephony profiles of the same remote role, many
+ * headsets and car kits expect the HFP/HSP link to be established first.
+ */
+static const char *a2dp_source_after[] = {
+	HFP_AG_UUID,
+	HSP_AG_UUID,
+	NULL
+};
+
+static const char *a2dp_sink_after[] = {
+	HFP_HS_UUID,
+	HSP_HS_UUID,
+	NULL
+};
+
 static struct btd_profile a2dp_source_profile = {
 	.name		= "a2dp-source",
 	.priority	= BTD_PROFILE_PRIORITY_MEDIUM,
@@ -3540,6 +3555,7 @@ static struct btd_profile a2dp_source_profile = {
 	.device_remove	= a2dp_source_remove,
 
 	.auto_connect	= true,
+	.after_services	= a2dp_source_after,
 	.connect	= a2dp_source_connect,
 	.disconnect	= a2dp_source_disconnect,
 
@@ -3556,6 +3572,7 @@ static struct btd_profile a2dp_sink_profile = {
 	.device_remove	= a2dp_sink_remove,
 
 	.auto_connect	= true,
+	.after_services	= a2dp_sink_after,
 	.connect	= a2dp_sink_connect,
 	.disconnect	= a2dp_sink_disconnect,
 
@@ -2596,18 +2596,17 @@ static void bap_state_bcast_src(struct bt_bap_stream *stream, uint8_t old_state,
 	 * been acquired so we can create the BIG.
 	 */
 	case BT_BAP_STREAM_STATE_ENABLING:
-		/* If the stream attached to a broadcast
-		 * source endpoint generate the base.
+		/* Refresh the BASE of the stream attached to a broadcast
+		 * source endpoint. The BASE is cached per BIG so it is
+		 * only generated again if a stream of the BIG has been
+		 * added, removed or reconfigured since.
 		 */
-		if (setup->base == NULL) {
-			setup->base = bt_bap_stream_get_base(
-					setup->stream);
-			/* Set the generated BASE on all setups
-			 * from the same BIG.
-			 */
-			queue_foreach(setup->ep->setups,
-				iterate_setup_update_base, setup);
-		}
+		util_iov_free(setup->base, 1);
+		setup->base = bt_bap_stream_get_base(setup->stream);
+
+		/* Set the BASE on all setups from the same BIG. */
+		queue_foreach(setup->ep->setups, iterate_setup_update_base,
+								setup);
 		/* The kernel has 2 requirements when handling
 		 * multiple BIS connections for the same BIG:
 		 * 1 - setup_create_io for all but the last BIS
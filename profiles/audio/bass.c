@@ -58,6 +58,9 @@
 
 #define MEDIA_ASSISTANT_INTERFACE "org.bluez.MediaAssistant1"
 
+/* Maximum number of Control Point writes in flight per adapter */
+#define BASS_MAX_PENDING 8
+
 enum assistant_state {
 	ASSISTANT_STATE_IDLE,		/* Assistant object was created for
 					 * the stream
@@ -106,9 +109,37 @@ struct bass_delegator {
 	unsigned int state_id;
 };
 
+/* Control Point operations are queued per adapter so that pushing a
+ * stream to many peers at once does not flood the controller.
+ */
+struct bass_op_queue {
+	struct btd_adapter *adapter;
+	struct queue *waiting;
+	struct queue *inflight;
+};
+
+/* Aggregated result of operations started by a single method call */
+struct bass_batch {
+	DBusMessage *msg;
+	bool all;
+	unsigned int pending;
+	struct queue *failed;
+};
+
+struct bass_op {
+	struct bass_op_queue *q;
+	struct bass_assistant *assistant;
+	struct bass_batch *batch;
+	char *path;
+	uint8_t op;
+	struct iovec *params;
+	int err;
+};
+
 static struct queue *sessions;
 static struct queue *assistants;
 static struct queue *delegators;
+static struct queue *op_queues;
 
 static const char *state2str(enum assistant_state state);
 
@@ -361,35 +392,218 @@ fail:
 	return -EINVAL;
 }
 
-static DBusMessage *push(DBusConnection *conn, DBusMessage *msg,
-							  void *user_data)
+static struct bass_batch *batch_new(DBusMessage *msg, bool all)
+{
+	struct bass_batch *batch;
+
+	batch = new0(struct bass_batch, 1);
+	batch->msg = dbus_message_ref(msg);
+	batch->all = all;
+	batch->failed = queue_new();
+
+	return batch;
+}
+
+static void batch_reply(struct bass_batch *batch)
+{
+	const struct queue_entry *entry;
+	DBusMessage *reply;
+	DBusMessageIter iter, array;
+
+	DBG("batch %p failed %u", batch, queue_length(batch->failed));
+
+	if (!batch->all) {
+		if (queue_isempty(batch->failed))
+			reply = g_dbus_create_reply(batch->msg,
+							DBUS_TYPE_INVALID);
+		else
+			reply = btd_error_failed(batch->msg,
+						"Unable to push stream");
+		goto done;
+	}
+
+	reply = dbus_message_new_method_return(batch->msg);
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					DBUS_TYPE_OBJECT_PATH_AS_STRING,
+					&array);
+
+	for (entry = queue_get_entries(batch->failed); entry;
+						entry = entry->next) {
+		const char *path = entry->data;
+
+		dbus_message_iter_append_basic(&array, DBUS_TYPE_OBJECT_PATH,
+								&path);
+	}
+
+	dbus_message_iter_close_container(&iter, &array);
+
+done:
+	g_dbus_send_message(btd_get_dbus_connection(), reply);
+
+	dbus_message_unref(batch->msg);
+	queue_destroy(batch->failed, g_free);
+	free(batch);
+}
+
+static void op_finish(struct bass_op *op)
+{
+	struct bass_assistant *assistant = op->assistant;
+
+	if (op->err) {
+		error("%s: Control Point operation 0x%02x failed: %s",
+					op->path, op->op, strerror(-op->err));
+
+		/* Let the user push the stream again */
+		if (assistant && op->op == BT_BASS_ADD_SRC &&
+				assistant->state == ASSISTANT_STATE_PENDING)
+			assistant_set_state(assistant, ASSISTANT_STATE_IDLE);
+	}
+
+	if (op->batch) {
+		if (op->err)
+			queue_push_tail(op->batch->failed, g_strdup(op->path));
+
+		if (!--op->batch->pending)
+			batch_reply(op->batch);
+	}
+
+	util_iov_free(op->params, 1);
+	g_free(op->path);
+	free(op);
+}
+
+static void op_queue_process(struct bass_op_queue *q);
+
+static void op_complete(struct bt_bass *bass, int err, void *user_data)
+{
+	struct bass_op *op = user_data;
+
+	op->err = err;
+}
+
+static void op_destroy(void *user_data)
+{
+	struct bass_op *op = user_data;
+	struct bass_op_queue *q = op->q;
+
+	queue_remove(q->inflight, op);
+	op_finish(op);
+	op_queue_process(q);
+}
+
+static void op_queue_process(struct bass_op_queue *q)
 {
-	struct bass_assistant *assistant = user_data;
 	struct bt_bass_bcast_audio_scan_cp_hdr hdr;
-	struct bt_bass_add_src_params params;
-	struct iovec iov = {0};
-	uint32_t bis_sync = 0;
-	uint8_t meta_len = 0;
-	int err;
-	DBusMessageIter props, dict;
+	struct bass_op *op;
 
-	DBG("");
+	while (queue_length(q->inflight) < BASS_MAX_PENDING) {
+		op = queue_pop_head(q->waiting);
+		if (!op)
+			return;
 
-	dbus_message_iter_init(msg, &props);
+		hdr.op = op->op;
 
-	if (dbus_message_iter_get_arg_type(&props) != DBUS_TYPE_ARRAY) {
-		DBG("Unable to parse properties");
-		return btd_error_invalid_args(msg);
+		/* Cancelled until the write reports completion */
+		op->err = -ECANCELED;
+		queue_push_tail(q->inflight, op);
+
+		if (!bt_bass_send_req(op->assistant->data->bass, &hdr,
+						op->params, op_complete, op,
+						op_destroy)) {
+			queue_remove(q->inflight, op);
+			op->err = -EIO;
+			op_finish(op);
+			continue;
+		}
+
+		if (op->op == BT_BASS_ADD_SRC)
+			assistant_set_state(op->assistant,
+						ASSISTANT_STATE_PENDING);
 	}
+}
 
-	dbus_message_iter_recurse(&props, &dict);
+static bool match_op_queue(const void *data, const void *match_data)
+{
+	const struct bass_op_queue *q = data;
 
-	if (assistant_parse_props(assistant, &dict)) {
-		DBG("Unable to parse properties");
-		return btd_error_invalid_args(msg);
+	return q->adapter == match_data;
+}
+
+static void op_queue_push(struct bass_assistant *assistant, uint8_t opcode,
+				struct iovec *params, struct bass_batch *batch)
+{
+	struct btd_adapter *adapter = device_get_adapter(
+						assistant->data->device);
+	struct bass_op_queue *q;
+	struct bass_op *op;
+
+	if (!op_queues)
+		op_queues = queue_new();
+
+	q = queue_find(op_queues, match_op_queue, adapter);
+	if (!q) {
+		q = new0(struct bass_op_queue, 1);
+		q->adapter = adapter;
+		q->waiting = queue_new();
+		q->inflight = queue_new();
+		queue_push_tail(op_queues, q);
+	}
+
+	op = new0(struct bass_op, 1);
+	op->q = q;
+	op->assistant = assistant;
+	op->batch = batch;
+	op->path = g_strdup(assistant->path);
+	op->op = opcode;
+	op->params = util_iov_dup(params, 1);
+
+	if (batch)
+		batch->pending++;
+
+	queue_push_tail(q->waiting, op);
+
+	op_queue_process(q);
+}
+
+static bool match_op_assistant(const void *data, const void *match_data)
+{
+	const struct bass_op *op = data;
+
+	return op->assistant == match_data;
+}
+
+static void op_queue_cancel(void *data, void *user_data)
+{
+	struct bass_op_queue *q = data;
+	struct bass_assistant *assistant = user_data;
+	const struct queue_entry *entry;
+	struct bass_op *op;
+
+	/* Operations in flight complete once the write is done or
+	 * cancelled by the client, just detach them from the assistant.
+	 */
+	for (entry = queue_get_entries(q->inflight); entry;
+						entry = entry->next) {
+		op = entry->data;
+
+		if (op->assistant == assistant)
+			op->assistant = NULL;
 	}
 
-	hdr.op = BT_BASS_ADD_SRC;
+	while ((op = queue_remove_if(q->waiting, match_op_assistant,
+							assistant))) {
+		op->err = -ECANCELED;
+		op_finish(op);
+	}
+}
+
+static void assistant_add_src_params(struct bass_assistant *assistant,
+							struct iovec *iov)
+{
+	struct bt_bass_add_src_params params;
+	uint32_t bis_sync = 0;
+	uint8_t meta_len = 0;
 
 	if (device_get_le_address_type(assistant->device) == BDADDR_LE_PUBLIC)
 		params.addr_type = BT_BASS_ADDR_PUBLIC;
@@ -402,42 +616,129 @@ static DBusMessage *push(DBusConnection *conn, DBusMessage *msg,
 	params.pa_interval = PA_INTERVAL_UNKNOWN;
 	params.num_subgroups = assistant->sgrp + 1;
 
-	util_iov_append(&iov, &params, sizeof(params));
+	util_iov_append(iov, &params, sizeof(params));
 
 	/* Metadata and the BIS index associated with the MediaAssistant
 	 * object will be set in the subgroup they belong to. For the other
 	 * subgroups, no metadata and no BIS index will be provided.
 	 */
 	for (uint8_t sgrp = 0; sgrp < assistant->sgrp; sgrp++) {
-		util_iov_append(&iov, &bis_sync, sizeof(bis_sync));
-		util_iov_append(&iov, &meta_len, sizeof(meta_len));
+		util_iov_append(iov, &bis_sync, sizeof(bis_sync));
+		util_iov_append(iov, &meta_len, sizeof(meta_len));
 	}
 
 	bis_sync = (1 << (assistant->bis - 1));
 	meta_len = assistant->meta->iov_len;
 
-	util_iov_append(&iov, &bis_sync, sizeof(bis_sync));
-	util_iov_append(&iov, &meta_len, sizeof(meta_len));
-	util_iov_append(&iov, assistant->meta->iov_base,
+	util_iov_append(iov, &bis_sync, sizeof(bis_sync));
+	util_iov_append(iov, &meta_len, sizeof(meta_len));
+	util_iov_append(iov, assistant->meta->iov_base,
 				assistant->meta->iov_len);
+}
 
-	err = bt_bass_send(assistant->data->bass, &hdr, &iov);
-	if (err) {
-		DBG("Unable to send BASS Write Command");
-		return btd_error_failed(msg, strerror(-err));
-	}
+static void assistant_push(struct bass_assistant *assistant,
+						struct bass_batch *batch)
+{
+	struct iovec iov = {0};
+
+	assistant_add_src_params(assistant, &iov);
+
+	op_queue_push(assistant, BT_BASS_ADD_SRC, &iov, batch);
 
 	free(iov.iov_base);
+}
+
+static int assistant_parse_msg(struct bass_assistant *assistant,
+							DBusMessage *msg)
+{
+	DBusMessageIter props, dict;
+
+	dbus_message_iter_init(msg, &props);
+
+	if (dbus_message_iter_get_arg_type(&props) != DBUS_TYPE_ARRAY) {
+		DBG("Unable to parse properties");
+		return -EINVAL;
+	}
+
+	dbus_message_iter_recurse(&props, &dict);
+
+	if (assistant_parse_props(assistant, &dict)) {
+		DBG("Unable to parse properties");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static DBusMessage *push(DBusConnection *conn, DBusMessage *msg,
+							  void *user_data)
+{
+	struct bass_assistant *assistant = user_data;
 
-	assistant_set_state(assistant, ASSISTANT_STATE_PENDING);
+	DBG("");
+
+	if (assistant_parse_msg(assistant, msg))
+		return btd_error_invalid_args(msg);
+
+	/* Reply once the peer has acknowledged the operation */
+	assistant_push(assistant, batch_new(msg, false));
+
+	return NULL;
+}
+
+static DBusMessage *push_all(DBusConnection *conn, DBusMessage *msg,
+							  void *user_data)
+{
+	struct bass_assistant *assistant = user_data;
+	const struct queue_entry *entry;
+	struct bass_batch *batch;
+
+	DBG("");
+
+	if (assistant_parse_msg(assistant, msg))
+		return btd_error_invalid_args(msg);
+
+	batch = batch_new(msg, true);
+
+	/* Hold a reference so the reply is not sent before all operations
+	 * have been queued.
+	 */
+	batch->pending++;
+
+	/* Push the same stream to every peer an assistant object has been
+	 * created for.
+	 */
+	for (entry = queue_get_entries(assistants); entry;
+						entry = entry->next) {
+		struct bass_assistant *a = entry->data;
+
+		if (a->device != assistant->device || a->bis != assistant->bis)
+			continue;
 
-	return g_dbus_create_reply(msg, DBUS_TYPE_INVALID);
+		if (a != assistant) {
+			util_iov_free(a->meta, 1);
+			a->meta = util_iov_dup(assistant->meta, 1);
+			memcpy(a->qos.bcast.bcode, assistant->qos.bcast.bcode,
+						BT_BASS_BCAST_CODE_SIZE);
+		}
+
+		assistant_push(a, batch);
+	}
+
+	if (!--batch->pending)
+		batch_reply(batch);
+
+	return NULL;
 }
 
 static const GDBusMethodTable assistant_methods[] = {
 	{GDBUS_EXPERIMENTAL_ASYNC_METHOD("Push",
 					GDBUS_ARGS({ "Props", "a{sv}" }),
 					NULL, push)},
+	{GDBUS_EXPERIMENTAL_ASYNC_METHOD("PushAll",
+					GDBUS_ARGS({ "Props", "a{sv}" }),
+					GDBUS_ARGS({ "Failed", "ao" }),
+					push_all)},
 	{},
 };
 
@@ -524,6 +825,8 @@ static void assistant_free(void *data)
 {
 	struct bass_assistant *assistant = data;
 
+	queue_foreach(op_queues, op_queue_cancel, assistant);
+
 	g_free(assistant->path);
 	util_iov_free(assistant->meta, 1);
 	util_iov_free(assistant->caps, 1);
@@ -856,32 +1159,19 @@ static void bass_attached(struct bt_bass *bass, void *user_data)
 
 static void bass_handle_bcode_req(struct bass_assistant *assistant, int id)
 {
-	struct bt_bass_bcast_audio_scan_cp_hdr hdr;
 	struct bt_bass_set_bcast_code_params params;
-	struct iovec iov = {0};
-	int err;
+	struct iovec iov;
 
 	assistant_set_state(assistant, ASSISTANT_STATE_REQUESTING);
 
-	hdr.op = BT_BASS_SET_BCAST_CODE;
-
 	params.id = id;
 	memcpy(params.bcast_code, assistant->qos.bcast.bcode,
 					BT_BASS_BCAST_CODE_SIZE);
 
-	iov.iov_base = malloc0(sizeof(params));
-	if (!iov.iov_base)
-		return;
+	iov.iov_base = &params;
+	iov.iov_len = sizeof(params);
 
-	util_iov_push_mem(&iov, sizeof(params), &params);
-
-	err = bt_bass_send(assistant->data->bass, &hdr, &iov);
-	if (err) {
-		DBG("Unable to send BASS Write Command");
-		return;
-	}
-
-	free(iov.iov_base);
+	op_queue_push(assistant, BT_BASS_SET_BCAST_CODE, &iov, NULL);
 }
 
 static void bass_src_changed(uint8_t id, uint32_t bid, uint8_t enc,
@@ -22,8 +22,10 @@
 #include <stdbool.h>
 #include <sys/ioctl.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <limits.h>
 
 #include <glib.h>
@@ -68,6 +70,8 @@
 #include "adv_monitor.h"
 #include "eir.h"
 #include "battery.h"
+#include "set.h"
+#include "settings.h"
 
 #define MODE_OFF		0x00
 #define MODE_CONNECTABLE	0x01
@@ -75,6 +79,17 @@
 #define MODE_UNKNOWN		0xff
 
 #define CONN_SCAN_TIMEOUT (3)
+
+/* Host side duplicate filter for active discovery. Reports for the same
+ * device are only processed again once their data changes, the RSSI has
+ * moved far enough for a client to notice, or DUP_CACHE_TIMEOUT passed.
+ * Each client has its own RSSI threshold, the smallest one applies.
+ */
+#define DUP_CACHE_SETS		64
+#define DUP_CACHE_WAYS		4
+#define DUP_CACHE_TIMEOUT	1000000		/* usec */
+#define DUP_RSSI_DELTA		8		/* same as device RSSI updates */
+#define DUP_RSSI_DELTA_FILTER	1		/* RSSI or pathloss filter */
 #define IDLE_DISCOV_TIMEOUT (5)
 #define TEMP_DEV_TIMEOUT (3 * 60)
 #define BONDING_TIMEOUT (2 * 60)
@@ -216,6 +231,17 @@ struct discovery_filter {
 	bool discoverable;
 };
 
+struct dup_entry {
+	bdaddr_t bdaddr;
+	uint8_t bdaddr_type;
+	int8_t rssi;
+	uint8_t len;
+	uint32_t flags;
+	uint32_t hash;
+	int64_t time;
+	bool has_data;		/* manufacturer, service or other data */
+};
+
 struct discovery_client {
 	struct btd_adapter *adapter;
 	DBusMessage *msg;
@@ -301,12 +327,18 @@ struct btd_adapter {
 	struct discovery_client *client;	/* active discovery client */
 
 	GSList *discovery_found;	/* list of found devices */
+	struct dup_entry *dup_cache;	/* recently processed reports */
+	uint8_t dup_rssi_delta;		/* smallest client RSSI delta */
+	bool dup_data;			/* a client wants duplicate data */
 	unsigned int discovery_idle_timeout; /* timeout between discovery
 					      * runs
 					      */
 	unsigned int passive_scan_timeout; /* timeout between passive scans */
 
 	unsigned int pairable_timeout_id;	/* pairable timeout id */
+	struct device_snapshot *snapshot;	/* mapped device files */
+	unsigned int snapshot_id;	/* pending snapshot refresh */
+	GSList *snapshot_changed;	/* addresses of changed devices */
 	guint auth_idle_id;		/* Pending authorization dequeue */
 	GQueue *auths;			/* Ongoing and pending auths */
 	bool pincode_requested;		/* PIN requested during last bonding */
@@ -1694,12 +1726,108 @@ static void invalidate_rssi_and_tx_power(gpointer a)
 	device_set_tx_power(dev, 127);
 }
 
+static void dup_cache_flush(struct btd_adapter *adapter)
+{
+	if (!adapter->dup_cache)
+		return;
+
+	memset(adapter->dup_cache, 0, sizeof(*adapter->dup_cache) *
+					DUP_CACHE_SETS * DUP_CACHE_WAYS);
+}
+
+static uint32_t dup_hash(const void *data, size_t len, uint32_t hash)
+{
+	const uint8_t *p = data;
+	size_t i;
+
+	/* FNV-1a */
+	for (i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+/* Returns true if the report would not change anything for any of the
+ * discovery clients and so can be dropped before being parsed. Otherwise
+ * *update is set to the cache entry of a newly processed report, so that
+ * the caller can record whether it carried data.
+ */
+static bool dup_cache_filter(struct btd_adapter *adapter,
+				const bdaddr_t *bdaddr, uint8_t bdaddr_type,
+				int8_t rssi, uint32_t flags,
+				const uint8_t *data, uint8_t data_len,
+				struct dup_entry **update)
+{
+	struct dup_entry *set, *entry = NULL;
+	uint32_t hash;
+	int64_t now;
+	int delta;
+	int i;
+
+	*update = NULL;
+
+	if (!adapter->dup_cache)
+		adapter->dup_cache = new0(struct dup_entry,
+					DUP_CACHE_SETS * DUP_CACHE_WAYS);
+
+	hash = dup_hash(bdaddr, sizeof(*bdaddr), 2166136261u);
+	hash = dup_hash(&bdaddr_type, sizeof(bdaddr_type), hash);
+	set = &adapter->dup_cache[(hash % DUP_CACHE_SETS) * DUP_CACHE_WAYS];
+
+	hash = dup_hash(data, data_len, 2166136261u);
+	now = g_get_monotonic_time();
+
+	for (i = 0; i < DUP_CACHE_WAYS; i++) {
+		if (set[i].time && set[i].bdaddr_type == bdaddr_type &&
+				!bacmp(&set[i].bdaddr, bdaddr)) {
+			entry = &set[i];
+			break;
+		}
+
+		/* Otherwise replace the least recently processed entry */
+		if (!entry || set[i].time < entry->time)
+			entry = &set[i];
+	}
+
+	if (entry->time && entry->bdaddr_type == bdaddr_type &&
+					!bacmp(&entry->bdaddr, bdaddr)) {
+		delta = abs(rssi - entry->rssi);
+
+		if (entry->hash == hash && entry->len == data_len &&
+				entry->flags == flags &&
+				now - entry->time < DUP_CACHE_TIMEOUT &&
+				delta < adapter->dup_rssi_delta) {
+			/* Only clients asking for duplicate data need to
+			 * see the repeated data again, reports without
+			 * any are still dropped for everyone.
+			 */
+			return !(adapter->dup_data && entry->has_data);
+		}
+	}
+
+	bacpy(&entry->bdaddr, bdaddr);
+	entry->bdaddr_type = bdaddr_type;
+	entry->rssi = rssi;
+	entry->len = data_len;
+	entry->flags = flags;
+	entry->hash = hash;
+	entry->time = now;
+	entry->has_data = false;
+	*update = entry;
+
+	return false;
+}
+
 static void discovery_cleanup(struct btd_adapter *adapter, int timeout)
 {
 	GSList *l, *next;
 
 	adapter->discovery_type = 0x00;
 
+	dup_cache_flush(adapter);
+
 	if (adapter->discovery_idle_timeout > 0) {
 		timeout_remove(adapter->discovery_idle_timeout);
 		adapter->discovery_idle_timeout = 0;
@@ -2358,12 +2486,46 @@ static bool filters_equal(struct mgmt_cp_start_service_discovery *a,
 	return true;
 }
 
+static uint8_t discovery_client_rssi_delta(struct discovery_client *client)
+{
+	struct discovery_filter *filter = client->discovery_filter;
+
+	/* A client filtering on RSSI or pathloss needs to see every change
+	 * to tell when a device crosses its threshold.
+	 */
+	if (filter && (filter->rssi != DISTANCE_VAL_INVALID ||
+				filter->pathloss != DISTANCE_VAL_INVALID))
+		return DUP_RSSI_DELTA_FILTER;
+
+	return DUP_RSSI_DELTA;
+}
+
 static int update_discovery_filter(struct btd_adapter *adapter)
 {
 	struct mgmt_cp_start_service_discovery *sd_cp;
+	uint8_t rssi_delta;
+	GSList *l;
 
 	DBG("");
 
+	/* The most permissive client sets what the duplicate filter drops */
+	adapter->dup_rssi_delta = DUP_RSSI_DELTA;
+	adapter->dup_data = false;
+
+	for (l = adapter->discovery_list; l; l = g_slist_next(l)) {
+		struct discovery_client *client = l->data;
+
+		rssi_delta = discovery_client_rssi_delta(client);
+		if (rssi_delta < adapter->dup_rssi_delta)
+			adapter->dup_rssi_delta = rssi_delta;
+
+		if (client->discovery_filter &&
+				client->discovery_filter->duplicate)
+			adapter->dup_data = true;
+	}
+
+	dup_cache_flush(adapter);
+
 	if (discovery_filter_to_mgmt_cp(adapter, &sd_cp)) {
 		btd_error(adapter->dev_id,
 				"discovery_filter_to_mgmt_cp returned error");
@@ -2374,8 +2536,6 @@ static int update_discovery_filter(struct btd_adapter *adapter)
 	 * discoverable.
 	 */
 	if (!(adapter->current_settings & MGMT_SETTING_DISCOVERABLE)) {
-		GSList *l;
-
 		for (l = adapter->discovery_list; l; l = g_slist_next(l)) {
 			struct discovery_client *client = l->data;
 
@@ -4907,6 +5067,469 @@ done:
 	mgmt_tlv_list_free(list);
 }
 
+/*
+ * Device snapshot
+ *
+ * The files stored for every remote device (its info and attributes files
+ * and its cache file, which also holds its GATT database) are consolidated
+ * into a single checksummed file, so that they can be read with one mmap
+ * instead of opening and reading thousands of small files. Each entry
+ * records the mtime of the file it copies, a stale entry is ignored and the
+ * file read instead.
+ *
+ * The snapshot stays mapped while the adapter exists, so GATT databases
+ * loaded on connection are read from it as well. It is regenerated when
+ * loading devices found stale entries, and shortly after device info is
+ * stored or a device is removed. Only the files of those devices are read
+ * again then, the entries of all others are copied from the mapping.
+ */
+#define SNAPSHOT_MAGIC		0x534e5342	/* "BSNS" */
+#define SNAPSHOT_VERSION	2
+#define SNAPSHOT_NAME_LEN	32
+#define SNAPSHOT_DELAY		1
+
+struct snapshot_hdr {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;
+	uint32_t checksum;
+} __packed;
+
+struct snapshot_entry {
+	char name[SNAPSHOT_NAME_LEN];	/* relative to the storage directory */
+	uint64_t mtime_sec;
+	uint32_t mtime_nsec;
+	uint32_t len;
+	uint8_t data[];
+} __packed;
+
+struct snapshot_item {
+	char name[SNAPSHOT_NAME_LEN];
+	struct timespec mtime;
+	const char *data;
+	size_t len;
+	char *owned;
+};
+
+struct device_snapshot {
+	void *map;
+	size_t map_len;
+	GHashTable *entries;
+	GSList *items;
+	unsigned int count;
+	bool dirty;
+};
+
+static uint32_t snapshot_checksum(const uint8_t *data, size_t len)
+{
+	uint32_t hash = 0x811c9dc5;
+	size_t i;
+
+	/* FNV-1a */
+	for (i = 0; i < len; i++) {
+		hash ^= data[i];
+		hash *= 0x01000193;
+	}
+
+	return hash;
+}
+
+static struct device_snapshot *snapshot_open(struct btd_adapter *adapter)
+{
+	struct device_snapshot *snap;
+	char filename[PATH_MAX];
+	const struct snapshot_hdr *hdr;
+	struct stat st;
+	size_t offset;
+	uint32_t i;
+	void *map;
+	int fd;
+
+	snap = g_new0(struct device_snapshot, 1);
+	snap->entries = g_hash_table_new(g_str_hash, g_str_equal);
+	snap->dirty = true;
+
+	create_filename(filename, PATH_MAX, "/%s/snapshot",
+				btd_adapter_get_storage_dir(adapter));
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return snap;
+
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return snap;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return snap;
+
+	snap->map = map;
+	snap->map_len = st.st_size;
+
+	hdr = map;
+	if (le32_to_cpu(hdr->magic) != SNAPSHOT_MAGIC ||
+			le32_to_cpu(hdr->version) != SNAPSHOT_VERSION ||
+			le32_to_cpu(hdr->checksum) !=
+				snapshot_checksum(map + sizeof(*hdr),
+						st.st_size - sizeof(*hdr))) {
+		DBG("Discarding invalid snapshot %s", filename);
+		return snap;
+	}
+
+	snap->dirty = false;
+	offset = sizeof(*hdr);
+
+	for (i = 0; i < le32_to_cpu(hdr->count); i++) {
+		struct snapshot_entry *entry = map + offset;
+
+		if (offset + sizeof(*entry) > snap->map_len ||
+				offset + sizeof(*entry) +
+				le32_to_cpu(entry->len) > snap->map_len ||
+				entry->name[SNAPSHOT_NAME_LEN - 1] != '\0') {
+			snap->dirty = true;
+			break;
+		}
+
+		g_hash_table_insert(snap->entries, entry->name, entry);
+		offset += sizeof(*entry) + le32_to_cpu(entry->len);
+	}
+
+	snap->count = g_hash_table_size(snap->entries);
+
+	return snap;
+}
+
+static void snapshot_item_free(void *data)
+{
+	struct snapshot_item *item = data;
+
+	g_free(item->owned);
+	g_free(item);
+}
+
+static void snapshot_free(struct device_snapshot *snap)
+{
+	if (!snap)
+		return;
+
+	g_slist_free_full(snap->items, snapshot_item_free);
+	g_hash_table_destroy(snap->entries);
+
+	if (snap->map)
+		munmap(snap->map, snap->map_len);
+
+	g_free(snap);
+}
+
+static const struct snapshot_entry *snapshot_lookup(
+					struct device_snapshot *snap,
+					const char *name,
+					const struct stat *st)
+{
+	const struct snapshot_entry *entry;
+
+	entry = g_hash_table_lookup(snap->entries, name);
+	if (!entry)
+		return NULL;
+
+	if (le64_to_cpu(entry->mtime_sec) != (uint64_t) st->st_mtim.tv_sec ||
+			le32_to_cpu(entry->mtime_nsec) !=
+					(uint32_t) st->st_mtim.tv_nsec)
+		return NULL;
+
+	return entry;
+}
+
+/* Adds the current contents of a device file to the snapshot to be stored,
+ * taken from the mapped snapshot while it is up to date, and optionally
+ * loads them into key_file.
+ */
+static gboolean snapshot_add_file(struct btd_adapter *adapter,
+					struct device_snapshot *snap,
+					const char *name, GKeyFile *key_file,
+					GError **gerr)
+{
+	const struct snapshot_entry *entry;
+	struct snapshot_item *item;
+	char filename[PATH_MAX];
+	struct stat st;
+	gchar *data = NULL;
+	gsize len = 0;
+
+	create_filename(filename, PATH_MAX, "/%s/%s",
+				btd_adapter_get_storage_dir(adapter), name);
+
+	/* A removed file is noticed by the entry count */
+	if (stat(filename, &st) < 0) {
+		g_set_error(gerr, G_FILE_ERROR, g_file_error_from_errno(errno),
+						"%s", strerror(errno));
+		return FALSE;
+	}
+
+	entry = snapshot_lookup(snap, name, &st);
+	if (entry) {
+		data = (gchar *) entry->data;
+		len = le32_to_cpu(entry->len);
+	} else {
+		snap->dirty = true;
+
+		if (!g_file_get_contents(filename, &data, &len, gerr))
+			return FALSE;
+	}
+
+	item = g_new0(struct snapshot_item, 1);
+	strncpy(item->name, name, sizeof(item->name) - 1);
+	item->mtime = st.st_mtim;
+	item->data = data;
+	item->len = len;
+	item->owned = entry ? NULL : data;
+	snap->items = g_slist_prepend(snap->items, item);
+
+	if (!key_file)
+		return TRUE;
+
+	return g_key_file_load_from_data(key_file, data, len, 0, gerr);
+}
+
+static void snapshot_add_device(struct btd_adapter *adapter,
+					struct device_snapshot *snap,
+					const char *address)
+{
+	char name[SNAPSHOT_NAME_LEN];
+
+	snprintf(name, sizeof(name), "%s/attributes", address);
+	snapshot_add_file(adapter, snap, name, NULL, NULL);
+
+	snprintf(name, sizeof(name), "cache/%s", address);
+	snapshot_add_file(adapter, snap, name, NULL, NULL);
+}
+
+static GKeyFile *snapshot_load_info(struct btd_adapter *adapter,
+					struct device_snapshot *snap,
+					const char *address)
+{
+	char name[SNAPSHOT_NAME_LEN];
+	GKeyFile *key_file;
+	GError *gerr = NULL;
+
+	key_file = g_key_file_new();
+
+	snprintf(name, sizeof(name), "%s/info", address);
+
+	if (!snapshot_add_file(adapter, snap, name, key_file, &gerr)) {
+		error("Unable to load key file from %s: (%s)", name,
+								gerr->message);
+		g_clear_error(&gerr);
+	}
+
+	snapshot_add_device(adapter, snap, address);
+
+	return key_file;
+}
+
+static void snapshot_store(struct btd_adapter *adapter,
+					struct device_snapshot *snap)
+{
+	char filename[PATH_MAX], tmp[PATH_MAX];
+	struct snapshot_hdr *hdr;
+	struct iovec iov = {};
+	GSList *l;
+	int fd;
+
+	util_iov_append(&iov, NULL, sizeof(*hdr));
+
+	for (l = snap->items; l; l = g_slist_next(l)) {
+		struct snapshot_item *item = l->data;
+		struct snapshot_entry entry;
+
+		memset(&entry, 0, sizeof(entry));
+		memcpy(entry.name, item->name, sizeof(entry.name));
+		entry.mtime_sec = cpu_to_le64(item->mtime.tv_sec);
+		entry.mtime_nsec = cpu_to_le32(item->mtime.tv_nsec);
+		entry.len = cpu_to_le32(item->len);
+
+		util_iov_append(&iov, &entry, sizeof(entry));
+		util_iov_append(&iov, item->data, item->len);
+	}
+
+	hdr = iov.iov_base;
+	hdr->magic = cpu_to_le32(SNAPSHOT_MAGIC);
+	hdr->version = cpu_to_le32(SNAPSHOT_VERSION);
+	hdr->count = cpu_to_le32(g_slist_length(snap->items));
+	hdr->checksum = cpu_to_le32(snapshot_checksum(iov.iov_base +
+						sizeof(*hdr),
+						iov.iov_len - sizeof(*hdr)));
+
+	create_filename(filename, PATH_MAX, "/%s/snapshot",
+				btd_adapter_get_storage_dir(adapter));
+	snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		error("Unable to create %s: %s", tmp, strerror(errno));
+		free(iov.iov_base);
+		return;
+	}
+
+	if (write(fd, iov.iov_base, iov.iov_len) != (ssize_t) iov.iov_len ||
+						rename(tmp, filename) < 0) {
+		error("Unable to write %s: %s", filename, strerror(errno));
+		unlink(tmp);
+	}
+
+	close(fd);
+	free(iov.iov_base);
+}
+
+/* Stores the snapshot if anything changed and maps the stored one */
+static void snapshot_close(struct btd_adapter *adapter,
+					struct device_snapshot *snap)
+{
+	/* Regenerate if anything was stale or a file has been removed */
+	if (snap->dirty || snap->count != g_slist_length(snap->items))
+		snapshot_store(adapter, snap);
+
+	snapshot_free(snap);
+
+	adapter->snapshot = snapshot_open(adapter);
+}
+
+static void snapshot_add_address(struct btd_adapter *adapter,
+					struct device_snapshot *snap,
+					const char *address)
+{
+	char name[SNAPSHOT_NAME_LEN];
+
+	snprintf(name, sizeof(name), "%s/info", address);
+	snapshot_add_file(adapter, snap, name, NULL, NULL);
+	snapshot_add_device(adapter, snap, address);
+}
+
+/* Keeps a mapped entry unless it belongs to a device that has changed */
+static void snapshot_keep_entry(gpointer key, gpointer value,
+							gpointer user_data)
+{
+	struct btd_adapter *adapter = user_data;
+	struct snapshot_entry *entry = value;
+	struct snapshot_item *item;
+	char address[18];
+
+	if (g_str_has_prefix(entry->name, "cache/"))
+		strncpy(address, entry->name + 6, sizeof(address) - 1);
+	else
+		strncpy(address, entry->name, sizeof(address) - 1);
+
+	address[sizeof(address) - 1] = '\0';
+
+	if (g_slist_find_custom(adapter->snapshot_changed, address,
+							(GCompareFunc) strcmp))
+		return;
+
+	item = g_new0(struct snapshot_item, 1);
+	memcpy(item->name, entry->name, sizeof(item->name));
+	item->mtime.tv_sec = le64_to_cpu(entry->mtime_sec);
+	item->mtime.tv_nsec = le32_to_cpu(entry->mtime_nsec);
+	item->data = (const char *) entry->data;
+	item->len = le32_to_cpu(entry->len);
+	adapter->snapshot->items = g_slist_prepend(adapter->snapshot->items,
+									item);
+}
+
+static bool snapshot_refresh(gpointer user_data)
+{
+	struct btd_adapter *adapter = user_data;
+	struct device_snapshot *snap = adapter->snapshot;
+	GSList *l;
+
+	adapter->snapshot_id = 0;
+
+	if (snap->dirty) {
+		/* Nothing usable is mapped, read the files of every device */
+		for (l = adapter->devices; l; l = g_slist_next(l)) {
+			struct btd_device *device = l->data;
+			char address[18];
+
+			if (device_is_temporary(device))
+				continue;
+
+			ba2str(device_get_address(device), address);
+			snapshot_add_address(adapter, snap, address);
+		}
+	} else {
+		g_hash_table_foreach(snap->entries, snapshot_keep_entry,
+								adapter);
+
+		/* The files of a removed device are gone and not added */
+		for (l = adapter->snapshot_changed; l; l = g_slist_next(l))
+			snapshot_add_address(adapter, snap, l->data);
+
+		snap->dirty = true;
+	}
+
+	g_slist_free_full(adapter->snapshot_changed, g_free);
+	adapter->snapshot_changed = NULL;
+
+	snapshot_close(adapter, snap);
+
+	return FALSE;
+}
+
+void btd_adapter_update_snapshot(struct btd_adapter *adapter,
+						const bdaddr_t *bdaddr)
+{
+	char address[18];
+
+	if (!adapter->snapshot)
+		return;
+
+	ba2str(bdaddr, address);
+
+	if (!g_slist_find_custom(adapter->snapshot_changed, address,
+							(GCompareFunc) strcmp))
+		adapter->snapshot_changed = g_slist_prepend(
+						adapter->snapshot_changed,
+						g_strdup(address));
+
+	if (adapter->snapshot_id)
+		return;
+
+	adapter->snapshot_id = timeout_add_seconds(SNAPSHOT_DELAY,
+						snapshot_refresh, adapter,
+						NULL);
+}
+
+gboolean btd_adapter_load_key_file(struct btd_adapter *adapter,
+					const char *filename, GKeyFile *key_file,
+					GError **gerr)
+{
+	const struct snapshot_entry *entry;
+	char prefix[PATH_MAX];
+	struct stat st;
+	size_t len;
+
+	if (!adapter->snapshot)
+		goto file;
+
+	create_filename(prefix, PATH_MAX, "/%s/",
+				btd_adapter_get_storage_dir(adapter));
+	len = strlen(prefix);
+	if (strncmp(filename, prefix, len) || stat(filename, &st) < 0)
+		goto file;
+
+	entry = snapshot_lookup(adapter->snapshot, filename + len, &st);
+	if (entry)
+		return g_key_file_load_from_data(key_file,
+						(const char *) entry->data,
+						le32_to_cpu(entry->len), 0,
+						gerr);
+
+file:
+	return g_key_file_load_from_file(key_file, filename, 0, gerr);
+}
+
 static void load_devices(struct btd_adapter *adapter)
 {
 	char dirname[PATH_MAX];
@@ -4915,7 +5538,7 @@ static void load_devices(struct btd_adapter *adapter)
 	GSList *irks = NULL;
 	GSList *params = NULL;
 	GSList *added_devices = NULL;
-	GError *gerr = NULL;
+	struct device_snapshot *snap;
 	DIR *dir;
 	struct dirent *entry;
 
@@ -4930,9 +5553,13 @@ static void load_devices(struct btd_adapter *adapter)
 		return;
 	}
 
+	/* Device files loaded meanwhile are read from it too */
+	snapshot_free(adapter->snapshot);
+	adapter->snapshot = snapshot_open(adapter);
+	snap = adapter->snapshot;
+
 	while ((entry = readdir(dir)) != NULL) {
 		struct btd_device *device;
-		char filename[PATH_MAX];
 		GKeyFile *key_file;
 		struct link_key_info *key_info;
 		struct smp_ltk_info *ltk_info;
@@ -4948,16 +5575,7 @@ static void load_devices(struct btd_adapter *adapter)
 		if (entry->d_type != DT_DIR || bachk(entry->d_name) < 0)
 			continue;
 
-		create_filename(filename, PATH_MAX, "/%s/%s/info",
-					btd_adapter_get_storage_dir(adapter),
-					entry->d_name);
-
-		key_file = g_key_file_new();
-		if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
-			error("Unable to load key file from %s: (%s)", filename,
-								gerr->message);
-			g_clear_error(&gerr);
-		}
+		key_file = snapshot_load_info(adapter, snap, entry->d_name);
 
 		bdaddr_type = get_addr_type(key_file);
 
@@ -5066,6 +5684,12 @@ free:
 
 	closedir(dir);
 
+	snapshot_close(adapter, snap);
+
+	create_filename(dirname, PATH_MAX, "/%s/cache",
+				btd_adapter_get_storage_dir(adapter));
+	btd_settings_gatt_cache_gc(dirname);
+
 	load_link_keys(adapter, keys, btd_opts.debug_keys);
 	g_slist_free_full(keys, g_free);
 
@@ -5888,6 +6512,7 @@ static void adapter_free(gpointer user_data)
 	 * the adapter.
 	 */
 	remove_discovery_list(adapter);
+	free(adapter->dup_cache);
 
 	if (adapter->pairable_timeout_id > 0) {
 		timeout_remove(adapter->pairable_timeout_id);
@@ -5899,6 +6524,12 @@ static void adapter_free(gpointer user_data)
 		adapter->passive_scan_timeout = 0;
 	}
 
+	if (adapter->snapshot_id)
+		timeout_remove(adapter->snapshot_id);
+
+	g_slist_free_full(adapter->snapshot_changed, g_free);
+	snapshot_free(adapter->snapshot);
+
 	if (adapter->auth_idle_id)
 		g_source_remove(adapter->auth_idle_id);
 
@@ -7234,6 +7865,7 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	bool scan_rsp;
 	bool duplicate = false;
 	struct queue *matched_monitors = NULL;
+	struct dup_entry *dup = NULL;
 
 	confirm = (flags & MGMT_DEV_FOUND_CONFIRM_NAME);
 	legacy = (flags & MGMT_DEV_FOUND_LEGACY_PAIRING);
@@ -7263,9 +7895,21 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	if (!adapter->discovering && !monitoring)
 		return;
 
+	/* Drop repeated reports during active discovery, passive scanning
+	 * and Adv monitors still get every report.
+	 */
+	if (!monitoring && adapter->discovery_list &&
+			dup_cache_filter(adapter, bdaddr, bdaddr_type, rssi,
+						flags, data, data_len, &dup))
+		return;
+
 	memset(&eir_data, 0, sizeof(eir_data));
 	eir_parse(&eir_data, data, data_len);
 
+	if (dup)
+		dup->has_data = eir_data.msd_list || eir_data.sd_list ||
+							eir_data.data_list;
+
 	ba2str(bdaddr, addr);
 
 	discoverable = device_is_discoverable(adapter, &eir_data, addr,
@@ -7393,6 +8037,10 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	if (eir_data.data_list)
 		device_set_data(dev, eir_data.data_list, duplicate);
 
+	/* Resolve RSI against known sets as soon as it is advertised */
+	if (eir_data.rsi)
+		btd_set_device_found(dev);
+
 	if (bdaddr_type != BDADDR_BREDR)
 		device_set_flags(dev, eir_data.flags);
 
@@ -99,6 +99,11 @@ const char *adapter_get_path(struct btd_adapter *adapter);
 const bdaddr_t *btd_adapter_get_address(struct btd_adapter *adapter);
 uint8_t btd_adapter_get_address_type(struct btd_adapter *adapter);
 const char *btd_adapter_get_storage_dir(struct btd_adapter *adapter);
+gboolean btd_adapter_load_key_file(struct btd_adapter *adapter,
+					const char *filename, GKeyFile *key_file,
+					GError **gerr);
+void btd_adapter_update_snapshot(struct btd_adapter *adapter,
+						const bdaddr_t *bdaddr);
 int adapter_set_name(struct btd_adapter *adapter, const char *name);
 
 int adapter_service_add(struct btd_adapter *adapter, sdp_record_t *rec);
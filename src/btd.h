@@ -119,6 +119,7 @@ struct btd_opts {
 	bool		device_privacy;
 	uint32_t	name_request_retry_delay;
 	uint8_t		secure_conn;
+	uint8_t		max_connecting;
 
 	struct btd_defaults defaults;
 
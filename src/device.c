@@ -134,6 +134,8 @@ struct browse_req {
 	int reconnect_attempt;
 	guint listener_id;
 	uint16_t sdp_flags;
+	bool has_db_state;
+	uint32_t db_state;
 };
 
 struct included_search {
@@ -235,6 +237,7 @@ struct btd_device {
 	GSList		*primaries;		/* List of primary services */
 	GSList		*services;		/* List of btd_service */
 	GSList		*pending;		/* Pending services */
+	GSList		*connecting;		/* Services being connected */
 	GSList		*watches;		/* List of disconnect_data */
 	bool		temporary;
 	bool		connectable;
@@ -303,6 +306,7 @@ static const uint16_t uuid_list[] = {
 
 static int device_browse_gatt(struct btd_device *device, DBusMessage *msg);
 static int device_browse_sdp(struct btd_device *device, DBusMessage *msg);
+static int device_refresh_sdp(struct btd_device *device);
 
 static struct bearer_state *get_state(struct btd_device *dev,
 							uint8_t bdaddr_type)
@@ -545,6 +549,8 @@ static gboolean store_device_info_cb(gpointer user_data)
 	g_key_file_free(key_file);
 	g_free(uuids);
 
+	btd_adapter_update_snapshot(device->adapter, &device->bdaddr);
+
 	return FALSE;
 }
 
@@ -813,6 +819,8 @@ static void device_free(gpointer user_data)
 	g_slist_free_full(device->uuids, g_free);
 	g_slist_free_full(device->primaries, g_free);
 	g_slist_free_full(device->svc_callbacks, svc_dev_remove);
+	g_slist_free(device->pending);
+	g_slist_free(device->connecting);
 
 	/* Reset callbacks since the device is going to be freed */
 	gatt_db_unregister(device->db, device->db_id);
@@ -1748,6 +1756,11 @@ int device_block(struct btd_device *device, gboolean update_only)
 
 	disconnect_all(device);
 
+	g_slist_free(device->pending);
+	device->pending = NULL;
+	g_slist_free(device->connecting);
+	device->connecting = NULL;
+
 	while (device->services != NULL) {
 		struct btd_service *service = device->services->data;
 
@@ -1871,6 +1884,8 @@ void device_request_disconnect(struct btd_device *device, DBusMessage *msg)
 
 	g_slist_free(device->pending);
 	device->pending = NULL;
+	g_slist_free(device->connecting);
+	device->connecting = NULL;
 
 	while (device->watches) {
 		struct btd_disconnect_data *data = device->watches->data;
@@ -2113,28 +2128,80 @@ static DBusMessage *dev_disconnect(DBusConnection *conn, DBusMessage *msg,
 	return NULL;
 }
 
+static bool service_has_pending_deps(struct btd_device *dev,
+						struct btd_service *service)
+{
+	struct btd_profile *p = btd_service_get_profile(service);
+	const char **uuid;
+	GSList *l;
+
+	for (uuid = p->after_services; uuid && *uuid; uuid++) {
+		for (l = dev->pending; l; l = g_slist_next(l)) {
+			p = btd_service_get_profile(l->data);
+			if (!bt_uuid_strcmp(p->remote_uuid, *uuid))
+				return true;
+		}
+
+		for (l = dev->connecting; l; l = g_slist_next(l)) {
+			p = btd_service_get_profile(l->data);
+			if (!bt_uuid_strcmp(p->remote_uuid, *uuid))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+static int connect_service(struct btd_device *dev, GSList *l)
+{
+	struct btd_service *service = l->data;
+	int err;
+
+	dev->pending = g_slist_delete_link(dev->pending, l);
+
+	err = btd_service_connect(service);
+	if (!err)
+		dev->connecting = g_slist_append(dev->connecting, service);
+
+	return err;
+}
+
+/* Start connecting pending services, up to MaxConnectingProfiles at once.
+ * Services are picked in priority order skipping those whose dependencies
+ * are still pending or connecting.
+ */
 static int connect_next(struct btd_device *dev)
 {
-	struct btd_service *service;
+	GSList *l, *next;
 	int err = -ENOENT;
 
-	while (dev->pending) {
-		service = dev->pending->data;
+	for (l = dev->pending; l; l = next) {
+		next = g_slist_next(l);
 
-		err = btd_service_connect(service);
-		if (!err)
-			return 0;
+		if (g_slist_length(dev->connecting) >= btd_opts.max_connecting)
+			break;
+
+		if (service_has_pending_deps(dev, l->data))
+			continue;
 
-		dev->pending = g_slist_delete_link(dev->pending, dev->pending);
+		err = connect_service(dev, l);
 	}
 
+	/* Dependencies can only be waited on while something is in progress,
+	 * otherwise fallback to connecting in priority order.
+	 */
+	while (!dev->connecting && dev->pending)
+		err = connect_service(dev, dev->pending);
+
+	if (dev->connecting)
+		return 0;
+
 	return err;
 }
 
 static void device_profile_connected(struct btd_device *dev,
 					struct btd_profile *profile, int err)
 {
-	struct btd_service *pending;
 	GSList *l;
 
 	DBG("%s %s (%d)", profile->name, strerror(-err), -err);
@@ -2142,7 +2209,7 @@ static void device_profile_connected(struct btd_device *dev,
 	if (!err)
 		btd_device_set_temporary(dev, false);
 
-	if (dev->pending == NULL)
+	if (dev->pending == NULL && dev->connecting == NULL)
 		goto done;
 
 	if (!btd_device_is_connected(dev)) {
@@ -2154,18 +2221,21 @@ static void device_profile_connected(struct btd_device *dev,
 		}
 	}
 
+	l = find_service_with_profile(dev->connecting, profile);
+	if (l == NULL) {
+		/* Not started by us, e.g. connected by the remote, so just
+		 * drop it from pending. Only continue connecting if nothing
+		 * else is in progress, otherwise it will trigger another
+		 * connect once that completes.
+		 */
+		l = find_service_with_profile(dev->pending, profile);
+		if (l != NULL)
+			dev->pending = g_slist_delete_link(dev->pending, l);
 
-	pending = dev->pending->data;
-	l = find_service_with_profile(dev->pending, profile);
-	if (l != NULL)
-		dev->pending = g_slist_delete_link(dev->pending, l);
-
-	/* Only continue connecting the next profile if it matches the first
-	 * pending, otherwise it will trigger another connect to the same
-	 * profile
-	 */
-	if (profile != btd_service_get_profile(pending))
-		return;
+		if (dev->connecting)
+			return;
+	} else
+		dev->connecting = g_slist_delete_link(dev->connecting, l);
 
 	if (connect_next(dev) == 0)
 		return;
@@ -2173,6 +2243,8 @@ static void device_profile_connected(struct btd_device *dev,
 done:
 	g_slist_free(dev->pending);
 	dev->pending = NULL;
+	g_slist_free(dev->connecting);
+	dev->connecting = NULL;
 
 	if (!dev->connect)
 		return;
@@ -2203,7 +2275,7 @@ done:
 	} else {
 		/* Start passive SDP discovery to update known services */
 		if (dev->bredr && !dev->svc_refreshed && dev->refresh_discovery)
-			device_browse_sdp(dev, NULL);
+			device_refresh_sdp(dev);
 		g_dbus_send_reply(dbus_conn, dev->connect, DBUS_TYPE_INVALID);
 	}
 
@@ -2431,7 +2503,7 @@ int btd_device_connect_services(struct btd_device *dev, GSList *services)
 {
 	GSList *l;
 
-	if (dev->pending || dev->connect || dev->browse)
+	if (dev->pending || dev->connecting || dev->connect || dev->browse)
 		return -EBUSY;
 
 	if (!btd_adapter_get_powered(dev->adapter))
@@ -2462,7 +2534,7 @@ static DBusMessage *connect_profiles(struct btd_device *dev, uint8_t bdaddr_type
 	DBG("%s %s, client %s", dev->path, uuid ? uuid : "(all)",
 						dbus_message_get_sender(msg));
 
-	if (dev->pending || dev->connect || dev->browse)
+	if (dev->pending || dev->connecting || dev->connect || dev->browse)
 		return btd_error_in_progress_str(msg, ERR_BREDR_CONN_BUSY);
 
 	if (!btd_adapter_get_powered(dev->adapter)) {
@@ -3595,7 +3667,8 @@ static char *load_cached_name(struct btd_device *device, const char *local,
 
 	key_file = g_key_file_new();
 
-	if (!g_key_file_load_from_file(key_file, filename, 0, NULL))
+	if (!btd_adapter_load_key_file(device->adapter, filename, key_file,
+									NULL))
 		goto failed;
 
 	str = g_key_file_get_string(key_file, "General", "Name", NULL);
@@ -3625,7 +3698,8 @@ static void load_cached_name_resolve(struct btd_device *device,
 
 	key_file = g_key_file_new();
 
-	if (!g_key_file_load_from_file(key_file, filename, 0, NULL))
+	if (!btd_adapter_load_key_file(device->adapter, filename, key_file,
+									NULL))
 		goto failed;
 
 	failed_time = g_key_file_get_uint64(key_file, "NameResolving",
@@ -3946,7 +4020,8 @@ static void load_att_info(struct btd_device *device, const char *local,
 		return;
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_adapter_load_key_file(device->adapter, filename, key_file,
+								&gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -4052,6 +4127,7 @@ static void load_gatt_db(struct btd_device *device, const char *local,
 							const char *peer)
 {
 	char filename[PATH_MAX];
+	GKeyFile *key_file;
 	int err;
 
 	if (!gatt_cache_is_enabled(device))
@@ -4061,7 +4137,11 @@ static void load_gatt_db(struct btd_device *device, const char *local,
 
 	create_filename(filename, PATH_MAX, "/%s/cache/%s", local, peer);
 
-	err = btd_settings_gatt_db_load(device->db, filename);
+	key_file = g_key_file_new();
+	btd_adapter_load_key_file(device->adapter, filename, key_file, NULL);
+
+	err = btd_settings_gatt_db_load(device->db, filename, key_file);
+	g_key_file_free(key_file);
 	if (err < 0) {
 		if (err == -ENOENT)
 			return;
@@ -4199,6 +4279,7 @@ static void device_remove_gatt_service(struct btd_device *device,
 	service = l->data;
 	device->services = g_slist_delete_link(device->services, l);
 	device->pending = g_slist_remove(device->pending, service);
+	device->connecting = g_slist_remove(device->connecting, service);
 	service_remove(service);
 }
 
@@ -4793,6 +4874,8 @@ static void device_remove_stored(struct btd_device *device)
 				device_addr);
 	delete_folder_tree(filename);
 
+	btd_adapter_update_snapshot(device->adapter, &device->bdaddr);
+
 	create_filename(filename, PATH_MAX, "/%s/cache/%s",
 				btd_adapter_get_storage_dir(device->adapter),
 				device_addr);
@@ -4805,6 +4888,7 @@ static void device_remove_stored(struct btd_device *device)
 	}
 	g_key_file_remove_group(key_file, "ServiceRecords", NULL);
 	g_key_file_remove_group(key_file, "Attributes", NULL);
+	g_key_file_remove_group(key_file, "GattCache", NULL);
 
 	data = g_key_file_to_data(key_file, &length, NULL);
 	if (length > 0) {
@@ -4843,6 +4927,11 @@ void device_remove(struct btd_device *device, gboolean remove_stored)
 	if (device->browse)
 		browse_request_cancel(device->browse);
 
+	g_slist_free(device->pending);
+	device->pending = NULL;
+	g_slist_free(device->connecting);
+	device->connecting = NULL;
+
 	while (device->services != NULL) {
 		struct btd_service *service = device->services->data;
 
@@ -4850,9 +4939,6 @@ void device_remove(struct btd_device *device, gboolean remove_stored)
 		service_remove(service);
 	}
 
-	g_slist_free(device->pending);
-	device->pending = NULL;
-
 	if (btd_device_is_connected(device)) {
 		if (device->disconn_timer > 0)
 			timeout_remove(device->disconn_timer);
@@ -5068,6 +5154,7 @@ void device_remove_profile(gpointer a, gpointer b)
 	service = l->data;
 	device->services = g_slist_delete_link(device->services, l);
 	device->pending = g_slist_remove(device->pending, service);
+	device->connecting = g_slist_remove(device->connecting, service);
 	service_remove(service);
 }
 
@@ -5242,11 +5329,22 @@ static void update_bredr_services(struct browse_req *req, sdp_list_t *recs)
 
 	for (seq = recs; seq; seq = seq->next) {
 		sdp_record_t *rec = (sdp_record_t *) seq->data;
+		sdp_data_t *state;
 		char *profile_uuid;
 
 		if (!rec)
 			break;
 
+		/* Remember the state of the remote SDP database so records
+		 * can be revalidated without browsing again.
+		 */
+		state = rec->handle ? NULL :
+				sdp_data_get(rec, SDP_ATTR_SVCDB_STATE);
+		if (state && state->dtd == SDP_UINT32) {
+			req->has_db_state = true;
+			req->db_state = state->val.uint32;
+		}
+
 		/* If service class attribute is missing, svclass will be all
 		 * zero and the resulting uuid string will be NULL.
 		 */
@@ -5320,6 +5418,82 @@ next:
 	}
 }
 
+static bool read_sdp_db_state(struct btd_device *device, uint32_t *state)
+{
+	char local[18], peer[18];
+	char filename[PATH_MAX];
+	GKeyFile *key_file;
+	GError *gerr = NULL;
+	bool ret = false;
+	char *str;
+
+	ba2str(btd_adapter_get_address(device->adapter), local);
+	ba2str(&device->bdaddr, peer);
+
+	create_filename(filename, PATH_MAX, "/%s/cache/%s", local, peer);
+
+	key_file = g_key_file_new();
+	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+		g_error_free(gerr);
+		g_key_file_free(key_file);
+		return false;
+	}
+
+	str = g_key_file_get_string(key_file, "ServiceDatabase", "State", NULL);
+	if (str && sscanf(str, "0x%8x", state) == 1)
+		ret = true;
+
+	g_free(str);
+	g_key_file_free(key_file);
+
+	return ret;
+}
+
+static void store_sdp_db_state(struct btd_device *device,
+						struct browse_req *req)
+{
+	char local[18], peer[18];
+	char filename[PATH_MAX];
+	GKeyFile *key_file;
+	GError *gerr = NULL;
+	char state[11];
+	char *data;
+	gsize length = 0;
+
+	if (device->temporary)
+		return;
+
+	ba2str(btd_adapter_get_address(device->adapter), local);
+	ba2str(&device->bdaddr, peer);
+
+	create_filename(filename, PATH_MAX, "/%s/cache/%s", local, peer);
+	create_file(filename, 0600);
+
+	key_file = g_key_file_new();
+	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+		error("Unable to load key file from %s: (%s)", filename,
+								gerr->message);
+		g_clear_error(&gerr);
+	}
+
+	if (req->has_db_state) {
+		sprintf(state, "0x%8.8X", req->db_state);
+		g_key_file_set_string(key_file, "ServiceDatabase", "State",
+									state);
+	} else
+		g_key_file_remove_group(key_file, "ServiceDatabase", NULL);
+
+	data = g_key_file_to_data(key_file, &length, NULL);
+	if (!g_file_set_contents(filename, data, length, &gerr)) {
+		error("Unable set contents for %s: (%s)", filename,
+								gerr->message);
+		g_error_free(gerr);
+	}
+
+	g_free(data);
+	g_key_file_free(key_file);
+}
+
 static int primary_cmp(gconstpointer a, gconstpointer b)
 {
 	return memcmp(a, b, sizeof(struct gatt_primary));
@@ -5404,6 +5578,7 @@ static void search_cb(sdp_list_t *recs, int err, gpointer user_data)
 	}
 
 	update_bredr_services(req, recs);
+	store_sdp_db_state(device, req);
 
 	if (device->tmp_records)
 		sdp_list_free(device->tmp_records,
@@ -6074,6 +6249,69 @@ static int device_browse_sdp(struct btd_device *device, DBusMessage *msg)
 	return err;
 }
 
+static void db_state_cb(sdp_list_t *recs, int err, gpointer user_data)
+{
+	struct browse_req *req = user_data;
+	struct btd_device *device = req->device;
+	struct btd_adapter *adapter = device->adapter;
+	sdp_record_t *rec = recs ? recs->data : NULL;
+	sdp_data_t *state;
+	uuid_t uuid;
+
+	state = rec ? sdp_data_get(rec, SDP_ATTR_SVCDB_STATE) : NULL;
+	if (!err && state && state->dtd == SDP_UINT32 &&
+					state->val.uint32 == req->db_state) {
+		DBG("%s: service records unchanged", device->path);
+		device_svc_resolved(device, BROWSE_SDP, BDADDR_BREDR, 0);
+		return;
+	}
+
+	DBG("%s: service database changed, browsing", device->path);
+
+	req->has_db_state = false;
+
+	sdp_uuid16_create(&uuid, uuid_list[req->search_uuid++]);
+
+	err = bt_search(btd_adapter_get_address(adapter), &device->bdaddr,
+					&uuid, browse_cb, req, NULL,
+					req->sdp_flags);
+	if (err < 0)
+		device_svc_resolved(device, BROWSE_SDP, BDADDR_BREDR, err);
+}
+
+/* Revalidate stored service records using the ServiceDatabaseState of the
+ * remote SDP server, falling back to a full browse if it is not supported
+ * or has changed.
+ */
+static int device_refresh_sdp(struct btd_device *device)
+{
+	struct btd_adapter *adapter = device->adapter;
+	struct browse_req *req;
+	uint32_t state;
+	int err;
+
+	if (!device->bredr_state.svc_resolved ||
+				!read_sdp_db_state(device, &state))
+		return device_browse_sdp(device, NULL);
+
+	req = browse_request_new(device, BROWSE_SDP, NULL);
+	if (!req)
+		return -EBUSY;
+
+	req->sdp_flags = get_sdp_flags(device);
+	req->db_state = state;
+
+	err = bt_search_db_state(btd_adapter_get_address(adapter),
+					&device->bdaddr, db_state_cb, req,
+					NULL, req->sdp_flags);
+	if (err < 0) {
+		browse_request_free(req);
+		return err;
+	}
+
+	return err;
+}
+
 int device_discover_services(struct btd_device *device)
 {
 	int err;
@@ -7398,6 +7636,16 @@ static void service_state_changed(struct btd_service *service,
 	struct btd_device *device = btd_service_get_device(service);
 	int err = btd_service_get_error(service);
 
+	/* A connect aborted by a disconnect never completes, so finish it
+	 * here or it keeps holding its connecting slot.
+	 */
+	if (old_state == BTD_SERVICE_STATE_CONNECTING &&
+				new_state == BTD_SERVICE_STATE_DISCONNECTING) {
+		device_profile_connected(device, profile,
+						err ? err : -ECONNABORTED);
+		return;
+	}
+
 	if (new_state == BTD_SERVICE_STATE_CONNECTING ||
 				new_state == BTD_SERVICE_STATE_DISCONNECTING)
 		return;
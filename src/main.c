@@ -61,6 +61,7 @@
 #define DEFAULT_DISCOVERABLE_TIMEOUT     180 /* 3 minutes */
 #define DEFAULT_TEMPORARY_TIMEOUT         30 /* 30 seconds */
 #define DEFAULT_NAME_REQUEST_RETRY_DELAY 300 /* 5 minutes */
+#define DEFAULT_MAX_CONNECTING             1 /* one profile at a time */
 
 #define SHUTDOWN_GRACE_SECONDS 10
 
@@ -91,6 +92,7 @@ static const char *supported_options[] = {
 	"Testing",
 	"KernelExperimental",
 	"RemoteNameRequestRetryDelay",
+	"MaxConnectingProfiles",
 	NULL
 };
 
@@ -1045,6 +1047,9 @@ static void parse_general(GKeyFile *config)
 	parse_config_u32(config, "General", "RemoteNameRequestRetryDelay",
 					&btd_opts.name_request_retry_delay,
 					0, UINT32_MAX);
+	parse_config_u8(config, "General", "MaxConnectingProfiles",
+					&btd_opts.max_connecting,
+					1, UINT8_MAX);
 }
 
 static void parse_gatt_cache(GKeyFile *config)
@@ -1183,6 +1188,7 @@ static void init_defaults(void)
 	btd_opts.refresh_discovery = TRUE;
 	btd_opts.name_request_retry_delay = DEFAULT_NAME_REQUEST_RETRY_DELAY;
 	btd_opts.secure_conn = SC_ON;
+	btd_opts.max_connecting = DEFAULT_MAX_CONNECTING;
 
 	btd_opts.defaults.num_entries = 0;
 	btd_opts.defaults.br.page_scan_type = 0xFFFF;
@@ -22,6 +22,10 @@ struct btd_profile {
 	const char *remote_uuid;
 
 	bool auto_connect;
+	/* Remote UUIDs of the services that shall complete connecting before
+	 * this one is connected, NULL terminated.
+	 */
+	const char **after_services;
 	/* Some profiles are considered safe to be handled internally and also
 	 * be exposed in the GATT API. This flag give such profiles exception
 	 * from being claimed internally.
@@ -132,6 +132,7 @@ struct search_context {
 	uuid_t			uuid;
 	guint			io_id;
 	gboolean		filter_svc_class;
+	uint32_t		range;
 };
 
 static GSList *context_list = NULL;
@@ -237,7 +238,6 @@ static gboolean connect_watch(GIOChannel *chan, GIOCondition cond,
 {
 	struct search_context *ctxt = user_data;
 	sdp_list_t *search, *attrids;
-	uint32_t range = 0x0000ffff;
 	socklen_t len;
 	int sk, err, sk_err = 0;
 
@@ -259,7 +259,7 @@ static gboolean connect_watch(GIOChannel *chan, GIOCondition cond,
 	}
 
 	search = sdp_list_append(NULL, &ctxt->uuid);
-	attrids = sdp_list_append(NULL, &range);
+	attrids = sdp_list_append(NULL, &ctxt->range);
 	if (sdp_service_search_attr_async(ctxt->session,
 				search, SDP_ATTR_REQ_RANGE, attrids) < 0) {
 		sdp_list_free(attrids, NULL);
@@ -319,6 +319,7 @@ static int create_search_context(struct search_context **ctxt,
 	bacpy(&(*ctxt)->dst, dst);
 	(*ctxt)->session = s;
 	(*ctxt)->uuid = *uuid;
+	(*ctxt)->range = 0x0000ffff;
 
 	sk = sdp_get_socket(s);
 	/* Set low priority for the SDP connection not to interfere with
@@ -400,6 +401,35 @@ int bt_search_service(const bdaddr_t *src, const bdaddr_t *dst,
 	return 0;
 }
 
+int bt_search_db_state(const bdaddr_t *src, const bdaddr_t *dst,
+			bt_callback_t cb, void *user_data,
+			bt_destroy_t destroy, uint16_t flags)
+{
+	struct search_context *ctxt = NULL;
+	uuid_t uuid;
+	int err;
+
+	if (!cb)
+		return -EINVAL;
+
+	/* Only fetch the ServiceDatabaseState of the SDP server record, which
+	 * is enough to tell whether previously retrieved records are still
+	 * valid.
+	 */
+	sdp_uuid16_create(&uuid, SDP_SERVER_SVCLASS_ID);
+
+	err = create_search_context_full(&ctxt, src, dst, &uuid, flags,
+					user_data, cb, destroy, FALSE);
+	if (err < 0)
+		return err;
+
+	ctxt->range = (SDP_ATTR_SVCDB_STATE << 16) | SDP_ATTR_SVCDB_STATE;
+
+	context_list = g_slist_append(context_list, ctxt);
+
+	return 0;
+}
+
 static int find_by_bdaddr(gconstpointer data, gconstpointer user_data)
 {
 	const struct search_context *ctxt = data, *search = user_data;
@@ -20,6 +20,7 @@
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <errno.h>
+#include <time.h>
 
 #include <glib.h>
 
@@ -43,6 +44,7 @@ struct btd_service {
 	int			err;
 	bool			is_allowed;
 	bool			initiator;
+	struct timespec		connect_start;
 };
 
 struct service_state_callback {
@@ -92,6 +94,20 @@ static void change_state(struct btd_service *service, btd_service_state_t state,
 					addr, service->profile->name,
 					state2str(old), state2str(state), err);
 
+	/* Record connection latency of locally initiated connections */
+	if (state == BTD_SERVICE_STATE_CONNECTING)
+		clock_gettime(CLOCK_MONOTONIC, &service->connect_start);
+	else if (old == BTD_SERVICE_STATE_CONNECTING) {
+		struct timespec now;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		DBG("%p: device %s profile %s connect %s after %ld ms", service,
+			addr, service->profile->name, err ? "failed" : "done",
+			(now.tv_sec - service->connect_start.tv_sec) * 1000 +
+			(now.tv_nsec - service->connect_start.tv_nsec) /
+								1000000);
+	}
+
 	for (l = state_callbacks; l != NULL; l = g_slist_next(l)) {
 		struct service_state_callback *cb = l->data;
 
@@ -38,6 +38,10 @@
 #include "dbus-common.h"
 #include "set.h"
 
+/* Direct mapped cache of RSIs which did not resolve with any known SIRK */
+#define RSI_CACHE_SIZE		256
+#define RSI_CACHE_SLOT(_rsi)	(((_rsi)[0] ^ (_rsi)[3]) % RSI_CACHE_SIZE)
+
 static struct queue *set_list;
 
 struct btd_device_set {
@@ -47,9 +51,25 @@ struct btd_device_set {
 	uint8_t size;
 	bool auto_connect;
 	struct queue *devices;
+	struct bt_crypto_sih_key *sih;
+};
+
+struct rsi_entry {
+	struct btd_adapter *adapter;
+	uint8_t rsi[6];
+};
+
+struct rsi_batch {
+	struct btd_device_set *set;
 	struct btd_device *device;
+	struct btd_device **devices;
+	uint8_t *rsi;
+	size_t count;
+	size_t size;
 };
 
+static struct rsi_entry rsi_cache[RSI_CACHE_SIZE];
+
 static DBusMessage *set_disconnect(DBusConnection *conn, DBusMessage *msg,
 							void *user_data)
 {
@@ -168,6 +188,7 @@ static void set_free(void *data)
 	struct btd_device_set *set = data;
 
 	queue_destroy(set->devices, NULL);
+	bt_crypto_sih_key_free(set->sih);
 	g_free(set->path);
 	free(set);
 }
@@ -176,10 +197,23 @@ static struct btd_device_set *set_new(struct btd_device *device,
 					const uint8_t sirk[16], uint8_t size)
 {
 	struct btd_device_set *set;
+	struct bt_crypto *crypto;
+
+	crypto = bt_crypto_new();
+	if (!crypto)
+		return NULL;
 
 	set = new0(struct btd_device_set, 1);
 	set->adapter = device_get_adapter(device);
 	memcpy(set->sirk, sirk, sizeof(set->sirk));
+	set->sih = bt_crypto_sih_key_new(crypto, sirk);
+	bt_crypto_unref(crypto);
+	if (!set->sih) {
+		error("Unable to setup SIRK key");
+		free(set);
+		return NULL;
+	}
+
 	set->size = size;
 	set->auto_connect = true;
 	set->devices = queue_new();
@@ -258,29 +292,31 @@ done:
 		set_connect_next(set);
 }
 
-static void foreach_rsi(void *data, void *user_data)
+static bool rsi_cache_lookup(struct btd_adapter *adapter,
+						const uint8_t rsi[6])
 {
-	struct bt_ad_data *ad = data;
-	struct btd_device_set *set = user_data;
-	struct bt_crypto *crypto;
-	uint8_t res[3];
+	struct rsi_entry *entry = &rsi_cache[RSI_CACHE_SLOT(rsi)];
 
-	if (ad->type != BT_AD_CSIP_RSI || ad->len < 6)
-		return;
+	return entry->adapter == adapter && !memcmp(entry->rsi, rsi, 6);
+}
 
-	crypto = bt_crypto_new();
-	if (!crypto)
-		return;
+static void rsi_cache_add(struct btd_adapter *adapter, const uint8_t rsi[6])
+{
+	struct rsi_entry *entry = &rsi_cache[RSI_CACHE_SLOT(rsi)];
 
-	if (!bt_crypto_sih(crypto, set->sirk, ad->data + 3, res)) {
-		bt_crypto_unref(crypto);
-		return;
-	}
+	entry->adapter = adapter;
+	memcpy(entry->rsi, rsi, 6);
+}
 
-	bt_crypto_unref(crypto);
+static void rsi_cache_flush(void)
+{
+	memset(rsi_cache, 0, sizeof(rsi_cache));
+}
 
-	if (memcmp(ad->data, res, sizeof(res)))
-		return;
+static void set_member_found(struct btd_device_set *set,
+						struct btd_device *device)
+{
+	DBG("set %s RSI match %s", set->path, device_get_path(device));
 
 	/* Attempt to use existing gatt_db from set if device has never been
 	 * connected before.
@@ -288,28 +324,152 @@ static void foreach_rsi(void *data, void *user_data)
 	 * If dbs don't really match bt_gatt_client will attempt to rediscover
 	 * the ranges that don't match.
 	 */
-	if (gatt_db_isempty(btd_device_get_gatt_db(set->device))) {
-		struct btd_device *device;
+	if (gatt_db_isempty(btd_device_get_gatt_db(device))) {
+		struct btd_device *member;
 
-		device = queue_get_entries(set->devices)->data;
-		btd_device_set_gatt_db(set->device,
-					btd_device_get_gatt_db(device));
+		member = queue_get_entries(set->devices)->data;
+		btd_device_set_gatt_db(device, btd_device_get_gatt_db(member));
 	}
+}
 
-	device_connect_le(set->device);
+static void set_member_connect(void *data, void *user_data)
+{
+	device_connect_le(data);
+}
+
+static void collect_rsi(void *data, void *user_data)
+{
+	struct bt_ad_data *ad = data;
+	struct rsi_batch *batch = user_data;
+
+	if (ad->type != BT_AD_CSIP_RSI || ad->len < 6)
+		return;
+
+	/* RSIs already known not to belong to any set can be skipped */
+	if (rsi_cache_lookup(batch->set->adapter, ad->data))
+		return;
+
+	if (batch->count == batch->size) {
+		batch->size = batch->size ? batch->size * 2 : 8;
+		batch->devices = realloc(batch->devices, batch->size *
+						sizeof(*batch->devices));
+		batch->rsi = realloc(batch->rsi, batch->size * 6);
+	}
+
+	batch->devices[batch->count] = batch->device;
+	memcpy(batch->rsi + batch->count * 6, ad->data, 6);
+	batch->count++;
 }
 
 static void foreach_device(struct btd_device *device, void *data)
 {
-	struct btd_device_set *set = data;
+	struct rsi_batch *batch = data;
 
 	/* Check if device is already part of the set then skip */
-	if (queue_find(set->devices, NULL, device))
+	if (queue_find(batch->set->devices, NULL, device))
 		return;
 
-	set->device = device;
+	batch->device = device;
+
+	btd_device_foreach_ad(device, collect_rsi, batch);
+}
+
+static void set_resolve_devices(struct btd_device_set *set)
+{
+	struct rsi_batch batch;
+	struct queue *found;
+	uint8_t *prand, *hash;
+	size_t i;
+
+	memset(&batch, 0, sizeof(batch));
+	batch.set = set;
+
+	btd_adapter_for_each_device(set->adapter, foreach_device, &batch);
+
+	if (!batch.count)
+		return;
+
+	prand = new0(uint8_t, batch.count * 3);
+	hash = new0(uint8_t, batch.count * 3);
+	found = queue_new();
+
+	for (i = 0; i < batch.count; i++)
+		memcpy(prand + i * 3, batch.rsi + i * 6 + 3, 3);
+
+	/* Check every candidate against the SIRK in a single request */
+	if (bt_crypto_sih_batch(set->sih, prand, hash, batch.count)) {
+		for (i = 0; i < batch.count; i++) {
+			if (memcmp(batch.rsi + i * 6, hash + i * 3, 3))
+				continue;
+
+			/* A device may advertise more than one RSI */
+			if (queue_find(found, NULL, batch.devices[i]))
+				continue;
 
-	btd_device_foreach_ad(device, foreach_rsi, set);
+			set_member_found(set, batch.devices[i]);
+			queue_push_tail(found, batch.devices[i]);
+		}
+	}
+
+	free(hash);
+	free(prand);
+	free(batch.rsi);
+	free(batch.devices);
+
+	/* Connect once the whole batch is resolved */
+	queue_foreach(found, set_member_connect, NULL);
+	queue_destroy(found, NULL);
+}
+
+static bool set_match_rsi(struct btd_device_set *set, const uint8_t rsi[6])
+{
+	uint8_t hash[3];
+
+	if (!bt_crypto_sih_batch(set->sih, rsi + 3, hash, 1))
+		return false;
+
+	return !memcmp(rsi, hash, sizeof(hash));
+}
+
+static void resolve_rsi(void *data, void *user_data)
+{
+	struct bt_ad_data *ad = data;
+	struct btd_device *device = user_data;
+	struct btd_adapter *adapter = device_get_adapter(device);
+	const struct queue_entry *entry;
+
+	if (ad->type != BT_AD_CSIP_RSI || ad->len < 6)
+		return;
+
+	if (rsi_cache_lookup(adapter, ad->data))
+		return;
+
+	for (entry = queue_get_entries(set_list); entry; entry = entry->next) {
+		struct btd_device_set *set = entry->data;
+
+		if (set->adapter != adapter)
+			continue;
+
+		/* Already a member, nothing to resolve */
+		if (queue_find(set->devices, NULL, device))
+			return;
+
+		if (set_match_rsi(set, ad->data)) {
+			set_member_found(set, device);
+			device_connect_le(device);
+			return;
+		}
+	}
+
+	rsi_cache_add(adapter, ad->data);
+}
+
+void btd_set_device_found(struct btd_device *device)
+{
+	if (queue_isempty(set_list))
+		return;
+
+	btd_device_foreach_ad(device, resolve_rsi, device);
 }
 
 struct btd_device_set *btd_set_add_device(struct btd_device *device,
@@ -352,10 +512,12 @@ struct btd_device_set *btd_set_add_device(struct btd_device *device,
 
 	queue_push_tail(set_list, set);
 
+	/* RSIs that have been rejected so far may resolve with the new SIRK */
+	rsi_cache_flush();
+
 done:
 	/* Attempt to add devices which have matching RSI */
-	btd_adapter_for_each_device(device_get_adapter(device), foreach_device,
-									set);
+	set_resolve_devices(set);
 
 	return set;
 }
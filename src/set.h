@@ -19,3 +19,4 @@ struct btd_device_set *btd_set_add_device(struct btd_device *device,
 bool btd_set_remove_device(struct btd_device_set *set,
 						struct btd_device *device);
 const char *btd_set_get_path(struct btd_device_set *set);
+void btd_set_device_found(struct btd_device *device);
@@ -11,8 +11,18 @@
 #include <config.h>
 #endif
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <glib.h>
 
@@ -20,9 +30,11 @@
 #include "lib/uuid.h"
 
 #include "log.h"
+#include "src/shared/util.h"
 #include "src/shared/queue.h"
 #include "src/shared/att.h"
 #include "src/shared/gatt-db.h"
+#include "textfile.h"
 #include "settings.h"
 
 #define GATT_PRIM_SVC_UUID_STR "2800"
@@ -30,6 +42,37 @@
 #define GATT_INCLUDE_UUID_STR "2802"
 #define GATT_CHARAC_UUID_STR "2803"
 
+/*
+ * Binary GATT cache
+ *
+ * Remote databases that expose a Database Hash are additionally stored in
+ * a compact binary image named after the hash (cache/gatt/<hash>), so that
+ * identical peripherals share a single file. The image is mapped read-only
+ * once per hash and kept as a shared template from which every device with
+ * that hash is populated, without any text parsing. Each device still gets
+ * its own gatt_db built from the template.
+ *
+ * A template is mapped as long as a device cache file refers to it, images
+ * no cache file refers to are removed when the adapter loads its devices.
+ */
+#define GATT_CACHE_MAGIC	0x43475a42	/* "BZGC" */
+#define GATT_CACHE_VERSION	0x01
+#define GATT_CACHE_DIR		"gatt"
+
+#define GATT_CACHE_PRIM		0x00
+#define GATT_CACHE_SND		0x01
+#define GATT_CACHE_INCL		0x02
+#define GATT_CACHE_CHRC		0x03
+#define GATT_CACHE_DESC		0x04
+
+struct gatt_cache_hdr {
+	uint32_t magic;
+	uint8_t  version;
+	uint8_t  rfu;
+	uint16_t count;
+	uint8_t  hash[16];
+} __packed;
+
 static ssize_t str2val(const char *str, uint8_t *val, size_t len)
 {
 	const char *pos = str;
@@ -306,31 +349,369 @@ static int gatt_db_load(struct gatt_db *db, GKeyFile *key_file, char **keys)
 	return 0;
 }
 
-int btd_settings_gatt_db_load(struct gatt_db *db, const char *filename)
+static void gatt_cache_push_u8(struct iovec *iov, uint8_t val)
 {
-	char **keys;
-	GKeyFile *key_file;
+	util_iov_append(iov, &val, sizeof(val));
+}
+
+static void gatt_cache_push_le16(struct iovec *iov, uint16_t val)
+{
+	val = cpu_to_le16(val);
+	util_iov_append(iov, &val, sizeof(val));
+}
+
+static bool gatt_cache_pull_uuid(struct iovec *iov, bt_uuid_t *uuid)
+{
+	uint8_t len;
+	uint16_t u16;
+	uint128_t u128;
+	void *data;
+
+	if (!util_iov_pull_u8(iov, &len))
+		return false;
+
+	switch (len) {
+	case 2:
+		if (!util_iov_pull_le16(iov, &u16))
+			return false;
+		bt_uuid16_create(uuid, u16);
+		return true;
+	case 16:
+		data = util_iov_pull_mem(iov, len);
+		if (!data)
+			return false;
+		bswap_128(data, &u128);
+		bt_uuid128_create(uuid, u128);
+		return true;
+	}
+
+	return false;
+}
+
+static void gatt_cache_push_uuid(struct iovec *iov, const bt_uuid_t *uuid)
+{
+	uint8_t data[16];
+	uint8_t len = uuid->type == BT_UUID16 ? 2 : 16;
+
+	bt_uuid_to_le(uuid, data);
+	gatt_cache_push_u8(iov, len);
+	util_iov_append(iov, data, len);
+}
+
+static int gatt_cache_load_service(struct gatt_db *db, struct iovec *iov,
+					uint16_t handle, bool primary,
+					bool insert)
+{
+	uint16_t end;
+	bt_uuid_t uuid;
+
+	if (!util_iov_pull_le16(iov, &end) ||
+				!gatt_cache_pull_uuid(iov, &uuid) ||
+				end < handle)
+		return -EIO;
+
+	if (!insert)
+		return 0;
+
+	if (!gatt_db_insert_service(db, handle, &uuid, primary,
+							end - handle + 1))
+		return -EIO;
+
+	return 0;
+}
+
+static int gatt_cache_load_incl(struct gatt_db *db, struct iovec *iov,
+					struct gatt_db_attribute *service)
+{
+	struct gatt_db_attribute *att;
+	uint16_t start, end;
+
+	if (!util_iov_pull_le16(iov, &start) ||
+				!util_iov_pull_le16(iov, &end))
+		return -EIO;
+
+	if (!service)
+		return 0;
+
+	att = gatt_db_get_attribute(db, start);
+	if (!att || !gatt_db_service_add_included(service, att))
+		return -EIO;
+
+	return 0;
+}
+
+static int gatt_cache_load_chrc(struct iovec *iov, uint16_t handle,
+					struct gatt_db_attribute *service)
+{
+	struct gatt_db_attribute *att;
+	uint16_t value_handle;
+	uint8_t properties, len;
+	const uint8_t *val;
+	bt_uuid_t uuid;
+
+	if (!util_iov_pull_le16(iov, &value_handle) ||
+				!util_iov_pull_u8(iov, &properties) ||
+				!util_iov_pull_u8(iov, &len))
+		return -EIO;
+
+	val = util_iov_pull_mem(iov, len);
+	if ((len && !val) || !gatt_cache_pull_uuid(iov, &uuid))
+		return -EIO;
+
+	if (!service)
+		return 0;
+
+	att = gatt_db_service_insert_characteristic(service, handle,
+							value_handle,
+							&uuid, 0, properties,
+							NULL, NULL, NULL);
+	if (!att || gatt_db_attribute_get_handle(att) != value_handle)
+		return -EIO;
+
+	if (len && !gatt_db_attribute_write(att, 0, val, len, 0, NULL,
+						load_desc_value, NULL))
+		return -EIO;
+
+	return 0;
+}
+
+static int gatt_cache_load_desc(struct iovec *iov, uint16_t handle,
+					struct gatt_db_attribute *service)
+{
+	struct gatt_db_attribute *att;
+	uint16_t val;
+	bt_uuid_t uuid;
+
+	if (!util_iov_pull_le16(iov, &val) ||
+				!gatt_cache_pull_uuid(iov, &uuid))
+		return -EIO;
+
+	if (!service)
+		return 0;
+
+	att = gatt_db_service_insert_descriptor(service, handle, &uuid,
+							0, NULL, NULL, NULL);
+	if (!att || gatt_db_attribute_get_handle(att) != handle)
+		return -EIO;
+
+	if (val && !gatt_db_attribute_write(att, 0, (uint8_t *)&val,
+						sizeof(val), 0, NULL,
+						load_desc_value, NULL))
+		return -EIO;
+
+	return 0;
+}
+
+/* The first pass only inserts services, so that includes referring to a
+ * service at a higher handle can be resolved by the second pass which adds
+ * everything else.
+ */
+static int gatt_cache_load_pass(struct gatt_db *db, const void *data,
+						size_t len, bool services)
+{
+	const struct gatt_cache_hdr *hdr = data;
+	struct gatt_db_attribute *service = NULL;
+	struct iovec iov;
+	uint16_t i, count, handle;
+	uint8_t type;
+	int ret = 0;
+
+	count = le16_to_cpu(hdr->count);
+	iov.iov_base = (void *) data + sizeof(*hdr);
+	iov.iov_len = len - sizeof(*hdr);
+
+	for (i = 0; i < count && !ret; i++) {
+		if (!util_iov_pull_u8(&iov, &type) ||
+				!util_iov_pull_le16(&iov, &handle))
+			return -EIO;
+
+		switch (type) {
+		case GATT_CACHE_PRIM:
+		case GATT_CACHE_SND:
+			ret = gatt_cache_load_service(db, &iov, handle,
+						type == GATT_CACHE_PRIM,
+						services);
+			if (ret || services)
+				break;
+
+			if (service)
+				gatt_db_service_set_active(service, true);
+
+			service = gatt_db_get_attribute(db, handle);
+			break;
+		case GATT_CACHE_INCL:
+			ret = gatt_cache_load_incl(db, &iov, service);
+			break;
+		case GATT_CACHE_CHRC:
+			ret = gatt_cache_load_chrc(&iov, handle, service);
+			break;
+		case GATT_CACHE_DESC:
+			ret = gatt_cache_load_desc(&iov, handle, service);
+			break;
+		default:
+			ret = -EIO;
+			break;
+		}
+
+		/* Records are stored in handle order, so anything but a
+		 * service needs a service before it.
+		 */
+		if (!ret && !services && !service)
+			ret = -EIO;
+	}
+
+	if (!ret && service)
+		gatt_db_service_set_active(service, true);
+
+	return ret;
+}
+
+static int gatt_cache_load(struct gatt_db *db, const void *data, size_t len)
+{
+	const struct gatt_cache_hdr *hdr = data;
+	int ret;
+
+	if (len < sizeof(*hdr) || le32_to_cpu(hdr->magic) != GATT_CACHE_MAGIC ||
+					hdr->version != GATT_CACHE_VERSION)
+		return -EINVAL;
+
+	ret = gatt_cache_load_pass(db, data, len, true);
+	if (!ret)
+		ret = gatt_cache_load_pass(db, data, len, false);
+
+	if (ret)
+		gatt_db_clear(db);
+
+	return ret;
+}
+
+static void gatt_cache_filename(char *str, size_t size, const char *filename,
+						const uint8_t hash[16])
+{
+	const char *sep = strrchr(filename, '/');
+	int len = sep ? sep - filename : 0;
+
+	snprintf(str, size, "%.*s/" GATT_CACHE_DIR "/%02x%02x%02x%02x%02x%02x"
+			"%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x", len,
+			filename, hash[0], hash[1], hash[2], hash[3], hash[4],
+			hash[5], hash[6], hash[7], hash[8], hash[9], hash[10],
+			hash[11], hash[12], hash[13], hash[14], hash[15]);
+}
+
+static bool gatt_cache_get_hash(GKeyFile *key_file, uint8_t hash[16])
+{
+	char *str;
+	bool ret;
+
+	str = g_key_file_get_string(key_file, "GattCache", "DatabaseHash",
+									NULL);
+	if (!str)
+		return false;
+
+	ret = strlen(str) == 32 && str2val(str, hash, 16) == 16;
+
+	g_free(str);
+
+	return ret;
+}
+
+static int gatt_cache_load_hash(struct gatt_db *db, const char *filename,
+						GKeyFile *key_file)
+{
+	const struct gatt_cache_hdr *hdr;
+	struct timespec start, end;
+	char path[PATH_MAX];
+	uint8_t hash[16];
+	struct stat st;
+	void *map;
+	int fd, err = 0;
+
+	if (!gatt_cache_get_hash(key_file, hash))
+		return -ENOENT;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	gatt_cache_filename(path, sizeof(path), filename, hash);
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -ENOENT;
+
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return -ENOENT;
+	}
+
+	/* The image is only mapped while it is decoded */
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -ENOENT;
+
+	/* It must decode and its contents must produce the Database Hash it
+	 * is stored under.
+	 */
+	hdr = map;
+	if (memcmp(hdr->hash, hash, 16) ||
+			gatt_cache_load(db, map, st.st_size) < 0 ||
+			memcmp(gatt_db_get_hash(db), hash, 16)) {
+		DBG("Invalid GATT cache %s", path);
+		gatt_db_clear(db);
+		unlink(path);
+		err = -EINVAL;
+	}
+
+	munmap(map, st.st_size);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	DBG("%s: %zu bytes image loaded in %ld us (%d)", filename,
+			(size_t) st.st_size,
+			(end.tv_sec - start.tv_sec) * 1000000 +
+			(end.tv_nsec - start.tv_nsec) / 1000, err);
+
+	return err;
+}
+
+/* If key_file is NULL it is loaded from filename */
+int btd_settings_gatt_db_load(struct gatt_db *db, const char *filename,
+							GKeyFile *key_file)
+{
+	GKeyFile *file = NULL;
 	GError *gerr = NULL;
+	char **keys;
 	int err;
 
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
-		DBG("Unable to load key file from %s: (%s)", filename,
+	if (!key_file) {
+		file = g_key_file_new();
+		if (!g_key_file_load_from_file(file, filename, 0, &gerr)) {
+			DBG("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
-		g_clear_error(&gerr);
+			g_clear_error(&gerr);
+		}
+
+		key_file = file;
 	}
 
-	keys = g_key_file_get_keys(key_file, "Attributes", NULL, NULL);
+	/* Prefer the binary image when the database has a hash */
+	if (!gatt_cache_load_hash(db, filename, key_file)) {
+		err = 0;
+		goto done;
+	}
 
+	keys = g_key_file_get_keys(key_file, "Attributes", NULL, NULL);
 	if (!keys) {
-		g_key_file_free(key_file);
-		return -ENOENT;
+		err = -ENOENT;
+		goto done;
 	}
 
 	err = gatt_db_load(db, key_file, keys);
 
 	g_strfreev(keys);
-	g_key_file_free(key_file);
+
+done:
+	if (file)
+		g_key_file_free(file);
 
 	return err;
 }
@@ -339,8 +720,20 @@ struct gatt_saver {
 	struct gatt_db *db;
 	uint16_t ext_props;
 	GKeyFile *key_file;
+	struct iovec *cache;
+	uint16_t count;
+	bool has_hash;
+	uint8_t hash[16];
 };
 
+static void gatt_cache_push_record(struct gatt_saver *saver, uint8_t type,
+							uint16_t handle)
+{
+	gatt_cache_push_u8(saver->cache, type);
+	gatt_cache_push_le16(saver->cache, handle);
+	saver->count++;
+}
+
 static void db_hash_read_value_cb(struct gatt_db_attribute *attrib,
 						int err, const uint8_t *value,
 						size_t length, void *user_data)
@@ -375,6 +768,11 @@ static void store_desc(struct gatt_db_attribute *attr, void *user_data)
 		sprintf(value, "%s", uuid_str);
 
 	g_key_file_set_string(key_file, "Attributes", handle, value);
+
+	gatt_cache_push_record(saver, GATT_CACHE_DESC, handle_num);
+	gatt_cache_push_le16(saver->cache, bt_uuid_cmp(uuid, &ext_uuid) ? 0 :
+							saver->ext_props);
+	gatt_cache_push_uuid(saver->cache, uuid);
 }
 
 static void store_chrc(struct gatt_db_attribute *attr, void *user_data)
@@ -405,6 +803,11 @@ static void store_chrc(struct gatt_db_attribute *attr, void *user_data)
 
 		gatt_db_attribute_read(attr, 0, BT_ATT_OP_READ_REQ, NULL,
 					db_hash_read_value_cb, &hash);
+		if (hash) {
+			saver->has_hash = true;
+			memcpy(saver->hash, hash, sizeof(saver->hash));
+		}
+
 		if (hash)
 			sprintf(value, GATT_CHARAC_UUID_STR ":%04hx:%02hhx:"
 				"%02hhx%02hhx%02hhx%02hhx%02hhx%02hhx%02hhx"
@@ -425,6 +828,15 @@ static void store_chrc(struct gatt_db_attribute *attr, void *user_data)
 
 	g_key_file_set_string(key_file, "Attributes", handle, value);
 
+	gatt_cache_push_record(saver, GATT_CACHE_CHRC, handle_num);
+	gatt_cache_push_le16(saver->cache, value_handle);
+	gatt_cache_push_u8(saver->cache, properties);
+	gatt_cache_push_u8(saver->cache, saver->has_hash &&
+				!bt_uuid_cmp(&uuid, &hash_uuid) ? 16 : 0);
+	if (saver->has_hash && !bt_uuid_cmp(&uuid, &hash_uuid))
+		util_iov_append(saver->cache, saver->hash, 16);
+	gatt_cache_push_uuid(saver->cache, &uuid);
+
 	gatt_db_service_foreach_desc(attr, store_desc, saver);
 }
 
@@ -456,6 +868,10 @@ static void store_incl(struct gatt_db_attribute *attr, void *user_data)
 								end, uuid_str);
 
 	g_key_file_set_string(key_file, "Attributes", handle, value);
+
+	gatt_cache_push_record(saver, GATT_CACHE_INCL, handle_num);
+	gatt_cache_push_le16(saver->cache, start);
+	gatt_cache_push_le16(saver->cache, end);
 }
 
 static void store_service(struct gatt_db_attribute *attr, void *user_data)
@@ -487,10 +903,59 @@ static void store_service(struct gatt_db_attribute *attr, void *user_data)
 
 	g_key_file_set_string(key_file, "Attributes", handle, value);
 
+	gatt_cache_push_record(saver, primary ? GATT_CACHE_PRIM :
+						GATT_CACHE_SND, start);
+	gatt_cache_push_le16(saver->cache, end);
+	gatt_cache_push_uuid(saver->cache, &uuid);
+
 	gatt_db_service_foreach_incl(attr, store_incl, saver);
 	gatt_db_service_foreach_char(attr, store_chrc, saver);
 }
 
+static void gatt_cache_store(struct gatt_saver *saver, const char *filename)
+{
+	struct gatt_cache_hdr *hdr = saver->cache->iov_base;
+	char path[PATH_MAX], tmp[PATH_MAX];
+	struct stat st;
+	int fd;
+
+	gatt_cache_filename(path, sizeof(path), filename, saver->hash);
+
+	/* Images are immutable: an existing file for this hash is shared
+	 * with other devices and already has the same contents.
+	 */
+	if (!stat(path, &st))
+		return;
+
+	hdr->magic = cpu_to_le32(GATT_CACHE_MAGIC);
+	hdr->version = GATT_CACHE_VERSION;
+	hdr->rfu = 0;
+	hdr->count = cpu_to_le16(saver->count);
+	memcpy(hdr->hash, saver->hash, sizeof(hdr->hash));
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	create_file(tmp, 0600);
+
+	fd = open(tmp, O_WRONLY | O_TRUNC | O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	if (write(fd, saver->cache->iov_base, saver->cache->iov_len) !=
+					(ssize_t) saver->cache->iov_len) {
+		DBG("Unable to write %s: %s", tmp, strerror(errno));
+		close(fd);
+		unlink(tmp);
+		return;
+	}
+
+	close(fd);
+
+	if (rename(tmp, path) < 0) {
+		DBG("Unable to rename %s: %s", tmp, strerror(errno));
+		unlink(tmp);
+	}
+}
+
 void btd_settings_gatt_db_store(struct gatt_db *db, const char *filename)
 {
 	GKeyFile *key_file;
@@ -498,6 +963,7 @@ void btd_settings_gatt_db_store(struct gatt_db *db, const char *filename)
 	char *data;
 	gsize length = 0;
 	struct gatt_saver saver;
+	struct iovec cache = {};
 
 	key_file = g_key_file_new();
 	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
@@ -509,11 +975,30 @@ void btd_settings_gatt_db_store(struct gatt_db *db, const char *filename)
 	/* Remove current attributes since it might have changed */
 	g_key_file_remove_group(key_file, "Attributes", NULL);
 
+	memset(&saver, 0, sizeof(saver));
 	saver.key_file = key_file;
 	saver.db = db;
+	saver.cache = &cache;
+
+	util_iov_append(&cache, NULL, sizeof(struct gatt_cache_hdr));
 
 	gatt_db_foreach_service(db, NULL, store_service, &saver);
 
+	if (saver.has_hash) {
+		char hash[33];
+		int i;
+
+		for (i = 0; i < 16; i++)
+			sprintf(hash + i * 2, "%02hhx", saver.hash[i]);
+
+		g_key_file_set_string(key_file, "GattCache", "DatabaseHash",
+									hash);
+		gatt_cache_store(&saver, filename);
+	} else
+		g_key_file_remove_group(key_file, "GattCache", NULL);
+
+	free(cache.iov_base);
+
 	data = g_key_file_to_data(key_file, &length, NULL);
 	if (!g_file_set_contents(filename, data, length, &gerr)) {
 		DBG("Unable set contents for %s: (%s)", filename,
@@ -524,3 +1009,75 @@ void btd_settings_gatt_db_store(struct gatt_db *db, const char *filename)
 	g_free(data);
 	g_key_file_free(key_file);
 }
+
+static bool gatt_cache_hash_from_name(const char *name, uint8_t hash[16])
+{
+	return strlen(name) == 32 && str2val(name, hash, 16) == 16;
+}
+
+static bool match_hash(const void *data, const void *match_data)
+{
+	return !memcmp(data, match_data, 16);
+}
+
+/* Removes the images in <dir>/gatt that no cache file in <dir> refers to */
+void btd_settings_gatt_cache_gc(const char *dir)
+{
+	struct queue *hashes;
+	struct dirent *entry;
+	char path[PATH_MAX];
+	uint8_t hash[16];
+	DIR *d;
+
+	d = opendir(dir);
+	if (!d)
+		return;
+
+	hashes = queue_new();
+
+	while ((entry = readdir(d))) {
+		GKeyFile *key_file;
+
+		if (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+
+		key_file = g_key_file_new();
+		if (g_key_file_load_from_file(key_file, path, 0, NULL) &&
+				gatt_cache_get_hash(key_file, hash))
+			queue_push_tail(hashes, util_memdup(hash, 16));
+
+		g_key_file_free(key_file);
+	}
+
+	closedir(d);
+
+	snprintf(path, sizeof(path), "%s/" GATT_CACHE_DIR, dir);
+
+	d = opendir(path);
+	if (!d) {
+		queue_destroy(hashes, free);
+		return;
+	}
+
+	while ((entry = readdir(d))) {
+		if (entry->d_name[0] == '.')
+			continue;
+
+		/* Leftovers of interrupted stores are removed as well */
+		if (gatt_cache_hash_from_name(entry->d_name, hash) &&
+				queue_find(hashes, match_hash, hash))
+			continue;
+
+		DBG("Removing unused GATT cache %s", entry->d_name);
+
+		snprintf(path, sizeof(path), "%s/" GATT_CACHE_DIR "/%s", dir,
+								entry->d_name);
+		unlink(path);
+	}
+
+	closedir(d);
+
+	queue_destroy(hashes, free);
+}
@@ -7,5 +7,7 @@
  *
  */
 
-int btd_settings_gatt_db_load(struct gatt_db *db, const char *filename);
+int btd_settings_gatt_db_load(struct gatt_db *db, const char *filename,
+							GKeyFile *key_file);
 void btd_settings_gatt_db_store(struct gatt_db *db, const char *filename);
+void btd_settings_gatt_cache_gc(const char *dir);
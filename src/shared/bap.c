@@ -176,6 +176,7 @@ struct bt_bap {
 	struct queue *streams;
 	struct queue *local_eps;
 	struct queue *remote_eps;
+	struct queue *bases;
 
 	struct queue *pac_cbs;
 	struct queue *ready_cbs;
@@ -319,6 +320,13 @@ struct bt_bis {
 	struct iovec *caps;
 };
 
+/* Serialized BASE of a BIG, kept until any stream it covers changes */
+struct bt_base_cache {
+	uint8_t big_id;
+	struct bt_bap_stream *stream;
+	struct iovec *base;
+};
+
 /* Contains local bt_bap_db */
 static struct queue *bap_db;
 static struct queue *bap_cbs;
@@ -1201,6 +1209,24 @@ static void bap_ucast_detach(struct bt_bap_stream *stream)
 	bap_stream_free(stream);
 }
 
+static void base_cache_free(void *data)
+{
+	struct bt_base_cache *cache = data;
+
+	util_iov_free(cache->base, 1);
+	free(cache);
+}
+
+static void bap_bcast_base_flush(struct bt_bap *bap)
+{
+	if (queue_isempty(bap->bases))
+		return;
+
+	DBG(bap, "bap %p", bap);
+
+	queue_remove_all(bap->bases, NULL, NULL, base_cache_free);
+}
+
 static void bap_bcast_src_detach(struct bt_bap_stream *stream)
 {
 	struct bt_bap_endpoint *ep = stream->ep;
@@ -1212,6 +1238,7 @@ static void bap_bcast_src_detach(struct bt_bap_stream *stream)
 
 	queue_remove(stream->bap->streams, stream);
 	bap_stream_clear_cfm(stream);
+	bap_bcast_base_flush(stream->bap);
 
 	stream->ep = NULL;
 	ep->stream = NULL;
@@ -1789,6 +1816,8 @@ static unsigned int bap_bcast_qos(struct bt_bap_stream *stream,
 					void *user_data)
 {
 	stream->qos = *data;
+	bap_bcast_base_flush(stream->bap);
+
 	return 1;
 }
 
@@ -1797,6 +1826,8 @@ static unsigned int bap_bcast_config(struct bt_bap_stream *stream,
 				     bt_bap_stream_func_t func, void *user_data)
 {
 	stream->qos = *qos;
+	bap_bcast_base_flush(stream->bap);
+
 	stream->lpac->ops->config(stream, stream->cc, &stream->qos,
 			ep_config_cb, stream->lpac->user_data);
 
@@ -2156,6 +2187,7 @@ static unsigned int bap_bcast_metadata(struct bt_bap_stream *stream,
 {
 	util_iov_free(stream->meta, 1);
 	stream->meta = util_iov_dup(data, 1);
+	bap_bcast_base_flush(stream->bap);
 
 	return 1;
 }
@@ -3896,6 +3928,7 @@ static void bap_free(void *data)
 	queue_destroy(bap->reqs, bap_req_free);
 	queue_destroy(bap->notify, NULL);
 	queue_destroy(bap->streams, bap_stream_free);
+	queue_destroy(bap->bases, base_cache_free);
 
 	free(bap);
 }
@@ -3973,6 +4006,7 @@ struct bt_bap *bt_bap_new(struct gatt_db *ldb, struct gatt_db *rdb)
 	bap->streams = queue_new();
 	bap->state_cbs = queue_new();
 	bap->local_eps = queue_new();
+	bap->bases = queue_new();
 
 	if (!rdb)
 		goto done;
@@ -5515,6 +5549,8 @@ static struct bt_bap_stream *bap_bcast_stream_new(struct bt_bap *bap,
 	if (!stream)
 		stream = bap_stream_new(bap, ep, lpac, NULL, data, true);
 
+	bap_bcast_base_flush(bap);
+
 	return stream;
 }
 
@@ -6435,6 +6471,21 @@ static void destroy_base_subgroup(void *data)
 	free(subgroup);
 }
 
+static bool match_base_cache(const void *data, const void *user_data)
+{
+	const struct bt_base_cache *cache = data;
+	const struct bt_bap_stream *stream = user_data;
+
+	if (cache->big_id != stream->qos.bcast.big)
+		return false;
+
+	/* A BIS without BIG ID has a BASE of its own */
+	if (stream->qos.bcast.big == 0xFF)
+		return cache->stream == stream;
+
+	return true;
+}
+
 /*
  * Function to update the BASE using configuration data
  * from each BIS belonging to the same BIG
@@ -6442,8 +6493,17 @@ static void destroy_base_subgroup(void *data)
 struct iovec *bt_bap_stream_get_base(struct bt_bap_stream *stream)
 {
 	struct bt_base base;
+	struct bt_base_cache *cache;
 	struct iovec *base_iov;
 
+	/* Generating the BASE also assigns the BIS indexes, so the cached
+	 * copy remains valid until a stream is added, removed or
+	 * reconfigured.
+	 */
+	cache = queue_find(stream->bap->bases, match_base_cache, stream);
+	if (cache)
+		return util_iov_dup(cache->base, 1);
+
 	base.subgroups = queue_new();
 	base.next_bis_index = 1;
 	base.big_id = stream->qos.bcast.big;
@@ -6464,6 +6524,16 @@ struct iovec *bt_bap_stream_get_base(struct bt_bap_stream *stream)
 
 	queue_destroy(base.subgroups, destroy_base_subgroup);
 
+	if (!base_iov)
+		return NULL;
+
+	cache = new0(struct bt_base_cache, 1);
+	cache->big_id = stream->qos.bcast.big;
+	if (stream->qos.bcast.big == 0xFF)
+		cache->stream = stream;
+	cache->base = util_iov_dup(base_iov, 1);
+	queue_push_tail(stream->bap->bases, cache);
+
 	return base_iov;
 }
 
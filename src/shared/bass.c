@@ -1733,6 +1733,76 @@ done:
 	return err;
 }
 
+struct bass_send {
+	struct bt_bass *bass;
+	bt_bass_send_func_t func;
+	bt_bass_destroy_func_t destroy;
+	void *user_data;
+};
+
+static void bass_send_cb(bool success, uint8_t att_ecode, void *user_data)
+{
+	struct bass_send *send = user_data;
+
+	DBG(send->bass, "success %u att_ecode 0x%02x", success, att_ecode);
+
+	if (send->func)
+		send->func(send->bass, success ? 0 : -EIO, send->user_data);
+}
+
+static void bass_send_free(void *data)
+{
+	struct bass_send *send = data;
+
+	if (send->destroy)
+		send->destroy(send->user_data);
+
+	free(send);
+}
+
+unsigned int bt_bass_send_req(struct bt_bass *bass,
+				struct bt_bass_bcast_audio_scan_cp_hdr *hdr,
+				struct iovec *params,
+				bt_bass_send_func_t func, void *user_data,
+				bt_bass_destroy_func_t destroy)
+{
+	struct bass_send *send;
+	struct iovec req = {0};
+	uint16_t handle;
+	unsigned int id;
+
+	if (!bass || !bass->client || !bass->rdb)
+		return 0;
+
+	if (!gatt_db_attribute_get_char_data(bass->rdb->bcast_audio_scan_cp,
+			NULL, &handle, NULL, NULL, NULL))
+		return 0;
+
+	DBG(bass, "bass %p op 0x%02x", bass, hdr->op);
+
+	util_iov_append(&req, hdr, sizeof(*hdr));
+	util_iov_append(&req, params->iov_base, params->iov_len);
+
+	send = new0(struct bass_send, 1);
+	send->bass = bass;
+	send->func = func;
+	send->destroy = destroy;
+	send->user_data = user_data;
+
+	/* Unlike bt_bass_send the write is acknowledged so the caller is
+	 * able to track when the peer has processed the operation.
+	 */
+	id = bt_gatt_client_write_value(bass->client, handle, req.iov_base,
+					req.iov_len, bass_send_cb, send,
+					bass_send_free);
+	if (!id)
+		free(send);
+
+	free(req.iov_base);
+
+	return id;
+}
+
 static void bt_bass_notify_all(struct gatt_db_attribute *attr,
 						struct iovec *iov)
 {
@@ -99,6 +99,8 @@ typedef void (*bt_bass_debug_func_t)(const char *str, void *user_data);
 typedef void (*bt_bass_src_func_t)(uint8_t id, uint32_t bid, uint8_t enc,
 					uint32_t bis_sync, void *user_data);
 
+typedef void (*bt_bass_send_func_t)(struct bt_bass *bass, int err,
+					void *user_data);
 typedef int (*bt_bass_cp_handler_func_t)(struct bt_bcast_src *bcast_src,
 		uint8_t op, void *params, void *user_data);
 
@@ -120,6 +122,11 @@ void bt_bass_add_db(struct gatt_db *db, const bdaddr_t *adapter_bdaddr);
 int bt_bass_send(struct bt_bass *bass,
 		struct bt_bass_bcast_audio_scan_cp_hdr *hdr,
 		struct iovec *params);
+unsigned int bt_bass_send_req(struct bt_bass *bass,
+				struct bt_bass_bcast_audio_scan_cp_hdr *hdr,
+				struct iovec *params,
+				bt_bass_send_func_t func, void *user_data,
+				bt_bass_destroy_func_t destroy);
 unsigned int bt_bass_src_register(struct bt_bass *bass, bt_bass_src_func_t cb,
 			void *user_data, bt_bass_destroy_func_t destroy);
 bool bt_bass_src_unregister(struct bt_bass *bass, unsigned int id);
@@ -59,6 +59,10 @@ struct af_alg_iv {
 #define SOL_ALG		279
 #endif
 
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
 /* Maximum message length that can be passed to aes_cmac */
 #define CMAC_MSG_MAX	80
 
@@ -788,6 +792,93 @@ bool bt_crypto_sih(struct bt_crypto *crypto, const uint8_t k[16],
 	return bt_crypto_ah(crypto, k, r, hash);
 }
 
+/* Number of 16 octet blocks submitted per AF_ALG request */
+#define SIH_BATCH_MAX	64
+
+struct bt_crypto_sih_key {
+	struct bt_crypto *crypto;
+	int fd;
+};
+
+struct bt_crypto_sih_key *bt_crypto_sih_key_new(struct bt_crypto *crypto,
+							const uint8_t k[16])
+{
+	struct bt_crypto_sih_key *key;
+	uint8_t tmp[16];
+	int fd;
+
+	if (!crypto)
+		return NULL;
+
+	/* The most significant octet of key corresponds to key[0] */
+	swap_buf(k, tmp, 16);
+
+	/* Keep the operation socket around so the kernel only expands the
+	 * key schedule once instead of on every hash calculation.
+	 */
+	fd = alg_new(crypto->ecb_aes, tmp, 16);
+	if (fd < 0)
+		return NULL;
+
+	key = new0(struct bt_crypto_sih_key, 1);
+	key->crypto = bt_crypto_ref(crypto);
+	key->fd = fd;
+
+	return key;
+}
+
+void bt_crypto_sih_key_free(struct bt_crypto_sih_key *key)
+{
+	if (!key)
+		return;
+
+	close(key->fd);
+	bt_crypto_unref(key->crypto);
+	free(key);
+}
+
+bool bt_crypto_sih_batch(struct bt_crypto_sih_key *key,
+				const uint8_t *r, uint8_t *hash,
+				size_t count)
+{
+	uint8_t in[SIH_BATCH_MAX * 16], out[SIH_BATCH_MAX * 16];
+	size_t i, n;
+
+	if (!key)
+		return false;
+
+	while (count) {
+		n = MIN(count, SIH_BATCH_MAX);
+
+		/* r' = padding || r, most significant octet first */
+		memset(in, 0, n * 16);
+		for (i = 0; i < n; i++) {
+			in[i * 16 + 13] = r[i * 3 + 2];
+			in[i * 16 + 14] = r[i * 3 + 1];
+			in[i * 16 + 15] = r[i * 3];
+		}
+
+		/* ECB encrypts every block independently so all of them can
+		 * be submitted with a single request.
+		 */
+		if (!alg_encrypt(key->fd, in, n * 16, out, n * 16))
+			return false;
+
+		/* sih(k, r) = e(k, r') mod 2^24 */
+		for (i = 0; i < n; i++) {
+			hash[i * 3] = out[i * 16 + 15];
+			hash[i * 3 + 1] = out[i * 16 + 14];
+			hash[i * 3 + 2] = out[i * 16 + 13];
+		}
+
+		r += n * 3;
+		hash += n * 3;
+		count -= n;
+	}
+
+	return true;
+}
+
 static bool aes_cmac_zero(struct bt_crypto *crypto, const uint8_t *msg,
 					size_t msg_len, uint8_t res[16])
 {
@@ -57,6 +57,15 @@ bool bt_crypto_sef(struct bt_crypto *crypto, const uint8_t k[16],
 			const uint8_t sirk[16], uint8_t out[16]);
 bool bt_crypto_sih(struct bt_crypto *crypto, const uint8_t k[16],
 					const uint8_t r[3], uint8_t hash[3]);
+
+struct bt_crypto_sih_key;
+
+struct bt_crypto_sih_key *bt_crypto_sih_key_new(struct bt_crypto *crypto,
+							const uint8_t k[16]);
+void bt_crypto_sih_key_free(struct bt_crypto_sih_key *key);
+bool bt_crypto_sih_batch(struct bt_crypto_sih_key *key,
+				const uint8_t *r, uint8_t *hash,
+				size_t count);
 bool bt_crypto_sirk(struct bt_crypto *crypto, const char *str, uint16_t vendor,
 			uint16_t product, uint16_t version, uint16_t source,
 			uint8_t sirk[16]);
@@ -18,6 +18,7 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stddef.h>
 
 #include "src/shared/io.h"
 #include "src/shared/util.h"
@@ -26,6 +27,14 @@
 
 #define UHID_DEVICE_FILE "/dev/uhid"
 
+/* Size of UHID_INPUT2 event without the report data, uHID accepts events
+ * shorter than struct uhid_event and zero fills the remaining.
+ */
+#define UHID_INPUT2_HDR_SIZE	offsetof(struct uhid_event, u.input2.data)
+
+/* Maximum number of input reports written with a single writev */
+#define UHID_INPUT_BATCH	16
+
 #ifndef MIN
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 #endif
@@ -50,6 +59,9 @@ struct bt_uhid {
 	unsigned int start_id;
 	bool started;
 	struct uhid_replay *replay;
+	struct iovec batch[UHID_INPUT_BATCH];
+	unsigned int batch_len;
+	bool batch_pending;
 };
 
 struct uhid_notify {
@@ -72,8 +84,30 @@ static void uhid_replay_free(struct uhid_replay *replay)
 	free(replay);
 }
 
+static void uhid_batch_clear(struct bt_uhid *uhid)
+{
+	unsigned int i;
+
+	if (uhid->batch_pending) {
+		io_set_write_handler(uhid->io, NULL, NULL, NULL);
+		uhid->batch_pending = false;
+	}
+
+	for (i = 0; i < uhid->batch_len; i++)
+		free(uhid->batch[i].iov_base);
+
+	uhid->batch_len = 0;
+}
+
+static int uhid_flush(struct bt_uhid *uhid);
+
 static void uhid_free(struct bt_uhid *uhid)
 {
+	if (uhid->io)
+		uhid_flush(uhid);
+
+	uhid_batch_clear(uhid);
+
 	if (uhid->io)
 		io_destroy(uhid->io);
 
@@ -344,17 +378,63 @@ bool bt_uhid_unregister_all(struct bt_uhid *uhid)
 	return true;
 }
 
+static size_t uhid_input_len(const struct uhid_event *ev)
+{
+	return UHID_INPUT2_HDR_SIZE + ev->u.input2.size;
+}
+
+static int uhid_flush(struct bt_uhid *uhid)
+{
+	ssize_t len;
+	size_t total = 0;
+	unsigned int i;
+
+	if (!uhid->batch_len)
+		return 0;
+
+	for (i = 0; i < uhid->batch_len; i++)
+		total += uhid->batch[i].iov_len;
+
+	/* uHID has no write_iter so each iovec is handled as a separate
+	 * write, one per event.
+	 */
+	len = io_send(uhid->io, uhid->batch, uhid->batch_len);
+
+	uhid_batch_clear(uhid);
+
+	if (len < 0)
+		return len;
+
+	return (size_t) len != total ? -EIO : 0;
+}
+
+static bool uhid_flush_cb(struct io *io, void *user_data)
+{
+	struct bt_uhid *uhid = user_data;
+
+	uhid->batch_pending = false;
+	uhid_flush(uhid);
+
+	return false;
+}
+
 static int uhid_send(struct bt_uhid *uhid, const struct uhid_event *ev)
 {
 	ssize_t len;
 	struct iovec iov;
+	int err;
+
+	/* Keep ordering with input reports still waiting to be written */
+	err = uhid_flush(uhid);
+	if (err)
+		return err;
 
 	iov.iov_base = (void *) ev;
 	iov.iov_len = sizeof(*ev);
 
 	len = io_send(uhid->io, &iov, 1);
 	if (len < 0)
-		return -errno;
+		return len;
 
 	/* uHID kernel driver does not handle partial writes */
 	return len != sizeof(*ev) ? -EIO : 0;
@@ -371,12 +451,45 @@ int bt_uhid_send(struct bt_uhid *uhid, const struct uhid_event *ev)
 	return uhid_send(uhid, ev);
 }
 
+static int uhid_input_push(struct bt_uhid *uhid, struct uhid_event *ev)
+{
+	if (!uhid->io) {
+		free(ev);
+		return -ENOTCONN;
+	}
+
+	uhid->batch[uhid->batch_len].iov_base = ev;
+	uhid->batch[uhid->batch_len].iov_len = uhid_input_len(ev);
+	uhid->batch_len++;
+
+	if (uhid->batch_len == UHID_INPUT_BATCH)
+		return uhid_flush(uhid);
+
+	/* uHID is always writable, so this writes the reports as soon as the
+	 * current mainloop iteration is done and reports arriving back to
+	 * back share a single syscall.
+	 */
+	if (!uhid->batch_pending)
+		uhid->batch_pending = io_set_write_handler(uhid->io,
+							uhid_flush_cb, uhid,
+							NULL);
+
+	/* Don't hold reports if they cannot be deferred */
+	if (!uhid->batch_pending)
+		return uhid_flush(uhid);
+
+	return 0;
+}
+
 static bool input_dequeue(const void *data, const void *match_data)
 {
 	struct uhid_event *ev = (void *)data;
 	struct bt_uhid *uhid = (void *)match_data;
 
-	return bt_uhid_send(uhid, ev) == 0;
+	/* Ownership is passed to the batch */
+	uhid_input_push(uhid, ev);
+
+	return true;
 }
 
 static void uhid_start(struct uhid_event *ev, void *user_data)
@@ -386,7 +499,7 @@ static void uhid_start(struct uhid_event *ev, void *user_data)
 	uhid->started = true;
 
 	/* dequeue input events send while UHID_CREATE2 was in progress */
-	queue_remove_all(uhid->input, input_dequeue, uhid, free);
+	queue_remove_all(uhid->input, input_dequeue, uhid, NULL);
 }
 
 int bt_uhid_create(struct bt_uhid *uhid, const char *name, bdaddr_t *src,
@@ -464,35 +577,45 @@ bool bt_uhid_started(struct bt_uhid *uhid)
 int bt_uhid_input(struct bt_uhid *uhid, uint8_t number, const void *data,
 			size_t size)
 {
-	struct uhid_event ev;
-	struct uhid_input2_req *req = &ev.u.input2;
+	struct uhid_event *ev;
+	struct uhid_input2_req *req;
 	size_t len = 0;
 
 	if (!uhid)
 		return -EINVAL;
 
-	memset(&ev, 0, sizeof(ev));
-	ev.type = UHID_INPUT2;
+	if (number)
+		size = 1 + MIN(size, sizeof(req->data) - 1);
+	else
+		size = MIN(size, sizeof(req->data));
 
-	if (number) {
+	/* Only allocate and write the used part of the event */
+	ev = malloc(UHID_INPUT2_HDR_SIZE + size);
+	if (!ev)
+		return -ENOMEM;
+
+	ev->type = UHID_INPUT2;
+	req = &ev->u.input2;
+	req->size = size;
+
+	if (number)
 		req->data[len++] = number;
-		req->size = 1 + MIN(size, sizeof(req->data) - 1);
-	} else
-		req->size = MIN(size, sizeof(req->data));
 
-	if (data && size)
-		memcpy(&req->data[len], data, req->size - len);
+	if (data && size > len)
+		memcpy(&req->data[len], data, size - len);
+	else
+		memset(&req->data[len], 0, size - len);
 
 	/* Queue events if UHID_START has not been received yet */
 	if (!uhid->started) {
 		if (!uhid->input)
 			uhid->input = queue_new();
 
-		queue_push_tail(uhid->input, util_memdup(&ev, sizeof(ev)));
+		queue_push_tail(uhid->input, ev);
 		return 0;
 	}
 
-	return bt_uhid_send(uhid, &ev);
+	return uhid_input_push(uhid, ev);
 }
 
 int bt_uhid_set_report_reply(struct bt_uhid *uhid, uint8_t id, uint8_t status)
@@ -559,6 +682,10 @@ int bt_uhid_destroy(struct bt_uhid *uhid, bool force)
 	queue_destroy(uhid->input, free);
 	uhid->input = NULL;
 
+	/* Reports already accepted are still delivered before destroying */
+	if (uhid->io)
+		uhid_flush(uhid);
+
 	/* Force destroy for non-keyboard devices - keyboards are not destroyed
 	 * on disconnect since they can glitch on reconnection losing
 	 * keypresses.
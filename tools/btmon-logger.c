@@ -24,6 +24,7 @@
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <libgen.h>
 #include <errno.h>
 
@@ -38,14 +39,268 @@
 
 #define MONITOR_INDEX_NONE 0xffff
 
+#define RING_PAD		0xffff
+#define RING_ALIGN(len)		(((len) + 7) & ~7)
+#define RING_DEFAULT_SIZE	(1024 * 1024)
+
 struct monitor_hdr {
 	uint16_t opcode;
 	uint16_t index;
 	uint16_t len;
 } __attribute__ ((packed));
 
+struct ring_hdr {
+	struct timeval tv;
+	uint16_t opcode;
+	uint16_t index;
+	uint16_t len;
+};
+
 static struct btsnoop *btsnoop_file = NULL;
 
+static const char *path = "hci.log";
+static unsigned long max_count = 0;
+static size_t size_limit = 0;
+
+/* Flight recorder: the most recent packets are only kept in memory and
+ * written out around a trigger event.
+ */
+static uint8_t *ring_buf = NULL;
+static size_t ring_size = 0;
+static size_t ring_head = 0;
+static size_t ring_tail = 0;
+static unsigned int ring_count = 0;
+static unsigned int ring_time = 0;
+static unsigned int pre_time = 0;
+static unsigned int post_time = 0;
+static int post_timeout = -1;
+static bool trigger_errors = false;
+static uint8_t trigger_reasons[32];
+
+static struct ring_hdr *ring_at(size_t pos)
+{
+	struct ring_hdr *hdr;
+
+	/* Not enough room left for a header means the writer wrapped */
+	if (ring_size - pos < sizeof(*hdr))
+		return NULL;
+
+	hdr = (struct ring_hdr *) (ring_buf + pos);
+	if (hdr->opcode == RING_PAD)
+		return NULL;
+
+	return hdr;
+}
+
+static void ring_pop(void)
+{
+	struct ring_hdr *hdr;
+
+	hdr = ring_at(ring_head);
+	if (!hdr) {
+		ring_head = 0;
+		hdr = ring_at(ring_head);
+	}
+
+	ring_head += RING_ALIGN(sizeof(*hdr) + hdr->len);
+	if (ring_head == ring_size)
+		ring_head = 0;
+
+	if (!--ring_count)
+		ring_head = ring_tail = 0;
+}
+
+static struct ring_hdr *ring_first(void)
+{
+	struct ring_hdr *hdr;
+
+	if (!ring_count)
+		return NULL;
+
+	hdr = ring_at(ring_head);
+	if (!hdr)
+		hdr = ring_at(0);
+
+	return hdr;
+}
+
+static void ring_expire(struct timeval *tv)
+{
+	struct ring_hdr *hdr;
+
+	if (!ring_time)
+		return;
+
+	while ((hdr = ring_first())) {
+		if (tv->tv_sec - hdr->tv.tv_sec < (time_t) ring_time)
+			break;
+
+		ring_pop();
+	}
+}
+
+static void ring_push(struct timeval *tv, uint16_t index, uint16_t opcode,
+					const void *data, uint16_t len)
+{
+	size_t need = RING_ALIGN(sizeof(struct ring_hdr) + len);
+	struct ring_hdr *hdr;
+
+	ring_expire(tv);
+
+	while (ring_count) {
+		if (ring_tail > ring_head) {
+			if (ring_size - ring_tail >= need)
+				break;
+
+			/* Mark the unused end so the reader wraps as well */
+			if (ring_size - ring_tail >= sizeof(*hdr)) {
+				hdr = (struct ring_hdr *) (ring_buf + ring_tail);
+				hdr->opcode = RING_PAD;
+			}
+
+			ring_tail = 0;
+			continue;
+		}
+
+		if (ring_head - ring_tail >= need)
+			break;
+
+		ring_pop();
+	}
+
+	hdr = (struct ring_hdr *) (ring_buf + ring_tail);
+	hdr->tv = *tv;
+	hdr->opcode = opcode;
+	hdr->index = index;
+	hdr->len = len;
+	memcpy(hdr + 1, data, len);
+
+	ring_tail += need;
+	if (ring_tail == ring_size)
+		ring_tail = 0;
+
+	ring_count++;
+}
+
+static bool open_btsnoop(void)
+{
+	if (btsnoop_file)
+		return true;
+
+	btsnoop_file = btsnoop_create(path, size_limit, max_count,
+							BTSNOOP_FORMAT_MONITOR);
+
+	return btsnoop_file != NULL;
+}
+
+static void ring_flush(struct timeval *tv)
+{
+	struct ring_hdr *hdr;
+
+	if (!open_btsnoop()) {
+		ring_head = ring_tail = ring_count = 0;
+		return;
+	}
+
+	while ((hdr = ring_first())) {
+		if (!pre_time || tv->tv_sec - hdr->tv.tv_sec <=
+							(time_t) pre_time)
+			btsnoop_write_hci(btsnoop_file, &hdr->tv, hdr->index,
+						hdr->opcode, 0, hdr + 1,
+						hdr->len);
+		ring_pop();
+	}
+}
+
+static void post_timeout_callback(int id, void *user_data)
+{
+	mainloop_remove_timeout(id);
+	post_timeout = -1;
+
+	printf("Flight recorder dump complete\n");
+}
+
+static void trigger(struct timeval *tv, const char *reason)
+{
+	/* Already dumping, extend the post trigger window */
+	if (post_timeout >= 0) {
+		mainloop_modify_timeout(post_timeout, post_time * 1000);
+		return;
+	}
+
+	printf("Flight recorder triggered (%s)\n", reason);
+
+	ring_flush(tv);
+
+	if (!post_time) {
+		printf("Flight recorder dump complete\n");
+		return;
+	}
+
+	post_timeout = mainloop_add_timeout(post_time * 1000,
+						post_timeout_callback,
+						NULL, NULL);
+}
+
+static const char *check_trigger(uint16_t opcode, const uint8_t *data,
+								uint16_t len)
+{
+	if (opcode != BTSNOOP_OPCODE_EVENT_PKT || len < 2)
+		return NULL;
+
+	switch (data[0]) {
+	case 0x05:	/* Disconnect Complete */
+		if (len < 6 || data[2])
+			break;
+
+		if (trigger_reasons[data[5] / 8] & (1 << (data[5] % 8)))
+			return "disconnect";
+		break;
+	case 0x0e:	/* Command Complete */
+		if (trigger_errors && len > 5 && data[5])
+			return "command error";
+		break;
+	case 0x0f:	/* Command Status */
+		if (trigger_errors && len > 2 && data[2])
+			return "command error";
+		break;
+	case 0x10:	/* Hardware Error */
+		if (trigger_errors)
+			return "hardware error";
+		break;
+	}
+
+	return NULL;
+}
+
+static void record_packet(struct timeval *tv, uint16_t index,
+				uint16_t opcode, const void *data,
+				uint16_t len)
+{
+	const char *reason;
+
+	if (!ring_buf) {
+		btsnoop_write_hci(btsnoop_file, tv, index, opcode, 0, data,
+									len);
+		return;
+	}
+
+	if (post_timeout >= 0) {
+		btsnoop_write_hci(btsnoop_file, tv, index, opcode, 0, data,
+									len);
+		reason = check_trigger(opcode, data, len);
+		if (reason)
+			trigger(tv, reason);
+		return;
+	}
+
+	ring_push(tv, index, opcode, data, len);
+
+	reason = check_trigger(opcode, data, len);
+	if (reason)
+		trigger(tv, reason);
+}
+
 static void data_callback(int fd, uint32_t events, void *user_data)
 {
 	uint8_t buf[BTSNOOP_MAX_PACKET_SIZE];
@@ -99,8 +354,12 @@ static void data_callback(int fd, uint32_t events, void *user_data)
 		index  = le16_to_cpu(hdr.index);
 		pktlen = le16_to_cpu(hdr.len);
 
-		btsnoop_write_hci(btsnoop_file, tv, index, opcode, 0, buf,
-									pktlen);
+		if (!tv) {
+			gettimeofday(&ctv, NULL);
+			tv = &ctv;
+		}
+
+		record_packet(tv, index, opcode, buf, pktlen);
 	}
 }
 
@@ -145,11 +404,20 @@ static bool open_monitor_channel(void)
 
 static void signal_callback(int signum, void *user_data)
 {
+	struct timeval tv;
+
 	switch (signum) {
 	case SIGINT:
 	case SIGTERM:
 		mainloop_quit();
 		break;
+	case SIGUSR2:
+		if (!ring_buf)
+			break;
+
+		gettimeofday(&tv, NULL);
+		trigger(&tv, "signal");
+		break;
 	}
 }
 
@@ -196,6 +464,16 @@ static void usage(void)
 		"\t-p, --parents          Create basename parent directories\n"
 		"\t-l, --limit <limit>    Limit traces file size (rotate)\n"
 		"\t-c, --count <count>    Limit number of rotated files\n"
+		"\t-r, --ring <limit>     Keep traces in memory (flight\n"
+		"\t                       recorder) and dump on trigger\n"
+		"\t-t, --ring-time <sec>  Limit in-memory traces by age\n"
+		"\t-B, --pre <sec>        Dump traces up to <sec> before\n"
+		"\t                       the trigger (default all)\n"
+		"\t-A, --post <sec>       Dump traces for <sec> after\n"
+		"\t                       the trigger (default 0)\n"
+		"\t-d, --disconnect <reason>[,...]\n"
+		"\t                       Trigger on disconnect reasons\n"
+		"\t-e, --errors           Trigger on HCI error events\n"
 		"\t-v, --version          Show version\n"
 		"\t-h, --help             Show help options\n");
 }
@@ -205,11 +483,61 @@ static const struct option main_options[] = {
 	{ "parents",	no_argument,		NULL, 'p' },
 	{ "limit",	required_argument,	NULL, 'l' },
 	{ "count",	required_argument,	NULL, 'c' },
+	{ "ring",	required_argument,	NULL, 'r' },
+	{ "ring-time",	required_argument,	NULL, 't' },
+	{ "pre",	required_argument,	NULL, 'B' },
+	{ "post",	required_argument,	NULL, 'A' },
+	{ "disconnect",	required_argument,	NULL, 'd' },
+	{ "errors",	no_argument,		NULL, 'e' },
 	{ "version",	no_argument,		NULL, 'v' },
 	{ "help",	no_argument,		NULL, 'h' },
 	{ }
 };
 
+static bool parse_size(const char *str, size_t *size)
+{
+	char *endptr;
+
+	*size = strtoul(str, &endptr, 10);
+
+	if (*size == ULONG_MAX)
+		return false;
+
+	if (*endptr != '\0') {
+		if (*endptr == 'K' || *endptr == 'k')
+			*size *= 1024;
+		else if (*endptr == 'M' || *endptr == 'm')
+			*size *= 1024 * 1024;
+		else
+			return false;
+	}
+
+	return true;
+}
+
+static bool parse_reasons(const char *str)
+{
+	char *endptr;
+	unsigned long reason;
+
+	while (*str) {
+		reason = strtoul(str, &endptr, 0);
+		if (endptr == str || reason > 0xff)
+			return false;
+
+		trigger_reasons[reason / 8] |= 1 << (reason % 8);
+
+		if (*endptr == ',')
+			endptr++;
+		else if (*endptr != '\0')
+			return false;
+
+		str = endptr;
+	}
+
+	return true;
+}
+
 static int create_dir(const char *filename)
 {
 	char *dirc;
@@ -259,9 +587,6 @@ done:
 
 int main(int argc, char *argv[])
 {
-	const char *path = "hci.log";
-	unsigned long max_count = 0;
-	size_t size_limit = 0;
 	bool parents = false;
 	int exit_status;
 	char *endptr;
@@ -273,7 +598,7 @@ int main(int argc, char *argv[])
 	while (true) {
 		int opt;
 
-		opt = getopt_long(argc, argv, "b:l:c:vhp", main_options,
+		opt = getopt_long(argc, argv, "b:l:c:r:t:B:A:d:evhp", main_options,
 									NULL);
 		if (opt < 0)
 			break;
@@ -287,24 +612,11 @@ int main(int argc, char *argv[])
 			}
 			break;
 		case 'l':
-			size_limit = strtoul(optarg, &endptr, 10);
-
-			if (size_limit == ULONG_MAX) {
+			if (!parse_size(optarg, &size_limit)) {
 				fprintf(stderr, "Invalid limit\n");
 				return EXIT_FAILURE;
 			}
 
-			if (*endptr != '\0') {
-				if (*endptr == 'K' || *endptr == 'k') {
-					size_limit *= 1024;
-				} else if (*endptr == 'M' || *endptr == 'm') {
-					size_limit *= 1024 * 1024;
-				} else {
-					fprintf(stderr, "Invalid limit\n");
-					return EXIT_FAILURE;
-				}
-			}
-
 			/* limit this to reasonable size */
 			if (size_limit < 4096) {
 				fprintf(stderr, "Too small limit value\n");
@@ -314,6 +626,48 @@ int main(int argc, char *argv[])
 		case 'c':
 			max_count = strtoul(optarg, &endptr, 10);
 			break;
+		case 'r':
+			if (!parse_size(optarg, &ring_size)) {
+				fprintf(stderr, "Invalid ring limit\n");
+				return EXIT_FAILURE;
+			}
+
+			/* must hold at least a few maximum sized packets */
+			if (ring_size < 64 * 1024) {
+				fprintf(stderr, "Too small ring limit value\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 't':
+			ring_time = strtoul(optarg, &endptr, 10);
+			if (!ring_time || *endptr != '\0') {
+				fprintf(stderr, "Invalid ring time\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'B':
+			pre_time = strtoul(optarg, &endptr, 10);
+			if (*endptr != '\0') {
+				fprintf(stderr, "Invalid pre trigger time\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'A':
+			post_time = strtoul(optarg, &endptr, 10);
+			if (*endptr != '\0') {
+				fprintf(stderr, "Invalid post trigger time\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'd':
+			if (!parse_reasons(optarg)) {
+				fprintf(stderr, "Invalid disconnect reason\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'e':
+			trigger_errors = true;
+			break;
 		case 'p':
 			if (getppid() != 1) {
 				fprintf(stderr, "Parents option allowed only "
@@ -345,9 +699,16 @@ int main(int argc, char *argv[])
 	if (parents && create_dir(path) < 0)
 		return EXIT_FAILURE;
 
-	btsnoop_file = btsnoop_create(path, size_limit, max_count,
-							BTSNOOP_FORMAT_MONITOR);
-	if (!btsnoop_file)
+	if (ring_time && !ring_size)
+		ring_size = RING_DEFAULT_SIZE;
+
+	if (ring_size) {
+		ring_buf = malloc(ring_size);
+		if (!ring_buf) {
+			perror("Failed to allocate ring");
+			return EXIT_FAILURE;
+		}
+	} else if (!open_btsnoop())
 		return EXIT_FAILURE;
 
 	drop_capabilities();
@@ -362,6 +723,7 @@ int main(int argc, char *argv[])
 	mainloop_sd_notify("STATUS=Quitting");
 
 	btsnoop_unref(btsnoop_file);
+	free(ring_buf);
 
 	return exit_status;
 }
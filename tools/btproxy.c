@@ -26,6 +26,7 @@
 #include <stdbool.h>
 #include <termios.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 
@@ -33,6 +34,7 @@
 #include <arpa/inet.h>
 
 #include "src/shared/util.h"
+#include "src/shared/queue.h"
 #include "src/shared/mainloop.h"
 #include "src/shared/ecc.h"
 #include "monitor/bt.h"
@@ -50,11 +52,18 @@ struct sockaddr_hci {
 #define HCI_INDEX_NONE		0xffff
 #define HCI_INDEX_MAX		16
 
+#define PROXY_BUF_SIZE		16384
+#define PROXY_IOV_MAX		64
+
+#define TAP_DIR_HOST		0x00
+#define TAP_DIR_DEV		0x01
+
 static uint64_t hci_index = HCI_INDEX_NONE;
 static bool client_active = false;
 static bool debug_enabled = false;
 static bool emulate_ecc = false;
 static bool skip_first_zero = false;
+static struct queue *tap_clients = NULL;
 
 static void hexdump_print(const char *str, void *user_data)
 {
@@ -64,16 +73,22 @@ static void hexdump_print(const char *str, void *user_data)
 struct proxy {
 	/* Receive commands, ACL, SCO and ISO data */
 	int host_fd;
-	uint8_t host_buf[4096];
+	uint8_t host_buf[PROXY_BUF_SIZE];
 	uint16_t host_len;
 	bool host_shutdown;
 	bool host_skip_first_zero;
+	bool host_stream;
 
 	/* Receive events, ACL, SCO and ISO data */
 	int dev_fd;
-	uint8_t dev_buf[4096];
+	uint8_t dev_buf[PROXY_BUF_SIZE];
 	uint16_t dev_len;
 	bool dev_shutdown;
+	bool dev_stream;
+
+	/* Complete packets pending to be written with a single writev */
+	struct iovec iov[PROXY_IOV_MAX];
+	int iov_cnt;
 
 	/* ECC emulation */
 	uint8_t event_mask[8];
@@ -104,6 +119,106 @@ static bool write_packet(int fd, const void *data, size_t size,
 	return true;
 }
 
+static bool write_packets(int fd, struct iovec *iov, int iovcnt,
+							void *user_data)
+{
+	while (iovcnt > 0) {
+		ssize_t written;
+
+		written = writev(fd, iov, iovcnt);
+		if (written < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			return false;
+		}
+
+		while (iovcnt > 0 && (size_t) written >= iov->iov_len) {
+			if (debug_enabled)
+				util_hexdump('<', iov->iov_base, iov->iov_len,
+						hexdump_print, user_data);
+
+			written -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+
+		if (written > 0) {
+			if (debug_enabled)
+				util_hexdump('<', iov->iov_base, written,
+						hexdump_print, user_data);
+
+			iov->iov_base += written;
+			iov->iov_len -= written;
+		}
+	}
+
+	return true;
+}
+
+static bool is_stream(int fd)
+{
+	int type;
+	socklen_t len = sizeof(type);
+
+	/* Only stream sockets can carry several packets per write, the HCI
+	 * user channel and /dev/vhci expect exactly one packet per write.
+	 */
+	if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) < 0)
+		return false;
+
+	return type == SOCK_STREAM;
+}
+
+static void tap_client_destroy(void *user_data)
+{
+	int fd = PTR_TO_INT(user_data);
+
+	printf("Closing tap client\n");
+
+	queue_remove(tap_clients, user_data);
+	close(fd);
+}
+
+static void tap_client_callback(int fd, uint32_t events, void *user_data)
+{
+	/* Tap clients are read-only, anything else means they went away */
+	mainloop_remove_fd(fd);
+}
+
+static void tap_write(void *data, void *user_data)
+{
+	int fd = PTR_TO_INT(data);
+	struct msghdr *msg = user_data;
+
+	/* Never block the primary path on a slow subscriber */
+	if (sendmsg(fd, msg, MSG_DONTWAIT | MSG_NOSIGNAL) !=
+				(ssize_t) (msg->msg_iov[0].iov_len +
+						msg->msg_iov[1].iov_len)) {
+		fprintf(stderr, "Dropping slow tap client\n");
+		mainloop_remove_fd(fd);
+	}
+}
+
+static void tap_packet(uint8_t dir, void *buf, uint16_t len)
+{
+	struct iovec iov[2];
+	struct msghdr msg;
+
+	if (queue_isempty(tap_clients))
+		return;
+
+	iov[0].iov_base = &dir;
+	iov[0].iov_len = sizeof(dir);
+	iov[1].iov_base = buf;
+	iov[1].iov_len = len;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+
+	queue_foreach(tap_clients, tap_write, &msg);
+}
+
 static void host_write_packet(struct proxy *proxy, void *buf, uint16_t len)
 {
 	if (!write_packet(proxy->dev_fd, buf, len, "D: ")) {
@@ -120,6 +235,43 @@ static void dev_write_packet(struct proxy *proxy, void *buf, uint16_t len)
 	}
 }
 
+/*
+ * On failure both descriptors are closed and the proxy is freed, so the
+ * caller must not touch it anymore.
+ */
+static bool flush_packets(struct proxy *proxy, int fd, const char *prefix)
+{
+	int iov_cnt = proxy->iov_cnt;
+
+	if (!iov_cnt)
+		return true;
+
+	proxy->iov_cnt = 0;
+
+	if (!write_packets(fd, proxy->iov, iov_cnt, (void *) prefix)) {
+		fprintf(stderr, "Write to %s descriptor failed\n",
+				fd == proxy->dev_fd ? "device" : "host");
+		mainloop_remove_fd(fd);
+		return false;
+	}
+
+	return true;
+}
+
+static bool queue_packet(struct proxy *proxy, int fd, const char *prefix,
+						void *buf, uint16_t len)
+{
+	if (proxy->iov_cnt == PROXY_IOV_MAX &&
+				!flush_packets(proxy, fd, prefix))
+		return false;
+
+	proxy->iov[proxy->iov_cnt].iov_base = buf;
+	proxy->iov[proxy->iov_cnt].iov_len = len;
+	proxy->iov_cnt++;
+
+	return true;
+}
+
 static void cmd_status(struct proxy *proxy, uint8_t status, uint16_t opcode)
 {
 	size_t buf_size = 1 + sizeof(struct bt_hci_evt_hdr) +
@@ -287,7 +439,8 @@ static void host_read_callback(int fd, uint32_t events, void *user_data)
 	struct bt_hci_sco_hdr *sco_hdr;
 	struct bt_hci_iso_hdr *iso_hdr;
 	ssize_t len;
-	uint16_t pktlen;
+	uint16_t pktlen, offset = 0;
+	uint8_t *pkt;
 
 	if (events & (EPOLLERR | EPOLLHUP)) {
 		fprintf(stderr, "Error from host descriptor\n");
@@ -329,65 +482,78 @@ static void host_read_callback(int fd, uint32_t events, void *user_data)
 	proxy->host_len += len;
 
 process_packet:
-	if (proxy->host_len < 1)
-		return;
+	if (proxy->host_len - offset < 1)
+		goto done;
 
-	switch (proxy->host_buf[0]) {
+	pkt = proxy->host_buf + offset;
+
+	switch (pkt[0]) {
 	case BT_H4_CMD_PKT:
-		if (proxy->host_len < 1 + sizeof(*cmd_hdr))
-			return;
+		if (proxy->host_len - offset < 1 + sizeof(*cmd_hdr))
+			goto done;
 
-		cmd_hdr = (void *) (proxy->host_buf + 1);
+		cmd_hdr = (void *) (pkt + 1);
 		pktlen = 1 + sizeof(*cmd_hdr) + cmd_hdr->plen;
 		break;
 	case BT_H4_ACL_PKT:
-		if (proxy->host_len < 1 + sizeof(*acl_hdr))
-			return;
+		if (proxy->host_len - offset < 1 + sizeof(*acl_hdr))
+			goto done;
 
-		acl_hdr = (void *) (proxy->host_buf + 1);
+		acl_hdr = (void *) (pkt + 1);
 		pktlen = 1 + sizeof(*acl_hdr) + cpu_to_le16(acl_hdr->dlen);
 		break;
 	case BT_H4_SCO_PKT:
-		if (proxy->host_len < 1 + sizeof(*sco_hdr))
-			return;
+		if (proxy->host_len - offset < 1 + sizeof(*sco_hdr))
+			goto done;
 
-		sco_hdr = (void *) (proxy->host_buf + 1);
+		sco_hdr = (void *) (pkt + 1);
 		pktlen = 1 + sizeof(*sco_hdr) + sco_hdr->dlen;
 		break;
 	case BT_H4_ISO_PKT:
-		if (proxy->host_len < 1 + sizeof(*iso_hdr))
-			return;
+		if (proxy->host_len - offset < 1 + sizeof(*iso_hdr))
+			goto done;
 
-		iso_hdr = (void *) (proxy->host_buf + 1);
+		iso_hdr = (void *) (pkt + 1);
 		pktlen = 1 + sizeof(*iso_hdr) + cpu_to_le16(iso_hdr->dlen);
 		break;
 	case 0xff:
 		/* Notification packet from /dev/vhci - ignore */
-		proxy->host_len = 0;
-		return;
+		offset = proxy->host_len;
+		goto done;
 	default:
 		fprintf(stderr, "Received unknown host packet type 0x%02x\n",
-							proxy->host_buf[0]);
-		mainloop_remove_fd(proxy->host_fd);
+									pkt[0]);
+		/* Forward what was parsed, the buffer is gone after this */
+		if (flush_packets(proxy, proxy->dev_fd, "D: "))
+			mainloop_remove_fd(proxy->host_fd);
 		return;
 	}
 
-	if (proxy->host_len < pktlen)
-		return;
+	if (proxy->host_len - offset < pktlen)
+		goto done;
+
+	tap_packet(TAP_DIR_HOST, pkt, pktlen);
 
 	if (emulate_ecc)
-		host_emulate_ecc(proxy, proxy->host_buf, pktlen);
-	else
-		host_write_packet(proxy, proxy->host_buf, pktlen);
+		host_emulate_ecc(proxy, pkt, pktlen);
+	else if (proxy->dev_stream) {
+		if (!queue_packet(proxy, proxy->dev_fd, "D: ", pkt, pktlen))
+			return;
+	} else
+		host_write_packet(proxy, pkt, pktlen);
 
-	if (proxy->host_len > pktlen) {
-		memmove(proxy->host_buf, proxy->host_buf + pktlen,
-						proxy->host_len - pktlen);
-		proxy->host_len -= pktlen;
-		goto process_packet;
-	}
+	offset += pktlen;
+	goto process_packet;
 
-	proxy->host_len = 0;
+done:
+	if (!flush_packets(proxy, proxy->dev_fd, "D: "))
+		return;
+
+	if (offset < proxy->host_len)
+		memmove(proxy->host_buf, proxy->host_buf + offset,
+						proxy->host_len - offset);
+
+	proxy->host_len -= offset;
 }
 
 static void dev_read_destroy(void *user_data)
@@ -417,7 +583,8 @@ static void dev_read_callback(int fd, uint32_t events, void *user_data)
 	struct bt_hci_sco_hdr *sco_hdr;
 	struct bt_hci_iso_hdr *iso_hdr;
 	ssize_t len;
-	uint16_t pktlen;
+	uint16_t pktlen, offset = 0;
+	uint8_t *pkt;
 
 	if (events & (EPOLLERR | EPOLLHUP)) {
 		fprintf(stderr, "Error from device descriptor\n");
@@ -449,61 +616,74 @@ static void dev_read_callback(int fd, uint32_t events, void *user_data)
 	proxy->dev_len += len;
 
 process_packet:
-	if (proxy->dev_len < 1)
-		return;
+	if (proxy->dev_len - offset < 1)
+		goto done;
 
-	switch (proxy->dev_buf[0]) {
+	pkt = proxy->dev_buf + offset;
+
+	switch (pkt[0]) {
 	case BT_H4_EVT_PKT:
-		if (proxy->dev_len < 1 + sizeof(*evt_hdr))
-			return;
+		if (proxy->dev_len - offset < 1 + sizeof(*evt_hdr))
+			goto done;
 
-		evt_hdr = (void *) (proxy->dev_buf + 1);
+		evt_hdr = (void *) (pkt + 1);
 		pktlen = 1 + sizeof(*evt_hdr) + evt_hdr->plen;
 		break;
 	case BT_H4_ACL_PKT:
-		if (proxy->dev_len < 1 + sizeof(*acl_hdr))
-			return;
+		if (proxy->dev_len - offset < 1 + sizeof(*acl_hdr))
+			goto done;
 
-		acl_hdr = (void *) (proxy->dev_buf + 1);
+		acl_hdr = (void *) (pkt + 1);
 		pktlen = 1 + sizeof(*acl_hdr) + cpu_to_le16(acl_hdr->dlen);
 		break;
 	case BT_H4_SCO_PKT:
-		if (proxy->dev_len < 1 + sizeof(*sco_hdr))
-			return;
+		if (proxy->dev_len - offset < 1 + sizeof(*sco_hdr))
+			goto done;
 
-		sco_hdr = (void *) (proxy->dev_buf + 1);
+		sco_hdr = (void *) (pkt + 1);
 		pktlen = 1 + sizeof(*sco_hdr) + sco_hdr->dlen;
 		break;
 	case BT_H4_ISO_PKT:
-		if (proxy->dev_len < 1 + sizeof(*iso_hdr))
-			return;
+		if (proxy->dev_len - offset < 1 + sizeof(*iso_hdr))
+			goto done;
 
-		iso_hdr = (void *) (proxy->dev_buf + 1);
+		iso_hdr = (void *) (pkt + 1);
 		pktlen = 1 + sizeof(*iso_hdr) + cpu_to_le16(iso_hdr->dlen);
 		break;
 	default:
 		fprintf(stderr, "Received unknown device packet type 0x%02x\n",
-							proxy->dev_buf[0]);
-		mainloop_remove_fd(proxy->dev_fd);
+									pkt[0]);
+		/* Forward what was parsed, the buffer is gone after this */
+		if (flush_packets(proxy, proxy->host_fd, "H: "))
+			mainloop_remove_fd(proxy->dev_fd);
 		return;
 	}
 
-	if (proxy->dev_len < pktlen)
-		return;
+	if (proxy->dev_len - offset < pktlen)
+		goto done;
+
+	tap_packet(TAP_DIR_DEV, pkt, pktlen);
 
 	if (emulate_ecc)
-		dev_emulate_ecc(proxy, proxy->dev_buf, pktlen);
-	else
-		dev_write_packet(proxy, proxy->dev_buf, pktlen);
+		dev_emulate_ecc(proxy, pkt, pktlen);
+	else if (proxy->host_stream) {
+		if (!queue_packet(proxy, proxy->host_fd, "H: ", pkt, pktlen))
+			return;
+	} else
+		dev_write_packet(proxy, pkt, pktlen);
 
-	if (proxy->dev_len > pktlen) {
-		memmove(proxy->dev_buf, proxy->dev_buf + pktlen,
-						proxy->dev_len - pktlen);
-		proxy->dev_len -= pktlen;
-		goto process_packet;
-	}
+	offset += pktlen;
+	goto process_packet;
 
-	proxy->dev_len = 0;
+done:
+	if (!flush_packets(proxy, proxy->host_fd, "H: "))
+		return;
+
+	if (offset < proxy->dev_len)
+		memmove(proxy->dev_buf, proxy->dev_buf + offset,
+						proxy->dev_len - offset);
+
+	proxy->dev_len -= offset;
 }
 
 static bool setup_proxy(int host_fd, bool host_shutdown,
@@ -525,6 +705,9 @@ static bool setup_proxy(int host_fd, bool host_shutdown,
 	proxy->dev_fd = dev_fd;
 	proxy->dev_shutdown = dev_shutdown;
 
+	proxy->host_stream = is_stream(host_fd);
+	proxy->dev_stream = is_stream(dev_fd);
+
 	mainloop_add_fd(proxy->host_fd, EPOLLIN | EPOLLRDHUP,
 				host_read_callback, proxy, host_read_destroy);
 
@@ -623,6 +806,29 @@ static void server_callback(int fd, uint32_t events, void *user_data)
 	client_active = true;
 }
 
+static void tap_server_callback(int fd, uint32_t events, void *user_data)
+{
+	int client_fd;
+
+	if (events & (EPOLLERR | EPOLLHUP)) {
+		mainloop_remove_fd(fd);
+		return;
+	}
+
+	client_fd = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+	if (client_fd < 0) {
+		perror("Failed to accept tap client socket");
+		return;
+	}
+
+	printf("New tap client connected\n");
+
+	queue_push_tail(tap_clients, INT_TO_PTR(client_fd));
+
+	mainloop_add_fd(client_fd, EPOLLIN | EPOLLRDHUP, tap_client_callback,
+				INT_TO_PTR(client_fd), tap_client_destroy);
+}
+
 static int open_unix(const char *path)
 {
 	struct sockaddr_un addr;
@@ -768,6 +974,7 @@ static void usage(void)
 		"\t-i, --index <num>           Use specified controller\n"
 		"\t-a, --amp                   Create AMP controller\n"
 		"\t-e, --ecc                   Emulate ECC support\n"
+		"\t-t, --tap <path>            Mirror traffic to Unix clients\n"
 		"\t-d, --debug                 Enable debugging output\n"
 		"\t-h, --help                  Show help options\n");
 }
@@ -781,6 +988,7 @@ static const struct option main_options[] = {
 	{ "index",    required_argument, NULL, 'i' },
 	{ "amp",      no_argument,       NULL, 'a' },
 	{ "ecc",      no_argument,       NULL, 'e' },
+	{ "tap",      required_argument, NULL, 't' },
 	{ "debug",    no_argument,       NULL, 'd' },
 	{ "version",  no_argument,       NULL, 'v' },
 	{ "help",     no_argument,       NULL, 'h' },
@@ -792,6 +1000,7 @@ int main(int argc, char *argv[])
 	const char *connect_address = NULL;
 	const char *server_address = NULL;
 	const char *unix_path = NULL;
+	const char *tap_path = NULL;
 	unsigned short tcp_port = 0xb1ee;	/* 45550 */
 	bool use_redirect = false;
 	uint8_t type = HCI_PRIMARY;
@@ -801,7 +1010,7 @@ int main(int argc, char *argv[])
 		int opt;
 		int index;
 
-		opt = getopt_long(argc, argv, "rc:l::u::p:i:aezdvh",
+		opt = getopt_long(argc, argv, "rc:l::u::p:i:aet:zdvh",
 						main_options, NULL);
 		if (opt < 0)
 			break;
@@ -858,6 +1067,9 @@ int main(int argc, char *argv[])
 		case 'e':
 			emulate_ecc = true;
 			break;
+		case 't':
+			tap_path = optarg;
+			break;
 		case 'z':
 			skip_first_zero = true;
 			break;
@@ -895,6 +1107,21 @@ int main(int argc, char *argv[])
 
 	mainloop_init();
 
+	tap_clients = queue_new();
+
+	if (tap_path) {
+		int tap_fd;
+
+		printf("Mirroring traffic on %s\n", tap_path);
+
+		tap_fd = open_unix(tap_path);
+		if (tap_fd < 0)
+			return EXIT_FAILURE;
+
+		mainloop_add_fd(tap_fd, EPOLLIN, tap_server_callback,
+							NULL, NULL);
+	}
+
 	if (connect_address || use_redirect) {
 		int host_fd, dev_fd;
 
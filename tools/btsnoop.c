@@ -25,8 +25,11 @@
 #include <getopt.h>
 #include <endian.h>
 #include <arpa/inet.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 
+#include "src/shared/util.h"
 #include "src/shared/btsnoop.h"
 
 struct btsnoop_hdr {
@@ -46,6 +49,8 @@ struct btsnoop_pkt {
 } __attribute__ ((packed));
 #define BTSNOOP_PKT_SIZE (sizeof(struct btsnoop_pkt))
 
+#define MERGE_INDEX_NONE 0xffff
+
 static const uint8_t btsnoop_id[] = { 0x62, 0x74, 0x73, 0x6e,
 				      0x6f, 0x6f, 0x70, 0x00 };
 
@@ -114,149 +119,458 @@ static int open_btsnoop(const char *path, uint32_t *type)
 	return fd;
 }
 
-#define MAX_MERGE 8
+struct merge_input {
+	unsigned int id;
+	uint32_t type;
+	const uint8_t *map;
+	size_t map_size;
+	size_t pos;
+	struct btsnoop *btsnoop;
+	uint64_t ts;
+	uint16_t index;
+	uint16_t opcode;
+	uint32_t drops;
+	const uint8_t *data;
+	uint16_t size;
+	uint8_t buf[BTSNOOP_MAX_PACKET_SIZE];
+};
+
+struct merge_index {
+	unsigned int id;
+	uint16_t index;
+};
 
-static void command_merge(const char *output, int argc, char *argv[])
+struct merge_output {
+	int fd;
+	size_t len;
+	struct merge_index *indexes;
+	unsigned int num_indexes;
+	uint8_t buf[256 * 1024];
+};
+
+static uint64_t slice_from = 0;
+static uint64_t slice_until = UINT64_MAX;
+static int slice_handle = -1;
+
+static bool uart_to_opcode(uint8_t type, uint32_t flags, uint16_t *opcode)
 {
-	struct btsnoop_pkt input_pkt[MAX_MERGE];
-	unsigned char buf[2048];
-	int output_fd, input_fd[MAX_MERGE], num_input = 0;
-	int i, select_input;
-	ssize_t len, written;
-	uint32_t toread, flags;
-	uint16_t index, opcode;
-
-	if (argc > MAX_MERGE) {
-		fprintf(stderr, "only up to %d files allowed\n", MAX_MERGE);
-		return;
+	switch (type) {
+	case 0x01:
+		*opcode = BTSNOOP_OPCODE_COMMAND_PKT;
+		break;
+	case 0x02:
+		if (flags & 0x01)
+			*opcode = BTSNOOP_OPCODE_ACL_RX_PKT;
+		else
+			*opcode = BTSNOOP_OPCODE_ACL_TX_PKT;
+		break;
+	case 0x03:
+		if (flags & 0x01)
+			*opcode = BTSNOOP_OPCODE_SCO_RX_PKT;
+		else
+			*opcode = BTSNOOP_OPCODE_SCO_TX_PKT;
+		break;
+	case 0x04:
+		*opcode = BTSNOOP_OPCODE_EVENT_PKT;
+		break;
+	case 0x05:
+		if (flags & 0x01)
+			*opcode = BTSNOOP_OPCODE_ISO_RX_PKT;
+		else
+			*opcode = BTSNOOP_OPCODE_ISO_TX_PKT;
+		break;
+	default:
+		return false;
 	}
 
-	for (i = 0; i < argc; i++) {
-		uint32_t type;
-		int fd;
+	return true;
+}
 
-		fd = open_btsnoop(argv[i], &type);
-		if (fd < 0)
-			break;
+static bool input_read_btsnoop(struct merge_input *input)
+{
+	const struct btsnoop_pkt *pkt;
+	uint32_t len, flags;
 
-		if (type != 1002) {
-			fprintf(stderr, "unsupported link data type %u\n",
-									type);
-			close(fd);
+	while (input->map_size - input->pos >= BTSNOOP_PKT_SIZE) {
+		pkt = (const void *) (input->map + input->pos);
+		len = be32toh(pkt->len);
+		flags = be32toh(pkt->flags);
+
+		if (len > input->map_size - input->pos - BTSNOOP_PKT_SIZE)
 			break;
+
+		input->pos += BTSNOOP_PKT_SIZE + len;
+
+		if (len > BTSNOOP_MAX_PACKET_SIZE + 1)
+			continue;
+
+		input->ts = be64toh(pkt->ts);
+		input->drops = be32toh(pkt->drops);
+
+		if (input->type == BTSNOOP_FORMAT_MONITOR) {
+			input->index = flags >> 16;
+			input->opcode = flags & 0xffff;
+			input->data = pkt->data;
+			input->size = len;
+			return true;
 		}
 
-		input_fd[num_input++] = fd;
+		if (!len || !uart_to_opcode(pkt->data[0], flags,
+							&input->opcode))
+			continue;
+
+		input->index = input->id;
+		input->data = pkt->data + 1;
+		input->size = len - 1;
+		return true;
 	}
 
-	if (num_input != argc) {
-		fprintf(stderr, "failed to open all input files\n");
-		goto close_input;
+	return false;
+}
+
+static bool input_read_other(struct merge_input *input)
+{
+	struct timeval tv;
+
+	if (!btsnoop_read_hci(input->btsnoop, &tv, &input->index,
+					&input->opcode, input->buf,
+					&input->size))
+		return false;
+
+	input->ts = tv.tv_sec * 1000000ll + tv.tv_usec +
+						0x00E03AB44A676000ll;
+	input->index = input->id;
+	input->drops = 0;
+	input->data = input->buf;
+
+	return true;
+}
+
+static bool input_read(struct merge_input *input)
+{
+	if (input->map)
+		return input_read_btsnoop(input);
+
+	return input_read_other(input);
+}
+
+static bool input_open(struct merge_input *input, const char *path)
+{
+	const struct btsnoop_hdr *hdr;
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		perror("failed to open input file");
+		return false;
 	}
 
-	output_fd = create_btsnoop(output);
-	if (output_fd < 0)
-		goto close_input;
+	if (fstat(fd, &st) < 0) {
+		perror("failed to get input file size");
+		close(fd);
+		return false;
+	}
 
-	for (i = 0; i < num_input; i++) {
-		len = read(input_fd[i], &input_pkt[i], BTSNOOP_PKT_SIZE);
-		if (len < 0 || len != BTSNOOP_PKT_SIZE) {
-			close(input_fd[i]);
-			input_fd[i] = -1;
-		}
+	if ((size_t) st.st_size < BTSNOOP_HDR_SIZE)
+		goto other;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		goto other;
+
+	hdr = map;
+
+	if (memcmp(hdr->id, btsnoop_id, sizeof(btsnoop_id)) ||
+			be32toh(hdr->version) != btsnoop_version) {
+		munmap(map, st.st_size);
+		goto other;
 	}
 
-next_packet:
-	select_input = -1;
+	input->type = be32toh(hdr->type);
+	if (input->type != BTSNOOP_FORMAT_UART &&
+				input->type != BTSNOOP_FORMAT_MONITOR) {
+		fprintf(stderr, "unsupported link data type %u\n",
+								input->type);
+		munmap(map, st.st_size);
+		close(fd);
+		return false;
+	}
+
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	close(fd);
 
-	for (i = 0; i < num_input; i++) {
-		uint64_t ts;
+	input->map = map;
+	input->map_size = st.st_size;
+	input->pos = BTSNOOP_HDR_SIZE;
 
-		if (input_fd[i] < 0)
-			continue;
+	return true;
 
-		if (select_input < 0) {
-			select_input = i;
-			continue;
+other:
+	close(fd);
+
+	/* Fall back to the generic reader for formats like PacketLogger */
+	input->btsnoop = btsnoop_open(path, BTSNOOP_FLAG_PKLG_SUPPORT);
+	if (!input->btsnoop)
+		return false;
+
+	input->type = btsnoop_get_format(input->btsnoop);
+	if (input->type != BTSNOOP_FORMAT_MONITOR) {
+		fprintf(stderr, "unsupported link data type %u\n",
+								input->type);
+		btsnoop_unref(input->btsnoop);
+		input->btsnoop = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+static void input_close(struct merge_input *input)
+{
+	if (input->map)
+		munmap((void *) input->map, input->map_size);
+
+	btsnoop_unref(input->btsnoop);
+}
+
+static bool output_flush(struct merge_output *output)
+{
+	size_t pos = 0;
+	ssize_t written;
+
+	while (pos < output->len) {
+		written = write(output->fd, output->buf + pos,
+							output->len - pos);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("failed to write output");
+			return false;
 		}
 
-		ts = be64toh(input_pkt[i].ts);
+		pos += written;
+	}
 
-		if (ts < be64toh(input_pkt[select_input].ts))
-			select_input = i;
+	output->len = 0;
+
+	return true;
+}
+
+static int output_index(struct merge_output *output,
+					const struct merge_input *input)
+{
+	struct merge_index *indexes;
+	unsigned int i;
+
+	/* Records not bound to a controller keep their special index */
+	if (input->index == MERGE_INDEX_NONE)
+		return MERGE_INDEX_NONE;
+
+	for (i = 0; i < output->num_indexes; i++) {
+		if (output->indexes[i].id == input->id &&
+				output->indexes[i].index == input->index)
+			return i;
+	}
+
+	/*
+	 * Every controller of every input gets its own index in the order
+	 * it first shows up, so that traces taken on different hosts
+	 * never end up on the same index.
+	 */
+	if (output->num_indexes == MERGE_INDEX_NONE) {
+		fprintf(stderr, "too many controllers in input files\n");
+		return -1;
+	}
+
+	indexes = realloc(output->indexes, (output->num_indexes + 1) *
+							sizeof(*indexes));
+	if (!indexes) {
+		fprintf(stderr, "failed to allocate memory\n");
+		return -1;
 	}
 
-	if (select_input < 0)
-		goto close_output;
+	indexes[i].id = input->id;
+	indexes[i].index = input->index;
+
+	output->indexes = indexes;
+	output->num_indexes++;
+
+	return i;
+}
 
-	toread = be32toh(input_pkt[select_input].size);
-	flags = be32toh(input_pkt[select_input].flags);
+static bool output_write(struct merge_output *output,
+					const struct merge_input *input)
+{
+	struct btsnoop_pkt pkt;
+	int index;
 
-	len = read(input_fd[select_input], buf, toread);
-	if (toread == 0 || len < 0 || len != (ssize_t) toread) {
-		close(input_fd[select_input]);
-		input_fd[select_input] = -1;
-		goto next_packet;
+	index = output_index(output, input);
+	if (index < 0)
+		return false;
+
+	if (sizeof(output->buf) - output->len < BTSNOOP_PKT_SIZE +
+								input->size) {
+		if (!output_flush(output))
+			return false;
 	}
 
-	written = htobe32(toread - 1);
-	input_pkt[select_input].size = written;
-	input_pkt[select_input].len = written;
+	pkt.size = htobe32(input->size);
+	pkt.len = htobe32(input->size);
+	pkt.flags = htobe32((index << 16) | input->opcode);
+	pkt.drops = htobe32(input->drops);
+	pkt.ts = htobe64(input->ts);
 
-	switch (buf[0]) {
-	case 0x01:
-		opcode = BTSNOOP_OPCODE_COMMAND_PKT;
-		break;
-	case 0x02:
-		if (flags & 0x01)
-			opcode = BTSNOOP_OPCODE_ACL_RX_PKT;
-		else
-			opcode = BTSNOOP_OPCODE_ACL_TX_PKT;
-		break;
-	case 0x03:
-		if (flags & 0x01)
-			opcode = BTSNOOP_OPCODE_SCO_RX_PKT;
-		else
-			opcode = BTSNOOP_OPCODE_SCO_TX_PKT;
-		break;
-	case 0x04:
-		opcode = BTSNOOP_OPCODE_EVENT_PKT;
-		break;
-	default:
-		goto skip_write;
+	memcpy(output->buf + output->len, &pkt, BTSNOOP_PKT_SIZE);
+	output->len += BTSNOOP_PKT_SIZE;
+
+	memcpy(output->buf + output->len, input->data, input->size);
+	output->len += input->size;
+
+	return true;
+}
+
+static bool input_before(const struct merge_input *a,
+					const struct merge_input *b)
+{
+	if (a->ts != b->ts)
+		return a->ts < b->ts;
+
+	return a->id < b->id;
+}
+
+static void heap_down(struct merge_input **heap, unsigned int num,
+							unsigned int i)
+{
+	while (true) {
+		unsigned int min = i, l = 2 * i + 1, r = 2 * i + 2;
+		struct merge_input *tmp;
+
+		if (l < num && input_before(heap[l], heap[min]))
+			min = l;
+
+		if (r < num && input_before(heap[r], heap[min]))
+			min = r;
+
+		if (min == i)
+			break;
+
+		tmp = heap[i];
+		heap[i] = heap[min];
+		heap[min] = tmp;
+		i = min;
+	}
+}
+
+static bool slice_match(const struct merge_input *input, uint64_t start)
+{
+	switch (input->opcode) {
+	case BTSNOOP_OPCODE_NEW_INDEX:
+	case BTSNOOP_OPCODE_DEL_INDEX:
+	case BTSNOOP_OPCODE_OPEN_INDEX:
+	case BTSNOOP_OPCODE_CLOSE_INDEX:
+	case BTSNOOP_OPCODE_INDEX_INFO:
+		/* Controller records describe every packet that follows */
+		return true;
 	}
 
-	index = select_input;
-	input_pkt[select_input].flags = htobe32((index << 16) | opcode);
+	if (input->ts - start < slice_from)
+		return false;
 
-	written = write(output_fd, &input_pkt[select_input], BTSNOOP_PKT_SIZE);
-	if (written != BTSNOOP_PKT_SIZE) {
-		fprintf(stderr, "write of packet header failed\n");
-		goto close_output;
+	if (slice_handle < 0)
+		return true;
+
+	switch (input->opcode) {
+	case BTSNOOP_OPCODE_ACL_TX_PKT:
+	case BTSNOOP_OPCODE_ACL_RX_PKT:
+	case BTSNOOP_OPCODE_SCO_TX_PKT:
+	case BTSNOOP_OPCODE_SCO_RX_PKT:
+	case BTSNOOP_OPCODE_ISO_TX_PKT:
+	case BTSNOOP_OPCODE_ISO_RX_PKT:
+		if (input->size < 2)
+			return false;
+
+		return (get_le16(input->data) & 0x0fff) == slice_handle;
 	}
 
-	written = write(output_fd, buf + 1, toread - 1);
-	if (written != (ssize_t) toread - 1) {
-		fprintf(stderr, "write of packet data failed\n");
-		goto close_output;
+	/* Commands and events are kept so the slice can still be decoded */
+	return true;
+}
+
+static void command_merge(const char *output_path, int argc, char *argv[])
+{
+	struct merge_input *inputs, **heap;
+	struct merge_output *output;
+	unsigned int num = 0;
+	uint64_t start = 0;
+	int i;
+
+	inputs = calloc(argc, sizeof(*inputs));
+	heap = calloc(argc, sizeof(*heap));
+	output = malloc(sizeof(*output));
+	if (!inputs || !heap || !output) {
+		fprintf(stderr, "failed to allocate memory\n");
+		goto done;
 	}
 
-skip_write:
-	len = read(input_fd[select_input],
-				&input_pkt[select_input], BTSNOOP_PKT_SIZE);
-	if (len < 0 || len != BTSNOOP_PKT_SIZE) {
-		close(input_fd[select_input]);
-		input_fd[select_input] = -1;
+	for (i = 0; i < argc; i++) {
+		inputs[i].id = i;
+
+		if (!input_open(&inputs[i], argv[i])) {
+			fprintf(stderr, "failed to open all input files\n");
+			goto close_input;
+		}
+
+		if (input_read(&inputs[i]))
+			heap[num++] = &inputs[i];
 	}
 
-	goto next_packet;
+	output->fd = create_btsnoop(output_path);
+	if (output->fd < 0)
+		goto close_input;
 
-close_output:
-	close(output_fd);
+	output->len = 0;
+	output->indexes = NULL;
+	output->num_indexes = 0;
+
+	for (i = num / 2; i >= 0; i--)
+		heap_down(heap, num, i);
+
+	if (num)
+		start = heap[0]->ts;
+
+	while (num) {
+		struct merge_input *input = heap[0];
+
+		/* Records are sorted, nothing left once the window is over */
+		if (input->ts - start > slice_until)
+			break;
+
+		if (slice_match(input, start)) {
+			if (!output_write(output, input))
+				break;
+		}
+
+		if (!input_read(input))
+			heap[0] = heap[--num];
+
+		heap_down(heap, num, 0);
+	}
+
+	output_flush(output);
+	close(output->fd);
+	free(output->indexes);
 
 close_input:
-	for (i = 0; i < num_input; i++)
-		close(input_fd[i]);
+	for (i = 0; i < argc; i++)
+		input_close(&inputs[i]);
+
+done:
+	free(output);
+	free(heap);
+	free(inputs);
 }
 
 static void command_extract_eir(const char *input)
@@ -506,12 +820,19 @@ static void usage(void)
 		"\t-m, --merge <output>   Merge multiple btsnoop files\n"
 		"\t-e, --extract <input>  Extract data from btsnoop file\n"
 		"\t-h, --help             Show help options\n");
+	printf("merge options:\n"
+		"\t-f, --from <sec>       Skip packets before <sec>\n"
+		"\t-u, --until <sec>      Skip packets after <sec>\n"
+		"\t-H, --handle <handle>  Only keep data of <handle>\n");
 }
 
 static const struct option main_options[] = {
 	{ "merge",   required_argument, NULL, 'm' },
 	{ "extract", required_argument, NULL, 'e' },
 	{ "type",    required_argument, NULL, 't' },
+	{ "from",    required_argument, NULL, 'f' },
+	{ "until",   required_argument, NULL, 'u' },
+	{ "handle",  required_argument, NULL, 'H' },
 	{ "version", no_argument,       NULL, 'v' },
 	{ "help",    no_argument,       NULL, 'h' },
 	{ }
@@ -519,17 +840,33 @@ static const struct option main_options[] = {
 
 enum { INVALID, MERGE, EXTRACT };
 
+static bool parse_seconds(const char *str, uint64_t *usec)
+{
+	char *endptr;
+	double sec;
+
+	sec = strtod(str, &endptr);
+	if (endptr == str || *endptr != '\0' || sec < 0)
+		return false;
+
+	*usec = sec * 1000000;
+
+	return true;
+}
+
 int main(int argc, char *argv[])
 {
 	const char *output_path = NULL;
 	const char *input_path = NULL;
 	const char *type = NULL;
 	unsigned short command = INVALID;
+	unsigned long handle;
+	char *endptr;
 
 	for (;;) {
 		int opt;
 
-		opt = getopt_long(argc, argv, "m:e:t:vh", main_options, NULL);
+		opt = getopt_long(argc, argv, "m:e:t:f:u:H:vh", main_options, NULL);
 		if (opt < 0)
 			break;
 
@@ -545,6 +882,27 @@ int main(int argc, char *argv[])
 		case 't':
 			type = optarg;
 			break;
+		case 'f':
+			if (!parse_seconds(optarg, &slice_from)) {
+				fprintf(stderr, "invalid from time\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'u':
+			if (!parse_seconds(optarg, &slice_until)) {
+				fprintf(stderr, "invalid until time\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'H':
+			handle = strtoul(optarg, &endptr, 0);
+			if (*endptr != '\0' || handle > 0x0eff) {
+				fprintf(stderr, "invalid handle\n");
+				return EXIT_FAILURE;
+			}
+
+			slice_handle = handle;
+			break;
 		case 'v':
 			printf("%s\n", VERSION);
 			return EXIT_SUCCESS;
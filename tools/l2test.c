@@ -327,6 +327,16 @@ bool use_color(void)
 	return false;
 }
 
+bool use_text(void)
+{
+	return true;
+}
+
+void display_record_field(int indent, const char *prefix, const char *title,
+						const char *fmt, ...)
+{
+}
+
 static const struct bitfield_data phy_table[] = {
 	{  0, "BR1M1SLOT" },
 	{  1, "BR1M3SLOT" },
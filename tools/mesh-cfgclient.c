@@ -2664,6 +2664,7 @@ int main(int argc, char *argv[])
 	l_dbus_client_destroy(client);
 	l_dbus_destroy(dbus);
 
+	mesh_db_cleanup();
 	cfgcli_cleanup();
 
 	return status;
@@ -38,10 +38,16 @@
 #define KEY_IDX_INVALID NET_IDX_INVALID
 #define DEFAULT_LOCATION 0x0000
 
+/* Delay in seconds before changes are written to the configuration file */
+#define SAVE_DELAY 1
+
 struct mesh_db {
 	json_object *jcfg;
 	char *cfg_fname;
 	uint8_t token[8];
+	struct l_hashmap *node_by_unicast;
+	struct l_hashmap *node_by_uuid;
+	struct l_timeout *save_timeout;
 };
 
 static struct mesh_db *cfg;
@@ -110,7 +116,7 @@ static bool save_config_file(const char *fname)
 	return result;
 }
 
-static bool save_config(void)
+static bool write_config(void)
 {
 	char *fname_tmp, *fname_bak, *fname_cfg;
 	bool result = false;
@@ -136,19 +142,142 @@ static bool save_config(void)
 	return result;
 }
 
+static void save_timeout(struct l_timeout *timeout, void *user_data)
+{
+	l_timeout_remove(cfg->save_timeout);
+	cfg->save_timeout = NULL;
+
+	if (!write_config())
+		l_error("Failed to save configuration");
+}
+
+/*
+ * Rewriting the whole configuration after every change gets expensive for
+ * large networks, so changes made in a burst are written out together.
+ */
+static bool save_config(void)
+{
+	if (cfg->save_timeout)
+		return true;
+
+	cfg->save_timeout = l_timeout_create(SAVE_DELAY, save_timeout, NULL,
+									NULL);
+	if (!cfg->save_timeout)
+		return write_config();
+
+	return true;
+}
+
+static bool flush_config(void)
+{
+	if (!cfg->save_timeout)
+		return true;
+
+	l_timeout_remove(cfg->save_timeout);
+	cfg->save_timeout = NULL;
+
+	return write_config();
+}
+
 static void release_config(void)
 {
+	l_timeout_remove(cfg->save_timeout);
+	l_hashmap_destroy(cfg->node_by_unicast, NULL);
+	l_hashmap_destroy(cfg->node_by_uuid, NULL);
 	l_free(cfg->cfg_fname);
 	json_object_put(cfg->jcfg);
 	l_free(cfg);
 	cfg = NULL;
 }
 
+static bool get_node_unicast(json_object *jnode, uint16_t *unicast)
+{
+	json_object *jval;
+	const char *str;
+
+	if (!json_object_object_get_ex(jnode, "unicastAddress", &jval))
+		return false;
+
+	str = json_object_get_string(jval);
+
+	return sscanf(str, "%04hx", unicast) == 1;
+}
+
+static const char *get_node_uuid(json_object *jnode)
+{
+	json_object *jval;
+	const char *str;
+
+	if (!json_object_object_get_ex(jnode, "UUID", &jval))
+		return NULL;
+
+	str = json_object_get_string(jval);
+	if (strlen(str) != 36)
+		return NULL;
+
+	return str;
+}
+
+static void index_node(json_object *jnode)
+{
+	uint16_t unicast;
+	const char *uuid;
+
+	if (get_node_unicast(jnode, &unicast) &&
+			!l_hashmap_lookup(cfg->node_by_unicast,
+						L_UINT_TO_PTR(unicast)))
+		l_hashmap_insert(cfg->node_by_unicast, L_UINT_TO_PTR(unicast),
+									jnode);
+
+	uuid = get_node_uuid(jnode);
+	if (uuid && !l_hashmap_lookup(cfg->node_by_uuid, uuid))
+		l_hashmap_insert(cfg->node_by_uuid, uuid, jnode);
+}
+
+static void unindex_node(json_object *jnode)
+{
+	uint16_t unicast;
+	const char *uuid;
+
+	if (get_node_unicast(jnode, &unicast) &&
+			l_hashmap_lookup(cfg->node_by_unicast,
+					L_UINT_TO_PTR(unicast)) == jnode)
+		l_hashmap_remove(cfg->node_by_unicast, L_UINT_TO_PTR(unicast));
+
+	uuid = get_node_uuid(jnode);
+	if (uuid && l_hashmap_lookup(cfg->node_by_uuid, uuid) == jnode)
+		l_hashmap_remove(cfg->node_by_uuid, uuid);
+}
+
+static void index_nodes(void)
+{
+	json_object *jarray;
+	int i, sz;
+
+	cfg->node_by_unicast = l_hashmap_new();
+	cfg->node_by_uuid = l_hashmap_string_new();
+
+	if (!json_object_object_get_ex(cfg->jcfg, "nodes", &jarray))
+		return;
+
+	if (!jarray || json_object_get_type(jarray) != json_type_array)
+		return;
+
+	sz = json_object_array_length(jarray);
+
+	for (i = 0; i < sz; ++i)
+		index_node(json_object_array_get_idx(jarray, i));
+}
+
 static json_object *get_node_by_unicast(json_object *jcfg, uint16_t unicast)
 {
 	json_object *jarray;
 	int i, sz;
 
+	if (cfg && jcfg == cfg->jcfg)
+		return l_hashmap_lookup(cfg->node_by_unicast,
+						L_UINT_TO_PTR(unicast));
+
 	if (!json_object_object_get_ex(jcfg, "nodes", &jarray))
 		return NULL;
 
@@ -306,6 +435,9 @@ static json_object *get_node_by_uuid(json_object *jcfg, uint8_t uuid[16])
 	if (!l_uuid_to_string(uuid, buf, sizeof(buf)))
 		return NULL;
 
+	if (cfg && jcfg == cfg->jcfg)
+		return l_hashmap_lookup(cfg->node_by_uuid, buf);
+
 	json_object_object_get_ex(jcfg, "nodes", &jarray);
 	if (!jarray || json_object_get_type(jarray) != json_type_array)
 		return NULL;
@@ -1715,8 +1847,14 @@ bool mesh_db_reset_node(uint16_t original, uint16_t unicast, uint8_t num_els)
 		return false;
 	}
 
-	if (!write_uint16_hex(jnode, "unicastAddress", unicast))
+	unindex_node(jnode);
+
+	if (!write_uint16_hex(jnode, "unicastAddress", unicast)) {
+		index_node(jnode);
 		return false;
+	}
+
+	index_node(jnode);
 
 	json_object_object_del(jnode, "elements");
 	jelements = init_elements(num_els);
@@ -1786,6 +1924,7 @@ bool mesh_db_add_node(uint8_t uuid[16], uint8_t num_els, uint16_t unicast,
 		goto fail;
 
 	json_object_array_add(jnodes, jnode);
+	index_node(jnode);
 
 	return save_config();
 
@@ -1796,7 +1935,7 @@ fail:
 
 bool mesh_db_del_node(uint16_t unicast)
 {
-	json_object *jarray;
+	json_object *jarray, *jnode;
 	int i, sz;
 
 	if (!json_object_object_get_ex(cfg->jcfg, "nodes", &jarray))
@@ -1805,29 +1944,21 @@ bool mesh_db_del_node(uint16_t unicast)
 	if (!jarray || json_object_get_type(jarray) != json_type_array)
 		return false;
 
+	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	if (!jnode)
+		return true;
+
 	sz = json_object_array_length(jarray);
 
 	for (i = 0; i < sz; ++i) {
-		json_object *jentry, *jval;
-		uint16_t addr;
-		const char *str;
-
-		jentry = json_object_array_get_idx(jarray, i);
-		if (!json_object_object_get_ex(jentry, "unicastAddress",
-								&jval))
-			continue;
-
-		str = json_object_get_string(jval);
-		if (sscanf(str, "%04hx", &addr) != 1)
-			continue;
-
-		if (addr == unicast)
+		if (json_object_array_get_idx(jarray, i) == jnode)
 			break;
 	}
 
 	if (i == sz)
 		return true;
 
+	unindex_node(jnode);
 	json_object_array_del_idx(jarray, i, 1);
 
 	return save_config();
@@ -2328,6 +2459,8 @@ bool mesh_db_create(const char *fname, const uint8_t token[8],
 	cfg = l_new(struct mesh_db, 1);
 	cfg->jcfg = jcfg;
 	cfg->cfg_fname = l_strdup(fname);
+	cfg->node_by_unicast = l_hashmap_new();
+	cfg->node_by_uuid = l_hashmap_string_new();
 	memcpy(cfg->token, token, 8);
 
 	if (!add_u8_8(jcfg, "token", token))
@@ -2376,7 +2509,7 @@ bool mesh_db_create(const char *fname, const uint8_t token[8],
 
 	write_int(jcfg, "ivIndex", 0);
 
-	if (!save_config())
+	if (!write_config())
 		goto fail;
 
 	return true;
@@ -2387,6 +2520,17 @@ fail:
 	return false;
 }
 
+void mesh_db_cleanup(void)
+{
+	if (!cfg)
+		return;
+
+	if (!flush_config())
+		l_error("Failed to save configuration");
+
+	release_config();
+}
+
 bool mesh_db_load(const char *fname)
 {
 	int fd;
@@ -2431,6 +2575,8 @@ bool mesh_db_load(const char *fname)
 	cfg->jcfg = jcfg;
 	cfg->cfg_fname = l_strdup(fname);
 
+	index_nodes();
+
 	if (!get_token(jcfg, cfg->token)) {
 		l_error("Configuration file missing token");
 		goto fail;
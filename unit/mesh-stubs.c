@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <ell/ell.h>
+
+#include "mesh/mesh-defs.h"
+#include "mesh/node.h"
+#include "mesh/net.h"
+#include "mesh/friend.h"
+#include "mesh/mesh-config.h"
+#include "mesh/model.h"
+#include "mesh/appkey.h"
+#include "mesh/rpl.h"
+
+/*
+ * The parts of the daemon that mesh/net.c calls into, for the unit tests
+ * that include it. Tests still provide the mesh_io functions themselves,
+ * those are where packets are sent and received.
+ */
+
+void appkey_key_free(void *data)
+{
+}
+
+void appkey_finalize(struct mesh_net *net, uint16_t net_idx)
+{
+}
+
+void appkey_delete_bound_keys(struct mesh_net *net, uint16_t net_idx)
+{
+}
+
+void friend_poll(struct mesh_net *net, uint16_t src, bool seq,
+						struct mesh_friend *frnd)
+{
+}
+
+void friend_request(struct mesh_net *net, uint16_t net_idx, uint16_t src,
+			uint8_t minReq, uint8_t delay, uint32_t timeout,
+			uint16_t prev, uint8_t num_elements, uint16_t cntr,
+			int8_t rssi)
+{
+}
+
+void friend_clear_confirm(struct mesh_net *net, uint16_t src, uint16_t lpn,
+							uint16_t lpnCounter)
+{
+}
+
+void friend_clear(struct mesh_net *net, uint16_t src, uint16_t lpn,
+			uint16_t lpnCounter, struct mesh_friend *frnd)
+{
+}
+
+void friend_sub_add(struct mesh_net *net, struct mesh_friend *frnd,
+					const uint8_t *pkt, uint8_t len)
+{
+}
+
+void friend_sub_del(struct mesh_net *net, struct mesh_friend *frnd,
+					const uint8_t *pkt, uint8_t len)
+{
+}
+
+bool mesh_config_net_key_add(struct mesh_config *cfg, uint16_t net_idx,
+							const uint8_t key[16])
+{
+	return true;
+}
+
+bool mesh_config_net_key_update(struct mesh_config *cfg, uint16_t idx,
+							const uint8_t key[16])
+{
+	return true;
+}
+
+bool mesh_config_net_key_del(struct mesh_config *cfg, uint16_t net_idx)
+{
+	return true;
+}
+
+bool mesh_config_net_key_set_phase(struct mesh_config *cfg, uint16_t idx,
+								uint8_t phase)
+{
+	return true;
+}
+
+bool mesh_config_write_iv_index(struct mesh_config *cfg, uint32_t idx,
+								bool update)
+{
+	return true;
+}
+
+bool mesh_model_rx(struct mesh_node *node, bool szmict, uint32_t seq0,
+			uint32_t iv_index, uint16_t net_idx, uint16_t src,
+			uint16_t dst, uint8_t key_aid, const uint8_t *data,
+								uint16_t size)
+{
+	return false;
+}
+
+struct mesh_config *node_config_get(struct mesh_node *node)
+{
+	return NULL;
+}
+
+uint16_t node_get_crpl(struct mesh_node *node)
+{
+	return 0;
+}
+
+void node_property_changed(struct mesh_node *node, const char *property)
+{
+}
+
+bool node_set_sequence_number(struct mesh_node *node, uint32_t seq)
+{
+	return true;
+}
+
+bool rpl_put_entry(struct mesh_node *node, uint16_t src, uint32_t iv_index,
+								uint32_t seq)
+{
+	return true;
+}
+
+bool rpl_get_list(struct mesh_node *node, struct l_queue *rpl_list)
+{
+	return true;
+}
+
+void rpl_update(struct mesh_node *node, uint32_t iv_index)
+{
+}
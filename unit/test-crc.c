@@ -12,6 +12,9 @@
 #include <config.h>
 #endif
 
+#include <stdlib.h>
+#include <time.h>
+
 #include "monitor/crc.h"
 #include "src/shared/tester.h"
 
@@ -162,6 +165,99 @@ static void test_crc(gconstpointer data)
 	tester_test_passed();
 }
 
+/* Reference bit by bit LFSR as described in the Core specification */
+static uint32_t crc24_bitwise(uint32_t preset, const uint8_t *data,
+								uint8_t len)
+{
+	uint32_t state = preset;
+	uint8_t i;
+
+	for (i = 0; i < len; i++) {
+		uint8_t n, cur = data[i];
+
+		for (n = 0; n < 8; n++) {
+			int next_bit = (state ^ cur) & 1;
+
+			cur >>= 1;
+			state >>= 1;
+			if (next_bit) {
+				state |= 1 << 23;
+				state ^= 0x5a6000;
+			}
+		}
+	}
+
+	return state;
+}
+
+static void test_crc_table(gconstpointer data)
+{
+	uint8_t buf[255];
+	uint32_t preset;
+	unsigned int i, len;
+
+	srand(0x5a6000);
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = rand();
+
+	for (len = 0; len <= sizeof(buf); len++) {
+		preset = rand() & 0xffffff;
+
+		g_assert(crc24_calculate(preset, buf, len) ==
+					crc24_bitwise(preset, buf, len));
+	}
+
+	tester_test_passed();
+}
+
+#define BENCHMARK_PACKETS	200000
+
+static double benchmark(uint32_t (*func)(uint32_t preset,
+						const uint8_t *data,
+						uint8_t len),
+				const uint8_t *buf, uint8_t len,
+				uint32_t *crc)
+{
+	struct timespec start, end;
+	uint32_t state = 0x555555;
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < BENCHMARK_PACKETS; i++)
+		state = func(state, buf, len);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	*crc = state;
+
+	return (end.tv_sec - start.tv_sec) +
+				(end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static void test_crc_benchmark(gconstpointer data)
+{
+	uint8_t buf[255];
+	uint32_t crc_table, crc_bits;
+	double table, bits;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+
+	table = benchmark(crc24_calculate, buf, sizeof(buf), &crc_table);
+	bits = benchmark(crc24_bitwise, buf, sizeof(buf), &crc_bits);
+
+	tester_debug("Table: %.1f MB/s, Bitwise: %.1f MB/s",
+			BENCHMARK_PACKETS * sizeof(buf) / table / 1e6,
+			BENCHMARK_PACKETS * sizeof(buf) / bits / 1e6);
+
+	g_assert(crc_table == crc_bits);
+
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -176,5 +272,8 @@ int main(int argc, char *argv[])
 	tester_add("/crc/8", &crc_8, NULL, test_crc, NULL);
 	tester_add("/crc/9", &crc_9, NULL, test_crc, NULL);
 
+	tester_add("/crc/table", NULL, NULL, test_crc_table, NULL);
+	tester_add("/crc/benchmark", NULL, NULL, test_crc_benchmark, NULL);
+
 	return tester_run();
 }
@@ -383,6 +383,60 @@ static void test_sih(const void *data)
 	tester_test_passed();
 }
 
+static void test_sih_batch(const void *data)
+{
+	const uint8_t k[16] = {
+			0xcd, 0xcc, 0x72, 0xdd, 0x86, 0x8c, 0xcd, 0xce,
+			0x22, 0xfd, 0xa1, 0x21, 0x09, 0x7d, 0x7d, 0x45 };
+	const uint8_t sample_hash[3] = { 0xda, 0x48, 0x19 };
+	uint8_t r[100][3];
+	uint8_t hash[100][3];
+	uint8_t exp[3];
+	struct bt_crypto_sih_key *key;
+	size_t i;
+
+	/* The first prand is the one of the CSIS sample data used by sih */
+	for (i = 0; i < ARRAY_SIZE(r); i++) {
+		r[i][0] = 0x63 + i;
+		r[i][1] = 0xf5 - i;
+		r[i][2] = 0x69;
+	}
+
+	key = bt_crypto_sih_key_new(crypto, k);
+	if (!key) {
+		tester_test_failed();
+		return;
+	}
+
+	if (!bt_crypto_sih_batch(key, r[0], hash[0], ARRAY_SIZE(r))) {
+		bt_crypto_sih_key_free(key);
+		tester_test_failed();
+		return;
+	}
+
+	bt_crypto_sih_key_free(key);
+
+	if (memcmp(hash[0], sample_hash, 3)) {
+		tester_test_failed();
+		return;
+	}
+
+	for (i = 1; i < ARRAY_SIZE(r); i++) {
+		if (!bt_crypto_sih(crypto, k, r[i], exp)) {
+			tester_test_failed();
+			return;
+		}
+
+		if (memcmp(hash[i], exp, 3)) {
+			tester_debug("Mismatch at %zu", i);
+			tester_test_failed();
+			return;
+		}
+	}
+
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	int exit_status;
@@ -411,6 +465,7 @@ int main(int argc, char *argv[])
 						NULL, test_verify_sign, NULL);
 	tester_add("/crypto/sef", NULL, NULL, test_sef, NULL);
 	tester_add("/crypto/sih", NULL, NULL, test_sih, NULL);
+	tester_add("/crypto/sih_batch", NULL, NULL, test_sih_batch, NULL);
 
 	exit_status = tester_run();
 
@@ -0,0 +1,262 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tools/mesh/mesh-db.c"
+#include "src/shared/tester.h"
+
+#include <glib.h>
+
+#define NUM_NODES	5000
+#define NUM_ELE		2
+#define FIRST_UNICAST	0x0100
+
+static unsigned int num_remotes;
+
+/* The database reports loaded nodes and keys to these */
+bool remote_add_node(const uint8_t uuid[16], uint16_t unicast,
+					uint8_t ele_cnt, uint16_t net_idx)
+{
+	num_remotes++;
+	return true;
+}
+
+bool remote_set_model(uint16_t unicast, uint8_t ele_idx, uint32_t mod_id,
+								bool vendor)
+{
+	return true;
+}
+
+void remote_add_rejected_address(uint16_t addr, uint32_t iv_index, bool save)
+{
+}
+
+bool remote_add_net_key(uint16_t addr, uint16_t net_idx, bool save)
+{
+	return true;
+}
+
+bool remote_update_net_key(uint16_t addr, uint16_t net_idx, bool update,
+								bool save)
+{
+	return true;
+}
+
+bool remote_add_app_key(uint16_t addr, uint16_t app_idx, bool save)
+{
+	return true;
+}
+
+bool remote_update_app_key(uint16_t addr, uint16_t app_idx, bool update,
+								bool save)
+{
+	return true;
+}
+
+void remote_set_composition(uint16_t addr, bool comp)
+{
+}
+
+void keys_add_net_key(uint16_t net_idx)
+{
+}
+
+void keys_add_app_key(uint16_t net_idx, uint16_t app_idx)
+{
+}
+
+void keys_set_net_key_phase(uint16_t net_idx, uint8_t phase, bool save)
+{
+}
+
+/* Page 0 with two elements carrying Generic OnOff Server and Client */
+static uint8_t comp_data[] = {
+	0x00,
+	0xf1, 0x05, 0x02, 0x00, 0x01, 0x00, 0x0a, 0x00, 0x03, 0x00,
+	0x00, 0x00, 0x01, 0x00, 0x00, 0x10,
+	0x00, 0x00, 0x01, 0x00, 0x01, 0x10,
+};
+
+static char storage_dir[] = "/tmp/mesh-db-XXXXXX";
+
+static double elapsed(const struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (end.tv_sec - start->tv_sec) +
+				(end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void node_uuid(unsigned int i, uint8_t uuid[16])
+{
+	memset(uuid, 0, 16);
+	l_put_be32(i, uuid + 12);
+}
+
+static bool provision_node(unsigned int i)
+{
+	uint16_t unicast = FIRST_UNICAST + i * NUM_ELE;
+	uint8_t uuid[16];
+
+	node_uuid(i, uuid);
+
+	return mesh_db_add_node(uuid, NUM_ELE, unicast, PRIMARY_NET_IDX) &&
+		mesh_db_node_set_composition(unicast, comp_data,
+							sizeof(comp_data));
+}
+
+static bool configure_node(unsigned int i)
+{
+	uint16_t unicast = FIRST_UNICAST + i * NUM_ELE;
+	struct model_pub pub;
+
+	memset(&pub, 0, sizeof(pub));
+	pub.app_idx = 0x001;
+	pub.u.addr = 0xc000;
+	pub.ttl = 5;
+
+	return mesh_db_node_add_app_key(unicast, 0x001) &&
+		mesh_db_node_set_ttl(unicast, 7) &&
+		mesh_db_node_set_relay(unicast, 1, 2, 20) &&
+		mesh_db_node_model_bind(unicast, unicast, false, 0x1000,
+								0x001) &&
+		mesh_db_node_model_bind(unicast, unicast + 1, false, 0x1001,
+								0x001) &&
+		mesh_db_node_model_add_sub(unicast, unicast, false, 0x1000,
+								0xc000) &&
+		mesh_db_node_model_set_pub(unicast, unicast + 1, false,
+							0x1001, &pub, false);
+}
+
+static void test_provision_configure(gconstpointer data)
+{
+	const char *fname = data;
+	uint8_t token[8] = { 0x01 }, uuid[16];
+	struct timespec start;
+	bool result = true;
+	unsigned int i;
+	double secs;
+
+	g_assert(mesh_db_create(fname, token, "Benchmark"));
+	g_assert(mesh_db_add_net_key(PRIMARY_NET_IDX));
+	g_assert(mesh_db_add_app_key(PRIMARY_NET_IDX, 0x001));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < NUM_NODES; i++)
+		result &= provision_node(i);
+
+	secs = elapsed(&start);
+	tester_debug("Provisioned %u nodes in %.3f s", NUM_NODES, secs);
+	g_assert(result);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < NUM_NODES; i++)
+		result &= configure_node(i);
+
+	secs = elapsed(&start);
+	tester_debug("Configured %u nodes in %.3f s", NUM_NODES, secs);
+	g_assert(result);
+
+	/* Provisioning an existing node fails */
+	node_uuid(NUM_NODES / 2, uuid);
+	g_assert(!mesh_db_add_node(uuid, NUM_ELE, 0x7000, PRIMARY_NET_IDX));
+
+	g_assert(mesh_db_del_node(FIRST_UNICAST));
+	g_assert(!mesh_db_node_set_ttl(FIRST_UNICAST, 7));
+
+	/* Reset node moves to its new address */
+	g_assert(mesh_db_reset_node(FIRST_UNICAST + NUM_ELE, 0x7000, NUM_ELE));
+	g_assert(mesh_db_node_set_ttl(0x7000, 7));
+	g_assert(!mesh_db_node_set_ttl(FIRST_UNICAST + NUM_ELE, 7));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	mesh_db_cleanup();
+	tester_debug("Saved configuration in %.3f s", elapsed(&start));
+
+	tester_test_passed();
+}
+
+/* Loads the configuration saved by test_provision_configure() */
+static void test_load(gconstpointer data)
+{
+	const char *fname = data;
+	uint8_t uuid[16];
+	bool result = true;
+	unsigned int i;
+
+	num_remotes = 0;
+
+	g_assert(mesh_db_load(fname));
+	g_assert(num_remotes == NUM_NODES - 1);
+
+	/* Nodes are found by unicast and by UUID after load */
+	for (i = 2; i < NUM_NODES; i++)
+		result &= mesh_db_node_set_ttl(FIRST_UNICAST + i * NUM_ELE, 7);
+
+	g_assert(result);
+
+	node_uuid(NUM_NODES - 1, uuid);
+	g_assert(!mesh_db_add_node(uuid, NUM_ELE, 0x7100, PRIMARY_NET_IDX));
+
+	mesh_db_cleanup();
+
+	tester_test_passed();
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag,
+							struct FTW *ftw)
+{
+	return remove(path);
+}
+
+int main(int argc, char *argv[])
+{
+	char *fname;
+	int status;
+
+	tester_init(&argc, &argv);
+
+	/* Changes are only saved by mesh_db_cleanup() without a main loop */
+	if (!l_main_init())
+		return EXIT_FAILURE;
+
+	if (!mkdtemp(storage_dir)) {
+		perror("Failed to create storage directory");
+		return EXIT_FAILURE;
+	}
+
+	fname = l_strdup_printf("%s/config_db.json", storage_dir);
+
+	tester_add("/mesh/db/provision-configure", fname, NULL,
+					test_provision_configure, NULL);
+	tester_add("/mesh/db/load", fname, NULL, test_load, NULL);
+
+	status = tester_run();
+
+	l_free(fname);
+
+	nftw(storage_dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+
+	l_main_exit();
+
+	return status;
+}
@@ -0,0 +1,349 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mesh/net.c"
+#include "src/shared/tester.h"
+
+#include <glib.h>
+
+#define NODE_ADDR	0x0001
+#define LPN_ADDR	0x0200
+#define SRC_ADDR	0x0100
+#define IV_INDEX	0x12345678
+#define CACHE_SIZE	8
+
+static const uint8_t net_key[16] = {
+	0x7d, 0xd7, 0x36, 0x4c, 0xd8, 0x42, 0xad, 0x18,
+	0xc1, 0x7c, 0x2b, 0x82, 0x0c, 0x84, 0xc3, 0xd6,
+};
+
+/* Nothing is sent or received, Friend Queues are filled directly */
+bool mesh_io_register_recv_cb(struct mesh_io *io, const uint8_t *filter,
+					uint8_t len, mesh_io_recv_func_t cb,
+					void *user_data)
+{
+	return true;
+}
+
+bool mesh_io_deregister_recv_cb(struct mesh_io *io, const uint8_t *filter,
+								uint8_t len)
+{
+	return true;
+}
+
+struct mesh_io_pkt *mesh_io_pkt_new(const uint8_t *data, uint16_t len)
+{
+	return NULL;
+}
+
+struct mesh_io_pkt *mesh_io_pkt_ref(struct mesh_io_pkt *pkt)
+{
+	return pkt;
+}
+
+void mesh_io_pkt_unref(struct mesh_io_pkt *pkt)
+{
+}
+
+bool mesh_io_send_pkt(struct mesh_io *io, struct mesh_io_send_info *info,
+						struct mesh_io_pkt *pkt)
+{
+	return true;
+}
+
+bool mesh_io_send(struct mesh_io *io, struct mesh_io_send_info *info,
+					const uint8_t *data, uint16_t len)
+{
+	return true;
+}
+
+bool mesh_io_send_cancel(struct mesh_io *io, const uint8_t *pattern,
+								uint8_t len)
+{
+	return true;
+}
+
+static struct mesh_net *test_net_new(void)
+{
+	struct mesh_net *net = mesh_net_new(NULL);
+
+	mesh_net_set_iv_index(net, IV_INDEX, false);
+	g_assert(mesh_net_set_key(net, PRIMARY_NET_IDX, net_key, NULL, 0));
+	g_assert(mesh_net_register_unicast(net, NODE_ADDR, 1));
+	g_assert(mesh_net_set_friend_mode(net, true));
+
+	return net;
+}
+
+static struct mesh_friend *test_friend_new(struct mesh_net *net)
+{
+	struct mesh_friend *frnd;
+
+	frnd = mesh_friend_new(net, LPN_ADDR, 1, 100, 10, 100, 0, 1,
+								CACHE_SIZE);
+	g_assert(frnd);
+	g_assert(frnd->cache_size == CACHE_SIZE);
+
+	return frnd;
+}
+
+/* Unsegmented Access message to the LPN, tagged by its SEQ */
+static void queue_msg(struct mesh_friend *frnd, uint32_t seq)
+{
+	struct mesh_friend_msg *rx = mesh_friend_msg_new(0);
+
+	rx->iv_index = IV_INDEX;
+	rx->src = SRC_ADDR;
+	rx->dst = LPN_ADDR;
+	rx->ttl = 5;
+	rx->last_len = 8;
+	rx->u.one[0].seq = seq;
+	memset(rx->u.one[0].data, seq, rx->last_len);
+
+	enqueue_friend_pkt(frnd, rx);
+	l_free(rx);
+}
+
+/* Segmented Access message to the LPN with segments SEQ .. SEQ + seg_max */
+static void queue_seg_msg(struct mesh_friend *frnd, uint32_t seq,
+							uint8_t seg_max)
+{
+	struct mesh_friend_msg *rx = mesh_friend_msg_new(seg_max);
+	uint8_t i;
+
+	rx->iv_index = IV_INDEX;
+	rx->src = SRC_ADDR;
+	rx->dst = LPN_ADDR;
+	rx->ttl = 5;
+	rx->cnt_in = seg_max;
+	rx->last_len = MAX_SEG_LEN;
+
+	for (i = 0; i <= seg_max; i++) {
+		rx->u.s12[i].hdr = ((uint32_t) 0x1 << SEG_HDR_SHIFT) |
+					(seq & SEQ_ZERO_MASK) <<
+							SEQ_ZERO_HDR_SHIFT |
+					i << SEGO_HDR_SHIFT |
+					seg_max << SEGN_HDR_SHIFT;
+		rx->u.s12[i].seq = seq + i;
+	}
+
+	enqueue_friend_pkt(frnd, rx);
+	l_free(rx);
+}
+
+/* Segment Ack for the SAR message starting with seq_zero */
+static void queue_ack(struct mesh_friend *frnd, uint32_t seq,
+					uint16_t seq_zero, uint32_t ack)
+{
+	struct mesh_friend_msg *rx = mesh_friend_msg_new(0);
+
+	rx->iv_index = IV_INDEX;
+	rx->src = SRC_ADDR;
+	rx->dst = LPN_ADDR;
+	rx->ttl = 5;
+	rx->ctl = true;
+	rx->last_len = 4;
+	rx->u.one[0].seq = seq;
+	rx->u.one[0].hdr = NET_OP_SEG_ACKNOWLEDGE << OPCODE_HDR_SHIFT |
+			(seq_zero & SEQ_ZERO_MASK) << SEQ_ZERO_HDR_SHIFT;
+	l_put_be32(ack, rx->u.one[0].data);
+
+	enqueue_friend_pkt(frnd, rx);
+	l_free(rx);
+}
+
+static uint32_t pop_seq(struct mesh_friend *frnd)
+{
+	struct mesh_friend_pdu *pdu = mesh_friend_queue_peek(frnd);
+	uint32_t seq;
+
+	g_assert(pdu);
+	seq = pdu->seq;
+	mesh_friend_queue_pop(frnd);
+
+	return seq;
+}
+
+static void test_net_free(struct mesh_net *net)
+{
+	mesh_net_free(net);
+	g_assert(!frnd_queue_pool);
+}
+
+static void test_wraparound(gconstpointer data)
+{
+	struct mesh_net *net = test_net_new();
+	struct mesh_friend *frnd = test_friend_new(net);
+	uint32_t seq;
+
+	for (seq = 1; seq <= 6; seq++)
+		queue_msg(frnd, seq);
+
+	for (seq = 1; seq <= 4; seq++)
+		g_assert(pop_seq(frnd) == seq);
+
+	/* The tail wraps around the end of the ring */
+	for (seq = 7; seq <= 12; seq++)
+		queue_msg(frnd, seq);
+
+	g_assert(frnd->cache_len == CACHE_SIZE);
+	g_assert(frnd->cache_head == 4);
+
+	for (seq = 5; seq <= 12; seq++)
+		g_assert(pop_seq(frnd) == seq);
+
+	g_assert(!frnd->cache_len);
+	g_assert(!mesh_friend_queue_peek(frnd));
+
+	test_net_free(net);
+
+	tester_test_passed();
+}
+
+static void test_overflow(gconstpointer data)
+{
+	struct mesh_net *net = test_net_new();
+	struct mesh_friend *frnd = test_friend_new(net);
+	uint32_t seq;
+
+	/* Oldest message has 3 segments, the queue is full after it */
+	queue_seg_msg(frnd, 0x100, 2);
+
+	for (seq = 1; seq <= CACHE_SIZE - 3; seq++)
+		queue_msg(frnd, seq);
+
+	g_assert(frnd->cache_len == CACHE_SIZE);
+
+	/* Overflow discards the oldest message with all of its segments */
+	queue_msg(frnd, 6);
+	g_assert(frnd->cache_len == CACHE_SIZE - 2);
+
+	for (seq = 1; seq <= 6; seq++)
+		g_assert(pop_seq(frnd) == seq);
+
+	/* A message with more segments than the queue holds is not queued */
+	queue_seg_msg(frnd, 0x200, CACHE_SIZE);
+	g_assert(!frnd->cache_len);
+
+	/* A segmented message pushes out as many PDUs as it needs */
+	for (seq = 1; seq <= CACHE_SIZE; seq++)
+		queue_msg(frnd, seq);
+
+	queue_seg_msg(frnd, 0x300, 3);
+	g_assert(frnd->cache_len == CACHE_SIZE);
+
+	for (seq = 5; seq <= CACHE_SIZE; seq++)
+		g_assert(pop_seq(frnd) == seq);
+
+	for (seq = 0x300; seq <= 0x303; seq++)
+		g_assert(pop_seq(frnd) == seq);
+
+	test_net_free(net);
+
+	tester_test_passed();
+}
+
+static void test_ack_replace(gconstpointer data)
+{
+	struct mesh_net *net = test_net_new();
+	struct mesh_friend *frnd = test_friend_new(net);
+	struct mesh_friend_pdu *pdu;
+
+	queue_msg(frnd, 1);
+	queue_ack(frnd, 2, 0x0100, 0x00000001);
+	queue_msg(frnd, 3);
+
+	/* A newer Ack to the same SAR message replaces the queued one */
+	queue_ack(frnd, 4, 0x0100, 0x00000003);
+	g_assert(frnd->cache_len == 3);
+
+	pdu = &frnd->pkt_cache[frnd->ack_slot];
+	g_assert(pdu->seq == 4);
+	g_assert(l_get_be32(pdu->data) == 0x00000003);
+
+	/* An Ack to another SAR message is queued behind */
+	queue_ack(frnd, 5, 0x0200, 0x00000001);
+	g_assert(frnd->cache_len == 4);
+
+	/* Once sent, the queued Ack is no longer replaced */
+	pdu = &frnd->pkt_cache[frnd->ack_slot];
+	pdu->sent = true;
+	queue_ack(frnd, 6, 0x0200, 0x00000003);
+	g_assert(frnd->cache_len == 5);
+
+	g_assert(pop_seq(frnd) == 1);
+	g_assert(pop_seq(frnd) == 4);
+	g_assert(pop_seq(frnd) == 3);
+	g_assert(pop_seq(frnd) == 5);
+	g_assert(pop_seq(frnd) == 6);
+
+	/* The replaced slot is gone, the next Ack takes a new one */
+	g_assert(!frnd->ack_queued);
+	queue_ack(frnd, 7, 0x0200, 0x00000007);
+	g_assert(frnd->cache_len == 1);
+
+	test_net_free(net);
+
+	tester_test_passed();
+}
+
+static void test_pool(gconstpointer data)
+{
+	struct mesh_net *net = test_net_new();
+	struct mesh_friend *frnd = test_friend_new(net);
+
+	g_assert(mesh_friend_queue_avail() ==
+					FRND_QUEUE_POOL_MAX - CACHE_SIZE);
+
+	/* Other friendships took the rest of the pool since the offer */
+	frnd_queue_pool = FRND_QUEUE_POOL_MAX;
+	g_assert(!mesh_friend_new(net, LPN_ADDR + 1, 1, 100, 10, 100, 0, 1,
+								CACHE_SIZE));
+
+	/* Replacing a friendship reuses the share of its old Queue */
+	g_assert(mesh_friend_new(net, LPN_ADDR, 1, 100, 10, 100, 0, 2,
+							CACHE_SIZE) == frnd);
+	g_assert(!mesh_friend_new(net, LPN_ADDR, 1, 100, 10, 100, 0, 3,
+							CACHE_SIZE + 1));
+
+	frnd_queue_pool = CACHE_SIZE;
+	test_net_free(net);
+
+	tester_test_passed();
+}
+
+int main(int argc, char *argv[])
+{
+	int status;
+
+	tester_init(&argc, &argv);
+
+	tester_add("/mesh/friend/queue/wraparound", NULL, NULL,
+						test_wraparound, NULL);
+	tester_add("/mesh/friend/queue/overflow", NULL, NULL,
+						test_overflow, NULL);
+	tester_add("/mesh/friend/queue/ack-replace", NULL, NULL,
+						test_ack_replace, NULL);
+	tester_add("/mesh/friend/queue/pool", NULL, NULL, test_pool, NULL);
+
+	status = tester_run();
+
+	mesh_net_cleanup();
+	net_key_cleanup();
+
+	return status;
+}
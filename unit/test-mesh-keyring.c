@@ -0,0 +1,275 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <ell/ell.h>
+
+/* Count every key file the keyring opens */
+static unsigned int num_opens;
+
+static int test_open(const char *path, int flags, ...)
+{
+	mode_t mode = 0;
+	va_list ap;
+
+	va_start(ap, flags);
+	if (flags & O_CREAT)
+		mode = va_arg(ap, int);
+	va_end(ap);
+
+	num_opens++;
+
+	return open(path, flags, mode);
+}
+
+static int test_openat(int dir_fd, const char *path, int flags)
+{
+	num_opens++;
+
+	return openat(dir_fd, path, flags);
+}
+
+#define open test_open
+#define openat test_openat
+
+#include "mesh/keyring.c"
+
+#undef open
+#undef openat
+
+#include "src/shared/tester.h"
+
+#include <glib.h>
+
+static char storage_dir[] = "/tmp/mesh-keyring-XXXXXX";
+
+/* The keyring only needs the storage directory of the node */
+static struct mesh_node *test_node = (struct mesh_node *) storage_dir;
+
+const char *node_get_storage_dir(struct mesh_node *node)
+{
+	return storage_dir;
+}
+
+void dbus_append_byte_array(struct l_dbus_message_builder *builder,
+						const uint8_t *data, int len)
+{
+}
+
+void dbus_append_dict_entry_basic(struct l_dbus_message_builder *builder,
+					const char *key, const char *signature,
+					const void *data)
+{
+}
+
+static void test_dev_keys(gconstpointer data)
+{
+	uint8_t key[16], dev_key[16];
+	unsigned int i, opens;
+	bool result = true;
+
+	memset(key, 0xaa, sizeof(key));
+
+	/* Put opens one file per element */
+	num_opens = 0;
+	g_assert(keyring_put_remote_dev_key(test_node, 0x0100, 3, key));
+	g_assert(num_opens == 3);
+
+	/* Every Config Status message looks up the sender's device key */
+	num_opens = 0;
+
+	for (i = 0; i < 1000; i++) {
+		if (!keyring_get_remote_dev_key(test_node, 0x0100 + i % 3,
+								dev_key) ||
+					memcmp(dev_key, key, sizeof(key)))
+			result = false;
+	}
+
+	opens = num_opens;
+	tester_debug("File opens per config message: %u/1000", opens);
+	g_assert(result);
+	g_assert(opens == 0);
+
+	/* Unknown device key is looked up once */
+	num_opens = 0;
+	g_assert(!keyring_get_remote_dev_key(test_node, 0x0200, dev_key));
+	g_assert(!keyring_get_remote_dev_key(test_node, 0x0200, dev_key));
+	g_assert(num_opens == 1);
+
+	/* Drop the cache, keys must be loaded from storage again */
+	keyring_cleanup(test_node);
+
+	num_opens = 0;
+	g_assert(keyring_get_remote_dev_key(test_node, 0x0101, dev_key));
+	g_assert(!memcmp(dev_key, key, sizeof(key)));
+	g_assert(keyring_get_remote_dev_key(test_node, 0x0101, dev_key));
+	g_assert(num_opens == 1);
+
+	/* Deleting all elements keeps the primary element device key */
+	g_assert(keyring_del_remote_dev_key_all(test_node, 0x0100));
+	g_assert(keyring_get_remote_dev_key(test_node, 0x0100, dev_key));
+
+	num_opens = 0;
+	g_assert(!keyring_get_remote_dev_key(test_node, 0x0101, dev_key));
+	g_assert(num_opens == 0);
+
+	keyring_cleanup(test_node);
+	g_assert(!keyring_get_remote_dev_key(test_node, 0x0102, dev_key));
+
+	keyring_cleanup(test_node);
+
+	tester_test_passed();
+}
+
+static void test_unknown_keys(gconstpointer data)
+{
+	struct key_cache *cache;
+	struct cached_key *entry;
+	uint8_t dev_key[16];
+	unsigned int i;
+
+	/* Senders without a device key only fill the cache up to the cap */
+	num_opens = 0;
+
+	for (i = 0; i < KEYRING_NEG_MAX * 2; i++)
+		g_assert(!keyring_get_remote_dev_key(test_node, 0x1000 + i,
+								dev_key));
+
+	cache = get_cache(test_node, dev_key_dir);
+	g_assert(num_opens == KEYRING_NEG_MAX * 2);
+	g_assert(cache->num_neg == KEYRING_NEG_MAX);
+	g_assert(l_hashmap_size(cache->keys) == KEYRING_NEG_MAX);
+
+	/* Cached misses are served without touching storage */
+	num_opens = 0;
+	g_assert(!keyring_get_remote_dev_key(test_node, 0x1000, dev_key));
+	g_assert(num_opens == 0);
+
+	/* Beyond the cap, misses are looked up every time */
+	g_assert(!keyring_get_remote_dev_key(test_node,
+				0x1000 + KEYRING_NEG_MAX, dev_key));
+	g_assert(num_opens == 1);
+
+	/* An expired miss is looked up again */
+	entry = l_hashmap_lookup(cache->keys, L_UINT_TO_PTR(0x1000));
+	g_assert(entry && !entry->present);
+	entry->expire = 0;
+
+	num_opens = 0;
+	g_assert(!keyring_get_remote_dev_key(test_node, 0x1000, dev_key));
+	g_assert(num_opens == 1);
+	g_assert(cache->num_neg == KEYRING_NEG_MAX);
+
+	/* A stored key replaces its cached miss */
+	memset(dev_key, 0x55, sizeof(dev_key));
+	g_assert(keyring_put_remote_dev_key(test_node, 0x1001, 1, dev_key));
+	g_assert(cache->num_neg == KEYRING_NEG_MAX - 1);
+
+	num_opens = 0;
+	g_assert(keyring_get_remote_dev_key(test_node, 0x1001, dev_key));
+	g_assert(num_opens == 0);
+
+	g_assert(keyring_del_remote_dev_key(test_node, 0x1001, 1));
+
+	keyring_cleanup(test_node);
+
+	tester_test_passed();
+}
+
+static void test_net_app_keys(gconstpointer data)
+{
+	struct keyring_net_key net_key, net_key_get;
+	struct keyring_app_key app_key, app_key_get;
+
+	memset(&net_key, 0, sizeof(net_key));
+	net_key.net_idx = 0x001;
+	memset(net_key.old_key, 0x11, 16);
+	memset(net_key.new_key, 0x11, 16);
+
+	memset(&app_key, 0, sizeof(app_key));
+	app_key.app_idx = 0x002;
+	app_key.net_idx = 0x001;
+	memset(app_key.old_key, 0x22, 16);
+	memset(app_key.new_key, 0x33, 16);
+
+	g_assert(keyring_put_net_key(test_node, 0x001, &net_key));
+	g_assert(keyring_put_app_key(test_node, 0x002, 0x001, &app_key));
+
+	/* Net and app keys are served from cache */
+	num_opens = 0;
+	g_assert(keyring_get_net_key(test_node, 0x001, &net_key_get));
+	g_assert(!memcmp(&net_key, &net_key_get, sizeof(net_key)));
+	g_assert(keyring_get_app_key(test_node, 0x002, &app_key_get));
+	g_assert(!memcmp(&app_key, &app_key_get, sizeof(app_key)));
+	g_assert(num_opens == 0);
+
+	g_assert(keyring_finalize_app_keys(test_node, 0x001));
+	g_assert(keyring_get_app_key(test_node, 0x002, &app_key_get));
+	g_assert(!memcmp(app_key_get.old_key, app_key.new_key, 16));
+
+	g_assert(keyring_del_net_key(test_node, 0x001));
+	g_assert(keyring_del_app_key(test_node, 0x002));
+
+	/* Deleted keys are gone and not looked up */
+	num_opens = 0;
+	g_assert(!keyring_get_net_key(test_node, 0x001, &net_key_get));
+	g_assert(!keyring_get_app_key(test_node, 0x002, &app_key_get));
+	g_assert(num_opens == 0);
+
+	keyring_cleanup(test_node);
+
+	tester_test_passed();
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag,
+							struct FTW *ftw)
+{
+	return remove(path);
+}
+
+int main(int argc, char *argv[])
+{
+	int status;
+
+	tester_init(&argc, &argv);
+
+	if (!mkdtemp(storage_dir)) {
+		perror("Failed to create storage directory");
+		return EXIT_FAILURE;
+	}
+
+	tester_add("/mesh/keyring/dev-keys", NULL, NULL, test_dev_keys, NULL);
+	tester_add("/mesh/keyring/unknown-keys", NULL, NULL,
+						test_unknown_keys, NULL);
+	tester_add("/mesh/keyring/net-app-keys", NULL, NULL,
+						test_net_app_keys, NULL);
+
+	status = tester_run();
+
+	nftw(storage_dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+
+	return status;
+}
@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include "mesh/net-keys.c"
+#include "src/shared/tester.h"
+
+#include <glib.h>
+
+#define NUM_SUBNETS	8
+#define NUM_NODES	32
+#define NUM_ROUNDS	10
+#define PKT_LEN		(9 + 8 + 4)
+#define IV_INDEX	0x00000001
+
+/* Beacons are not exercised, nothing is ever sent */
+struct mesh_io_pkt *mesh_io_pkt_new(const uint8_t *data, uint16_t len)
+{
+	return NULL;
+}
+
+void mesh_io_pkt_unref(struct mesh_io_pkt *pkt)
+{
+}
+
+bool mesh_io_send(struct mesh_io *io, struct mesh_io_send_info *info,
+					const uint8_t *data, uint16_t len)
+{
+	return true;
+}
+
+void net_local_beacon(uint32_t key_id, uint32_t ivi, bool ivu, bool kr)
+{
+}
+
+static uint32_t key_ids[NUM_SUBNETS];
+
+static void subnet_key(unsigned int subnet, uint8_t key[16])
+{
+	memset(key, 0, 16);
+	key[0] = subnet + 1;
+}
+
+static bool build_packet(uint32_t key_id, uint32_t seq, uint8_t *packet)
+{
+	l_put_be32(seq, packet + 1);
+	packet[1] = 5;
+	l_put_be16(0x0100 + seq % 0x100, packet + 5);
+	l_put_be16(0xc000, packet + 7);
+	memset(packet + 9, seq, 8);
+
+	return net_key_encrypt(key_id, IV_INDEX, packet, PKT_LEN);
+}
+
+/* Every local node attached to a subnet tries every received packet */
+static bool deliver(const uint8_t *packet, uint32_t key_id, uint32_t seq)
+{
+	unsigned int node;
+	uint8_t *plain;
+	size_t plain_len;
+	bool result = true;
+
+	for (node = 0; node < NUM_NODES; node++) {
+		if (net_key_decrypt(IV_INDEX, packet, PKT_LEN, &plain,
+						&plain_len) != key_id)
+			return false;
+
+		result &= plain_len == PKT_LEN - 4 &&
+				(l_get_be32(plain + 1) & SEQ_MASK) == seq;
+	}
+
+	return result;
+}
+
+static bool nids_unique(void)
+{
+	const struct net_key *key;
+	unsigned int i;
+
+	for (i = 0; i < NUM_SUBNETS; i++) {
+		key = l_queue_find(keys, match_id, L_UINT_TO_PTR(key_ids[i]));
+		if (!key || l_queue_length(nid_keys[key->nid]) != 1)
+			return false;
+	}
+
+	return true;
+}
+
+static void test_interleaved(gconstpointer data)
+{
+	uint8_t packets[NUM_SUBNETS][PKT_LEN];
+	struct net_key_cache_stats stats;
+	unsigned int i, round;
+	uint32_t seq = 1;
+	bool result = true;
+	uint8_t key[16];
+
+	for (i = 0; i < NUM_SUBNETS; i++) {
+		subnet_key(i, key);
+		key_ids[i] = net_key_add(key);
+		result &= !!key_ids[i];
+	}
+
+	g_assert(result);
+	g_assert(nids_unique());
+
+	for (round = 0; round < NUM_ROUNDS; round++) {
+		/* Packets of all subnets arrive before nodes process them */
+		for (i = 0; i < NUM_SUBNETS; i++)
+			result &= build_packet(key_ids[i], seq + i, packets[i]);
+
+		for (i = 0; i < NUM_SUBNETS; i++)
+			result &= deliver(packets[i], key_ids[i], seq + i);
+
+		for (i = 0; i < NUM_SUBNETS; i++)
+			result &= deliver(packets[i], key_ids[i], seq + i);
+
+		seq += NUM_SUBNETS;
+	}
+
+	g_assert(result);
+
+	net_key_get_cache_stats(&stats);
+	tester_debug("Decrypt cache: %u hits, %u misses, %u decrypts "
+			"(%u%% hit rate)", stats.hits, stats.misses,
+			stats.decrypts,
+			stats.hits * 100 / (stats.hits + stats.misses));
+
+	/* Each packet is decrypted once, with the key of matching NID only */
+	g_assert(stats.misses == NUM_ROUNDS * NUM_SUBNETS);
+	g_assert(stats.decrypts == stats.misses);
+
+	for (i = 0; i < NUM_SUBNETS; i++)
+		net_key_unref(key_ids[i]);
+
+	tester_test_passed();
+}
+
+static void test_unknown_key(gconstpointer data)
+{
+	struct net_key_cache_stats before, after;
+	uint8_t packet[PKT_LEN];
+	uint8_t key[16];
+	uint8_t *plain;
+	size_t plain_len;
+	uint32_t key_id;
+	unsigned int node;
+	bool result = true;
+
+	subnet_key(NUM_SUBNETS, key);
+	key_id = net_key_add(key);
+	g_assert(build_packet(key_id, 1, packet));
+	net_key_unref(key_id);
+
+	net_key_get_cache_stats(&before);
+
+	for (node = 0; node < NUM_NODES; node++)
+		result &= !net_key_decrypt(IV_INDEX, packet, PKT_LEN, &plain,
+								&plain_len);
+
+	net_key_get_cache_stats(&after);
+
+	/* Foreign packet does not decrypt and is looked up once */
+	g_assert(result);
+	g_assert(after.misses - before.misses == 1);
+
+	/* Adding a key must not leave the failed lookup in the cache */
+	key_id = net_key_add(key);
+	g_assert(net_key_decrypt(IV_INDEX, packet, PKT_LEN, &plain,
+						&plain_len) == key_id);
+
+	net_key_unref(key_id);
+	g_assert(!net_key_decrypt(IV_INDEX, packet, PKT_LEN, &plain,
+								&plain_len));
+
+	tester_test_passed();
+}
+
+int main(int argc, char *argv[])
+{
+	int status;
+
+	tester_init(&argc, &argv);
+
+	tester_add("/mesh/net-keys/interleaved", NULL, NULL,
+						test_interleaved, NULL);
+	tester_add("/mesh/net-keys/unknown-key", NULL, NULL,
+						test_unknown_key, NULL);
+
+	status = tester_run();
+
+	net_key_cleanup();
+
+	return status;
+}
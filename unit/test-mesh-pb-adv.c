@@ -0,0 +1,390 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include "mesh/pb-adv.c"
+#include "src/shared/tester.h"
+
+#include <glib.h>
+
+#define NUM_DEVS	16
+#define MAX_STEPS	100000
+
+/* One in LOSS_RATE advertisements is lost on the air */
+#define LOSS_RATE	4
+
+#define PROV_PDU_LEN	40
+
+struct air_pkt {
+	uint8_t count;
+	uint16_t interval;
+	uint16_t len;
+	uint8_t data[PB_ADV_MTU + 6];
+};
+
+/* An unprovisioned device answering on PB-ADV */
+struct sim_dev {
+	unsigned int idx;
+	uint8_t uuid[16];
+	uint32_t link_id;
+	uint8_t peer_trans_num;
+	uint8_t segs;
+	uint8_t got_segs;
+	bool acked;
+	bool replied;
+	bool closed;
+	unsigned int done_ms;
+	prov_trans_tx_t trans_tx;
+	void *trans_data;
+};
+
+static struct sim_dev devs[NUM_DEVS];
+static struct l_queue *air;
+static prov_rx_cb_t prov_rx;
+static unsigned int now_ms;
+static uint32_t loss_seed = 1;
+
+bool mesh_send_pkt(uint8_t count, uint16_t interval, void *data, uint16_t len)
+{
+	struct air_pkt *pkt = l_new(struct air_pkt, 1);
+
+	pkt->count = count;
+	pkt->interval = interval;
+	pkt->len = len;
+	memcpy(pkt->data, data, len);
+	l_queue_push_tail(air, pkt);
+
+	return true;
+}
+
+static bool match_pattern(void *data, void *user_data)
+{
+	struct air_pkt *pkt = data;
+
+	if (memcmp(pkt->data, user_data, 5))
+		return false;
+
+	l_free(pkt);
+	return true;
+}
+
+bool mesh_send_cancel(const uint8_t *filter, uint8_t len)
+{
+	/* Provisioning must not cancel the PDUs of other links */
+	if (len != 5)
+		return false;
+
+	l_queue_foreach_remove(air, match_pattern, (void *) filter);
+
+	return true;
+}
+
+bool mesh_reg_prov_rx(prov_rx_cb_t cb, void *user_data)
+{
+	if (prov_rx && prov_rx != cb)
+		return false;
+
+	prov_rx = cb;
+
+	return true;
+}
+
+void mesh_unreg_prov_rx(prov_rx_cb_t cb)
+{
+	if (prov_rx == cb)
+		prov_rx = NULL;
+}
+
+static void dev_send(struct sim_dev *dev, uint8_t trans_num,
+					const uint8_t *data, uint16_t len)
+{
+	uint8_t buf[PB_ADV_MTU + 6] = { MESH_AD_TYPE_PROVISION };
+
+	l_put_be32(dev->link_id, buf + 1);
+	buf[5] = trans_num;
+	memcpy(buf + 6, data, len);
+
+	if (prov_rx)
+		prov_rx(NULL, buf, len + 6);
+}
+
+static void dev_reply(struct sim_dev *dev)
+{
+	uint8_t reply[5] = { 0x00 };
+
+	/* Single segment Transaction Start carrying the device index */
+	l_put_be16(1, reply + 1);
+	reply[4] = dev->idx;
+	reply[3] = mesh_crypto_compute_fcs(reply + 4, 1);
+	dev_send(dev, 0x80, reply, sizeof(reply));
+}
+
+static void dev_rx(struct sim_dev *dev, const uint8_t *pkt, uint16_t len)
+{
+	uint32_t link_id = l_get_be32(pkt + 1);
+	uint8_t trans_num = pkt[5];
+	uint8_t type = pkt[6];
+	uint8_t ack = PB_ADV_ACK;
+	uint8_t cfm = PB_ADV_OPEN_CFM;
+
+	if (type == PB_ADV_OPEN_REQ) {
+		if (memcmp(pkt + 7, dev->uuid, 16))
+			return;
+
+		dev->link_id = link_id;
+		dev_send(dev, 0, &cfm, 1);
+		return;
+	}
+
+	if (!dev->link_id || link_id != dev->link_id)
+		return;
+
+	if (type == PB_ADV_CLOSE) {
+		dev->closed = true;
+		return;
+	}
+
+	/* Acks of our own PDUs */
+	if (type == PB_ADV_ACK)
+		return;
+
+	if ((type & 0x03) == 0x00) {
+		dev->segs = 0xff >> (7 - (type >> 2));
+		dev->got_segs |= 1;
+	} else if ((type & 0x03) == 0x02)
+		dev->got_segs |= 1 << (type >> 2);
+
+	if (!dev->segs || dev->got_segs != dev->segs)
+		return;
+
+	dev_send(dev, trans_num, &ack, 1);
+
+	if (dev->peer_trans_num == trans_num)
+		return;
+
+	dev->peer_trans_num = trans_num;
+	dev_reply(dev);
+}
+
+static void prov_open(void *user_data, prov_trans_tx_t trans_tx,
+					void *trans_data, uint8_t transport)
+{
+	struct sim_dev *dev = user_data;
+	uint8_t pdu[PROV_PDU_LEN];
+
+	dev->trans_tx = trans_tx;
+	dev->trans_data = trans_data;
+
+	/* Segmented PDU, as a Public Key would be */
+	memset(pdu, dev->idx, sizeof(pdu));
+	trans_tx(trans_data, pdu, sizeof(pdu));
+}
+
+static void prov_close(void *user_data, uint8_t reason)
+{
+	struct sim_dev *dev = user_data;
+
+	dev->closed = true;
+}
+
+static void prov_receive(void *user_data, const void *data, uint16_t size)
+{
+	struct sim_dev *dev = user_data;
+	const uint8_t *pdu = data;
+
+	/* Each PDU must reach the session of the device that sent it */
+	if (size != 1 || pdu[0] != dev->idx)
+		return;
+
+	dev->replied = true;
+	dev->done_ms = now_ms;
+}
+
+static void prov_ack(void *user_data, uint8_t msg_num)
+{
+	struct sim_dev *dev = user_data;
+
+	dev->acked = true;
+}
+
+static bool all_done(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < NUM_DEVS; i++) {
+		if (!devs[i].acked || !devs[i].replied)
+			return false;
+	}
+
+	return true;
+}
+
+static bool air_lost(void)
+{
+	/* Reproducible losses, which do not follow the link schedule */
+	loss_seed = loss_seed * 1103515245 + 12345;
+
+	return !((loss_seed >> 16) % LOSS_RATE);
+}
+
+static void air_step(void)
+{
+	struct air_pkt *pkt, copy;
+	unsigned int i;
+
+	pkt = l_queue_pop_head(air);
+	if (!pkt)
+		return;
+
+	memcpy(&copy, pkt, sizeof(copy));
+
+	if (pkt->count == MESH_IO_TX_COUNT_UNLIMITED || --pkt->count)
+		l_queue_push_tail(air, pkt);
+	else
+		l_free(pkt);
+
+	now_ms += copy.interval;
+
+	if (air_lost())
+		return;
+
+	for (i = 0; i < NUM_DEVS; i++)
+		dev_rx(&devs[i], copy.data, copy.len);
+}
+
+static bool link_ids_unique(void)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < NUM_DEVS; i++) {
+		if (!devs[i].link_id)
+			return false;
+
+		for (j = 0; j < i; j++) {
+			if (devs[i].link_id == devs[j].link_id)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static void test_parallel_sessions(gconstpointer data)
+{
+	unsigned int i, steps, max_ms = 0, sum_ms = 0;
+	bool result = true;
+
+	air = l_queue_new();
+
+	for (i = 0; i < NUM_DEVS; i++) {
+		devs[i].idx = i;
+		devs[i].peer_trans_num = 0xff;
+		l_put_be32(i + 1, devs[i].uuid + 12);
+
+		result &= pb_adv_reg(true, prov_open, prov_close, prov_receive,
+					prov_ack, devs[i].uuid, &devs[i]);
+	}
+
+	/* Links to all devices share the advertising interval */
+	g_assert(result);
+	g_assert(tx_interval() == PB_ADV_MIN_INTERVAL_MS);
+
+	/* Second link to the same device fails */
+	g_assert(!pb_adv_reg(true, prov_open, prov_close, prov_receive,
+					prov_ack, devs[0].uuid, &devs[0]));
+
+	for (steps = 0; steps < MAX_STEPS && !all_done(); steps++)
+		air_step();
+
+	g_assert(link_ids_unique());
+	g_assert(all_done());
+
+	for (i = 0; i < NUM_DEVS; i++) {
+		sum_ms += devs[i].done_ms;
+
+		if (devs[i].done_ms > max_ms)
+			max_ms = devs[i].done_ms;
+	}
+
+	tester_debug("Provisioned %u devices in parallel in %u ms of air time "
+			"(%u ms per device)", NUM_DEVS, max_ms,
+			sum_ms / NUM_DEVS);
+
+	for (i = 0; i < NUM_DEVS; i++)
+		pb_adv_unreg(&devs[i]);
+
+	for (steps = 0; steps < MAX_STEPS && !l_queue_isempty(air); steps++)
+		air_step();
+
+	/* All links are closed and the provisioning receiver is released */
+	for (i = 0; i < NUM_DEVS; i++)
+		g_assert(devs[i].closed);
+
+	g_assert(!prov_rx);
+
+	l_queue_destroy(air, l_free);
+	air = NULL;
+
+	tester_test_passed();
+}
+
+static void test_single_acceptor(gconstpointer data)
+{
+	uint8_t uuid[16] = { 0x01 };
+
+	air = l_queue_new();
+
+	g_assert(pb_adv_reg(false, prov_open, prov_close, prov_receive,
+						prov_ack, uuid, &devs[0]));
+
+	/* Only one session waits to be provisioned */
+	uuid[0] = 0x02;
+	g_assert(!pb_adv_reg(false, prov_open, prov_close, prov_receive,
+						prov_ack, uuid, &devs[1]));
+
+	/* Others can still be provisioned while waiting */
+	g_assert(pb_adv_reg(true, prov_open, prov_close, prov_receive,
+						prov_ack, uuid, &devs[1]));
+
+	pb_adv_unreg(&devs[1]);
+	pb_adv_unreg(&devs[0]);
+
+	l_queue_destroy(air, l_free);
+	air = NULL;
+
+	tester_test_passed();
+}
+
+int main(int argc, char *argv[])
+{
+	int status;
+
+	tester_init(&argc, &argv);
+
+	/* Link timeouts are created, but no ELL main loop ever runs */
+	if (!l_main_init())
+		return EXIT_FAILURE;
+
+	tester_add("/mesh/pb-adv/parallel-sessions", NULL, NULL,
+					test_parallel_sessions, NULL);
+	tester_add("/mesh/pb-adv/single-acceptor", NULL, NULL,
+					test_single_acceptor, NULL);
+
+	status = tester_run();
+
+	l_main_exit();
+
+	return status;
+}
@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ell/ell.h>
+
+/*
+ * Count the memcpy() calls made by mesh/net.c and by the io stubs below.
+ * Copies done elsewhere (crypto, net-keys) are not seen.
+ */
+static unsigned int num_copies;
+
+static void *test_memcpy(void *dest, const void *src, size_t n)
+{
+	num_copies++;
+
+	return memcpy(dest, src, n);
+}
+
+#define memcpy test_memcpy
+
+#include "mesh/net.c"
+
+#undef memcpy
+
+#include "src/shared/tester.h"
+
+#include <glib.h>
+
+#define NODE_ADDR	0x0001
+#define SRC_ADDR	0x0100
+#define DST_ADDR	0x0200
+#define IV_INDEX	0x12345678
+#define SEQ		0x000100
+
+static const uint8_t net_key[16] = {
+	0x7d, 0xd7, 0x36, 0x4c, 0xd8, 0x42, 0xad, 0x18,
+	0xc1, 0x7c, 0x2b, 0x82, 0x0c, 0x84, 0xc3, 0xd6,
+};
+
+/* The only io the network is attached to, packets never reach the air */
+static struct mesh_io *test_io = (struct mesh_io *) net_key;
+static mesh_io_recv_func_t net_recv;
+static struct mesh_io_pkt *sent_pkt;
+static unsigned int num_sent;
+
+bool mesh_io_register_recv_cb(struct mesh_io *io, const uint8_t *filter,
+					uint8_t len, mesh_io_recv_func_t cb,
+					void *user_data)
+{
+	if (filter[0] == MESH_AD_TYPE_NETWORK)
+		net_recv = cb;
+
+	return true;
+}
+
+bool mesh_io_deregister_recv_cb(struct mesh_io *io, const uint8_t *filter,
+								uint8_t len)
+{
+	return true;
+}
+
+struct mesh_io_pkt *mesh_io_pkt_new(const uint8_t *data, uint16_t len)
+{
+	struct mesh_io_pkt *pkt;
+
+	if (!len || len > MESH_IO_PKT_MAX)
+		return NULL;
+
+	pkt = l_new(struct mesh_io_pkt, 1);
+	pkt->ref_count = 1;
+	pkt->len = len;
+
+	if (data)
+		test_memcpy(pkt->data, data, len);
+
+	return pkt;
+}
+
+struct mesh_io_pkt *mesh_io_pkt_ref(struct mesh_io_pkt *pkt)
+{
+	pkt->ref_count++;
+
+	return pkt;
+}
+
+void mesh_io_pkt_unref(struct mesh_io_pkt *pkt)
+{
+	if (pkt && !--pkt->ref_count)
+		l_free(pkt);
+}
+
+bool mesh_io_send_pkt(struct mesh_io *io, struct mesh_io_send_info *info,
+						struct mesh_io_pkt *pkt)
+{
+	/* The transmit queue keeps the buffer it is handed */
+	mesh_io_pkt_unref(sent_pkt);
+	sent_pkt = mesh_io_pkt_ref(pkt);
+	num_sent++;
+
+	return true;
+}
+
+bool mesh_io_send(struct mesh_io *io, struct mesh_io_send_info *info,
+					const uint8_t *data, uint16_t len)
+{
+	struct mesh_io_pkt *pkt = mesh_io_pkt_new(data, len);
+	bool result;
+
+	result = mesh_io_send_pkt(io, info, pkt);
+	mesh_io_pkt_unref(pkt);
+
+	return result;
+}
+
+bool mesh_io_send_cancel(struct mesh_io *io, const uint8_t *pattern,
+								uint8_t len)
+{
+	return true;
+}
+
+/* Unsegmented Access message from another node, as it is seen on the air */
+static uint8_t build_packet(uint32_t key_id, uint32_t seq, uint8_t ttl,
+								uint8_t *ad)
+{
+	uint8_t *packet = ad + 1;
+	uint8_t len = 9 + 8 + 4;
+
+	ad[0] = MESH_AD_TYPE_NETWORK;
+	l_put_be32(seq, packet + 1);
+	packet[1] = ttl;
+	l_put_be16(SRC_ADDR, packet + 5);
+	l_put_be16(DST_ADDR, packet + 7);
+	memset(packet + 9, 0x5a, 8);
+
+	if (!net_key_encrypt(key_id, IV_INDEX, packet, len))
+		return 0;
+
+	return len + 1;
+}
+
+static void test_relay(gconstpointer data)
+{
+	struct mesh_net *net = mesh_net_new(NULL);
+	uint8_t ad[MESH_IO_PKT_MAX];
+	uint8_t *plain;
+	size_t plain_len;
+	uint32_t key_id;
+	unsigned int copies;
+	uint8_t len;
+
+	mesh_net_set_iv_index(net, IV_INDEX, false);
+	g_assert(mesh_net_set_key(net, PRIMARY_NET_IDX, net_key, NULL, 0));
+	g_assert(mesh_net_register_unicast(net, NODE_ADDR, 1));
+	g_assert(mesh_net_set_relay_mode(net, true, 0, 0));
+	g_assert(mesh_net_attach(net, test_io) && net_recv);
+
+	key_id = net_key_add(net_key);
+	len = build_packet(key_id, SEQ, 5, ad);
+	g_assert(len);
+
+	num_copies = 0;
+	net_recv(NULL, NULL, ad, len);
+	copies = num_copies;
+
+	tester_debug("memcpy calls in net.c per relayed packet: %u", copies);
+
+	/* Packet is relayed without net.c copying the packet data */
+	g_assert(num_sent == 1 && sent_pkt);
+	g_assert(!copies);
+	g_assert(sent_pkt->len == len);
+
+	/* The decrypted packet is served from the cache, unchanged */
+	g_assert(net_key_decrypt(IV_INDEX, ad + 1, len - 1,
+					&plain, &plain_len) == key_id);
+	g_assert((plain[1] & TTL_MASK) == 5);
+
+	/* Relayed packet has TTL decremented, SEQ, SRC and DST kept */
+	g_assert(net_key_decrypt(IV_INDEX, sent_pkt->data + 1,
+					sent_pkt->len - 1,
+					&plain, &plain_len) == key_id);
+	g_assert((plain[1] & TTL_MASK) == 4);
+	g_assert((l_get_be32(plain + 1) & SEQ_MASK) == SEQ);
+	g_assert(l_get_be16(plain + 5) == SRC_ADDR);
+	g_assert(l_get_be16(plain + 7) == DST_ADDR);
+
+	/* Duplicates and packets with TTL 1 are not relayed */
+	num_sent = 0;
+	net_recv(NULL, NULL, ad, len);
+	g_assert(!num_sent);
+
+	len = build_packet(key_id, SEQ + 1, 1, ad);
+	net_recv(NULL, NULL, ad, len);
+	g_assert(!num_sent);
+
+	mesh_io_pkt_unref(sent_pkt);
+	sent_pkt = NULL;
+
+	net_key_unref(key_id);
+	mesh_net_detach(net);
+	mesh_net_free(net);
+
+	tester_test_passed();
+}
+
+int main(int argc, char *argv[])
+{
+	int status;
+
+	tester_init(&argc, &argv);
+
+	tester_add("/mesh/net/relay", NULL, NULL, test_relay, NULL);
+
+	status = tester_run();
+
+	mesh_net_cleanup();
+	net_key_cleanup();
+
+	return status;
+}
@@ -0,0 +1,403 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ell/ell.h>
+
+/*
+ * Timers only fire when a test says so, and idle work runs at once, so the
+ * SAR engine can be stepped through without a main loop.
+ */
+struct test_timeout {
+	l_timeout_notify_cb_t callback;
+	void *user_data;
+	l_timeout_destroy_cb_t destroy;
+	uint64_t ms;
+};
+
+static struct l_timeout *test_timeout_create_ms(uint64_t milliseconds,
+					l_timeout_notify_cb_t callback,
+					void *user_data,
+					l_timeout_destroy_cb_t destroy)
+{
+	struct test_timeout *timeout = l_new(struct test_timeout, 1);
+
+	timeout->callback = callback;
+	timeout->user_data = user_data;
+	timeout->destroy = destroy;
+	timeout->ms = milliseconds;
+
+	return (struct l_timeout *) timeout;
+}
+
+static struct l_timeout *test_timeout_create(unsigned int seconds,
+					l_timeout_notify_cb_t callback,
+					void *user_data,
+					l_timeout_destroy_cb_t destroy)
+{
+	return test_timeout_create_ms(seconds * 1000ULL, callback, user_data,
+								destroy);
+}
+
+static void test_timeout_modify_ms(struct l_timeout *timeout,
+							uint64_t milliseconds)
+{
+	((struct test_timeout *) timeout)->ms = milliseconds;
+}
+
+static void test_timeout_modify(struct l_timeout *timeout,
+							unsigned int seconds)
+{
+	test_timeout_modify_ms(timeout, seconds * 1000ULL);
+}
+
+static void test_timeout_remove(struct l_timeout *timeout)
+{
+	struct test_timeout *t = (struct test_timeout *) timeout;
+
+	if (!t)
+		return;
+
+	if (t->destroy)
+		t->destroy(t->user_data);
+
+	l_free(t);
+}
+
+static bool test_idle_oneshot(l_idle_notify_cb_t callback, void *user_data,
+						l_idle_destroy_cb_t destroy)
+{
+	callback(user_data);
+
+	if (destroy)
+		destroy(user_data);
+
+	return true;
+}
+
+#define l_timeout_create test_timeout_create
+#define l_timeout_create_ms test_timeout_create_ms
+#define l_timeout_modify test_timeout_modify
+#define l_timeout_modify_ms test_timeout_modify_ms
+#define l_timeout_remove test_timeout_remove
+#define l_idle_oneshot test_idle_oneshot
+
+#include "mesh/net.c"
+
+#undef l_timeout_create
+#undef l_timeout_create_ms
+#undef l_timeout_modify
+#undef l_timeout_modify_ms
+#undef l_timeout_remove
+#undef l_idle_oneshot
+
+#include "src/shared/tester.h"
+
+#include <glib.h>
+
+#define NODE_ADDR	0x0001
+#define DST_ADDR	0x0200
+#define FRND_ADDR	0x0300
+#define GROUP_ADDR	0xc000
+#define IV_INDEX	0x12345678
+
+static const uint8_t net_key[16] = {
+	0x7d, 0xd7, 0x36, 0x4c, 0xd8, 0x42, 0xad, 0x18,
+	0xc1, 0x7c, 0x2b, 0x82, 0x0c, 0x84, 0xc3, 0xd6,
+};
+
+/* The only io the network is attached to, packets never reach the air */
+static struct mesh_io *test_io = (struct mesh_io *) net_key;
+static uint8_t sent_segs[64];
+static unsigned int num_sent;
+
+bool mesh_io_register_recv_cb(struct mesh_io *io, const uint8_t *filter,
+					uint8_t len, mesh_io_recv_func_t cb,
+					void *user_data)
+{
+	return true;
+}
+
+bool mesh_io_deregister_recv_cb(struct mesh_io *io, const uint8_t *filter,
+								uint8_t len)
+{
+	return true;
+}
+
+struct mesh_io_pkt *mesh_io_pkt_new(const uint8_t *data, uint16_t len)
+{
+	struct mesh_io_pkt *pkt;
+
+	if (!len || len > MESH_IO_PKT_MAX)
+		return NULL;
+
+	pkt = l_new(struct mesh_io_pkt, 1);
+	pkt->ref_count = 1;
+	pkt->len = len;
+
+	if (data)
+		memcpy(pkt->data, data, len);
+
+	return pkt;
+}
+
+struct mesh_io_pkt *mesh_io_pkt_ref(struct mesh_io_pkt *pkt)
+{
+	pkt->ref_count++;
+
+	return pkt;
+}
+
+void mesh_io_pkt_unref(struct mesh_io_pkt *pkt)
+{
+	if (pkt && !--pkt->ref_count)
+		l_free(pkt);
+}
+
+/* Record the SegO of each segment put on the air */
+bool mesh_io_send_pkt(struct mesh_io *io, struct mesh_io_send_info *info,
+						struct mesh_io_pkt *pkt)
+{
+	uint8_t *plain;
+	size_t plain_len;
+
+	g_assert(net_key_decrypt(IV_INDEX, pkt->data + 1, pkt->len - 1,
+						&plain, &plain_len));
+	g_assert(num_sent < sizeof(sent_segs));
+
+	sent_segs[num_sent++] = (l_get_be32(plain + 9) >> SEGO_HDR_SHIFT) &
+								SEG_MASK;
+
+	return true;
+}
+
+bool mesh_io_send(struct mesh_io *io, struct mesh_io_send_info *info,
+					const uint8_t *data, uint16_t len)
+{
+	struct mesh_io_pkt *pkt = mesh_io_pkt_new(data, len);
+	bool result;
+
+	result = mesh_io_send_pkt(io, info, pkt);
+	mesh_io_pkt_unref(pkt);
+
+	return result;
+}
+
+bool mesh_io_send_cancel(struct mesh_io *io, const uint8_t *pattern,
+								uint8_t len)
+{
+	return true;
+}
+
+static const uint8_t msg[36] = { 0x5a };
+
+static struct mesh_net *create_net(void)
+{
+	struct mesh_net *net = mesh_net_new(NULL);
+
+	mesh_net_set_iv_index(net, IV_INDEX, false);
+	g_assert(mesh_net_set_key(net, PRIMARY_NET_IDX, net_key, NULL, 0));
+	g_assert(mesh_net_register_unicast(net, NODE_ADDR, 1));
+	g_assert(mesh_net_attach(net, test_io));
+
+	num_sent = 0;
+
+	return net;
+}
+
+static void destroy_net(struct mesh_net *net)
+{
+	mesh_net_detach(net);
+	mesh_net_free(net);
+}
+
+/* Segments of 12 octets each, sent with TTL 5 */
+static struct mesh_sar *send_msg(struct mesh_net *net, uint16_t dst,
+								uint16_t len)
+{
+	uint32_t seq = mesh_net_next_seq_num(net);
+
+	g_assert(mesh_net_app_send(net, false, NODE_ADDR, dst, APP_AID_DEV,
+					PRIMARY_NET_IDX, 5, 0, 0, seq, IV_INDEX,
+					true, false, msg, len));
+
+	return l_hashmap_lookup(net->sar_out, L_UINT_TO_PTR(dst));
+}
+
+static uint64_t timeout_ms(struct mesh_sar *sar)
+{
+	return ((struct test_timeout *) sar->seg_timeout)->ms;
+}
+
+static void fire_timeout(struct mesh_sar *sar)
+{
+	struct test_timeout *timeout = (struct test_timeout *) sar->seg_timeout;
+
+	timeout->callback(sar->seg_timeout, timeout->user_data);
+}
+
+/* Run the transaction to dst until it is given up, no ACKs arrive */
+static void run_to_end(struct mesh_net *net, uint16_t dst)
+{
+	struct mesh_sar *sar;
+
+	while ((sar = l_hashmap_lookup(net->sar_out, L_UINT_TO_PTR(dst))))
+		fire_timeout(sar);
+}
+
+static void test_pacing(gconstpointer data)
+{
+	struct mesh_net *net = create_net();
+	const struct mesh_net_sar_tx *cfg = mesh_net_get_sar_tx(net);
+	struct mesh_sar *sar;
+
+	/* Only the first segment goes out at once */
+	sar = send_msg(net, DST_ADDR, sizeof(msg));
+	g_assert(sar);
+	g_assert(num_sent == 1 && sent_segs[0] == 0);
+	g_assert(timeout_ms(sar) == SAR_SEG_INT(cfg->seg_int_step));
+
+	/* The others follow one Segment Interval apart */
+	fire_timeout(sar);
+	g_assert(num_sent == 2 && sent_segs[1] == 1);
+	g_assert(timeout_ms(sar) == SAR_SEG_INT(cfg->seg_int_step));
+
+	/* The last one waits for the ACK over 5 hops */
+	fire_timeout(sar);
+	g_assert(num_sent == 3 && sent_segs[2] == 2);
+	g_assert(timeout_ms(sar) == SAR_RTX_INT(cfg->unicast_rtx_int_step) +
+				SAR_RTX_INT(cfg->unicast_rtx_int_inc) * 4);
+
+	/* Another message to the same destination waits its turn */
+	g_assert(send_msg(net, DST_ADDR, 24) == sar);
+	g_assert(num_sent == 3);
+
+	ack_received(net, DST_ADDR, false, sar->seqZero, 0x00000007);
+	sar = l_hashmap_lookup(net->sar_out, L_UINT_TO_PTR(DST_ADDR));
+	g_assert(sar && sar->flags == 0x00000003);
+	g_assert(num_sent == 4 && sent_segs[3] == 0);
+
+	destroy_net(net);
+
+	tester_test_passed();
+}
+
+static void test_ack(gconstpointer data)
+{
+	struct mesh_net *net = create_net();
+	struct mesh_sar *sar;
+	uint16_t seq0;
+
+	sar = send_msg(net, DST_ADDR, sizeof(msg));
+	seq0 = sar->seqZero;
+	fire_timeout(sar);
+	fire_timeout(sar);
+	g_assert(num_sent == 3);
+
+	/* Only the missing segments are sent again, at once */
+	ack_received(net, DST_ADDR, false, seq0, 0x00000001);
+	g_assert(num_sent == 4 && sent_segs[3] == 1);
+
+	/* ACKs for another message, or from another node, are ignored */
+	ack_received(net, DST_ADDR, false, seq0 + 1, 0x00000006);
+	ack_received(net, FRND_ADDR, false, seq0, 0x00000006);
+	g_assert(l_hashmap_lookup(net->sar_out, L_UINT_TO_PTR(DST_ADDR)));
+
+	/* ACKs add up, a later one need not repeat earlier segments */
+	ack_received(net, DST_ADDR, false, seq0, 0x00000002);
+	g_assert(sar->last_nak == 0x00000003 && sar->pending == 0x00000004);
+
+	/* A Friend ACKs on behalf of its Low Power Node, with OBO set */
+	ack_received(net, FRND_ADDR, true, seq0, 0x00000004);
+	g_assert(!l_hashmap_lookup(net->sar_out, L_UINT_TO_PTR(DST_ADDR)));
+
+	/* An empty ACK cancels the transaction */
+	sar = send_msg(net, DST_ADDR, sizeof(msg));
+	ack_received(net, DST_ADDR, false, sar->seqZero, 0x00000000);
+	g_assert(!l_hashmap_lookup(net->sar_out, L_UINT_TO_PTR(DST_ADDR)));
+
+	destroy_net(net);
+
+	tester_test_passed();
+}
+
+static void test_budget(gconstpointer data)
+{
+	struct mesh_net *net = create_net();
+	struct mesh_net_sar_tx cfg = *mesh_net_get_sar_tx(net);
+	struct mesh_sar *sar;
+
+	/* Initial round plus two retransmissions of both segments */
+	cfg.unicast_rtx_cnt = 2;
+	cfg.unicast_rtx_wo_prog_cnt = 15;
+	g_assert(mesh_net_set_sar_tx(net, &cfg));
+	send_msg(net, DST_ADDR, 24);
+	run_to_end(net, DST_ADDR);
+	g_assert(num_sent == 2 * 3);
+
+	/* Without progress, one retransmission is all there is */
+	cfg.unicast_rtx_cnt = 15;
+	cfg.unicast_rtx_wo_prog_cnt = 1;
+	g_assert(mesh_net_set_sar_tx(net, &cfg));
+	num_sent = 0;
+	send_msg(net, DST_ADDR, 24);
+	run_to_end(net, DST_ADDR);
+	g_assert(num_sent == 2 * 2);
+
+	/* Progress restores the without progress budget */
+	num_sent = 0;
+	sar = send_msg(net, DST_ADDR, sizeof(msg));
+	fire_timeout(sar);
+	fire_timeout(sar);
+	fire_timeout(sar);
+	fire_timeout(sar);
+	fire_timeout(sar);
+	g_assert(num_sent == 3 + 3);
+	ack_received(net, DST_ADDR, false, sar->seqZero, 0x00000001);
+	g_assert(num_sent == 3 + 3 + 1);
+	run_to_end(net, DST_ADDR);
+	g_assert(num_sent == 3 + 3 + 2);
+
+	/* Nothing ACKs a group, each round is sent in full */
+	cfg.multicast_rtx_cnt = 1;
+	g_assert(mesh_net_set_sar_tx(net, &cfg));
+	num_sent = 0;
+	send_msg(net, GROUP_ADDR, sizeof(msg));
+	run_to_end(net, GROUP_ADDR);
+	g_assert(num_sent == 3 * 2);
+
+	destroy_net(net);
+
+	tester_test_passed();
+}
+
+int main(int argc, char *argv[])
+{
+	int status;
+
+	tester_init(&argc, &argv);
+
+	tester_add("/mesh/sar/pacing", NULL, NULL, test_pacing, NULL);
+	tester_add("/mesh/sar/ack", NULL, NULL, test_ack, NULL);
+	tester_add("/mesh/sar/budget", NULL, NULL, test_budget, NULL);
+
+	status = tester_run();
+
+	mesh_net_cleanup();
+	net_key_cleanup();
+
+	return status;
+}
@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "lib/bluetooth.h"
+
+#include "src/shared/util.h"
+#include "src/shared/btsnoop.h"
+#include "monitor/bt.h"
+#include "monitor/packet.h"
+#include "monitor/keys.h"
+#include "monitor/control.h"
+#include "src/shared/tester.h"
+
+#include <glib.h>
+
+#define CONN_HANDLE	0x0040
+#define NUM_NOTIFY	20000
+
+struct trace_data {
+	const char *name;
+	unsigned int num_notify;
+};
+
+static char trace_path[] = "/tmp/test-monitor-XXXXXX";
+static char output_path[] = "/tmp/test-monitor-out-XXXXXX";
+
+static const struct trace_data att_notify = {
+	.name = "ATT notifications",
+	.num_notify = NUM_NOTIFY,
+};
+
+static void write_pkt(struct btsnoop *snoop, struct timeval *tv,
+				uint16_t opcode, const void *data, uint16_t size)
+{
+	/* Fixed packet spacing, so that the trace is the same every run */
+	tv->tv_usec += 7500;
+	if (tv->tv_usec >= 1000000) {
+		tv->tv_sec++;
+		tv->tv_usec -= 1000000;
+	}
+
+	g_assert(btsnoop_write_hci(snoop, tv, 0, opcode, 0, data, size));
+}
+
+static void write_conn(struct btsnoop *snoop, struct timeval *tv)
+{
+	struct {
+		struct bt_hci_evt_hdr hdr;
+		uint8_t subevent;
+		struct bt_hci_evt_le_conn_complete evt;
+	} __attribute__ ((packed)) pkt;
+	static const uint8_t peer[6] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0xc6 };
+
+	memset(&pkt, 0, sizeof(pkt));
+	pkt.hdr.evt = BT_HCI_EVT_LE_META_EVENT;
+	pkt.hdr.plen = sizeof(pkt) - sizeof(pkt.hdr);
+	pkt.subevent = BT_HCI_EVT_LE_CONN_COMPLETE;
+	pkt.evt.handle = cpu_to_le16(CONN_HANDLE);
+	pkt.evt.peer_addr_type = 0x01;
+	memcpy(pkt.evt.peer_addr, peer, sizeof(peer));
+	pkt.evt.interval = cpu_to_le16(0x0018);
+	pkt.evt.supv_timeout = cpu_to_le16(0x0048);
+
+	write_pkt(snoop, tv, BTSNOOP_OPCODE_EVENT_PKT, &pkt, sizeof(pkt));
+}
+
+static void write_notify(struct btsnoop *snoop, struct timeval *tv,
+							unsigned int i)
+{
+	uint8_t pkt[4 + 4 + 3 + 8];
+
+	/* ACL start fragment with a complete L2CAP frame on the ATT CID */
+	put_le16(CONN_HANDLE | 0x2000, pkt);
+	put_le16(sizeof(pkt) - 4, pkt + 2);
+	put_le16(sizeof(pkt) - 8, pkt + 4);
+	put_le16(0x0004, pkt + 6);
+	pkt[8] = 0x1b;
+	put_le16(0x0010 + i % 4, pkt + 9);
+	memset(pkt + 11, i, 8);
+
+	write_pkt(snoop, tv, BTSNOOP_OPCODE_ACL_RX_PKT, pkt, sizeof(pkt));
+}
+
+static void create_trace(const struct trace_data *data)
+{
+	struct btsnoop_opcode_new_index index;
+	struct timeval tv = { .tv_sec = 1 };
+	struct btsnoop *snoop;
+	unsigned int i;
+
+	snoop = btsnoop_create(trace_path, 0, 0, BTSNOOP_FORMAT_MONITOR);
+	g_assert(snoop);
+
+	memset(&index, 0, sizeof(index));
+	index.type = BTSNOOP_TYPE_PRIMARY;
+	index.bus = BTSNOOP_BUS_VIRTUAL;
+	strcpy(index.name, "hci0");
+	write_pkt(snoop, &tv, BTSNOOP_OPCODE_NEW_INDEX, &index,
+							sizeof(index));
+
+	write_conn(snoop, &tv);
+
+	for (i = 0; i < data->num_notify; i++)
+		write_notify(snoop, &tv, i);
+
+	btsnoop_unref(snoop);
+}
+
+static unsigned int count_str(const char *output, const char *str)
+{
+	unsigned int count = 0;
+
+	while ((output = strstr(output, str))) {
+		output += strlen(str);
+		count++;
+	}
+
+	return count;
+}
+
+static void check_output(const struct trace_data *data)
+{
+	gchar *output;
+	gsize len;
+
+	g_assert(g_file_get_contents(output_path, &output, &len, NULL));
+
+	g_assert(count_str(output, "LE Connection Complete") == 1);
+	g_assert(count_str(output, "ATT: Handle Value Notification (0x1b)"
+				" len 10") == data->num_notify);
+	g_assert(count_str(output, "Handle: 0x0010") ==
+						(data->num_notify + 3) / 4);
+
+	/* The value of every notification is decoded */
+	g_assert(count_str(output, "Data[8]: ") == data->num_notify);
+
+	g_free(output);
+}
+
+static void test_decode_benchmark(gconstpointer test_data)
+{
+	const struct trace_data *data = test_data;
+	struct timespec start, end;
+	int fd, out;
+	double secs;
+
+	create_trace(data);
+
+	/* Only the decoding is measured, not the terminal */
+	fflush(stdout);
+	out = dup(STDOUT_FILENO);
+	fd = open(output_path, O_WRONLY | O_TRUNC | O_CLOEXEC);
+	g_assert(out >= 0 && fd >= 0);
+	dup2(fd, STDOUT_FILENO);
+	close(fd);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	control_reader(trace_path, false);
+	fflush(stdout);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	dup2(out, STDOUT_FILENO);
+	close(out);
+
+	secs = (end.tv_sec - start.tv_sec) +
+				(end.tv_nsec - start.tv_nsec) / 1e9;
+
+	tester_debug("Decoded %u %s in %.3f s (%.0f packets/s)",
+				data->num_notify, data->name, secs,
+				data->num_notify / secs);
+
+	check_output(data);
+
+	unlink(trace_path);
+	unlink(output_path);
+
+	tester_test_passed();
+}
+
+int main(int argc, char *argv[])
+{
+	int fd, status;
+
+	tester_init(&argc, &argv);
+
+	fd = mkstemp(trace_path);
+	if (fd < 0) {
+		perror("Failed to create trace file");
+		return EXIT_FAILURE;
+	}
+
+	close(fd);
+
+	fd = mkstemp(output_path);
+	if (fd < 0) {
+		perror("Failed to create output file");
+		unlink(trace_path);
+		return EXIT_FAILURE;
+	}
+
+	close(fd);
+
+	keys_setup();
+	packet_set_filter(0);
+
+	tester_add("/monitor/decode/att/benchmark", &att_notify, NULL,
+					test_decode_benchmark, NULL);
+
+	status = tester_run();
+
+	keys_cleanup();
+
+	return status;
+}
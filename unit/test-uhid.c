@@ -17,7 +17,9 @@
 #include <stdbool.h>
 #include <inttypes.h>
 #include <string.h>
+#include <stddef.h>
 #include <fcntl.h>
+#include <time.h>
 #include <sys/socket.h>
 
 #include <glib.h>
@@ -353,6 +355,154 @@ static struct test_device mx_anywhere_3 = {
 				0xC0),
 };
 
+#define BENCH_REPORTS	20000
+#define BENCH_CHUNK	32
+
+struct bench {
+	struct bt_uhid *uhid;
+	guint source;
+	guint idle;
+	unsigned int sent;
+	unsigned int received;
+	struct timespec start;
+	struct timespec cpu_start;
+};
+
+static double timespec_diff(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+static void bench_done(struct bench *bench)
+{
+	struct timespec end, cpu_end;
+	double elapsed, cpu;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+
+	elapsed = timespec_diff(&bench->start, &end);
+	cpu = timespec_diff(&bench->cpu_start, &cpu_end);
+
+	/* CPU time includes the receiving end as well */
+	tester_print("%u reports in %.3f ms: %.0f reports/s, %.3f us CPU/report",
+				bench->received, elapsed * 1000,
+				bench->received / elapsed,
+				cpu * 1e6 / bench->received);
+
+	if (bench->idle)
+		g_source_remove(bench->idle);
+
+	g_source_remove(bench->source);
+	bt_uhid_unregister_all(bench->uhid);
+	bt_uhid_unref(bench->uhid);
+	g_free(bench);
+
+	tester_test_passed();
+}
+
+static gboolean bench_handler(GIOChannel *channel, GIOCondition cond,
+							gpointer user_data)
+{
+	struct bench *bench = user_data;
+	unsigned char buf[sizeof(struct uhid_event) * 2];
+	struct uhid_event *ev;
+	ssize_t len, offset;
+
+	if (cond & (G_IO_NVAL | G_IO_ERR | G_IO_HUP)) {
+		tester_test_failed();
+		return FALSE;
+	}
+
+	len = read(g_io_channel_unix_get_fd(channel), buf, sizeof(buf));
+	g_assert(len > 0);
+
+	/* Batched reports arrive in a single packet over the socketpair */
+	for (offset = 0; offset < len; ) {
+		ev = (void *) (buf + offset);
+
+		if (ev->type != UHID_INPUT2)
+			return TRUE;
+
+		offset += offsetof(struct uhid_event, u.input2.data) +
+							ev->u.input2.size;
+		bench->received++;
+	}
+
+	if (bench->received == BENCH_REPORTS) {
+		bench->source = 0;
+		bench_done(bench);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean bench_send(gpointer user_data)
+{
+	struct bench *bench = user_data;
+	uint8_t report[8] = { 0x01 };
+	int i;
+
+	/* Emulate a burst of reports arriving in one mainloop iteration */
+	for (i = 0; i < BENCH_CHUNK && bench->sent < BENCH_REPORTS; i++) {
+		report[1] = bench->sent;
+		g_assert(bt_uhid_input(bench->uhid, 0, report,
+						sizeof(report)) == 0);
+		bench->sent++;
+	}
+
+	if (bench->sent < BENCH_REPORTS)
+		return TRUE;
+
+	bench->idle = 0;
+	return FALSE;
+}
+
+static void bench_start(struct uhid_event *ev, void *user_data)
+{
+	struct bench *bench = user_data;
+
+	clock_gettime(CLOCK_MONOTONIC, &bench->start);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &bench->cpu_start);
+
+	bench->idle = g_idle_add(bench_send, bench);
+}
+
+static void test_benchmark(gconstpointer data)
+{
+	const struct uhid_event ev_start = { .type = UHID_START };
+	struct bench *bench = g_new0(struct bench, 1);
+	GIOChannel *channel;
+	int err, sv[2];
+
+	err = socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv);
+	g_assert(err == 0);
+
+	bench->uhid = bt_uhid_new(sv[0]);
+	g_assert(bench->uhid != NULL);
+
+	bt_uhid_set_close_on_unref(bench->uhid, true);
+	bt_uhid_register(bench->uhid, UHID_START, bench_start, bench);
+
+	g_assert(bt_uhid_create(bench->uhid, "bench", NULL, NULL, 0, 0, 0, 0,
+					BT_UHID_MOUSE, NULL, 0) == 0);
+
+	channel = g_io_channel_unix_new(sv[1]);
+	g_io_channel_set_close_on_unref(channel, TRUE);
+	g_io_channel_set_encoding(channel, NULL, NULL);
+	g_io_channel_set_buffered(channel, FALSE);
+
+	bench->source = g_io_add_watch(channel,
+				G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL,
+				bench_handler, bench);
+	g_io_channel_unref(channel);
+
+	/* Let the kernel side start the device */
+	g_assert(write(sv[1], &ev_start, sizeof(ev_start)) ==
+							sizeof(ev_start));
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -369,5 +519,7 @@ int main(int argc, char *argv[])
 	define_test_device("/uhid/device/mx_anywhere_3", test_client,
 					&mx_anywhere_3, event(&ev_create));
 
+	tester_add("/uhid/benchmark/input", NULL, NULL, test_benchmark, NULL);
+
 	return tester_run();
 }